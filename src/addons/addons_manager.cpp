@@ -22,6 +22,7 @@
 
 #include "addons/news_manager.hpp"
 #include "addons/zip.hpp"
+#include "addons/zip_package.hpp"
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
@@ -468,7 +469,9 @@ bool AddonsManager::anyAddonsInstalled() const
 // ----------------------------------------------------------------------------
 /** Installs or updates (i.e. = install on top of an existing installation) an
  *  addon. It checks for the directories and then unzips the file (which must
- *  already have been downloaded).
+ *  already have been downloaded). If possible (see ZipPackage::canBeMounted)
+ *  the zip file is not extracted, but moved into the data directory and
+ *  mounted, so the addon is loaded directly from the zip file.
  *  \param addon Addon data for the addon to install.
  *  \return true if installation was successful.
  */
@@ -481,20 +484,46 @@ bool AddonsManager::install(const Addon &addon)
     std::string from      = file_manager->getAddonsFile("tmp/"+base_name);
     std::string to        = addon.getDataDir();
 
-    bool success = extract_zip(from, to);
-    if (!success)
+    // Remove the package of a previous installation of this addon
+    const std::string package = to + "/" + ZipPackage::PACKAGE_NAME;
+    file_manager->unmountAddonPackage(to);
+    file_manager->removeFile(package);
+
+    bool mounted = false;
+    if (UserConfigParams::m_mount_addons)
     {
-        // TODO: show a message in the interface
-        Log::error("addons", "Failed to unzip '%s' to '%s'.",
-                    from.c_str(), to.c_str());
-        Log::error("addons", "Zip file will not be removed.");
-        return false;
+        ZipPackage *zip = new ZipPackage(from, to);
+        const bool can_be_mounted = zip->canBeMounted();
+        zip->drop();
+        mounted = can_be_mounted && rename(from.c_str(), package.c_str())==0
+               && file_manager->mountAddonPackage(to);
+        if (can_be_mounted && !mounted)
+        {
+            Log::warn("addons", "Could not mount '%s', extracting it.",
+                      from.c_str());
+            // Move the zip back if it was renamed, but could not be mounted
+            if (file_manager->fileExists(package))
+                rename(package.c_str(), from.c_str());
+        }
     }
 
-    if(!file_manager->removeFile(from))
+    if (!mounted)
     {
-        Log::error("addons", "Problems removing temporary file '%s'.",
-                    from.c_str());
+        bool success = extract_zip(from, to);
+        if (!success)
+        {
+            // TODO: show a message in the interface
+            Log::error("addons", "Failed to unzip '%s' to '%s'.",
+                        from.c_str(), to.c_str());
+            Log::error("addons", "Zip file will not be removed.");
+            return false;
+        }
+
+        if(!file_manager->removeFile(from))
+        {
+            Log::error("addons", "Problems removing temporary file '%s'.",
+                        from.c_str());
+        }
     }
 
     int index = getAddonIndex(addon.getId());
@@ -558,6 +587,7 @@ bool AddonsManager::uninstall(const Addon &addon)
     // because the kart/track was never added in the first place
     if (file_manager->fileExists(addon.getDataDir()))
     {
+        file_manager->unmountAddonPackage(addon.getDataDir());
         error = !file_manager->removeDirectory(addon.getDataDir());
 
         // Even if an error happened when removing the data files
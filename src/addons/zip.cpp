@@ -19,6 +19,7 @@
 #include <iostream>
 #include <fstream>
 
+#include "addons/zip_package.hpp"
 #include "graphics/irr_driver.hpp"
 #include "io/file_manager.hpp"
 #include "utils/string_utils.hpp"
@@ -50,11 +51,30 @@ s32 IFileSystem_copyFileToFile(IWriteFile* dst, IReadFile* src)
 
 // ----------------------------------------------------------------------------
 /** Extracts all files from the zip archive 'from' to the directory 'to'.
+ *  The files are inflated in large chunks directly into the destination
+ *  files, several files at the same time, see ZipPackage.
  *  \param from A zip archive.
  *  \param to The destination directory.
  *  \return True if successful.
  */
 bool extract_zip(const std::string &from, const std::string &to)
+{
+    ZipPackage *package = new ZipPackage(from, to);
+    const bool success = package->extractAll(to);
+    package->drop();
+    return success;
+}   // extract_zip
+
+// ----------------------------------------------------------------------------
+/** Extracts all files from the zip archive 'from' to the directory 'to'
+ *  using the irrlicht zip reader. This is the previous implementation of
+ *  extract_zip, which is only kept to compare it with ZipPackage in
+ *  ZipPackage::benchmark.
+ *  \param from A zip archive.
+ *  \param to The destination directory.
+ *  \return True if successful.
+ */
+bool extract_zip_irrlicht(const std::string &from, const std::string &to)
 {
     //Add the zip to the file system
     IFileSystem *file_system = irr_driver->getDevice()->getFileSystem();
@@ -117,4 +137,4 @@ bool extract_zip(const std::string &from, const std::string &to)
     file_system->removeFileArchive(file_system->getAbsolutePath(from.c_str()));
 
     return !error;
-}   // extract_zip
+}   // extract_zip_irrlicht
@@ -23,5 +23,6 @@
   * \ingroup addonsgroup
   */
 bool extract_zip(const std::string &from, const std::string &to);
+bool extract_zip_irrlicht(const std::string &from, const std::string &to);
 
 #endif
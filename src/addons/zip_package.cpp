@@ -0,0 +1,535 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "addons/zip_package.hpp"
+
+#include "addons/zip.hpp"
+#include "io/file_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
+
+#include <IReadFile.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+const char *ZipPackage::PACKAGE_NAME = "package.zip";
+
+namespace
+{
+    /** Reads a little endian 16 bit value. */
+    uint16_t get16(const unsigned char *p)
+    {
+        return (uint16_t)(p[0] | (p[1] << 8));
+    }   // get16
+    // ------------------------------------------------------------------------
+    /** Reads a little endian 32 bit value. */
+    uint32_t get32(const unsigned char *p)
+    {
+        return (uint32_t)p[0]         | ((uint32_t)p[1] << 8) |
+              ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }   // get32
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Opens a zip file and reads its index.
+ *  \param filename Name of the zip file.
+ *  \param mount_dir The directory in which the files appear when the
+ *         package is mounted.
+ */
+ZipPackage::ZipPackage(const std::string &filename,
+                       const std::string &mount_dir)
+{
+    m_filename   = filename;
+    m_mount_dir  = normalisePath(mount_dir + "/");
+    m_mount_path = m_mount_dir.c_str();
+    m_is_valid   = false;
+
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+    {
+        Log::warn("ZipPackage", "Can't open '%s'.", filename.c_str());
+        return;
+    }
+    m_is_valid = readIndex(f);
+    fclose(f);
+    if (!m_is_valid)
+        Log::warn("ZipPackage", "'%s' is not a supported zip file.",
+                  filename.c_str());
+}   // ZipPackage
+
+// ----------------------------------------------------------------------------
+/** Reads the central directory of the zip file and the local headers of
+ *  all files (to get the offset of the data).
+ *  \param f The opened zip file.
+ *  \return False if the file is not a zip file, or uses features that are
+ *          not supported (zip64, encryption, compression other than
+ *          deflate).
+ */
+bool ZipPackage::readIndex(FILE *f)
+{
+    // Find the end of central directory record, which is followed by a
+    // comment of at most 64 KB.
+    if (fseek(f, 0, SEEK_END) != 0)
+        return false;
+    const long file_size = ftell(f);
+    const long tail_size = std::min(file_size, 22L + 65535L);
+    std::vector<unsigned char> tail(tail_size);
+    if (tail_size < 22 || fseek(f, file_size - tail_size, SEEK_SET) != 0 ||
+        fread(&tail[0], 1, tail_size, f) != (size_t)tail_size)
+        return false;
+    long eocd = tail_size - 22;
+    while (eocd >= 0 && get32(&tail[eocd]) != 0x06054b50)
+        eocd--;
+    if (eocd < 0)
+        return false;
+
+    const unsigned int num_entries = get16(&tail[eocd + 10]);
+    const uint32_t cd_size         = get32(&tail[eocd + 12]);
+    const uint32_t cd_offset       = get32(&tail[eocd + 16]);
+    if (num_entries == 0xffff || cd_offset == 0xffffffff ||
+        (long)cd_offset + (long)cd_size > file_size)
+        return false;
+
+    std::vector<unsigned char> cd(cd_size + 1);
+    if (fseek(f, cd_offset, SEEK_SET) != 0 ||
+        fread(&cd[0], 1, cd_size, f) != cd_size)
+        return false;
+
+    uint32_t p = 0;
+    for (unsigned int i = 0; i < num_entries; i++)
+    {
+        if (p + 46 > cd_size || get32(&cd[p]) != 0x02014b50)
+            return false;
+        const uint16_t flags       = get16(&cd[p + 8]);
+        const uint16_t method      = get16(&cd[p + 10]);
+        const unsigned int name_length    = get16(&cd[p + 28]);
+        const unsigned int extra_length   = get16(&cd[p + 30]);
+        const unsigned int comment_length = get16(&cd[p + 32]);
+        if (p + 46 + name_length > cd_size)
+            return false;
+
+        Entry entry;
+        entry.m_crc             = get32(&cd[p + 16]);
+        entry.m_compressed_size = get32(&cd[p + 20]);
+        entry.m_size            = get32(&cd[p + 24]);
+        entry.m_offset          = get32(&cd[p + 42]);
+        entry.m_method          = method;
+        const std::string path((const char*)&cd[p + 46], name_length);
+        p += 46 + name_length + extra_length + comment_length;
+
+        // Directories and hidden files are not extracted
+        const std::string name = StringUtils::getBasename(path);
+        if (path.empty() || path[path.size() - 1] == '/' || name.empty() ||
+            name[0] == '.')
+            continue;
+
+        // Encrypted files and unknown compression methods
+        if ((flags & 1) != 0 || (method != 0 && method != 8))
+            return false;
+
+        // Get the size of the local header to find the data
+        unsigned char local[30];
+        if (fseek(f, entry.m_offset, SEEK_SET) != 0 ||
+            fread(local, 1, 30, f) != 30 || get32(local) != 0x04034b50)
+            return false;
+        entry.m_offset += 30 + get16(&local[26]) + get16(&local[28]);
+        if ((long)entry.m_offset + (long)entry.m_compressed_size > file_size)
+            return false;
+        // A stored file is not compressed, and deflate can not compress
+        // by more than a factor of 1032, so larger sizes are corrupt.
+        if ((method == 0 && entry.m_size != entry.m_compressed_size) ||
+            (uint64_t)entry.m_size >
+                                 (uint64_t)entry.m_compressed_size*1032 + 1024)
+            return false;
+
+        entry.m_name      = name.c_str();
+        entry.m_full_name = (m_mount_dir + name).c_str();
+
+        // Like extract_zip, a later file with the same name replaces the
+        // earlier one.
+        std::map<std::string, unsigned int>::iterator j = m_index.find(name);
+        if (j != m_index.end())
+        {
+            m_entries[j->second] = entry;
+        }
+        else
+        {
+            m_index[name] = (unsigned int)m_entries.size();
+            m_entries.push_back(entry);
+        }
+    }   // for i < num_entries
+    return true;
+}   // readIndex
+
+// ----------------------------------------------------------------------------
+/** Reads one file of the archive, and either writes it to a file or to
+ *  memory. The data is read and inflated in chunks of BUFFER_SIZE.
+ *  \param f The opened zip file.
+ *  \param entry The file to read.
+ *  \param out If not NULL the data is written to this file.
+ *  \param memory Otherwise the data is written here (which must be large
+ *         enough for the uncompressed file).
+ *  \return False if an error occurred (including a wrong CRC).
+ */
+bool ZipPackage::readEntry(FILE *f, const Entry &entry, FILE *out,
+                           char *memory) const
+{
+    if (fseek(f, entry.m_offset, SEEK_SET) != 0)
+        return false;
+
+    std::vector<char> in_buffer(std::min<uint32_t>(BUFFER_SIZE,
+                                              entry.m_compressed_size + 1));
+    std::vector<char> out_buffer(out ? BUFFER_SIZE : 0);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uint32_t remaining = entry.m_compressed_size;
+    uint32_t written   = 0;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // Negative window bits: raw deflate data without zlib header
+    if (entry.m_method == 8 && inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return false;
+
+    bool ok = true, done = false;
+    while (ok && !done)
+    {
+        const uint32_t n = std::min<uint32_t>(remaining,
+                                              (uint32_t)in_buffer.size());
+        if (n > 0 && fread(&in_buffer[0], 1, n, f) != n)
+        {
+            ok = false;
+            break;
+        }
+        remaining -= n;
+
+        if (entry.m_method == 0)
+        {
+            if (written + n > entry.m_size)
+            {
+                ok = false;
+                break;
+            }
+            crc = crc32(crc, (const Bytef*)&in_buffer[0], n);
+            if (out)
+                ok = fwrite(&in_buffer[0], 1, n, out) == n;
+            else if (n > 0)
+                memcpy(memory + written, &in_buffer[0], n);
+            written += n;
+            done = remaining == 0;
+            continue;
+        }
+
+        stream.next_in  = (Bytef*)&in_buffer[0];
+        stream.avail_in = n;
+        while (true)
+        {
+            Bytef *start = out ? (Bytef*)&out_buffer[0]
+                               : (Bytef*)memory + written;
+            const uint32_t available = out ? BUFFER_SIZE
+                                           : entry.m_size - written;
+            stream.next_out  = start;
+            stream.avail_out = available;
+            const int result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END &&
+                result != Z_BUF_ERROR)
+            {
+                ok = false;
+                break;
+            }
+            const uint32_t produced = available - stream.avail_out;
+            crc = crc32(crc, start, produced);
+            if (out && produced > 0)
+                ok = fwrite(start, 1, produced, out) == produced;
+            written += produced;
+            if (result == Z_STREAM_END)
+            {
+                done = true;
+                break;
+            }
+            // More input is needed
+            if (stream.avail_in == 0 &&
+                (stream.avail_out > 0 || result == Z_BUF_ERROR))
+                break;
+            // No progress possible, i.e. the file is larger than its size
+            if (result == Z_BUF_ERROR || !ok)
+            {
+                ok = false;
+                break;
+            }
+        }   // while true
+
+        // All input consumed, but the stream did not end
+        if (ok && !done && remaining == 0)
+            ok = false;
+    }   // while ok && !done
+
+    if (entry.m_method == 8)
+        inflateEnd(&stream);
+    return ok && written == entry.m_size && crc == entry.m_crc;
+}   // readEntry
+
+// ----------------------------------------------------------------------------
+/** Returns true if all files of this package can be read by STK when the
+ *  package is mounted. Music, sounds and scripts are read with fopen, and
+ *  can therefore not be read from a mounted package.
+ */
+bool ZipPackage::canBeMounted() const
+{
+    if (!m_is_valid)
+        return false;
+    for (unsigned int i = 0; i < m_entries.size(); i++)
+    {
+        const std::string ext =
+            StringUtils::toLowerCase(StringUtils::getExtension(
+                                         m_entries[i].m_name.c_str()));
+        if (ext == "ogg" || ext == "wav" || ext == "as" || ext == "challenge")
+            return false;
+    }
+    return true;
+}   // canBeMounted
+
+// ----------------------------------------------------------------------------
+/** Extracts all files to a directory.
+ *  \param to The destination directory.
+ *  \param parallel If true, several files are extracted at the same time.
+ *  \return True if all files were extracted.
+ */
+bool ZipPackage::extractAll(const std::string &to, bool parallel) const
+{
+    if (!m_is_valid)
+        return false;
+    int num_errors = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:num_errors) if(parallel)
+    for (int i = 0; i < (int)m_entries.size(); i++)
+    {
+        const Entry &entry = m_entries[i];
+        Log::info("addons", "Unzipping file '%s'.", entry.m_name.c_str());
+        const std::string dest = to + "/" + entry.m_name.c_str();
+        FILE *f   = fopen(m_filename.c_str(), "rb");
+        FILE *out = fopen(dest.c_str(), "wb");
+        if (!f || !out)
+        {
+            Log::warn("addons", "Couldn't create the file '%s'. The "
+                      "directory might not exist. This is ignored, but the "
+                      "addon might not work.", dest.c_str());
+            num_errors++;
+        }
+        else if (!readEntry(f, entry, out, NULL))
+        {
+            Log::warn("addons", "Could not copy '%s' from archive '%s'. This "
+                      "is ignored, but the addon might not work.",
+                      entry.m_name.c_str(), m_filename.c_str());
+            num_errors++;
+        }
+        if (f)   fclose(f);
+        if (out) fclose(out);
+    }
+    return num_errors == 0;
+}   // extractAll
+
+// ----------------------------------------------------------------------------
+/** Normalises a path, so that it can be compared with the mount directory:
+ *  '\' is replaced with '/', and '//' and '/./' with '/'.
+ *  \param path The path to normalise.
+ */
+std::string ZipPackage::normalisePath(const std::string &path)
+{
+    std::string result;
+    result.reserve(path.size());
+    for (unsigned int i = 0; i < path.size(); i++)
+    {
+        const char c = path[i] == '\\' ? '/' : path[i];
+        if (c == '/' && !result.empty() && result[result.size() - 1] == '/')
+            continue;
+        if (c == '/' && result.size() >= 2 &&
+            result[result.size() - 1] == '.' &&
+            result[result.size() - 2] == '/')
+        {
+            result.erase(result.size() - 1);
+            continue;
+        }
+        result += c;
+    }
+    return result;
+}   // normalisePath
+
+// ----------------------------------------------------------------------------
+/** Returns the index of a file if it is in the mount directory and in the
+ *  package, or -1 otherwise.
+ *  \param filename Full name of the file.
+ *  \param is_folder True if a directory is searched, which is never found.
+ */
+s32 ZipPackage::findFile(const io::path &filename, bool is_folder) const
+{
+    if (is_folder || !m_is_valid)
+        return -1;
+    const std::string name = normalisePath(filename.c_str());
+    if (name.size() <= m_mount_dir.size() ||
+        name.compare(0, m_mount_dir.size(), m_mount_dir) != 0)
+        return -1;
+    std::map<std::string, unsigned int>::const_iterator i =
+        m_index.find(name.substr(m_mount_dir.size()));
+    return i == m_index.end() ? -1 : (s32)i->second;
+}   // findFile
+
+// ----------------------------------------------------------------------------
+/** Opens a file of the package, i.e. inflates it into memory.
+ *  \param filename Full name of the file.
+ */
+io::IReadFile *ZipPackage::createAndOpenFile(const io::path &filename)
+{
+    const s32 index = findFile(filename);
+    return index < 0 ? NULL : createAndOpenFile((u32)index);
+}   // createAndOpenFile
+
+// ----------------------------------------------------------------------------
+/** Opens a file of the package, i.e. inflates it into memory.
+ *  \param index Index of the file.
+ */
+io::IReadFile *ZipPackage::createAndOpenFile(u32 index)
+{
+    if (index >= m_entries.size())
+        return NULL;
+    const Entry &entry = m_entries[index];
+    FILE *f = fopen(m_filename.c_str(), "rb");
+    if (!f)
+        return NULL;
+    char *memory = new (std::nothrow) char[(size_t)entry.m_size + 1];
+    if (!memory)
+    {
+        fclose(f);
+        Log::error("ZipPackage", "Not enough memory to read '%s' from '%s'.",
+                   entry.m_name.c_str(), m_filename.c_str());
+        return NULL;
+    }
+    const bool ok = readEntry(f, entry, NULL, memory);
+    fclose(f);
+    if (!ok)
+    {
+        Log::error("ZipPackage", "Can't read '%s' from '%s'.",
+                   entry.m_name.c_str(), m_filename.c_str());
+        delete [] memory;
+        return NULL;
+    }
+    return file_manager->getFileSystem()
+        ->createMemoryReadFile(memory, entry.m_size, entry.m_full_name,
+                               /*deleteMemoryWhenDropped*/true);
+}   // createAndOpenFile
+
+// ----------------------------------------------------------------------------
+/** Compares the time needed to install an addon: extracting the zip file
+ *  with the irrlicht zip reader (as was done before), extracting it with
+ *  the streaming extractor (with one and with several threads), and
+ *  mounting the package (reading the index and all files, which is what
+ *  loading the addon needs). The extracted files are compared.
+ *  \param filename Name of the zip file of an addon.
+ */
+void ZipPackage::benchmark(const std::string &filename)
+{
+    const std::string base = file_manager->getAddonsFile("tmp/benchmark-");
+    const char *names[] = { "irrlicht", "serial", "parallel" };
+    for (unsigned int i = 0; i < 3; i++)
+        file_manager->checkAndCreateDirectoryP(base + names[i]);
+
+    double start = getTimeMilliseconds();
+    bool ok = extract_zip_irrlicht(filename, base + names[0]);
+    const double irrlicht_time = getTimeMilliseconds() - start;
+
+    start = getTimeMilliseconds();
+    ZipPackage *serial = new ZipPackage(filename, base + names[1]);
+    ok &= serial->extractAll(base + names[1], /*parallel*/false);
+    const double serial_time = getTimeMilliseconds() - start;
+    serial->drop();
+
+    start = getTimeMilliseconds();
+    ZipPackage *parallel = new ZipPackage(filename, base + names[2]);
+    ok &= parallel->extractAll(base + names[2], /*parallel*/true);
+    const double parallel_time = getTimeMilliseconds() - start;
+    parallel->drop();
+
+    // Mount the package and read all files through the irrlicht file
+    // system, comparing them with the extracted files. Like the data
+    // directory of an installed addon the mount directory exists, but
+    // contains no files.
+    const std::string mount_dir = base + "mounted";
+    file_manager->checkAndCreateDirectoryP(mount_dir);
+    start = getTimeMilliseconds();
+    ZipPackage *package = new ZipPackage(filename, mount_dir);
+    const double index_time = getTimeMilliseconds() - start;
+    io::IFileSystem *fs = file_manager->getFileSystem();
+    fs->addFileArchive(package);
+    double read_time = 0;
+    unsigned int num_different = 0;
+    uint64_t total_size = 0;
+    for (unsigned int i = 0; i < package->getFileCount(); i++)
+    {
+        start = getTimeMilliseconds();
+        io::IReadFile *file =
+            fs->createAndOpenFile(package->getFullFileName(i));
+        read_time += getTimeMilliseconds() - start;
+        if (!file)
+        {
+            num_different++;
+            continue;
+        }
+        std::vector<char> mounted(file->getSize() + 1);
+        file->read(&mounted[0], file->getSize());
+        total_size += file->getSize();
+        file->drop();
+
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            const std::string extracted = base + names[j] + "/"
+                                        + package->getFileName(i).c_str();
+            FILE *f = fopen(extracted.c_str(), "rb");
+            std::vector<char> data(mounted.size());
+            const size_t n = f ? fread(&data[0], 1, data.size(), f) : 0;
+            if (f) fclose(f);
+            if (n != mounted.size() - 1 || data != mounted)
+            {
+                Log::error("ZipPackage", "'%s' is different in '%s'.",
+                           extracted.c_str(), names[j]);
+                num_different++;
+            }
+        }
+    }
+    const unsigned int num_files = package->getFileCount();
+    fs->removeFileArchive(package);
+    package->drop();
+
+    for (unsigned int i = 0; i < 3; i++)
+        file_manager->removeDirectory(base + names[i]);
+    file_manager->removeDirectory(mount_dir);
+
+    Log::info("ZipPackage", "%s: %d files, %lu bytes.", filename.c_str(),
+              num_files, (unsigned long)total_size);
+    Log::info("ZipPackage", "Extracting: irrlicht %f ms, streaming %f ms, "
+              "streaming parallel %f ms.", irrlicht_time, serial_time,
+              parallel_time);
+    Log::info("ZipPackage", "Mounting: index %f ms, reading all files "
+              "%f ms.", index_time, read_time);
+    if (!ok || num_different > 0)
+        Log::error("ZipPackage", "Errors while extracting, %d files are "
+                   "different.", num_different);
+    else
+        Log::info("ZipPackage", "All files are identical.");
+}   // benchmark
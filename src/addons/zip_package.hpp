@@ -0,0 +1,165 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_ZIP_PACKAGE_HPP
+#define HEADER_ZIP_PACKAGE_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <IFileArchive.h>
+#include <IFileList.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace irr;
+
+/**
+  * \brief A zip archive of an addon, which can be extracted or mounted.
+  * The index (central directory) of the zip file is read once when the
+  * package is opened. Like extract_zip did before, all paths inside the
+  * archive are ignored, i.e. all files are put into one directory.
+  * A package can be mounted into the irrlicht file system as a read-only
+  * archive: all files of the package then appear to be in the mount
+  * directory (the data directory of the addon), so the addon can be loaded
+  * without extracting it. Only files that are read by irrlicht (XML files,
+  * meshes, textures) can be read this way, so packages containing files
+  * that are opened with fopen (music, sounds, scripts) can not be mounted,
+  * see canBeMounted(). Reading a file opens the zip file again, so files
+  * can be read from several threads at the same time.
+  * When extracting, the files are inflated in chunks of BUFFER_SIZE
+  * directly into the destination files, and several files are extracted
+  * in parallel.
+  * \ingroup addonsgroup
+  */
+class ZipPackage : public io::IFileArchive, public io::IFileList,
+                   public NoCopy
+{
+public:
+    /** Name of the package file in the data directory of a mounted addon. */
+    static const char *PACKAGE_NAME;
+
+    /** Size of the buffers used when inflating a file. */
+    enum { BUFFER_SIZE = 256*1024 };
+
+private:
+    /** Information about one file in the zip archive. */
+    struct Entry
+    {
+        /** Name of the file (without the path inside the archive). */
+        io::path m_name;
+        /** Name of the file in the mount directory. */
+        io::path m_full_name;
+        /** Offset of the (compressed) data in the zip file. */
+        uint32_t m_offset;
+        /** Compressed and uncompressed size. */
+        uint32_t m_compressed_size, m_size;
+        /** CRC32 of the uncompressed data. */
+        uint32_t m_crc;
+        /** Compression method: 0 = stored, 8 = deflate. */
+        uint16_t m_method;
+    };   // Entry
+
+    /** Name of the zip file. */
+    std::string m_filename;
+
+    /** Directory in which the files appear when the package is mounted,
+     *  always ending in '/'. */
+    std::string m_mount_dir;
+    io::path    m_mount_path;
+
+    /** All files of the archive. */
+    std::vector<Entry> m_entries;
+
+    /** Index of each file in m_entries, indexed by name. */
+    std::map<std::string, unsigned int> m_index;
+
+    /** True if the zip file was read successfully and all files use a
+     *  supported compression method. */
+    bool m_is_valid;
+
+    bool readIndex(FILE *f);
+    bool readEntry(FILE *f, const Entry &entry, FILE *out,
+                   char *memory) const;
+
+public:
+             ZipPackage(const std::string &filename,
+                        const std::string &mount_dir);
+    static std::string normalisePath(const std::string &path);
+    bool     canBeMounted() const;
+    bool     extractAll(const std::string &to, bool parallel=true) const;
+    static void benchmark(const std::string &filename);
+
+    // ------------------------------------------------------------------------
+    /** Returns true if the index of the zip file could be read. */
+    bool isValid() const { return m_is_valid; }
+    // ------------------------------------------------------------------------
+    /** Returns the name of the zip file. */
+    const std::string &getFilename() const { return m_filename; }
+    // ------------------------------------------------------------------------
+    /** Returns the directory in which the package is mounted. */
+    const std::string &getMountDir() const { return m_mount_dir; }
+
+    // IFileArchive
+    // ------------------------------------------------------------------------
+    virtual io::IReadFile *createAndOpenFile(const io::path &filename);
+    virtual io::IReadFile *createAndOpenFile(u32 index);
+    // ------------------------------------------------------------------------
+    virtual const io::IFileList *getFileList() const { return this; }
+
+    // IFileList
+    // ------------------------------------------------------------------------
+    virtual u32 getFileCount() const { return (u32)m_entries.size(); }
+    // ------------------------------------------------------------------------
+    virtual const io::path &getFileName(u32 index) const
+    {
+        return m_entries[index].m_name;
+    }   // getFileName
+    // ------------------------------------------------------------------------
+    virtual const io::path &getFullFileName(u32 index) const
+    {
+        return m_entries[index].m_full_name;
+    }   // getFullFileName
+    // ------------------------------------------------------------------------
+    virtual u32 getFileSize(u32 index) const { return m_entries[index].m_size; }
+    // ------------------------------------------------------------------------
+    virtual u32 getFileOffset(u32 index) const
+    {
+        return m_entries[index].m_offset;
+    }   // getFileOffset
+    // ------------------------------------------------------------------------
+    virtual u32 getID(u32 index) const { return index; }
+    // ------------------------------------------------------------------------
+    virtual bool isDirectory(u32 index) const { return false; }
+    // ------------------------------------------------------------------------
+    virtual s32 findFile(const io::path &filename, bool is_folder=false) const;
+    // ------------------------------------------------------------------------
+    virtual const io::path &getPath() const { return m_mount_path; }
+    // ------------------------------------------------------------------------
+    /** A package is read-only. */
+    virtual u32 addItem(const io::path &full_path, u32 offset, u32 size,
+                        bool is_directory, u32 id=0)           { return 0; }
+    // ------------------------------------------------------------------------
+    /** The entries are looked up using m_index, no sorting needed. */
+    virtual void sort() {}
+};   // ZipPackage
+
+#endif
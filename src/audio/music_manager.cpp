@@ -41,50 +41,60 @@
 MusicManager* music_manager= NULL;
 
 
-MusicManager::MusicManager()
+/** Creates the music manager and opens the sound device.
+ *  \param init_openal If false, no sound device is opened (and no music or
+ *         sound effects can be played), which is used by a dedicated server.
+ */
+MusicManager::MusicManager(bool init_openal)
 {
     m_current_music= NULL;
+    m_initialized  = false;
     setMasterMusicVolume(UserConfigParams::m_music_volume);
 
     //FIXME: I'm not sure that this code goes here
 #if HAVE_OGGVORBIS
 
-#if defined(__APPLE__) && !defined(NDEBUG)
-    // HACK: On OSX, when OpenAL is initialized, breaking in a debugger causes
-    // my iTunes music to stop too, which is highly annoying ;) so in debug
-    // mode, require a restart to enable sound
-    if (UserConfigParams::m_sfx || UserConfigParams::m_music)
+    // A dedicated server does not play any sound, so it does not open a
+    // sound device at all.
+    if (init_openal)
     {
+#if defined(__APPLE__) && !defined(NDEBUG)
+        // HACK: On OSX, when OpenAL is initialized, breaking in a debugger causes
+        // my iTunes music to stop too, which is highly annoying ;) so in debug
+        // mode, require a restart to enable sound
+        if (UserConfigParams::m_sfx || UserConfigParams::m_music)
+        {
 #endif
 
-    ALCdevice* device = alcOpenDevice ( NULL ); //The default sound device
-    if( device == NULL )
-    {
-        Log::warn("MusicManager", "Could not open the default sound device.");
-        m_initialized = false;
-    }
-    else
-    {
-
-        ALCcontext* context = alcCreateContext( device, NULL );
-
-        if( context == NULL )
+        ALCdevice* device = alcOpenDevice ( NULL ); //The default sound device
+        if( device == NULL )
         {
-            Log::warn("MusicManager", "Could not create a sound context.");
+            Log::warn("MusicManager", "Could not open the default sound device.");
             m_initialized = false;
         }
         else
         {
-            alcMakeContextCurrent( context );
-            m_initialized = true;
+
+            ALCcontext* context = alcCreateContext( device, NULL );
+
+            if( context == NULL )
+            {
+                Log::warn("MusicManager", "Could not create a sound context.");
+                m_initialized = false;
+            }
+            else
+            {
+                alcMakeContextCurrent( context );
+                m_initialized = true;
+            }
         }
-    }
 
 #if defined(__APPLE__) && !defined(NDEBUG)
-    }
+        }
 #endif
 
-    alGetError(); //Called here to clear any non-important errors found
+        alGetError(); //Called here to clear any non-important errors found
+    }   // if init_openal
 #endif
 
     loadMusicInformation();
@@ -53,7 +53,7 @@ private:
     void              loadMusicFromOneDir(const std::string& dir);
 
 public:
-                      MusicManager();
+                      MusicManager(bool init_openal=true);
     virtual          ~MusicManager();
     MusicInformation* getMusicInformation(const std::string& filename);
     void              addMusicToTracks();
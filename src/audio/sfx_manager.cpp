@@ -50,11 +50,15 @@ SFXManager *SFXManager::m_sfx_manager;
 
 // ----------------------------------------------------------------------------
 /** Static function to create the singleton sfx manager.
+ *  \param start_thread If false, the thread executing the sfx commands is
+ *         not started, startThread() must then be called later. This is
+ *         used by a dedicated server that forks after loading all data
+ *         (since fork does not copy threads).
  */
-void SFXManager::create()
+void SFXManager::create(bool start_thread)
 {
     assert(!m_sfx_manager);
-    m_sfx_manager = new SFXManager();
+    m_sfx_manager = new SFXManager(start_thread);
 }   // create
 
 // ------------------------------------------------------------------------
@@ -69,8 +73,9 @@ void SFXManager::destroy()
 
 // ----------------------------------------------------------------------------
 /** Initialises the SFX manager and loads the sfx from a config file.
+ *  \param start_thread If the sfx thread should be started.
  */
-SFXManager::SFXManager()
+SFXManager::SFXManager(bool start_thread)
 {
 
     // The sound manager initialises OpenAL
@@ -85,8 +90,32 @@ SFXManager::SFXManager()
 
     loadSfx();
 
+    m_num_overflow          = 0;
+    m_consumer_idle         = 0;
+    m_max_queue_depth       = 0;
+    m_num_dropped_commands  = 0;
+    m_num_overflow_commands = 0;
+    // Only the thread creating the sfx manager (i.e. the main thread) can
+    // use the lock-free command queue.
+    m_producer_thread       = pthread_self();
+    pthread_mutex_init(&m_idle_mutex, NULL);
     pthread_cond_init(&m_cond_request, NULL);
+    m_thread_id.setAtomic(0);
 
+    if (start_thread)
+        startThread();
+
+    setMasterSFXVolume( UserConfigParams::m_sfx_volume );
+
+}  // SoundManager
+
+//-----------------------------------------------------------------------------
+/** Starts the thread that executes all queued sfx commands. Commands queued
+ *  before the thread is started are executed once it runs.
+ */
+void SFXManager::startThread()
+{
+    assert(m_thread_id.getAtomic() == 0);
     pthread_attr_t  attr;
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
@@ -109,24 +138,28 @@ SFXManager::SFXManager()
                    errno);
     }
     pthread_attr_destroy(&attr);
-
-    setMasterSFXVolume( UserConfigParams::m_sfx_volume );
-    m_sfx_commands.lock();
-    m_sfx_commands.getData().clear();
-    m_sfx_commands.unlock();
-
-}  // SoundManager
+}   // startThread
 
 //-----------------------------------------------------------------------------
 /** Destructor, frees all sound effects.
  */
 SFXManager::~SFXManager()
 {
+    // The thread is not running if startThread() was never called (or
+    // failed to create the thread).
     m_thread_id.lock();
-    pthread_join(*m_thread_id.getData(), NULL);
-    delete m_thread_id.getData();
+    if (m_thread_id.getData())
+    {
+        pthread_join(*m_thread_id.getData(), NULL);
+        delete m_thread_id.getData();
+    }
     m_thread_id.unlock();
     pthread_cond_destroy(&m_cond_request);
+    pthread_mutex_destroy(&m_idle_mutex);
+
+    Log::info("SFXManager", "Command queue: max depth %d, %d commands "
+              "dropped, %d commands overflowed.", m_max_queue_depth,
+              m_num_dropped_commands, m_num_overflow_commands);
 
     // ---- clear m_all_sfx
     // not strictly necessary, but might avoid copy&paste problems
@@ -176,8 +209,7 @@ SFXManager::~SFXManager()
  */
 void SFXManager::queue(SFXCommands command,  SFXBase *sfx)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, sfx);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx));
 }   // queue
 
 //----------------------------------------------------------------------------
@@ -190,8 +222,7 @@ void SFXManager::queue(SFXCommands command,  SFXBase *sfx)
  */
 void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, sfx, f);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, f));
 }   // queue(float)
 
 //----------------------------------------------------------------------------
@@ -204,8 +235,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f)
  */
 void SFXManager::queue(SFXCommands command, SFXBase *sfx, const Vec3 &p)
 {
-   SFXCommand *sfx_command = new SFXCommand(command, sfx, p);
-   queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, p));
 }   // queue (Vec3)
 
 //----------------------------------------------------------------------------
@@ -220,8 +250,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, const Vec3 &p)
 void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f,
                        const Vec3 &p)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, sfx, f, p);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, sfx, f, p));
 }   // queue(float, Vec3)
 
 //----------------------------------------------------------------------------
@@ -230,8 +259,7 @@ void SFXManager::queue(SFXCommands command, SFXBase *sfx, float f,
  */
 void SFXManager::queue(SFXCommands command, MusicInformation *mi)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, mi);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, mi));
 }   // queue(MusicInformation)
 //----------------------------------------------------------------------------
 /** Queues a command for the music manager that takes a floating point value
@@ -241,51 +269,119 @@ void SFXManager::queue(SFXCommands command, MusicInformation *mi)
  */
 void SFXManager::queue(SFXCommands command, MusicInformation *mi, float f)
 {
-    SFXCommand *sfx_command = new SFXCommand(command, mi, f);
-    queueCommand(sfx_command);
+    queueCommand(SFXCommand(command, mi, f));
 }   // queue(MusicInformation)
 
 //----------------------------------------------------------------------------
-/** Enqueues a command to the sfx queue threadsafe. Then signal the
- *  sfx manager to wake up.
- *  \param command Pointer to the command to queue up.
+/** Enqueues a command to the sfx queue threadsafe. Commands from the
+ *  producer thread (the thread that created the sfx manager) are added to
+ *  a lock-free ring buffer, so no memory is allocated and no lock is taken.
+ *  Commands from other threads, and commands that can not be dropped if the
+ *  ring buffer is full, are added to a locked overflow list. If the sfx
+ *  thread is waiting for commands it is woken up.
+ *  \param command The command to queue up.
  */
-void SFXManager::queueCommand(SFXCommand *command)
+void SFXManager::queueCommand(const SFXCommand &command)
 {
-    m_sfx_commands.lock();
-    if(World::getWorld() && 
-        m_sfx_commands.getData().size() > 20*race_manager->getNumberOfKarts()+20 &&
+    const unsigned int depth = getQueueDepth();
+    // This is only used for statistics, so concurrent updates don't matter
+    if (depth > m_max_queue_depth)
+        m_max_queue_depth = depth;
+
+    // Commands that only update the state of a sfx can be dropped if too
+    // many commands are queued up, the next update will fix the state.
+    const bool can_drop = command.m_command==SFX_POSITION ||
+                          command.m_command==SFX_LOOP     ||
+                          command.m_command==SFX_SPEED    ||
+                          command.m_command==SFX_SPEED_POSITION;
+
+    if(can_drop && World::getWorld() &&
+        depth > 20*race_manager->getNumberOfKarts()+20 &&
         race_manager->getMinorMode() != RaceManager::MINOR_MODE_CUTSCENE)
     {
-        if(command->m_command==SFX_POSITION || command->m_command==SFX_LOOP ||
-           command->m_command==SFX_SPEED    || 
-           command->m_command==SFX_SPEED_POSITION                               )
+        m_num_dropped_commands++;
+        static int count_messages = 0;
+        if(count_messages < 5)
         {
-            delete command;
-            static int count_messages = 0;
-            if(count_messages < 5)
-            {
-                Log::warn("SFXManager", "Throttling sfx - queue size %d",
-                         m_sfx_commands.getData().size());
-                count_messages++;
-            }
-            m_sfx_commands.unlock();
+            Log::warn("SFXManager", "Throttling sfx - queue size %d",
+                      depth);
+            count_messages++;
+        }
+        return;
+    }   // if throttling
+
+    // As long as there are commands in the overflow list the producer
+    // thread must use it as well, otherwise its commands could be
+    // executed out of order.
+    if (pthread_equal(pthread_self(), m_producer_thread) &&
+        m_num_overflow == 0)
+    {
+        if (m_sfx_commands.push(command))
+        {
+            wakeUpThread();
+            return;
+        }
+        if (can_drop)
+        {
+            m_num_dropped_commands++;
             return;
-        }   // if throttling
+        }
     }
-    m_sfx_commands.getData().push_back(command);
-    m_sfx_commands.unlock();
+
+    m_sfx_overflow.lock();
+    m_sfx_overflow.getData().push_back(command);
+    m_num_overflow = (unsigned int)m_sfx_overflow.getData().size();
+    m_num_overflow_commands++;
+    m_sfx_overflow.unlock();
+    wakeUpThread();
 }   // queueCommand
 
 //----------------------------------------------------------------------------
-/** Puts a NULL request into the queue, which will trigger the thread to
+/** Wakes up the sfx thread if it is waiting for new commands. This must be
+ *  called after a command was added to a queue.
+ */
+void SFXManager::wakeUpThread()
+{
+    // Make sure the new command is visible before testing the idle flag.
+    // The sfx thread does the opposite (sets the idle flag, then tests the
+    // queue), so at least one of the two threads will notice the other.
+    stkMemoryBarrier();
+    if (!m_consumer_idle)
+        return;
+    pthread_mutex_lock(&m_idle_mutex);
+    pthread_cond_signal(&m_cond_request);
+    pthread_mutex_unlock(&m_idle_mutex);
+}   // wakeUpThread
+
+//----------------------------------------------------------------------------
+/** Called from the sfx thread when there are no more commands to execute.
+ *  It waits till a new command is queued, or at most 1 ms (after which all
+ *  playing sfx are updated to keep music playing, even if the main thread
+ *  is busy, e.g. while loading).
+ */
+void SFXManager::waitForCommands()
+{
+    pthread_mutex_lock(&m_idle_mutex);
+    m_consumer_idle = 1;
+    stkMemoryBarrier();
+    if (m_sfx_commands.isEmpty() && m_num_overflow == 0)
+    {
+        struct timespec timeout;
+        StkTime::getTimeout(1, &timeout);
+        // Spurious wakeups are harmless, the main loop tests the queue again
+        pthread_cond_timedwait(&m_cond_request, &m_idle_mutex, &timeout);
+    }
+    m_consumer_idle = 0;
+    pthread_mutex_unlock(&m_idle_mutex);
+}   // waitForCommands
+
+//----------------------------------------------------------------------------
+/** Puts an exit request into the queue, which will trigger the thread to
  *  exit.
  */
 void SFXManager::stopThread()
 {
     queue(SFX_EXIT);
-    // Make sure the thread wakes up.
-    pthread_cond_signal(&m_cond_request);
 }   // stopThread
 
 //----------------------------------------------------------------------------
@@ -301,123 +397,123 @@ void* SFXManager::mainLoop(void *obj)
 
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 
-    me->m_sfx_commands.lock();
+    // Commands taken from the overflow list. They are executed before
+    // any further command from the ring buffer is read.
+    std::vector<SFXCommand> overflow;
+    unsigned int next_overflow = 0;
+    SFXCommand current;
 
-    // Wait till we have an empty sfx in the queue
-    while (me->m_sfx_commands.getData().empty() ||
-           me->m_sfx_commands.getData().front()->m_command!=SFX_EXIT)
+    while (true)
     {
-        bool empty = me->m_sfx_commands.getData().empty();
-
-        // Wait in cond_wait for a request to arrive. The 'while' is necessary
-        // since "spurious wakeups from the pthread_cond_wait ... may occur"
-        // (pthread_cond_wait man page)!
-        while (empty)
-        {
-            pthread_cond_wait(&me->m_cond_request, me->m_sfx_commands.getMutex());
-            empty = me->m_sfx_commands.getData().empty();
-        }
-        SFXCommand *current = me->m_sfx_commands.getData().front();
-        me->m_sfx_commands.getData().erase(me->m_sfx_commands.getData().begin());
-
-        if (current->m_command == SFX_EXIT)
+        if (next_overflow < overflow.size())
         {
-            delete current;
-            break;
+            current = overflow[next_overflow++];
         }
-        me->m_sfx_commands.unlock();
-        switch (current->m_command)
+        else if (!me->m_sfx_commands.pop(&current))
         {
-        case SFX_PLAY:     current->m_sfx->reallyPlayNow();       break;
-        case SFX_PLAY_POSITION:
-            current->m_sfx->reallyPlayNow(current->m_parameter);  break;
-        case SFX_STOP:     current->m_sfx->reallyStopNow();       break;
-        case SFX_PAUSE:    current->m_sfx->reallyPauseNow();      break;
-        case SFX_RESUME:   current->m_sfx->reallyResumeNow();     break;
-        case SFX_SPEED:    current->m_sfx->reallySetSpeed(
-                                  current->m_parameter.getX());   break;
-        case SFX_POSITION: current->m_sfx->reallySetPosition(
-                                         current->m_parameter);   break;
-        case SFX_SPEED_POSITION: current->m_sfx->reallySetSpeedPosition(
-                                         // Extract float from W component
-                                         current->m_parameter.getW(),
-                                         current->m_parameter);   break;
-        case SFX_VOLUME:   current->m_sfx->reallySetVolume(
-                                  current->m_parameter.getX());   break;
-        case SFX_MASTER_VOLUME:
-            current->m_sfx->reallySetMasterVolumeNow(
-                                  current->m_parameter.getX());   break;
-        case SFX_LOOP:     current->m_sfx->reallySetLoop(
-                             current->m_parameter.getX() != 0);   break;
-        case SFX_DELETE:     me->deleteSFX(current->m_sfx);       break;
-        case SFX_PAUSE_ALL:  me->reallyPauseAllNow();             break;
-        case SFX_RESUME_ALL: me->reallyResumeAllNow();            break;
-        case SFX_LISTENER:   me->reallyPositionListenerNow();     break;
-        case SFX_UPDATE:     me->reallyUpdateNow(current);        break;
-        case SFX_MUSIC_START:
-        {
-            current->m_music_information->setDefaultVolume();
-            current->m_music_information->startMusic();           break;
-        }
-        case SFX_MUSIC_STOP:
-            current->m_music_information->stopMusic();            break;
-        case SFX_MUSIC_PAUSE:
-            current->m_music_information->pauseMusic();           break;
-        case SFX_MUSIC_RESUME:
-            current->m_music_information->resumeMusic();
-            // This might be necessasary if the volume was changed
-            // in the in-game menu
-            current->m_music_information->setDefaultVolume();     break;
-        case SFX_MUSIC_SWITCH_FAST:
-            current->m_music_information->switchToFastMusic();    break;
-        case SFX_MUSIC_SET_TMP_VOLUME:
-        {
-            MusicInformation *mi = current->m_music_information;
-            mi->setTemporaryVolume(current->m_parameter.getX());  break;
-        }
-        case SFX_MUSIC_WAITING:
-               current->m_music_information->setMusicWaiting();   break;
-        case SFX_MUSIC_DEFAULT_VOLUME:
-        {
-            current->m_music_information->setDefaultVolume();
-            break;
-        }
-        case SFX_CREATE_SOURCE:
-            current->m_sfx->init(); break;
-        default: assert("Not yet supported.");
-        }
-        delete current;
-        current = NULL;
-        // We access the size without lock, doesn't matter if we
-        // should get an incorrect value because of concurrent read/writes
-        if (me->m_sfx_commands.getData().size() == 0)
-        {
-            // Wait some time to let other threads run, then queue an
-            // update event to keep music playing.
+            overflow.clear();
+            next_overflow = 0;
+            if (me->m_num_overflow > 0)
+            {
+                me->m_sfx_overflow.lock();
+                overflow.swap(me->m_sfx_overflow.getData());
+                me->m_num_overflow = 0;
+                me->m_sfx_overflow.unlock();
+                continue;
+            }
+
+            // Wait some time for new commands. If none arrive, update
+            // all sfx to keep music playing.
             double t = StkTime::getRealTime();
-            StkTime::sleep(1);
-            t = StkTime::getRealTime() - t;
-            me->queue(SFX_UPDATE, (SFXBase*)NULL, float(t));
+            me->waitForCommands();
+            if (me->getQueueDepth() == 0)
+            {
+                t = StkTime::getRealTime() - t;
+                SFXCommand update(SFX_UPDATE, (SFXBase*)NULL, float(t));
+                me->reallyUpdateNow(&update);
+            }
+            continue;
         }
-        me->m_sfx_commands.lock();
 
+        if (current.m_command == SFX_EXIT)
+            break;
+        me->executeCommand(&current);
     }   // while
 
     // Signal that the sfx manager can now be deleted.
-    // We signal this even before cleaning up memory, since there is no
-    // need to keep the user waiting for STK to exit.
     me->setCanBeDeleted();
 
-    // Clean up memory to avoid leak detection
-    while(!me->m_sfx_commands.getData().empty())
-    {
-        delete me->m_sfx_commands.getData().front();
-        me->m_sfx_commands.getData().erase(me->m_sfx_commands.getData().begin());
-    }
-    me->m_sfx_commands.unlock();
     return NULL;
 }   // mainLoop
 
+//----------------------------------------------------------------------------
+/** Executes one command in the sfx thread.
+ *  \param current The command to execute.
+ */
+void SFXManager::executeCommand(SFXCommand *current)
+{
+    switch (current->m_command)
+    {
+    case SFX_PLAY:     current->m_sfx->reallyPlayNow();       break;
+    case SFX_PLAY_POSITION:
+        current->m_sfx->reallyPlayNow(current->m_parameter);  break;
+    case SFX_STOP:     current->m_sfx->reallyStopNow();       break;
+    case SFX_PAUSE:    current->m_sfx->reallyPauseNow();      break;
+    case SFX_RESUME:   current->m_sfx->reallyResumeNow();     break;
+    case SFX_SPEED:    current->m_sfx->reallySetSpeed(
+                              current->m_parameter.getX());   break;
+    case SFX_POSITION: current->m_sfx->reallySetPosition(
+                                     current->m_parameter);   break;
+    case SFX_SPEED_POSITION: current->m_sfx->reallySetSpeedPosition(
+                                     // Extract float from W component
+                                     current->m_parameter.getW(),
+                                     current->m_parameter);   break;
+    case SFX_VOLUME:   current->m_sfx->reallySetVolume(
+                              current->m_parameter.getX());   break;
+    case SFX_MASTER_VOLUME:
+        current->m_sfx->reallySetMasterVolumeNow(
+                              current->m_parameter.getX());   break;
+    case SFX_LOOP:     current->m_sfx->reallySetLoop(
+                         current->m_parameter.getX() != 0);   break;
+    case SFX_DELETE:     deleteSFX(current->m_sfx);       break;
+    case SFX_PAUSE_ALL:  reallyPauseAllNow();             break;
+    case SFX_RESUME_ALL: reallyResumeAllNow();            break;
+    case SFX_LISTENER:   reallyPositionListenerNow();     break;
+    case SFX_UPDATE:     reallyUpdateNow(current);        break;
+    case SFX_MUSIC_START:
+    {
+        current->m_music_information->setDefaultVolume();
+        current->m_music_information->startMusic();           break;
+    }
+    case SFX_MUSIC_STOP:
+        current->m_music_information->stopMusic();            break;
+    case SFX_MUSIC_PAUSE:
+        current->m_music_information->pauseMusic();           break;
+    case SFX_MUSIC_RESUME:
+        current->m_music_information->resumeMusic();
+        // This might be necessasary if the volume was changed
+        // in the in-game menu
+        current->m_music_information->setDefaultVolume();     break;
+    case SFX_MUSIC_SWITCH_FAST:
+        current->m_music_information->switchToFastMusic();    break;
+    case SFX_MUSIC_SET_TMP_VOLUME:
+    {
+        MusicInformation *mi = current->m_music_information;
+        mi->setTemporaryVolume(current->m_parameter.getX());  break;
+    }
+    case SFX_MUSIC_WAITING:
+           current->m_music_information->setMusicWaiting();   break;
+    case SFX_MUSIC_DEFAULT_VOLUME:
+    {
+        current->m_music_information->setDefaultVolume();
+        break;
+    }
+    case SFX_CREATE_SOURCE:
+        current->m_sfx->init(); break;
+    default: assert("Not yet supported.");
+    }
+}   // executeCommand
+
 //----------------------------------------------------------------------------
 /** Called when sound is globally switched on or off. It either pauses or
  *  resumes all sound effects. 
@@ -703,8 +799,6 @@ void SFXManager::deleteSFXMapping(const std::string &name)
 void SFXManager::update()
 {
     queue(SFX_UPDATE, (SFXBase*)NULL);
-    // Wake up the sfx thread to handle all queued up audio commands.
-    pthread_cond_signal(&m_cond_request);
 }   // update
 
 //----------------------------------------------------------------------------
@@ -20,8 +20,8 @@
 #define HEADER_SFX_MANAGER_HPP
 
 #include "utils/can_be_deleted.hpp"
-#include "utils/leak_check.hpp"
 #include "utils/no_copy.hpp"
+#include "utils/ring_buffer.hpp"
 #include "utils/synchronised.hpp"
 #include "utils/vec3.hpp"
 
@@ -113,11 +113,10 @@ public:
 private:
 
     /** Data structure for the queue, which stores a sfx and the command to 
-     *  execute for it. */
-    class SFXCommand : public NoCopy
+     *  execute for it. Commands are copied by value into a preallocated
+     *  ring buffer, so this class must remain small and copyable. */
+    class SFXCommand
     {
-    private:
-        LEAK_CHECK()
     public:
         /** The sound effect for which the command should be executed. */
         SFXBase *m_sfx;
@@ -131,16 +130,27 @@ private:
          *  floating point values are stored in the X component. */
         Vec3        m_parameter;
         // --------------------------------------------------------------------
+        /** Default constructor, used for the preallocated slots of the
+         *  command queue. */
+        SFXCommand()
+        {
+            m_command           = SFX_UPDATE;
+            m_sfx               = NULL;
+            m_music_information = NULL;
+        }   // SFXCommand
+        // --------------------------------------------------------------------
         SFXCommand(SFXCommands command, SFXBase *base)
         {
-            m_command   = command;
-            m_sfx       = base;
+            m_command           = command;
+            m_sfx               = base;
+            m_music_information = NULL;
         }   // SFXCommand()
         // --------------------------------------------------------------------
         /** Constructor for music information commands. */
         SFXCommand(SFXCommands command, MusicInformation *mi)
         {
             m_command           = command;
+            m_sfx               = NULL;
             m_music_information = mi;
         }   // SFXCommnd(MusicInformation*)
         // --------------------------------------------------------------------
@@ -150,6 +160,7 @@ private:
         {
             m_command = command;
             m_parameter.setX(f);
+            m_sfx               = NULL;
             m_music_information = mi;
         }   // SFXCommnd(MusicInformation *, float)
         // --------------------------------------------------------------------
@@ -157,6 +168,7 @@ private:
         {
             m_command   = command;
             m_sfx       = base;
+            m_music_information = NULL;
             m_parameter.setX(parameter);
         }   // SFXCommand(float)
         // --------------------------------------------------------------------
@@ -164,6 +176,7 @@ private:
         {
             m_command   = command;
             m_sfx       = base;
+            m_music_information = NULL;
             m_parameter = parameter;
         }   // SFXCommand(Vec3)
         // --------------------------------------------------------------------
@@ -175,6 +188,7 @@ private:
         {
             m_command   = command;
             m_sfx       = base;
+            m_music_information = NULL;
             m_parameter = parameter;
             m_parameter.setW(f);
         }   // SFXCommand(Vec3)
@@ -199,8 +213,44 @@ private:
     /** The actual instances (sound sources) */
     Synchronised<std::vector<SFXBase*> > m_all_sfx;
 
-    /** The list of sound effects to be played in the next update. */
-    Synchronised< std::vector<SFXCommand*> > m_sfx_commands;
+    /** Number of preallocated slots in the command queue. */
+    static const unsigned int COMMAND_QUEUE_SIZE = 1024;
+
+    /** The list of sound effects to be played in the next update. This is
+     *  a lock-free queue written only by the producer thread (the thread
+     *  that created the sfx manager) and read only by the sfx thread. */
+    RingBuffer<SFXCommand, COMMAND_QUEUE_SIZE> m_sfx_commands;
+
+    /** Commands queued from threads other than the producer thread, or
+     *  essential commands that did not fit into the ring buffer. While this
+     *  list is not empty the producer thread appends here, too, so that the
+     *  order of its commands is kept. */
+    Synchronised< std::vector<SFXCommand> > m_sfx_overflow;
+
+    /** Number of commands in m_sfx_overflow, so that the producer can
+     *  test for it without taking the lock. Only written under the lock. */
+    volatile unsigned int     m_num_overflow;
+
+    /** The thread that can use the lock-free queue. */
+    pthread_t                 m_producer_thread;
+
+    /** Set by the sfx thread before it waits for new commands. The
+     *  condition variable is only signalled if this is set. */
+    volatile int              m_consumer_idle;
+
+    /** Mutex used with m_cond_request to wait for commands. */
+    pthread_mutex_t           m_idle_mutex;
+
+    /** Statistics: the maximum number of commands that were queued. */
+    volatile unsigned int     m_max_queue_depth;
+
+    /** Statistics: the number of commands dropped because the queue was
+     *  too full. */
+    volatile unsigned int     m_num_dropped_commands;
+
+    /** Statistics: the number of commands that had to use the (locked)
+     *  overflow list. */
+    volatile unsigned int     m_num_overflow_commands;
 
     /** To play non-positional sounds without having to create a
      *  new object for each. */
@@ -221,17 +271,21 @@ private:
     pthread_cond_t            m_cond_request;
 
     void                      loadSfx();
-                             SFXManager();
+                             SFXManager(bool start_thread);
     virtual                 ~SFXManager();
 
     static void* mainLoop(void *obj);
     void deleteSFX(SFXBase *sfx);
-    void queueCommand(SFXCommand *command);
+    void queueCommand(const SFXCommand &command);
+    void wakeUpThread();
+    void waitForCommands();
+    void executeCommand(SFXCommand *current);
     void reallyPositionListenerNow();
 
 public:
-    static void create();
+    static void create(bool start_thread=true);
     static void destroy();
+    void startThread();
     void queue(SFXCommands command,  SFXBase *sfx=NULL);
     void queue(SFXCommands command,  SFXBase *sfx, float f);
     void queue(SFXCommands command,  SFXBase *sfx, const Vec3 &p);
@@ -292,6 +346,22 @@ public:
      *  debug audio leaks */
     void dump();
 
+    // ------------------------------------------------------------------------
+    /** Returns the number of commands currently waiting to be executed. */
+    unsigned int getQueueDepth() const
+    {
+        return m_sfx_commands.size() + m_num_overflow;
+    }   // getQueueDepth
+    // ------------------------------------------------------------------------
+    /** Returns the maximum number of commands that were waiting. */
+    unsigned int getMaxQueueDepth() const { return m_max_queue_depth; }
+    // ------------------------------------------------------------------------
+    /** Returns how many commands were dropped because the queue was full. */
+    unsigned int getNumDroppedCommands() const
+    {
+        return m_num_dropped_commands;
+    }   // getNumDroppedCommands
+
     // ------------------------------------------------------------------------
     /** Returns the current position of the listener. */
     Vec3 getListenerPos() const { return m_listener_position.getData(); }
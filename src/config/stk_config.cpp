@@ -77,7 +77,7 @@ void STKConfig::load(const std::string &filename)
     XMLNode *root = 0;
     try
     {
-        root = new XMLNode(filename);
+        root = file_manager->createXMLTree(filename, /*use_cache*/true);
         if(!root || root->getName()!="config")
         {
             if(root) delete root;
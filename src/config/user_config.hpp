@@ -406,6 +406,10 @@ namespace UserConfigParams
         PARAM_DEFAULT( StringUserConfigParam("", "additional_gp_directory",
                                             "Directory with additional GP's."));
 
+    PARAM_PREFIX BoolUserConfigParam         m_replay_compression
+        PARAM_DEFAULT( BoolUserConfigParam(true, "replay_compression",
+                       "Compress the events in saved replay files.") );
+
     // ---- Video
     PARAM_PREFIX GroupUserConfigParam        m_video_group
         PARAM_DEFAULT( GroupUserConfigParam("Video", "Video Settings") );
@@ -565,6 +569,10 @@ namespace UserConfigParams
     /** True if hardware skinning should be enabled */
     PARAM_PREFIX bool m_hw_skinning_enabled  PARAM_DEFAULT( false );
 
+    /** True if the decisions of the AI controllers are computed in
+     *  parallel (if OpenMP is available). */
+    PARAM_PREFIX bool m_parallel_ai  PARAM_DEFAULT( true );
+
     // not saved to file
 
     // ---- Networking
@@ -573,6 +581,23 @@ namespace UserConfigParams
             PARAM_DEFAULT(  IntUserConfigParam(16, "server_max_players",
                                        "Maximum number of players on the server.") );
 
+    PARAM_PREFIX IntUserConfigParam         m_kart_update_frequency
+            PARAM_DEFAULT(  IntUserConfigParam(10, "kart_update_frequency",
+                                       "Number of kart state updates sent per "
+                                       "second in network races.") );
+
+    PARAM_PREFIX IntUserConfigParam         m_server_tick_rate
+            PARAM_DEFAULT(  IntUserConfigParam(60, "server_tick_rate",
+                                       "Number of world updates per second "
+                                       "of a dedicated server.") );
+
+    PARAM_PREFIX FloatUserConfigParam       m_network_interpolation_delay
+            PARAM_DEFAULT(  FloatUserConfigParam(0.2f,
+                            "network_interpolation_delay",
+                            "Delay (in seconds) with which remote karts are "
+                            "shown in network races, to allow interpolation "
+                            "between received states.") );
+
     PARAM_PREFIX StringListUserConfigParam         m_stun_servers
             PARAM_DEFAULT(  StringListUserConfigParam("Stun_servers", "The stun servers"
                             " that will be used to know the public address.",
@@ -689,6 +714,21 @@ namespace UserConfigParams
     PARAM_PREFIX BoolUserConfigParam        m_cache_overworld
             PARAM_DEFAULT(  BoolUserConfigParam(true, "cache-overworld") );
 
+    PARAM_PREFIX BoolUserConfigParam        m_cache_height_map
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "cache-height-map",
+                            "Save the terrain height map of tracks in the "
+                            "cached-textures directory.") );
+
+    PARAM_PREFIX BoolUserConfigParam        m_cache_battle_graph
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "cache-battle-graph",
+                            "Save the shortest paths of arenas in the "
+                            "cached-textures directory.") );
+
+    PARAM_PREFIX BoolUserConfigParam        m_cache_xml_trees
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "cache-xml-trees",
+                            "Save pre-parsed binary copies of large data "
+                            "XML files in the cached-textures directory.") );
+
     // TODO : is this used with new code? does it still work?
     PARAM_PREFIX BoolUserConfigParam        m_crashed
             PARAM_DEFAULT(  BoolUserConfigParam(false, "crashed") );
@@ -704,6 +744,11 @@ namespace UserConfigParams
             PARAM_DEFAULT(  BoolUserConfigParam(
             CONSOLE_DEFAULT, "log_errors", "Enable logging to console.") );
 
+    PARAM_PREFIX BoolUserConfigParam        m_log_async
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "log_async",
+                            "Write log messages in a separate thread, so "
+                            "that logging does not slow down the game.") );
+
     // ---- Camera
     PARAM_PREFIX GroupUserConfigParam        m_camera
             PARAM_DEFAULT( GroupUserConfigParam("camera",
@@ -856,6 +901,13 @@ namespace UserConfigParams
                                                 &m_addon_group,
                                         "Time addon-list was updated last.") );
 
+    PARAM_PREFIX BoolUserConfigParam        m_mount_addons
+            PARAM_DEFAULT(  BoolUserConfigParam(true, "mount_addons",
+                                                &m_addon_group,
+                                        "Load addons directly from their zip "
+                                        "file instead of extracting them, "
+                                        "if possible.") );
+
     PARAM_PREFIX StringUserConfigParam      m_language
             PARAM_DEFAULT( StringUserConfigParam("system", "language",
                         "Which language to use (language code or 'system')") );
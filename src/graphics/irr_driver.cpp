@@ -1637,6 +1637,57 @@ video::ITexture *IrrDriver::getTexture(FileManager::AssetType type,
     return getTexture(path, is_premul, is_prediv, complain_if_not_found);
 }   // getTexture
 
+// ----------------------------------------------------------------------------
+/** Loads a list of textures, decoding the image files on several threads.
+ *  Only the creation of the textures (i.e. the upload to the GPU) is done
+ *  on the main thread. The textures are registered under their absolute
+ *  file names, so a later getTexture call for one of these files will
+ *  find the already loaded texture. Textures that are already loaded are
+ *  skipped. Only PNG images are decoded in parallel, since irrlicht's JPEG
+ *  loader stores the name of the file being loaded in a static variable;
+ *  all other files are loaded on the main thread.
+ *  \param files File names of the textures to load.
+ */
+void IrrDriver::preloadTextures(const std::vector<std::string> &files)
+{
+    io::IFileSystem *file_system = m_device->getFileSystem();
+    std::vector<io::path> names;
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        io::path name = file_system->getAbsolutePath(files[i].c_str());
+        if (m_video_driver->findTexture(name))
+            continue;
+        if (!StringUtils::hasSuffix(StringUtils::toLowerCase(files[i]),
+                                    ".png"))
+        {
+            getTexture(files[i]);
+            continue;
+        }
+        names.push_back(name);
+    }   // for i < files.size()
+
+    std::vector<video::IImage*> images(names.size(), NULL);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)names.size(); i++)
+    {
+        images[i] = m_video_driver->createImageFromFile(names[i]);
+    }
+
+    for (unsigned int i = 0; i < names.size(); i++)
+    {
+        if (!images[i])
+        {
+            Log::error("irr_driver", "Texture '%s' not found.",
+                       core::stringc(names[i]).c_str());
+            continue;
+        }
+        // Another file name in the list might refer to the same texture
+        if (!m_video_driver->findTexture(names[i]))
+            m_video_driver->addTexture(names[i], images[i]);
+        images[i]->drop();
+    }
+}   // preloadTextures
+
 // ----------------------------------------------------------------------------
 /** Loads a texture from a file and returns the texture object.
  *  \param filename File name of the texture to load.
@@ -375,6 +375,7 @@ public:
                                      bool is_premul=false,
                                      bool is_prediv=false,
                                      bool complain_if_not_found=true);
+    void                  preloadTextures(const std::vector<std::string> &files);
     void                  clearTexturesFileName();
     std::string           getTextureName(video::ITexture* tex);
     void                  grabAllTextures(const scene::IMesh *mesh);
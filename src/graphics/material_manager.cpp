@@ -30,6 +30,9 @@
 #include "modes/profile_world.hpp"
 #include "modes/world.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 
 #include <ITexture.h>
@@ -60,6 +63,8 @@ MaterialManager::~MaterialManager()
         delete m_materials[i];
     }
     m_materials.clear();
+    m_materials_by_name.clear();
+    m_materials_by_path.clear();
 
     for (std::map<video::E_MATERIAL_TYPE, Material*> ::iterator it =
          m_default_materials.begin(); it != m_default_materials.end(); it++)
@@ -87,29 +92,13 @@ Material* MaterialManager::getMaterialFor(video::ITexture* t,
 
     core::stringc img_path = core::stringc(t->getName());
     const std::string image = StringUtils::getBasename(img_path.c_str());
+    Material *m;
     if (!img_path.empty() && (img_path.findFirst('/') != -1 || img_path.findFirst('\\') != -1))
-    {
-        // Search backward so that temporary (track) textures are found first
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
-        {
-            if (m_materials[i]->getTexFullPath() == img_path.c_str())
-            {
-                return m_materials[i];
-            }
-        }
-    }
+        m = findMaterial(img_path.c_str(), /*full_path*/true);
     else
-    {
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
-        {
-            if (m_materials[i]->getTexFname() == image)
-            {
-                return m_materials[i];
-            }
-        }   // for i
-    }
+        m = findMaterial(image, /*full_path*/false);
 
-    return getDefaultMaterial(material_type);
+    return m ? m : getDefaultMaterial(material_type);
 }
 
 //-----------------------------------------------------------------------------
@@ -174,15 +163,9 @@ void MaterialManager::adjustForFog(video::ITexture* t,
                                    bool use_fog) const
 {
     const std::string image = StringUtils::getBasename(core::stringc(t->getName()).c_str());
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
-    {
-        if (m_materials[i]->getTexFname()==image)
-        {
-            m_materials[i]->adjustForFog(parent, &(mb->getMaterial()), use_fog);
-            return;
-        }
-    }   // for i
+    Material *m = findMaterial(image, /*full_path*/false);
+    if (m)
+        m->adjustForFog(parent, &(mb->getMaterial()), use_fog);
 }   // adjustForFog
 
 //-----------------------------------------------------------------------------
@@ -207,9 +190,91 @@ void MaterialManager::setAllUntexturedMaterialFlags(scene::IMeshBuffer *mb)
 //-----------------------------------------------------------------------------
 int MaterialManager::addEntity(Material *m)
 {
+    return addMaterial(m);
+}   // addEntity
+
+//-----------------------------------------------------------------------------
+/** Appends a material to the list of all materials and adds it to the
+ *  lookup tables. Since it is the newest material, it shadows any existing
+ *  material with the same name or path.
+ *  \param m The material to add.
+ *  \return The index of the material.
+ */
+int MaterialManager::addMaterial(Material *m)
+{
+    const int index = (int)m_materials.size();
     m_materials.push_back(m);
-    return (int)m_materials.size()-1;
-}
+    m_materials_by_name[m->getTexFname()].push_back(index);
+    if (!m->getTexFullPath().empty())
+        m_materials_by_path[m->getTexFullPath()].push_back(index);
+    return index;
+}   // addMaterial
+
+//-----------------------------------------------------------------------------
+/** Deletes the last material and removes it from the lookup tables. Since
+ *  it has the highest index, it is always the last entry in its lists.
+ */
+void MaterialManager::removeLastMaterial()
+{
+    Material *m = m_materials.back();
+    std::unordered_map<std::string, std::vector<int> >::iterator i =
+        m_materials_by_name.find(m->getTexFname());
+    assert(i != m_materials_by_name.end() &&
+           i->second.back() == (int)m_materials.size() - 1);
+    i->second.pop_back();
+    if (i->second.empty())
+        m_materials_by_name.erase(i);
+
+    if (!m->getTexFullPath().empty())
+    {
+        i = m_materials_by_path.find(m->getTexFullPath());
+        assert(i != m_materials_by_path.end() &&
+               i->second.back() == (int)m_materials.size() - 1);
+        i->second.pop_back();
+        if (i->second.empty())
+            m_materials_by_path.erase(i);
+    }
+    delete m;
+    m_materials.pop_back();
+}   // removeLastMaterial
+
+//-----------------------------------------------------------------------------
+/** Returns the newest material with the given texture basename or full
+ *  path, or NULL if no such material exists.
+ *  \param name Basename or full path of the texture.
+ *  \param full_path True if name is a full path.
+ */
+Material* MaterialManager::findMaterial(const std::string &name,
+                                        bool full_path) const
+{
+    const std::unordered_map<std::string, std::vector<int> > &map =
+        full_path ? m_materials_by_path : m_materials_by_name;
+    std::unordered_map<std::string, std::vector<int> >::const_iterator i =
+        map.find(name);
+    if (i == map.end())
+        return NULL;
+    return m_materials[i->second.back()];
+}   // findMaterial
+
+//-----------------------------------------------------------------------------
+/** Same as findMaterial, but using a linear search over all materials. This
+ *  is only used as a reference in benchmark().
+ *  \param name Basename or full path of the texture.
+ *  \param full_path True if name is a full path.
+ */
+Material* MaterialManager::findMaterialLinear(const std::string &name,
+                                              bool full_path) const
+{
+    // Search backward so that temporary (track) textures are found first
+    for (int i = (int)m_materials.size() - 1; i >= 0; i--)
+    {
+        const std::string &s = full_path ? m_materials[i]->getTexFullPath()
+                                         : m_materials[i]->getTexFname();
+        if (s == name)
+            return m_materials[i];
+    }
+    return NULL;
+}   // findMaterialLinear
 
 //-----------------------------------------------------------------------------
 void MaterialManager::loadMaterial()
@@ -251,7 +316,7 @@ void MaterialManager::addSharedMaterial(const std::string& filename, bool deprec
 //-----------------------------------------------------------------------------
 bool MaterialManager::pushTempMaterial(const std::string& filename, bool deprecated)
 {
-    XMLNode *root = file_manager->createXMLTree(filename);
+    XMLNode *root = file_manager->createXMLTree(filename, /*use_cache*/true);
     if(!root || root->getName()!="materials")
     {
         if(root) delete root;
@@ -278,7 +343,7 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
         }
         try
         {
-            m_materials.push_back(new Material(node, deprecated));
+            addMaterial(new Material(node, deprecated));
         }
         catch(std::exception& e)
         {
@@ -293,11 +358,8 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
 //-----------------------------------------------------------------------------
 void MaterialManager::popTempMaterial()
 {
-    for(int i=(int)m_materials.size()-1; i>=this->m_shared_material_index; i--)
-    {
-        delete m_materials[i];
-        m_materials.pop_back();
-    }   // for i6
+    while((int)m_materials.size() > m_shared_material_index)
+        removeLastMaterial();
 }   // popTempMaterial
 
 //-----------------------------------------------------------------------------
@@ -338,15 +400,13 @@ Material *MaterialManager::getMaterial(const std::string& fname,
     else
         basename = fname;
         
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
-    {
-        if(m_materials[i]->getTexFname()==basename) return m_materials[i];
-    }
+    Material *m = findMaterial(basename, /*full_path*/false);
+    if (m)
+        return m;
 
     // Add the new material
-    Material* m = new Material(fname, is_full_path, complain_if_not_found);
-    m_materials.push_back(m);
+    m = new Material(fname, is_full_path, complain_if_not_found);
+    addMaterial(m);
     if(make_permanent)
     {
         assert(m_shared_material_index==(int)m_materials.size()-1);
@@ -368,11 +428,87 @@ void MaterialManager::makeMaterialsPermanent()
 bool MaterialManager::hasMaterial(const std::string& fname)
 {
     std::string basename=StringUtils::getBasename(fname);
+    return findMaterial(basename, /*full_path*/false) != NULL;
+}   // hasMaterial
 
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
+
+// ----------------------------------------------------------------------------
+/** Measures the time needed to look up materials while loading each track.
+ *  For each track the track materials are loaded, then the material of each
+ *  texture name and full path known to the material manager is looked up
+ *  (similar to what happens for each mesh buffer while loading), once using
+ *  the hash tables and once using a linear search. The results of both
+ *  searches are compared to make sure that the precedence of track
+ *  materials over shared materials is kept.
+ */
+void MaterialManager::benchmark()
+{
+    const int rounds = 20;
+    double total_hash = 0, total_linear = 0;
+    int total_lookups = 0;
+    bool all_correct  = true;
+
+    for (unsigned int t = 0; t < track_manager->getNumberOfTracks(); t++)
     {
-        if(m_materials[i]->getTexFname()==basename) return true;
-    }
-    return false;
-}
+        const Track *track = track_manager->getTrack(t);
+        const std::string root = StringUtils::getPath(track->getFilename())
+                               + "/";
+        file_manager->pushTextureSearchPath(root);
+        if (file_manager->fileExists(root + "materials.xml"))
+            pushTempMaterial(root + "materials.xml");
+
+        std::vector<std::string> names, paths;
+        for (unsigned int i = 0; i < m_materials.size(); i++)
+        {
+            names.push_back(m_materials[i]->getTexFname());
+            if (!m_materials[i]->getTexFullPath().empty())
+                paths.push_back(m_materials[i]->getTexFullPath());
+        }
+
+        for (unsigned int i = 0; i < names.size(); i++)
+            all_correct &= findMaterial(names[i], false) ==
+                           findMaterialLinear(names[i], false);
+        for (unsigned int i = 0; i < paths.size(); i++)
+            all_correct &= findMaterial(paths[i], true) ==
+                           findMaterialLinear(paths[i], true);
+
+        // Use the result so that the lookups are not optimised away
+        int found = 0;
+        double start = getTimeMilliseconds();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (unsigned int i = 0; i < names.size(); i++)
+                found += findMaterial(names[i], false) != NULL;
+            for (unsigned int i = 0; i < paths.size(); i++)
+                found += findMaterial(paths[i], true) != NULL;
+        }
+        const double hash_time = getTimeMilliseconds() - start;
+
+        start = getTimeMilliseconds();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (unsigned int i = 0; i < names.size(); i++)
+                found += findMaterialLinear(names[i], false) != NULL;
+            for (unsigned int i = 0; i < paths.size(); i++)
+                found += findMaterialLinear(paths[i], true) != NULL;
+        }
+        const double linear_time = getTimeMilliseconds() - start;
+
+        const int lookups = rounds * int(names.size() + paths.size());
+        Log::info("MaterialManager", "%-20s %5d materials: hash %8.3f ms, "
+                  "linear %8.3f ms (%d lookups, %d found).",
+                  track->getIdent().c_str(), (int)m_materials.size(),
+                  hash_time, linear_time, lookups, found/2);
+        total_hash    += hash_time;
+        total_linear  += linear_time;
+        total_lookups += lookups;
+
+        popTempMaterial();
+        file_manager->popTextureSearchPath();
+    }   // for t < number of tracks
+
+    Log::info("MaterialManager", "Total: hash %.3f ms, linear %.3f ms for "
+              "%d lookups.", total_hash, total_linear, total_lookups);
+    if (!all_correct)
+        Log::error("MaterialManager", "Hashed and linear lookup differ.");
+}   // benchmark
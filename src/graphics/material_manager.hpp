@@ -33,6 +33,7 @@ using namespace irr;
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 class Material;
 class XMLReader;
@@ -50,6 +51,20 @@ private:
 
     std::vector<Material*> m_materials;
 
+    /** Maps a texture basename to the indices of all materials in
+     *  m_materials with this name, in increasing order. The last index has
+     *  precedence, so temporary (track) materials shadow shared ones. */
+    std::unordered_map<std::string, std::vector<int> > m_materials_by_name;
+
+    /** Same as m_materials_by_name, but using the full texture path. */
+    std::unordered_map<std::string, std::vector<int> > m_materials_by_path;
+
+    int       addMaterial(Material *m);
+    void      removeLastMaterial();
+    Material* findMaterial(const std::string &name, bool full_path) const;
+    Material* findMaterialLinear(const std::string &name,
+                                 bool full_path) const;
+
     std::map<video::E_MATERIAL_TYPE, Material*> m_default_materials;
     Material* getDefaultMaterial(video::E_MATERIAL_TYPE material_type);
 
@@ -82,6 +97,7 @@ public:
     void      popTempMaterial  ();
     void      makeMaterialsPermanent();
     bool      hasMaterial(const std::string& fname);
+    void      benchmark();
 
     Material* getLatestMaterial() { return m_materials[m_materials.size()-1]; }
 };   // MaterialManager
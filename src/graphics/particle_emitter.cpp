@@ -111,7 +111,7 @@ class HeightMapCollisionAffector : public scene::IParticleAffector
     bool m_first_time;
 
 public:
-    HeightMapCollisionAffector(Track* t) : m_height_map(t->buildHeightMap())
+    HeightMapCollisionAffector(Track* t) : m_height_map(t->getHeightMap())
     {
         m_track = t;
         m_first_time = true;
@@ -717,7 +717,7 @@ void ParticleEmitter::addHeightMapAffector(Track* t)
         float track_z = aabb_min->getZ();
         const float track_x_len = aabb_max->getX() - aabb_min->getX();
         const float track_z_len = aabb_max->getZ() - aabb_min->getZ();
-        static_cast<ParticleSystemProxy *>(m_node)->setHeightmap(t->buildHeightMap(),
+        static_cast<ParticleSystemProxy *>(m_node)->setHeightmap(t->getHeightMap(),
             track_x, track_z, track_x_len, track_z_len);
     }
     else
@@ -20,13 +20,16 @@
 
 #include "io/file_manager.hpp"
 
+#include "addons/zip_package.hpp"
 #include "config/user_config.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/material_manager.hpp"
 #include "karts/kart_properties_manager.hpp"
+#include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
 #include "utils/log.hpp"
+#include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 
 #include <irrlicht.h>
@@ -322,6 +325,8 @@ void FileManager::init()
 //-----------------------------------------------------------------------------
 FileManager::~FileManager()
 {
+    clearPreloadedXMLTrees();
+
     // Clean up left-over files in addons/tmp that are older than 24h
     // ==============================================================
     // (The 24h delay is useful when debugging a problem with a zip file)
@@ -369,6 +374,10 @@ FileManager::~FileManager()
 
     // Clean up rest of file manager
     // =============================
+    std::map<std::string, ZipPackage*>::iterator i;
+    for (i = m_mounted_packages.begin(); i != m_mounted_packages.end(); i++)
+        m_file_system->removeFileArchive(i->second);
+    m_mounted_packages.clear();
     popMusicSearchPath();
     popModelSearchPath();
     popTextureSearchPath();
@@ -419,11 +428,28 @@ io::IXMLReader *FileManager::createXMLReader(const std::string &filename)
 //-----------------------------------------------------------------------------
 /** Reads in a XML file and converts it into a XMLNode tree.
  *  \param filename Name of the XML file to read.
+ *  \param use_cache If true (and enabled in the user config) a pre-parsed
+ *         binary copy of the tree in the cached-textures directory is used
+ *         if it is up to date, see XMLNode::createCached. This should only
+ *         be used for large files that are read often.
  */
-XMLNode *FileManager::createXMLTree(const std::string &filename)
+XMLNode *FileManager::createXMLTree(const std::string &filename,
+                                    bool use_cache)
 {
+    std::map<std::string, XMLNode*>::iterator i =
+        m_preloaded_xml_trees.find(filename);
+    if (i != m_preloaded_xml_trees.end())
+    {
+        XMLNode *node = i->second;
+        m_preloaded_xml_trees.erase(i);
+        return node;
+    }
+
     try
     {
+        if (use_cache && UserConfigParams::m_cache_xml_trees)
+            return XMLNode::createCached(filename,
+                                         getXMLCacheFileName(filename));
         XMLNode* node = new XMLNode(filename);
         return node;
     }
@@ -437,6 +463,162 @@ XMLNode *FileManager::createXMLTree(const std::string &filename)
     }
 }   // createXMLTree
 
+//-----------------------------------------------------------------------------
+/** Returns the name of the file in which a pre-parsed binary copy of a XML
+ *  file is stored. The name contains the name of the directory and of the
+ *  file (for debugging), and a hash of the full path, since many files
+ *  have the same name (e.g. scene.xml).
+ *  \param filename Full path of the XML file.
+ */
+std::string FileManager::getXMLCacheFileName(const std::string &filename)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned int i = 0; i < filename.size(); i++)
+        hash = (hash ^ (unsigned char)filename[i]) * 1099511628211ULL;
+    char hex[17];
+    sprintf(hex, "%08x%08x", (unsigned int)(hash >> 32),
+                             (unsigned int)(hash & 0xffffffff));
+    const std::string dir =
+        StringUtils::getBasename(StringUtils::getPath(filename));
+    return m_cached_textures_dir + "xml-" + dir + "-"
+         + StringUtils::getBasename(filename) + "-" + hex + ".bin";
+}   // getXMLCacheFileName
+
+//-----------------------------------------------------------------------------
+/** Compares the time needed to parse the track.xml, scene.xml and
+ *  materials.xml files of all stock tracks with the time needed to load
+ *  the pre-parsed binary trees, and checks that both give the same trees.
+ */
+void FileManager::benchmarkXMLCache()
+{
+    std::vector<std::string> files;
+    for (unsigned int t = 0; t < track_manager->getNumberOfTracks(); t++)
+    {
+        const Track *track = track_manager->getTrack(t);
+        if (track->getFilename().find(getAddonsDir()) == 0)
+            continue;
+        const std::string root = StringUtils::getPath(track->getFilename())
+                               + "/";
+        const char *names[] = { "track.xml", "scene.xml", "materials.xml" };
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            if (fileExists(root + names[i]))
+                files.push_back(root + names[i]);
+        }
+    }
+
+    double total_xml = 0, total_write = 0, total_binary = 0;
+    unsigned int num_errors = 0;
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        const std::string cache_name = getXMLCacheFileName(files[i]);
+        remove(cache_name.c_str());
+
+        double start = getTimeMilliseconds();
+        XMLNode *xml = new XMLNode(files[i]);
+        const double xml_time = getTimeMilliseconds() - start;
+
+        // The first call parses the XML file and writes the binary file,
+        // the second call loads the binary file.
+        start = getTimeMilliseconds();
+        delete XMLNode::createCached(files[i], cache_name);
+        const double write_time = getTimeMilliseconds() - start;
+
+        start = getTimeMilliseconds();
+        XMLNode *binary = XMLNode::createCached(files[i], cache_name);
+        const double binary_time = getTimeMilliseconds() - start;
+
+        if (!xml->isEqual(binary))
+        {
+            Log::error("FileManager", "Binary tree of '%s' is different.",
+                       files[i].c_str());
+            num_errors++;
+        }
+        Log::info("FileManager", "%s: xml %f ms, xml+write %f ms, "
+                  "binary %f ms.", files[i].c_str(), xml_time, write_time,
+                  binary_time);
+        total_xml    += xml_time;
+        total_write  += write_time;
+        total_binary += binary_time;
+        delete xml;
+        delete binary;
+    }
+    Log::info("FileManager", "%d files: xml %f ms, xml+write %f ms, "
+              "binary %f ms.", (int)files.size(), total_xml, total_write,
+              total_binary);
+    if (num_errors == 0)
+        Log::info("FileManager", "All binary trees are identical.");
+}   // benchmarkXMLCache
+
+//-----------------------------------------------------------------------------
+/** Parses a list of XML files on several threads. The trees are kept until
+ *  they are requested by createXMLTree, so loaders that read many small
+ *  files (e.g. the kart.xml files of all karts) only need to call this
+ *  function beforehand to get the parsing done in parallel. Files that
+ *  can not be parsed are skipped here, the error is then reported when
+ *  createXMLTree tries to parse them again.
+ *  Only the parsing is done in parallel: irrlicht's file system is safe
+ *  to be used to open and read files from different threads, but the
+ *  objects using the XML data (e.g. textures) are not.
+ *  \param files Names of the XML files to parse.
+ */
+void FileManager::preloadXMLTrees(const std::vector<std::string> &files)
+{
+    std::vector<XMLNode*> trees(files.size(), NULL);
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)files.size(); i++)
+    {
+        try
+        {
+            trees[i] = new XMLNode(files[i]);
+        }
+        catch (std::runtime_error&)
+        {
+            trees[i] = NULL;
+        }
+    }   // for i < files.size()
+
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        if (!trees[i]) continue;
+        std::map<std::string, XMLNode*>::iterator old =
+            m_preloaded_xml_trees.find(files[i]);
+        if (old != m_preloaded_xml_trees.end())
+            delete old->second;
+        m_preloaded_xml_trees[files[i]] = trees[i];
+    }
+}   // preloadXMLTrees
+
+//-----------------------------------------------------------------------------
+/** Returns a tree parsed by preloadXMLTrees without handing it out, so
+ *  that e.g. the names of textures can be collected from it, or NULL if
+ *  the file was not preloaded (or could not be parsed).
+ *  \param filename Name of the XML file.
+ */
+const XMLNode *FileManager::getPreloadedXMLTree(const std::string &filename)
+                                                                         const
+{
+    std::map<std::string, XMLNode*>::const_iterator i =
+        m_preloaded_xml_trees.find(filename);
+    return i == m_preloaded_xml_trees.end() ? NULL : i->second;
+}   // getPreloadedXMLTree
+
+//-----------------------------------------------------------------------------
+/** Frees all preloaded XML trees that were not requested by createXMLTree,
+ *  e.g. because a kart or track was skipped.
+ */
+void FileManager::clearPreloadedXMLTrees()
+{
+    std::map<std::string, XMLNode*>::iterator i;
+    for (i = m_preloaded_xml_trees.begin(); i != m_preloaded_xml_trees.end();
+         i++)
+    {
+        delete i->second;
+    }
+    m_preloaded_xml_trees.clear();
+}   // clearPreloadedXMLTrees
+
 //-----------------------------------------------------------------------------
 /** Reads in XML from a string and converts it into a XMLNode tree.
  *  \param content the string containing the XML content.
@@ -1277,6 +1459,71 @@ void FileManager::checkAndCreateDirForAddons(const std::string &dir)
     }
 }   // checkAndCreateDirForAddons
 
+//-----------------------------------------------------------------------------
+/** Mounts the package of an addon (if the data directory of the addon
+ *  contains one), so that the files of the addon can be read without
+ *  extracting them, see ZipPackage.
+ *  \param dir The data directory of the addon.
+ *  \return True if a package was mounted.
+ */
+bool FileManager::mountAddonPackage(const std::string &dir)
+{
+    const std::string package_file = dir + "/" + ZipPackage::PACKAGE_NAME;
+    unmountAddonPackage(dir);
+    if (!fileExists(package_file))
+        return false;
+
+    ZipPackage *package = new ZipPackage(package_file, dir);
+    if (!package->isValid())
+    {
+        package->drop();
+        return false;
+    }
+    // The file system now owns the package, and drops it when it is removed
+    m_file_system->addFileArchive(package);
+    m_mounted_packages[package->getMountDir()] = package;
+    if (UserConfigParams::logAddons())
+        Log::verbose("FileManager", "Mounted '%s' with %d files.",
+                     package_file.c_str(), package->getFileCount());
+    return true;
+}   // mountAddonPackage
+
+//-----------------------------------------------------------------------------
+/** Removes the package of an addon from the file system, if it is mounted.
+ *  \param dir The data directory of the addon.
+ */
+void FileManager::unmountAddonPackage(const std::string &dir)
+{
+    std::map<std::string, ZipPackage*>::iterator i =
+        m_mounted_packages.find(ZipPackage::normalisePath(dir + "/"));
+    if (i == m_mounted_packages.end())
+        return;
+    m_file_system->removeFileArchive(i->second);
+    m_mounted_packages.erase(i);
+}   // unmountAddonPackage
+
+//-----------------------------------------------------------------------------
+/** Mounts the packages of all installed kart and track addons. This must be
+ *  called before the karts and tracks are loaded.
+ */
+void FileManager::mountAddonPackages()
+{
+    const char *types[] = { "karts/", "tracks/" };
+    for (unsigned int i = 0; i < 2; i++)
+    {
+        const std::string dir = getAddonsFile(types[i]);
+        std::set<std::string> addons;
+        listFiles(addons, dir);
+        for (std::set<std::string>::iterator j = addons.begin();
+             j != addons.end(); j++)
+        {
+            if (*j == "." || *j == "..") continue;
+            if (isDirectory(dir + *j))
+                mountAddonPackage(dir + *j);
+        }
+    }
+}   // mountAddonPackages
+
 // ----------------------------------------------------------------------------
 /** Removes the specified file.
  *  \return True if successful, or false if the file is not a regular file or
@@ -1379,14 +1626,47 @@ bool FileManager::copyFile(const std::string &source, const std::string &dest)
 }   // copyFile
 // ----------------------------------------------------------------------------
 /** Returns true if the first file is newer than the second. The comparison is
-*   based on the modification time of the two files.
+*   based on the modification time of the two files (see
+*   getFileModificationTime), a file that does not exist is older than any
+*   existing file.
 */
 bool FileManager::fileIsNewer(const std::string& f1, const std::string& f2) const
 {
-    struct stat stat1;
-    struct stat stat2;
-    stat(f1.c_str(), &stat1);
-    stat(f2.c_str(), &stat2);
-    return stat1.st_mtime > stat2.st_mtime;
+    return getFileModificationTime(f1) > getFileModificationTime(f2);
 }   // fileIsNewer
 
+// ----------------------------------------------------------------------------
+/** Returns the modification time of a file, or 0 if the file does not
+ *  exist. For a file in a mounted addon package the modification time of
+ *  the package is used.
+ *  \param name Full path of the file.
+ */
+int64_t FileManager::getFileModificationTime(const std::string& name) const
+{
+    struct stat mystat;
+    if(stat(name.c_str(), &mystat) == 0)
+        return (int64_t)mystat.st_mtime;
+
+    const std::string dir =
+        ZipPackage::normalisePath(StringUtils::getPath(name) + "/");
+    std::map<std::string, ZipPackage*>::const_iterator i =
+        m_mounted_packages.find(dir);
+    if (i == m_mounted_packages.end() ||
+        stat(i->second->getFilename().c_str(), &mystat) < 0)
+        return 0;
+    return (int64_t)mystat.st_mtime;
+}   // getFileModificationTime
+
+// ----------------------------------------------------------------------------
+/** Returns the size of a file in bytes, or -1 if the file does not exist
+ *  (or is only contained in a mounted addon package).
+ *  \param name Full path of the file.
+ */
+int64_t FileManager::getFileSize(const std::string& name) const
+{
+    struct stat mystat;
+    if(stat(name.c_str(), &mystat) == 0)
+        return (int64_t)mystat.st_size;
+    return -1;
+}   // getFileSize
+
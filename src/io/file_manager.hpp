@@ -25,6 +25,7 @@
  * Contains generic utility classes for file I/O (especially XML handling).
  */
 
+#include <map>
 #include <string>
 #include <vector>
 #include <set>
@@ -37,6 +38,8 @@ using namespace irr;
 #include "io/xml_node.hpp"
 #include "utils/no_copy.hpp"
 
+class ZipPackage;
+
 /**
   * \brief class handling files and paths
   * \ingroup io
@@ -78,6 +81,14 @@ private:
     /** Directory to store replays in. */
     std::string       m_replay_dir;
 
+    /** XML trees parsed in advance by preloadXMLTrees, indexed by file
+     *  name. They are handed out (once) by createXMLTree. */
+    std::map<std::string, XMLNode*> m_preloaded_xml_trees;
+
+    /** Addon packages mounted into the file system, indexed by the
+     *  (normalised) data directory of the addon. */
+    std::map<std::string, ZipPackage*> m_mounted_packages;
+
     /** Directory where resized textures are cached. */
     std::string       m_cached_textures_dir;
 
@@ -96,6 +107,7 @@ private:
                                const std::string& fname) const;
     bool              checkAndCreateDirectory(const std::string &path);
     io::path          createAbsoluteFilename(const std::string &f);
+    std::string       getXMLCacheFileName(const std::string &filename);
     void              checkAndCreateConfigDir();
     bool              isDirectory(const std::string &path) const;
     void              checkAndCreateAddonsDir();
@@ -118,8 +130,13 @@ public:
     static void       addRootDirs(const std::string &roots);
     static void       setStdoutName(const std::string &name);
     io::IXMLReader   *createXMLReader(const std::string &filename);
-    XMLNode          *createXMLTree(const std::string &filename);
+    XMLNode          *createXMLTree(const std::string &filename,
+                                     bool use_cache=false);
     XMLNode          *createXMLTreeFromString(const std::string & content);
+    void              preloadXMLTrees(const std::vector<std::string> &files);
+    const XMLNode    *getPreloadedXMLTree(const std::string &filename) const;
+    void              clearPreloadedXMLTrees();
+    void              benchmarkXMLCache();
 
     std::string       getScreenshotDir() const;
     std::string       getReplayDir() const;
@@ -130,6 +147,9 @@ public:
     const std::string &getAddonsDir() const;
     std::string        getAddonsFile(const std::string &name);
     void checkAndCreateDirForAddons(const std::string &dir);
+    bool mountAddonPackage(const std::string &dir);
+    void unmountAddonPackage(const std::string &dir);
+    void mountAddonPackages();
     bool removeFile(const std::string &name) const;
     bool removeDirectory(const std::string &name) const;
     bool copyFile(const std::string &source, const std::string &dest);
@@ -173,6 +193,8 @@ public:
     void       redirectOutput();
 
     bool       fileIsNewer(const std::string& f1, const std::string& f2) const;
+    int64_t    getFileModificationTime(const std::string& name) const;
+    int64_t    getFileSize(const std::string& name) const;
 
     // ------------------------------------------------------------------------
     /** Returns the irrlicht file system. */
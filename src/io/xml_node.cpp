@@ -19,10 +19,19 @@
 #include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/log.hpp"
 #include "utils/interpolation_array.hpp"
 #include "utils/vec3.hpp"
 
 #include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#ifdef WIN32
+#  include <process.h>
+#  define getpid _getpid
+#else
+#  include <unistd.h>
+#endif
 
 XMLNode::XMLNode(io::IXMLReader *xml)
 {
@@ -631,3 +640,305 @@ bool XMLNode::hasChildNamed(const char* name) const
     }
     return false;
 }
+
+// ----------------------------------------------------------------------------
+/** Returns true if this tree has the same names, attributes and children
+ *  (in the same order) as the other tree.
+ *  \param other The tree to compare with.
+ */
+bool XMLNode::isEqual(const XMLNode *other) const
+{
+    if (m_name != other->m_name || m_attributes != other->m_attributes ||
+        m_nodes.size() != other->m_nodes.size())
+        return false;
+    for (unsigned int i = 0; i < m_nodes.size(); i++)
+    {
+        if (!m_nodes[i]->isEqual(other->m_nodes[i]))
+            return false;
+    }
+    return true;
+}   // isEqual
+
+// ============================================================================
+// Binary trees
+// ----------------------------------------------------------------------------
+/** Reads a XML file, using a binary copy of the tree if possible. The binary
+ *  file is only used if it was created from a file with the same content
+ *  (the file stores a hash of the XML file), otherwise the XML file is
+ *  parsed and a new binary file is written.
+ *  The binary file contains a header (magic "STKX", version, size of
+ *  wchar_t and the hash of the XML file), then the list of all element and
+ *  attribute names (so each name is only stored once), followed by the
+ *  nodes: index of the name, the attributes (index of the name and the
+ *  value as wchar_t) and then the children.
+ *  \param filename Name of the XML file.
+ *  \param cache_name Name of the binary file.
+ *  \throw runtime_error if the XML file is not found.
+ */
+XMLNode *XMLNode::createCached(const std::string &filename,
+                               const std::string &cache_name)
+{
+    uint64_t hash;
+    if (!getFileHash(filename, &hash))
+        throw std::runtime_error("Cannot find file "+filename);
+
+    XMLNode *node = loadBinary(cache_name, hash, filename);
+    if (node)
+        return node;
+
+    node = new XMLNode(filename);
+    node->saveBinary(cache_name, hash);
+    return node;
+}   // createCached
+
+// ----------------------------------------------------------------------------
+/** Computes a hash (FNV-1a) of the content of a file.
+ *  \param filename Name of the file.
+ *  \param hash On return the hash.
+ *  \return False if the file could not be read.
+ */
+bool XMLNode::getFileHash(const std::string &filename, uint64_t *hash)
+{
+    io::IReadFile *file =
+        file_manager->getFileSystem()->createAndOpenFile(filename.c_str());
+    if (!file)
+        return false;
+    std::vector<char> buffer(file->getSize());
+    const bool ok = buffer.empty() ||
+                    file->read(&buffer[0], (u32)buffer.size())
+                                                   == (s32)buffer.size();
+    file->drop();
+
+    *hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < buffer.size(); i++)
+        *hash = (*hash ^ (unsigned char)buffer[i]) * 1099511628211ULL;
+    return ok;
+}   // getFileHash
+
+// ----------------------------------------------------------------------------
+/** Adds the names of this node and its attributes, and of all children,
+ *  to the list of names, numbering them in the order they are found.
+ *  \param names The names and their index.
+ */
+void XMLNode::collectNames(std::map<std::string, uint32_t> *names) const
+{
+    names->insert(std::make_pair(m_name, (uint32_t)names->size()));
+    std::map<std::string, core::stringw>::const_iterator i;
+    for (i = m_attributes.begin(); i != m_attributes.end(); i++)
+        names->insert(std::make_pair(i->first, (uint32_t)names->size()));
+    for (unsigned int n = 0; n < m_nodes.size(); n++)
+        m_nodes[n]->collectNames(names);
+}   // collectNames
+
+// ----------------------------------------------------------------------------
+/** Writes this node and all children to a binary file.
+ *  \param f The file to write to.
+ *  \param names Index of each name.
+ */
+void XMLNode::writeBinary(FILE *f,
+                          const std::map<std::string, uint32_t> &names) const
+{
+    uint32_t n = names.find(m_name)->second;
+    fwrite(&n, sizeof(n), 1, f);
+    n = (uint32_t)m_attributes.size();
+    fwrite(&n, sizeof(n), 1, f);
+    std::map<std::string, core::stringw>::const_iterator i;
+    for (i = m_attributes.begin(); i != m_attributes.end(); i++)
+    {
+        n = names.find(i->first)->second;
+        fwrite(&n, sizeof(n), 1, f);
+        n = i->second.size();
+        fwrite(&n, sizeof(n), 1, f);
+        fwrite(i->second.c_str(), sizeof(wchar_t), n, f);
+    }
+    n = (uint32_t)m_nodes.size();
+    fwrite(&n, sizeof(n), 1, f);
+    for (unsigned int k = 0; k < m_nodes.size(); k++)
+        m_nodes[k]->writeBinary(f, names);
+}   // writeBinary
+
+// ----------------------------------------------------------------------------
+/** Writes this tree to a binary file, see createCached for the format.
+ *  The tree is written to a temporary file first, which is then renamed,
+ *  so that other processes (e.g. the lobbies of a server) never read a
+ *  partially written file.
+ *  \param cache_name Name of the binary file.
+ *  \param hash Hash of the XML file this tree was read from.
+ */
+void XMLNode::saveBinary(const std::string &cache_name, uint64_t hash) const
+{
+    std::map<std::string, uint32_t> names;
+    collectNames(&names);
+
+    const std::string temp_name = cache_name + "."
+                                + StringUtils::toString(getpid()) + ".part";
+    FILE *f = fopen(temp_name.c_str(), "wb");
+    if (!f)
+    {
+        Log::warn("XMLNode", "Can't write binary tree '%s'.",
+                  cache_name.c_str());
+        return;
+    }
+    const uint32_t version = 1, wchar_size = sizeof(wchar_t);
+    fwrite("STKX", 1, 4, f);
+    fwrite(&version, sizeof(version), 1, f);
+    fwrite(&wchar_size, sizeof(wchar_size), 1, f);
+    fwrite(&hash, sizeof(hash), 1, f);
+
+    // Write the names ordered by their index
+    std::vector<const std::string*> ordered(names.size());
+    std::map<std::string, uint32_t>::const_iterator i;
+    for (i = names.begin(); i != names.end(); i++)
+        ordered[i->second] = &i->first;
+    uint32_t n = (uint32_t)ordered.size();
+    fwrite(&n, sizeof(n), 1, f);
+    uint32_t size = 0;
+    for (unsigned int k = 0; k < ordered.size(); k++)
+    {
+        n = (uint32_t)ordered[k]->size();
+        fwrite(&n, sizeof(n), 1, f);
+        fwrite(ordered[k]->c_str(), 1, n, f);
+        size += n;
+    }
+    // Pad the names so that the values (wchar_t) are aligned when the
+    // file is loaded into memory.
+    const char padding[4] = { 0, 0, 0, 0 };
+    fwrite(padding, 1, (4 - size % 4) % 4, f);
+
+    writeBinary(f, names);
+    // fwrite sets the error indicator of the file if it fails
+    const bool ok = !ferror(f);
+    if (fclose(f) != 0 || !ok)
+    {
+        Log::warn("XMLNode", "Can't write binary tree '%s'.",
+                  cache_name.c_str());
+        remove(temp_name.c_str());
+        return;
+    }
+#ifdef WIN32
+    // rename does not replace an existing file on windows
+    remove(cache_name.c_str());
+#endif
+    if (rename(temp_name.c_str(), cache_name.c_str()) != 0)
+    {
+        Log::warn("XMLNode", "Can't rename binary tree '%s'.",
+                  temp_name.c_str());
+        remove(temp_name.c_str());
+    }
+}   // saveBinary
+
+// ----------------------------------------------------------------------------
+/** Reads a node and all its children from a binary file in memory.
+ *  \param p Pointer to the current position, will be moved to the end of
+ *         this node.
+ *  \param end End of the data.
+ *  \param names All names used in the file.
+ *  \param filename Name of the XML file (used in error messages).
+ *  \return False if the data is invalid.
+ */
+bool XMLNode::readBinary(const char **p, const char *end,
+                         const std::vector<std::string> &names,
+                         const std::string &filename)
+{
+    m_file_name = filename;
+    uint32_t name, num;
+    if (end - *p < 8) return false;
+    memcpy(&name, *p, 4);
+    memcpy(&num, *p + 4, 4);
+    *p += 8;
+    if (name >= names.size()) return false;
+    m_name = names[name];
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        uint32_t length;
+        if (end - *p < 8) return false;
+        memcpy(&name, *p, 4);
+        memcpy(&length, *p + 4, 4);
+        *p += 8;
+        if (name >= names.size() ||
+            (size_t)(end - *p) / sizeof(wchar_t) < length)
+            return false;
+        m_attributes[names[name]] =
+            core::stringw((const wchar_t*)*p, length);
+        *p += length * sizeof(wchar_t);
+    }
+
+    if (end - *p < 4) return false;
+    memcpy(&num, *p, 4);
+    *p += 4;
+    for (uint32_t i = 0; i < num; i++)
+    {
+        XMLNode *node = new XMLNode();
+        m_nodes.push_back(node);
+        if (!node->readBinary(p, end, names, filename))
+            return false;
+    }
+    return true;
+}   // readBinary
+
+// ----------------------------------------------------------------------------
+/** Loads a tree from a binary file, see createCached for the format.
+ *  \param cache_name Name of the binary file.
+ *  \param hash Hash of the XML file, must match the hash stored in the file.
+ *  \param filename Name of the XML file.
+ *  \return The tree, or NULL if the file does not exist, is invalid or was
+ *          created from a different version of the XML file.
+ */
+XMLNode *XMLNode::loadBinary(const std::string &cache_name, uint64_t hash,
+                             const std::string &filename)
+{
+    FILE *f = fopen(cache_name.c_str(), "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 24)
+    {
+        fclose(f);
+        return NULL;
+    }
+    std::vector<char> buffer(size);
+    const bool ok = fread(&buffer[0], 1, size, f) == (size_t)size;
+    fclose(f);
+
+    uint32_t version, wchar_size;
+    uint64_t file_hash;
+    memcpy(&version,    &buffer[4],  4);
+    memcpy(&wchar_size, &buffer[8],  4);
+    memcpy(&file_hash,  &buffer[12], 8);
+    if (!ok || memcmp(&buffer[0], "STKX", 4) != 0 || version != 1 ||
+        wchar_size != sizeof(wchar_t) || file_hash != hash)
+        return NULL;
+
+    const char *p   = &buffer[20];
+    const char *end = &buffer[0] + size;
+    uint32_t num_names, names_size = 0;
+    memcpy(&num_names, p, 4);
+    p += 4;
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < num_names; i++)
+    {
+        uint32_t length;
+        if (end - p < 4) return NULL;
+        memcpy(&length, p, 4);
+        p += 4;
+        if ((size_t)(end - p) < length) return NULL;
+        names.push_back(std::string(p, length));
+        p += length;
+        names_size += length;
+    }
+    p += (4 - names_size % 4) % 4;
+
+    // The file must end exactly after the root node
+    XMLNode *node = new XMLNode();
+    if (p > end || !node->readBinary(&p, end, names, filename) || p != end)
+    {
+        Log::warn("XMLNode", "Binary tree '%s' is invalid.",
+                  cache_name.c_str());
+        delete node;
+        return NULL;
+    }
+    return node;
+}   // loadBinary
@@ -19,6 +19,7 @@
 #ifndef HEADER_XML_NODE_HPP
 #define HEADER_XML_NODE_HPP
 
+#include <stdio.h>
 #include <string>
 #include <map>
 #include <vector>
@@ -57,6 +58,20 @@ private:
 
     std::string                          m_file_name;
 
+    /** Only used when reading a binary tree. */
+         XMLNode() {}
+    void collectNames(std::map<std::string, uint32_t> *names) const;
+    void writeBinary(FILE *f,
+                     const std::map<std::string, uint32_t> &names) const;
+    bool readBinary(const char **p, const char *end,
+                    const std::vector<std::string> &names,
+                    const std::string &filename);
+    static bool     getFileHash(const std::string &filename, uint64_t *hash);
+    static XMLNode *loadBinary(const std::string &cache_name, uint64_t hash,
+                               const std::string &filename);
+    void            saveBinary(const std::string &cache_name,
+                               uint64_t hash) const;
+
 public:
          LEAK_CHECK();
          XMLNode(io::IXMLReader *xml);
@@ -66,6 +81,10 @@ public:
 
         ~XMLNode();
 
+    static XMLNode *createCached(const std::string &filename,
+                                 const std::string &cache_name);
+    bool isEqual(const XMLNode *other) const;
+
     const std::string &getName() const {return m_name; }
     const XMLNode     *getNode(const std::string &name) const;
     const void         getNodes(const std::string &s, std::vector<XMLNode*>& out) const;
@@ -270,6 +270,10 @@ public:
     /** Returns the XYZ position of the item. */
     const Vec3&   getXYZ() const { return m_xyz; }
     // ------------------------------------------------------------------------
+    /** Returns the maximum distance of a kart to this item at which
+     *  the item is hit. */
+    float         getHitDistance() const { return sqrtf(m_distance_2); }
+    // ------------------------------------------------------------------------
     /** Returns the index of the graph node this item is on. */
     int           getGraphNode() const { return m_graph_node; }
     // ------------------------------------------------------------------------
@@ -0,0 +1,259 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "items/item_grid.hpp"
+
+#include "items/item.hpp"
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+#include "utils/vec3.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+const float ItemGrid::CELL_SIZE = 5.0f;
+
+namespace
+{
+    /** Sorts items by their item id. */
+    bool compareItemId(const Item *a, const Item *b)
+    {
+        return a->getItemId() < b->getItemId();
+    }   // compareItemId
+}   // namespace
+
+// ----------------------------------------------------------------------------
+ItemGrid::ItemGrid()
+{
+    assert((NUM_BUCKETS & (NUM_BUCKETS-1)) == 0);
+    m_buckets.resize(NUM_BUCKETS);
+}   // ItemGrid
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the cell a coordinate is in. */
+int ItemGrid::getCell(float f)
+{
+    return (int)floorf(f / CELL_SIZE);
+}   // getCell
+
+// ----------------------------------------------------------------------------
+/** Returns the bucket in which the items of a cell are stored.
+ *  \param x, z Index of the cell.
+ */
+unsigned int ItemGrid::getBucket(int x, int z)
+{
+    return ((unsigned int)x*73856093u ^ (unsigned int)z*19349663u)
+         & (NUM_BUCKETS-1);
+}   // getBucket
+
+// ----------------------------------------------------------------------------
+/** Computes the (sorted and unique) list of all buckets that store an item,
+ *  i.e. the buckets of all cells overlapped by the hit area of the item.
+ *  \param item The item.
+ *  \param buckets On return the list of buckets.
+ */
+void ItemGrid::getBucketsOfItem(const Item *item,
+                                std::vector<unsigned int> *buckets) const
+{
+    buckets->clear();
+    // Add a small margin so that rounding errors in the square root can
+    // not cause a hit in a cell which does not contain the item.
+    const float r = item->getHitDistance()*1.01f + 0.01f;
+    const Vec3 &xyz = item->getXYZ();
+    const int x0 = getCell(xyz.getX() - r), x1 = getCell(xyz.getX() + r);
+    const int z0 = getCell(xyz.getZ() - r), z1 = getCell(xyz.getZ() + r);
+
+    // Very large trigger items are simply stored in all buckets
+    if((x1-x0+1)*(z1-z0+1) >= NUM_BUCKETS)
+    {
+        buckets->resize(NUM_BUCKETS);
+        for(unsigned int i=0; i<NUM_BUCKETS; i++)
+            (*buckets)[i] = i;
+        return;
+    }
+
+    for(int x=x0; x<=x1; x++)
+        for(int z=z0; z<=z1; z++)
+            buckets->push_back(getBucket(x, z));
+    std::sort(buckets->begin(), buckets->end());
+    buckets->erase(std::unique(buckets->begin(), buckets->end()),
+                   buckets->end());
+}   // getBucketsOfItem
+
+// ----------------------------------------------------------------------------
+/** Adds an item to the grid. The item id must already be set.
+ *  \param item The item to add.
+ */
+void ItemGrid::add(Item *item)
+{
+    std::vector<unsigned int> buckets;
+    getBucketsOfItem(item, &buckets);
+    for(unsigned int i=0; i<buckets.size(); i++)
+    {
+        std::vector<Item*> &items = m_buckets[buckets[i]];
+        std::vector<Item*>::iterator p =
+            std::lower_bound(items.begin(), items.end(), item, compareItemId);
+        items.insert(p, item);
+    }
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Removes an item from the grid.
+ *  \param item The item to remove.
+ */
+void ItemGrid::remove(Item *item)
+{
+    std::vector<unsigned int> buckets;
+    getBucketsOfItem(item, &buckets);
+    for(unsigned int i=0; i<buckets.size(); i++)
+    {
+        std::vector<Item*> &items = m_buckets[buckets[i]];
+        std::vector<Item*>::iterator p =
+            std::lower_bound(items.begin(), items.end(), item, compareItemId);
+        assert(p!=items.end() && *p==item);
+        if(p!=items.end() && *p==item)
+            items.erase(p);
+    }
+}   // remove
+
+// ----------------------------------------------------------------------------
+/** Returns all items that might be hit by a kart at the specified position,
+ *  sorted by item id. Each item still needs to be tested with hitKart.
+ *  \param xyz Position of the kart.
+ */
+const std::vector<Item*> &ItemGrid::getItemsAt(const Vec3 &xyz) const
+{
+    return m_buckets[getBucket(getCell(xyz.getX()), getCell(xyz.getZ()))];
+}   // getItemsAt
+
+// ----------------------------------------------------------------------------
+/** Compares the items hit by karts driving around randomly when testing all
+ *  items and when using the grid, and prints the time taken by both
+ *  approaches. Items are added and removed during the test to check that
+ *  the grid is kept up to date (including re-used item ids).
+ */
+void ItemGrid::benchmark()
+{
+    const unsigned int num_items  = 3000;
+    const unsigned int num_karts  = 30;
+    const unsigned int num_steps  = 2000;
+    const float        track_size = 600.0f;
+    srand(42);
+
+    ItemGrid grid;
+    std::vector<Item*> all_items(num_items, (Item*)NULL);
+    // Most items have the default hit distance, some are trigger items
+    // with a large hit distance.
+    for(unsigned int i=0; i<num_items; i++)
+    {
+        Vec3 xyz(track_size * rand()/RAND_MAX, 5.0f * rand()/RAND_MAX,
+                 track_size * rand()/RAND_MAX);
+        const float distance = i%50==0 ? 5.0f + 35.0f*rand()/RAND_MAX
+                                       : sqrtf(0.8f);
+        all_items[i] = new Item(xyz, distance, NULL);
+        all_items[i]->setItemId(i);
+        grid.add(all_items[i]);
+    }
+
+    // Each kart starts at an item (to make sure there are hits at all)
+    // and then moves a small random step each frame.
+    std::vector<Vec3> kart_xyz(num_karts);
+    for(unsigned int k=0; k<num_karts; k++)
+        kart_xyz[k] = all_items[rand()%num_items]->getXYZ();
+
+    double time_all = 0, time_grid = 0;
+    unsigned int num_hits = 0, num_errors = 0;
+    std::vector<const Item*> hit_all, hit_grid;
+    for(unsigned int step=0; step<num_steps; step++)
+    {
+        for(unsigned int k=0; k<num_karts; k++)
+        {
+            kart_xyz[k] += Vec3(1.0f - 2.0f*rand()/RAND_MAX, 0,
+                                1.0f - 2.0f*rand()/RAND_MAX);
+            const Item *item = all_items[rand()%num_items];
+            if(step % 100 == k && item)
+                kart_xyz[k] = item->getXYZ();
+        }
+
+        hit_all.clear();
+        double start = getTimeMilliseconds();
+        for(unsigned int k=0; k<num_karts; k++)
+        {
+            for(unsigned int i=0; i<all_items.size(); i++)
+            {
+                if(all_items[i] && all_items[i]->hitKart(kart_xyz[k]))
+                    hit_all.push_back(all_items[i]);
+            }
+        }
+        time_all += getTimeMilliseconds() - start;
+
+        hit_grid.clear();
+        start = getTimeMilliseconds();
+        for(unsigned int k=0; k<num_karts; k++)
+        {
+            const std::vector<Item*> &items = grid.getItemsAt(kart_xyz[k]);
+            for(unsigned int i=0; i<items.size(); i++)
+            {
+                if(items[i]->hitKart(kart_xyz[k]))
+                    hit_grid.push_back(items[i]);
+            }
+        }
+        time_grid += getTimeMilliseconds() - start;
+
+        num_hits += (unsigned int)hit_all.size();
+        if(hit_all != hit_grid)
+            num_errors++;
+
+        // Remove some items and add new ones, re-using the freed ids
+        // like ItemManager::insertItem does.
+        if(step % 10 == 0)
+        {
+            const unsigned int n = rand() % num_items;
+            if(all_items[n])
+            {
+                grid.remove(all_items[n]);
+                delete all_items[n];
+                all_items[n] = NULL;
+            }
+            const unsigned int m = rand() % num_items;
+            if(!all_items[m])
+            {
+                Vec3 xyz(track_size * rand()/RAND_MAX, 0,
+                         track_size * rand()/RAND_MAX);
+                all_items[m] = new Item(xyz, sqrtf(0.8f), NULL);
+                all_items[m]->setItemId(m);
+                grid.add(all_items[m]);
+            }
+        }
+    }   // for step < num_steps
+
+    for(unsigned int i=0; i<all_items.size(); i++)
+        delete all_items[i];
+
+    Log::info("ItemGrid", "%d items, %d karts, %d steps, %d hits.",
+              num_items, num_karts, num_steps, num_hits);
+    Log::info("ItemGrid", "Testing all items: %f ms, using grid: %f ms.",
+              time_all, time_grid);
+    if(num_errors>0)
+        Log::error("ItemGrid", "Different items hit in %d steps.",
+                   num_errors);
+    else
+        Log::info("ItemGrid", "Identical items hit in all steps.");
+}   // benchmark
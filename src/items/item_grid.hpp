@@ -0,0 +1,69 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_ITEM_GRID_HPP
+#define HEADER_ITEM_GRID_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <vector>
+
+class Item;
+class Vec3;
+
+/**
+  * \brief A spatial index of items used for hit detection.
+  * The XZ plane is divided into square cells of CELL_SIZE. An item is
+  * added to each cell that its hit area (a circle with the item's hit
+  * distance around it) overlaps, so all items that can be hit by a kart
+  * are stored in the cell the kart is in. The cells are hashed into a fixed
+  * number of buckets, so no bounds of the track are needed, and items
+  * outside of the track are handled like any other item. A bucket can
+  * contain items of more than one cell, so the items returned still need
+  * to be tested with Item::hitKart. The items in each bucket are sorted by
+  * their item id, i.e. in the same order as in the list of all items of the
+  * ItemManager.
+  * \ingroup items
+  */
+class ItemGrid : public NoCopy
+{
+public:
+    /** Size of a cell in the XZ plane. */
+    static const float CELL_SIZE;
+
+    /** Number of buckets, must be a power of two. */
+    enum { NUM_BUCKETS = 4096 };
+
+private:
+    /** The items in each bucket, sorted by item id. */
+    std::vector< std::vector<Item*> > m_buckets;
+
+    static int  getCell(float f);
+    static unsigned int getBucket(int x, int z);
+    void        getBucketsOfItem(const Item *item,
+                                 std::vector<unsigned int> *buckets) const;
+
+public:
+                ItemGrid();
+    void        add(Item *item);
+    void        remove(Item *item);
+    const std::vector<Item*> &getItemsAt(const Vec3 &xyz) const;
+    static void benchmark();
+};   // ItemGrid
+
+#endif
@@ -218,6 +218,7 @@ void ItemManager::insertItem(Item *item)
     else
         m_all_items.push_back(item);
     item->setItemId(index);
+    m_item_grid.add(item);
 
     // Now insert into the appropriate quad list, if there is a quad list
     // (i.e. race mode has a quad graph).
@@ -304,22 +305,20 @@ void ItemManager::collectedItem(Item *item, AbstractKart *kart, int add_info)
  */
 void  ItemManager::checkItemHit(AbstractKart* kart)
 {
-    // We could use m_items_in_quads to to check for item hits: take the quad
-    // of the graph node of the kart, and only check items in that quad. But
-    // then we also need to check for any adjacent quads (since an item just
-    // on the order of one quad might get hit from an adjacent quad). Then
-    // it is possible that a quad is that short that we need to test adjacent
-    // of adjacent quads. And check for items outside of the track.
-    // Since at this stace item detection is by far not a bottle neck,
-    // the original, simple and stable algorithm is left in place.
-
-    for(AllItemTypes::iterator i =m_all_items.begin();
-        i!=m_all_items.end();  i++)
+    // Only the items stored in the grid cell of the kart can be hit. They
+    // are sorted by item id, so they are collected in the same order as
+    // when testing all items in m_all_items. Collecting an item can run a
+    // trigger script which adds items to this cell, so a copy is tested.
+    const Vec3 &xyz = kart->getXYZ();
+    const AllItemTypes &items = m_item_grid.getItemsAt(xyz);
+    m_items_to_check.assign(items.begin(), items.end());
+    for(AllItemTypes::const_iterator i =m_items_to_check.begin();
+        i!=m_items_to_check.end();  i++)
     {
-        if((!*i) || (*i)->wasCollected()) continue;
+        if((*i)->wasCollected()) continue;
         // To allow inlining and avoid including kart.hpp in item.hpp,
         // we pass the kart and the position separately.
-        if((*i)->hitKart(kart->getXYZ(), kart))
+        if((*i)->hitKart(xyz, kart))
         {
             // if we're not playing online, pick the item.
             if (!RaceEventManager::getInstance()->isRunning())
@@ -333,7 +332,7 @@ void  ItemManager::checkItemHit(AbstractKart* kart)
                 RaceEventManager::getInstance()->collectedItem(*i, kart);
             }
         }   // if hit
-    }   // for m_all_items
+    }   // for items
 }   // checkItemHit
 
 //-----------------------------------------------------------------------------
@@ -437,6 +436,7 @@ void ItemManager::deleteItem(Item *item)
         items.erase(it);
     }   // if m_items_in_quads
 
+    m_item_grid.remove(item);
     int index = item->getItemId();
     m_all_items[index] = NULL;
     delete item;
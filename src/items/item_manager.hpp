@@ -22,6 +22,7 @@
 #include "LinearMath/btTransform.h"
 
 #include "items/item.hpp"
+#include "items/item_grid.hpp"
 #include "utils/aligned_array.hpp"
 #include "utils/no_copy.hpp"
 
@@ -85,6 +86,14 @@ private:
      *  field is undefined if no QuadGraph exist, e.g. in battle mode. */
     std::vector< AllItemTypes > *m_items_in_quads;
 
+    /** Spatial index of all items, used for the hit detection. */
+    ItemGrid m_item_grid;
+
+    /** Copy of the grid cell tested in checkItemHit. Collecting an item can
+     *  add new items to the same cell, so the cell itself is not iterated.
+     *  This is a member so that its memory is reused. */
+    AllItemTypes m_items_to_check;
+
     /** What item this item is switched to. */
     std::vector<Item::ItemType> m_switch_to;
 
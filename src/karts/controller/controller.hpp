@@ -59,6 +59,11 @@ public:
     virtual      ~Controller         () {};
     virtual void  reset              () = 0;
     virtual void  update             (float dt) = 0;
+    /** Computes the decisions of this controller for the following call to
+     *  update(). This is called for all karts before any kart is updated,
+     *  and can be called for several karts in parallel. So it must only
+     *  read the state of the world and only modify this controller. */
+    virtual void  computeDecisions   (float dt) {};
     virtual void  handleZipper       (bool play_sound) = 0;
     virtual void  collectedItem      (const Item &item, int add_info=-1,
                                       float previous_energy=0) = 0;
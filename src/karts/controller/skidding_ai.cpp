@@ -176,6 +176,7 @@ void SkiddingAI::reset()
     m_avoid_item_close           = false;
     m_skid_probability_state     = SKID_PROBAB_NOT_YET;
     m_last_item_random           = NULL;
+    m_decisions_computed         = false;
 
     AIBaseLapController::reset();
     m_track_node               = QuadGraph::UNKNOWN_SECTOR;
@@ -305,15 +306,20 @@ void SkiddingAI::update(float dt)
         return;
     }
 
-    // Get information that is needed by more than 1 of the handling funcs
-    computeNearestKarts();
+    // Get information that is needed by more than 1 of the handling funcs,
+    // unless it was already computed in computeDecisions.
+    if(!m_decisions_computed)
+    {
+        computeNearestKarts();
+        //Detect if we are going to crash with the track and/or kart
+        checkCrashes(m_kart->getXYZ());
+        determineTrackDirection();
+    }
+    m_decisions_computed = false;
 
     m_kart->setSlowdown(MaxSpeed::MS_DECREASE_AI,
                         m_ai_properties->getSpeedCap(m_distance_to_player),
                         /*fade_in_time*/0.0f);
-    //Detect if we are going to crash with the track and/or kart
-    checkCrashes(m_kart->getXYZ());
-    determineTrackDirection();
 
     // Special behaviour if we have a bomb attach: try to hit the kart ahead
     // of us.
@@ -380,6 +386,27 @@ void SkiddingAI::update(float dt)
     AIBaseLapController::update(dt);
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Computes the information about the world that is used by several of the
+ *  handling functions in update: the nearest karts, expected crashes and the
+ *  direction of the track. These are the most expensive parts of the AI,
+ *  and they only read the world state, so this function is called for all
+ *  AI karts (potentially in parallel) before any kart is updated.
+ *  \param dt Time step size.
+ */
+void SkiddingAI::computeDecisions(float dt)
+{
+    m_decisions_computed = false;
+    // Nothing to do if update() will return early
+    if(m_kart->getKartAnimation() || m_world->isStartPhase())
+        return;
+
+    computeNearestKarts();
+    checkCrashes(m_kart->getXYZ());
+    determineTrackDirection();
+    m_decisions_computed = true;
+}   // computeDecisions
+
 //-----------------------------------------------------------------------------
 /** This function decides if the AI should brake.
  *  The decision can be based on race mode (e.g. in follow the leader the AI
@@ -173,6 +173,10 @@ private:
     /** If set an item that the AI should aim for. */
     const Item *m_item_to_collect;
 
+    /** True if computeDecisions() was called before update, i.e. the
+     *  nearest karts, crashes and track direction are already computed. */
+    bool m_decisions_computed;
+
     /** True if items to avoid are close by. Used to avoid using zippers
      *  (which would make it more difficult to avoid items). */
     bool m_avoid_item_close;
@@ -281,6 +285,7 @@ public:
                  SkiddingAI(AbstractKart *kart);
                 ~SkiddingAI();
     virtual void update      (float delta) ;
+    virtual void computeDecisions(float delta);
     virtual void reset       ();
     virtual const irr::core::stringw& getNamePostfix() const;
 };
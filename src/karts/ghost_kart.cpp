@@ -22,6 +22,7 @@
 #include "karts/kart_model.hpp"
 #include "graphics/render_info.hpp"
 #include "modes/world.hpp"
+#include "utils/transform_buffer.hpp"
 
 #include "LinearMath/btQuaternion.h"
 
@@ -101,12 +102,11 @@ void GhostKart::update(float dt)
     const float rd         = gc->getReplayDelta();
     assert(idx < m_all_transform.size());
 
-    setXYZ((1- rd)*m_all_transform[idx    ].getOrigin()
-           +  rd  *m_all_transform[idx + 1].getOrigin() );
-
-    const btQuaternion q = m_all_transform[idx].getRotation()
-        .slerp(m_all_transform[idx + 1].getRotation(), rd);
-    setRotation(q);
+    const btTransform t =
+        TransformBuffer::interpolate(m_all_transform[idx],
+                                     m_all_transform[idx + 1], rd);
+    setXYZ(t.getOrigin());
+    setRotation(t.getRotation());
 
     Vec3 center_shift(0, 0, 0);
     center_shift.setY(m_graphical_y_offset);
@@ -147,6 +147,9 @@ float GhostKart::getSpeed() const
     const GhostController* gc =
         dynamic_cast<const GhostController*>(getController());
 
+    // No events if the replay file could not be read
+    if (m_all_physic_info.empty())
+        return 0.0f;
     assert(gc->getCurrentReplayIndex() < m_all_physic_info.size());
     return m_all_physic_info[gc->getCurrentReplayIndex()].m_speed;
 }   // getSpeed
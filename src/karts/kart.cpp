@@ -45,6 +45,7 @@
 #include "karts/rescue_animation.hpp"
 #include "modes/overworld.hpp"
 #include "modes/soccer_world.hpp"
+#include "modes/profile_world.hpp"
 #include "modes/world.hpp"
 #include "io/file_manager.hpp"
 #include "items/attachment.hpp"
@@ -1200,7 +1201,11 @@ void Kart::update(float dt)
     Moveable::update(dt);
 
     if(!history->replayHistory())
+    {
+        double start = getTimeMilliseconds();
         m_controller->update(dt);
+        ProfileWorld::addSubsystemTime(ProfileWorld::PS_AI, start);
+    }
 
     // if its view is blocked by plunger, decrease remaining time
     if(m_view_blocked_by_plunger > 0) m_view_blocked_by_plunger -= dt;
@@ -1402,7 +1407,11 @@ void Kart::update(float dt)
     // (when network mode is on)
     if (!RaceEventManager::getInstance()->isRunning() ||
         NetworkConfig::get()->isServer())
+    {
+        double start = getTimeMilliseconds();
         ItemManager::get()->checkItemHit(this);
+        ProfileWorld::addSubsystemTime(ProfileWorld::PS_ITEMS, start);
+    }
 
     static video::SColor pink(255, 255, 133, 253);
     static video::SColor green(255, 61, 87, 23);
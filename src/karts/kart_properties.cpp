@@ -166,7 +166,11 @@ void KartProperties::load(const std::string &filename, const std::string &node)
     // Get the default values from STKConfig. This will also allocate any
     // pointers used in KartProperties
 
-    const XMLNode* root = new XMLNode(filename);
+    const XMLNode* root = file_manager->createXMLTree(filename,
+                                                      /*use_cache*/true);
+    if (!root)
+        throw std::runtime_error("Couldn't read kart properties '" +
+                                 filename + "'.");
     std::string kart_type;
 
     if (root->get("type", &kart_type))
@@ -148,6 +148,7 @@ void KartPropertiesManager::removeKart(const std::string &ident)
 void KartPropertiesManager::loadAllKarts(bool loading_icon)
 {
     m_all_kart_dirs.clear();
+    preloadAllKarts();
     std::vector<std::string>::const_iterator dir;
     for(dir = m_kart_search_path.begin(); dir!=m_kart_search_path.end(); dir++)
     {
@@ -173,8 +174,58 @@ void KartPropertiesManager::loadAllKarts(bool loading_icon)
             }
         }   // for all files in the currently handled directory
     }   // for i
+    // Free the trees of karts that were not loaded
+    file_manager->clearPreloadedXMLTrees();
 }   // loadAllKarts
 
+//-----------------------------------------------------------------------------
+/** Parses the kart.xml files of all karts and decodes their icons on
+ *  several threads, so that loadKart (which has to run on the main thread
+ *  since it creates materials and textures) finds the data already in
+ *  memory. It uses the same search order as loadAllKarts.
+ */
+void KartPropertiesManager::preloadAllKarts()
+{
+    std::vector<std::string> kart_files;
+    std::vector<std::string>::const_iterator dir;
+    for(dir = m_kart_search_path.begin(); dir!=m_kart_search_path.end(); dir++)
+    {
+        if(file_manager->fileExists(*dir + "/kart.xml"))
+        {
+            kart_files.push_back(*dir + "/kart.xml");
+            continue;
+        }
+        std::set<std::string> result;
+        file_manager->listFiles(result, *dir);
+        for(std::set<std::string>::const_iterator subdir=result.begin();
+            subdir!=result.end(); subdir++)
+        {
+            const std::string filename = *dir + *subdir + "/kart.xml";
+            if(file_manager->fileExists(filename))
+                kart_files.push_back(filename);
+        }
+    }   // for dir
+
+    file_manager->preloadXMLTrees(kart_files);
+
+    std::vector<std::string> textures;
+    for(unsigned int i=0; i<kart_files.size(); i++)
+    {
+        const XMLNode *root = file_manager->getPreloadedXMLTree(kart_files[i]);
+        if(!root) continue;
+        // Same path as used in KartProperties::load
+        const std::string kart_root = StringUtils::getPath(kart_files[i])+"/";
+        std::string icon;
+        if(root->get("icon-file", &icon))
+            textures.push_back(kart_root + icon);
+        std::string minimap_icon;
+        if(root->get("minimap-icon-file", &minimap_icon) &&
+            minimap_icon!="")
+            textures.push_back(kart_root + minimap_icon);
+    }
+    irr_driver->preloadTextures(textures);
+}   // preloadAllKarts
+
 //-----------------------------------------------------------------------------
 /** Loads the characteristics from the characteristics config file.
  *  \param root The xml node where the characteristics are stored.
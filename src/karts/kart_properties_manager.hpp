@@ -66,6 +66,8 @@ private:
     std::map<std::string, std::unique_ptr<AbstractCharacteristic> > m_kart_type_characteristics;
     std::map<std::string, std::unique_ptr<AbstractCharacteristic> > m_player_characteristics;
 
+    void preloadAllKarts();
+
 protected:
 
     typedef PtrVector<KartProperties> KartPropertiesVector;
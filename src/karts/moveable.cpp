@@ -125,14 +125,24 @@ void Moveable::stopFlying()
  *  \param float dt Time step size.
  */
 void Moveable::update(float dt)
+{
+    updateFromPhysics();
+
+    updateGraphics(dt, Vec3(0,0,0), btQuaternion(0, 0, 0, 1));
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Copies the transform and velocity from the physics body. This is called
+ *  from update(), and by the world for all karts before the AI decisions are
+ *  computed, so that the AI sees the positions after the last physics step.
+ */
+void Moveable::updateFromPhysics()
 {
     if(m_body->getInvMass()!=0)
         m_motion_state->getWorldTransform(m_transform);
     m_velocityLC = getVelocity()*m_transform.getBasis();
     updatePosition();
-
-    updateGraphics(dt, Vec3(0,0,0), btQuaternion(0, 0, 0, 1));
-}   // update
+}   // updateFromPhysics
 
 //-----------------------------------------------------------------------------
 /** Updates the current position and rotation. This function is also called
@@ -111,6 +111,7 @@ public:
                  &getTrans() const {return m_transform;}
     void          setTrans(const btTransform& t);
     void          updatePosition();
+    void          updateFromPhysics();
 }
 ;   // class Moveable
 
@@ -127,8 +127,12 @@
 #    include <direct.h>
 #  endif
 #else
+#  include <signal.h>
 #  include <unistd.h>
 #endif
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
 #include <stdexcept>
 #include <cstdio>
 #include <string>
@@ -142,6 +146,7 @@
 #include "achievements/achievements_manager.hpp"
 #include "addons/addons_manager.hpp"
 #include "addons/news_manager.hpp"
+#include "addons/zip_package.hpp"
 #include "audio/music_manager.hpp"
 #include "audio/sfx_manager.hpp"
 #include "challenges/unlock_manager.hpp"
@@ -168,6 +173,7 @@
 #include "input/wiimote_manager.hpp"
 #include "io/file_manager.hpp"
 #include "items/attachment_manager.hpp"
+#include "items/item_grid.hpp"
 #include "items/item_manager.hpp"
 #include "items/projectile_manager.hpp"
 #include "karts/combined_characteristic.hpp"
@@ -178,6 +184,7 @@
 #include "modes/demo_world.hpp"
 #include "modes/profile_world.hpp"
 #include "network/network_config.hpp"
+#include "network/kart_snapshot.hpp"
 #include "network/network_string.hpp"
 #include "network/servers_manager.hpp"
 #include "network/stk_host.hpp"
@@ -195,6 +202,8 @@
 #include "states_screens/user_screen.hpp"
 #include "states_screens/dialogs/message_dialog.hpp"
 #include "tracks/battle_graph.hpp"
+#include "tracks/check_manager.hpp"
+#include "tracks/quad_graph.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/command_line.hpp"
@@ -202,6 +211,7 @@
 #include "utils/crash_reporting.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/log.hpp"
+#include "utils/startup_profile.hpp"
 #include "utils/translation.hpp"
 
 static void cleanSuperTuxKart();
@@ -526,6 +536,15 @@ void cmdLineHelp()
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
+    "       --profile-tracks=t1,t2 Profile each of the listed tracks.\n"
+    "       --profile-karts=n1,n2 Profile each track with n1, n2, ... karts.\n"
+    "       --profile-difficulties=d1,d2 Profile each track with the listed\n"
+    "                          difficulties (0 novice ... 3 supertux).\n"
+    "       --profile-report=file Write the results of all profiled races to\n"
+    "                          file (JSON if it ends in .json, CSV otherwise).\n"
+    "       --profile-check-determinism Run each profiled race twice, with\n"
+    "                          and without parallel AI, and compare results.\n"
+    "       --no-parallel-ai   Compute the AI decisions in one thread only.\n"
     "       --no-graphics      Do not display the actual race.\n"
     "       --demo-mode=t      Enables demo mode after t seconds idle time in "
                                "main menu.\n"
@@ -533,6 +552,19 @@ void cmdLineHelp()
     "                          spaces are allowed in the track names.\n"
     "       --demo-laps=n      Number of laps in a demo.\n"
     "       --demo-karts=n     Number of karts to use in a demo.\n"
+    "       --replay-benchmark=file Compare size and load time of the\n"
+    "                          replay file formats using the given replay.\n"
+    "       --material-benchmark Measure material lookup time for all tracks.\n"
+    "       --translation-benchmark Measure the lookup time of translated\n"
+    "                          strings with and without cache.\n"
+    "       --item-benchmark   Compare item hit detection with and without\n"
+    "                          the item grid.\n"
+    "       --xml-benchmark    Compare the load time of the XML files of all\n"
+    "                          tracks with and without binary cache.\n"
+    "       --zip-benchmark=file Compare the time to extract and mount the\n"
+    "                          given addon zip file.\n"
+    "       --startup-profile  Print the time needed for each phase of\n"
+    "                          loading STK.\n"
     // "       --history          Replay history file 'history.dat'.\n"
     // "       --history=n        Replay history file 'history.dat' using:\n"
     // "                            n=1: recorded positions\n"
@@ -542,11 +574,20 @@ void cmdLineHelp()
     // "
     "       --server=name      Start a server (not a playing client).\n"
     "       --lan-server=name  Start a LAN server (not a playing client).\n"
+    "       --dedicated-server Run the server without graphics and GUI, and\n"
+    "                          update the world with a fixed tick rate.\n"
+    "       --server-tick-rate=n Number of world updates per second of a\n"
+    "                          dedicated server.\n"
+    "       --lobbies=n        Run n lobbies of a dedicated (WAN) server on\n"
+    "                          consecutive ports, sharing all loaded data.\n"
     "       --server-password= Sets a password for a server (both client&server).\n"
     "       --login=s          Automatically log in (set the login).\n"
     "       --password=s       Automatically log in (set the password).\n"
     "       --port=n           Port number to use.\n"
     "       --max-players=n    Maximum number of clients (server only).\n"
+    "       --network-stats=file Append network traffic and latency statistics\n"
+    "                          to a CSV file once per second. With --lobbies\n"
+    "                          the port is added to the file name.\n"
     "       --no-console       Does not write messages in the console but to\n"
     "                          stdout.log.\n"
     "       --console          Write messages in the console and files\n"
@@ -688,6 +729,15 @@ int handleCmdLinePreliminary()
         UserConfigParams::m_log_errors_to_console=true;
     }
 
+    // A dedicated server must not create a render device, so this must
+    // be handled before the IrrDriver is created.
+    if(CommandLine::has("--dedicated-server"))
+    {
+        ProfileWorld::disableGraphics();
+        NetworkConfig::get()->setIsDedicatedServer(true);
+        UserConfigParams::m_log_errors_to_console=true;
+    }
+
     if(CommandLine::has("--screensize", &s) || CommandLine::has("-s", &s))
     {
         //Check if fullscreen and new res is blacklisted
@@ -821,6 +871,8 @@ int handleCmdLinePreliminary()
     }
 
     int n;
+    if(CommandLine::has("--server-tick-rate", &n))
+        UserConfigParams::m_server_tick_rate = n;
     if(CommandLine::has("--xmas", &n))
         UserConfigParams::m_xmas_mode = n;
     if (CommandLine::has("--easter", &n))
@@ -839,6 +891,98 @@ int handleCmdLinePreliminary()
     return 0;
 }   // handleCmdLinePreliminary
 
+// ============================================================================
+/** Called on a dedicated server once all karts, tracks and materials are
+ *  loaded, before the server host is created. With --lobbies=n the process
+ *  forks into n processes, each running one lobby on its own port (the
+ *  server port plus the lobby index). All loaded data is shared copy-on-write
+ *  between the lobbies, so an additional lobby only needs memory for the data
+ *  it modifies. Since fork does not copy threads, the threads of the request
+ *  manager, the news manager and the sfx manager are only started here.
+ */
+void startDedicatedServer()
+{
+    int lobby = 0;
+    int num_lobbies = 1;
+    if (CommandLine::has("--lobbies", &num_lobbies) && num_lobbies > 1)
+    {
+        // A LAN server needs the fixed discovery port, which can only be
+        // used by one process.
+        if (!NetworkConfig::get()->isServer() || NetworkConfig::get()->isLAN())
+        {
+            Log::warn("main", "Multiple lobbies need a WAN server.");
+            num_lobbies = 1;
+        }
+#ifdef WIN32
+        Log::warn("main", "Multiple lobbies are not supported on Windows.");
+        num_lobbies = 1;
+#else
+        // The lobbies are not waited for, avoid zombie processes.
+        if (num_lobbies > 1)
+            signal(SIGCHLD, SIG_IGN);
+        // The thread writing asynchronous log messages is not copied by
+        // fork either, so log synchronously while forking, and restart it
+        // in every lobby afterwards.
+        Log::stopAsync();
+        for (int i = 1; i < num_lobbies; i++)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                lobby = i;
+                // The lobby might start its own child processes.
+                signal(SIGCHLD, SIG_DFL);
+#ifdef _OPENMP
+                // The OpenMP thread pool of the parent (which was used
+                // while loading) is not copied by fork, and libgomp would
+                // wait for it forever in the next parallel region. With
+                // only one thread the pool is not used.
+                omp_set_num_threads(1);
+#endif
+                break;
+            }
+            if (pid < 0)
+            {
+                Log::error("main", "Could not start lobby %d.", i + 1);
+                break;
+            }
+        }   // for i < num_lobbies
+        if (UserConfigParams::m_log_async)
+            Log::startAsync();
+#endif
+    }
+
+    if (num_lobbies > 1)
+    {
+        NetworkConfig *config = NetworkConfig::get();
+        config->setServerPort(config->getServerPort() + lobby);
+        if (lobby > 0)
+        {
+            config->setServerName(config->getServerName() + L" " +
+                                  StringUtils::toWString(lobby + 1));
+        }
+        Log::info("main", "Lobby %d uses port %d.", lobby + 1,
+                  config->getServerPort());
+
+        // Each lobby writes its own network statistics: add the port to
+        // the file name (before the extension, if there is one).
+        std::string &stats_file = STKHost::m_network_stats_file;
+        if (!stats_file.empty())
+        {
+            size_t dot = stats_file.find_last_of('.');
+            if (dot == std::string::npos ||
+                stats_file.find_first_of("/\\", dot) != std::string::npos)
+                dot = stats_file.size();
+            stats_file.insert(dot, "-" + StringUtils::toString(
+                                             config->getServerPort()));
+        }
+    }
+
+    SFXManager::get()->startThread();
+    Online::RequestManager::get()->startNetworkThread();
+    NewsManager::get();   // this will create the news manager
+}   // startDedicatedServer
+
 // ============================================================================
 /** Handles command line options.
  *  \param argc Number of command line options
@@ -940,21 +1084,41 @@ int handleCmdLine()
     // Networking command lines
     NetworkConfig::get()->
         setMaxPlayers(UserConfigParams::m_server_max_players);
+    // Must be set before the host is created
+    if(CommandLine::has("--network-stats", &s))
+        STKHost::m_network_stats_file = s;
+    if(CommandLine::has("--port", &n))
+        NetworkConfig::get()->setServerPort(n);
+
     if(CommandLine::has("--server", &s))
     {
         NetworkConfig::get()->setServerName(core::stringw(s.c_str()));
         NetworkConfig::get()->setIsServer(true);
         NetworkConfig::get()->setIsWAN();
-        STKHost::create();
-        Log::info("main", "Creating a WAN server '%s'.", s.c_str());
     }
     if (CommandLine::has("--lan-server", &s))
     {
         NetworkConfig::get()->setServerName(core::stringw(s.c_str()));
         NetworkConfig::get()->setIsServer(true);
         NetworkConfig::get()->setIsLAN();
+    }
+    if (NetworkConfig::get()->isDedicatedServer())
+    {
+        startDedicatedServer();
+        if (!NetworkConfig::get()->isServer())
+        {
+            Log::error("main", "--dedicated-server needs --server or "
+                               "--lan-server.");
+            return false;
+        }
+    }
+    if (NetworkConfig::get()->isServer())
+    {
         STKHost::create();
-        Log::info("main", "Creating a LAN server '%s'.", s.c_str());
+        Log::info("main", "Creating a %s server '%s'.",
+                  NetworkConfig::get()->isLAN() ? "LAN" : "WAN",
+                  StringUtils::wideToUtf8(
+                      NetworkConfig::get()->getServerName()).c_str());
     }
     if (CommandLine::has("--server-password", &s))
     {
@@ -1170,6 +1334,86 @@ int handleCmdLine()
         race_manager->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
+    if(CommandLine::has("--profile-tracks", &s))
+        ProfileWorld::setBatchTracks(StringUtils::split(s, ','));
+
+    if(CommandLine::has("--profile-karts", &s))
+    {
+        std::vector<std::string> l = StringUtils::split(s, ',');
+        std::vector<int> num_karts;
+        for(unsigned int i=0; i<l.size(); i++)
+        {
+            int k = atoi(l[i].c_str());
+            if(k<1 || k>(int)stk_config->m_max_karts)
+                Log::warn("main", "Invalid number of karts '%s' - ignored.",
+                          l[i].c_str());
+            else
+                num_karts.push_back(k);
+        }
+        ProfileWorld::setBatchNumKarts(num_karts);
+    }   // --profile-karts
+
+    if(CommandLine::has("--profile-difficulties", &s))
+    {
+        std::vector<std::string> l = StringUtils::split(s, ',');
+        std::vector<int> difficulties;
+        for(unsigned int i=0; i<l.size(); i++)
+        {
+            int d = atoi(l[i].c_str());
+            if(d<0 || d>RaceManager::DIFFICULTY_LAST)
+                Log::warn("main", "Invalid difficulty '%s' - ignored.",
+                          l[i].c_str());
+            else
+                difficulties.push_back(d);
+        }
+        ProfileWorld::setBatchDifficulties(difficulties);
+    }   // --profile-difficulties
+
+    if(CommandLine::has("--profile-report", &s))
+        ProfileWorld::setReportFile(s);
+
+    if(CommandLine::has("--profile-check-determinism"))
+        ProfileWorld::enableDeterminismCheck();
+
+    if(CommandLine::has("--no-parallel-ai"))
+        UserConfigParams::m_parallel_ai = false;
+
+    if(CommandLine::has("--replay-benchmark", &s))
+    {
+        ReplayPlay::benchmark(s);
+        return 0;
+    }
+
+    if(CommandLine::has("--material-benchmark"))
+    {
+        material_manager->benchmark();
+        return 0;
+    }
+
+    if(CommandLine::has("--translation-benchmark"))
+    {
+        translations->benchmark();
+        return 0;
+    }
+
+    if(CommandLine::has("--item-benchmark"))
+    {
+        ItemGrid::benchmark();
+        return 0;
+    }
+
+    if(CommandLine::has("--xml-benchmark"))
+    {
+        file_manager->benchmarkXMLCache();
+        return 0;
+    }
+
+    if(CommandLine::has("--zip-benchmark", &s))
+    {
+        ZipPackage::benchmark(s);
+        return 0;
+    }
+
     if(CommandLine::has("--history",  &n))
     {
         history->doReplayHistory( (History::HistoryReplayMode)n);
@@ -1258,6 +1502,8 @@ void initUserConfig()
     file_manager = new FileManager();
     user_config  = new UserConfig();     // needs file_manager
     user_config->loadConfig();
+    if (UserConfigParams::m_log_async)
+        Log::startAsync();
     // Some parts of the file manager needs user config (paths for models
     // depend on artist debug flag). So init the rest of the file manager
     // after reading the user config file.
@@ -1281,8 +1527,10 @@ void initUserConfig()
 //=============================================================================
 void initRest()
 {
+    StartupProfile::startPhase("stk config");
     stk_config->load(file_manager->getAsset("stk_config.xml"));
 
+    StartupProfile::startPhase("device");
     irr_driver = new IrrDriver();
     StkTime::init();   // grabs the timer object from the irrlicht device
 
@@ -1299,6 +1547,7 @@ void initRest()
         exit(0);
     }
 
+    StartupProfile::startPhase("fonts and gui");
     font_manager = new FontManager();
     font_manager->loadFonts();
     GUIEngine::init(device, driver, StateManager::get());
@@ -1306,6 +1555,7 @@ void initRest()
     // This only initialises the non-network part of the addons manager. The
     // online section of the addons manager will be initialised from a
     // separate thread running in network http.
+    StartupProfile::startPhase("managers");
     addons_manager          = new AddonsManager();
     Online::ProfileManager::create();
 
@@ -1314,11 +1564,19 @@ void initRest()
     // The rest will be read later (since the rest needs the unlock- and
     // achievement managers to be created, which can only be created later).
     PlayerManager::create();
-    Online::RequestManager::get()->startNetworkThread();
-    NewsManager::get();   // this will create the news manager
+    // A dedicated server starts these threads only after all data is
+    // loaded, see startDedicatedServer().
+    if (!NetworkConfig::get()->isDedicatedServer())
+    {
+        Online::RequestManager::get()->startNetworkThread();
+        NewsManager::get();   // this will create the news manager
+    }
 
-    music_manager = new MusicManager();
-    SFXManager::create();
+    // A dedicated server does not need a sound device. This also avoids
+    // sharing one OpenAL context between all forked lobbies.
+    const bool dedicated = NetworkConfig::get()->isDedicatedServer();
+    music_manager = new MusicManager(/*init_openal*/!dedicated);
+    SFXManager::create(/*start_thread*/!dedicated);
     // The order here can be important, e.g. KartPropertiesManager needs
     // defaultKartProperties, which are defined in stk_config.
     history                 = new History              ();
@@ -1339,18 +1597,21 @@ void initRest()
                  file_manager->getAddonsFile("karts/"));
     track_manager->addTrackSearchDir(
                  file_manager->getAddonsFile("tracks/"));
+    file_manager->mountAddonPackages();
 
     {
         XMLNode characteristicsNode(file_manager->getAsset("kart_characteristics.xml"));
         kart_properties_manager->loadCharacteristics(&characteristicsNode);
     }
 
+    StartupProfile::startPhase("tracks");
     track_manager->loadTrackList();
     music_manager->addMusicToTracks();
 
     GUIEngine::addLoadingIcon(irr_driver->getTexture(FileManager::GUI,
                                                      "notes.png"      ) );
 
+    StartupProfile::startPhase("grand prix");
     grand_prix_manager      = new GrandPrixManager     ();
     // Consistency check for challenges, and enable all challenges
     // that have all prerequisites fulfilled
@@ -1437,6 +1698,8 @@ void askForInternetPermission()
 int main(int argc, char *argv[] )
 {
     CommandLine::init(argc, argv);
+    if(CommandLine::has("--startup-profile"))
+        StartupProfile::enable();
 
     CrashReporting::installHandlers();
 
@@ -1456,6 +1719,7 @@ int main(int argc, char *argv[] )
         // Init the minimum managers so that user config exists, then
         // handle all command line options that do not need (or must
         // not have) other managers initialised:
+        StartupProfile::startPhase("user config");
         initUserConfig();
 
         handleCmdLinePreliminary();
@@ -1471,10 +1735,12 @@ int main(int argc, char *argv[] )
         // Get into menu mode initially.
         input_manager->setMode(InputManager::MENU);
         main_loop = new MainLoop();
+        StartupProfile::startPhase("materials");
         material_manager->loadMaterial();
 
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI,
                                                           "options_video.png"));
+        StartupProfile::startPhase("karts");
         kart_properties_manager -> loadAllKarts    ();
         handleXmasMode();
         handleEasterEarMode();
@@ -1482,6 +1748,7 @@ int main(int argc, char *argv[] )
         // Needs the kart and track directories to load potential challenges
         // in those dirs, so it can only be created after reading tracks
         // and karts.
+        StartupProfile::startPhase("challenges and players");
         unlock_manager = new UnlockManager();
         AchievementsManager::create();
 
@@ -1492,11 +1759,13 @@ int main(int argc, char *argv[] )
 
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI,
                                                           "gui_lock.png"  ) );
+        StartupProfile::startPhase("projectiles");
         projectile_manager->loadData();
 
         // Both item_manager and powerup_manager load models and therefore
         // textures from the model directory. To avoid reading the
         // materials.xml twice, we do this here once for both:
+        StartupProfile::startPhase("powerups and items");
         file_manager->pushTextureSearchPath(file_manager->getAsset(FileManager::MODEL,""));
         const std::string materials_file =
             file_manager->getAsset(FileManager::MODEL,"materials.xml");
@@ -1518,14 +1787,17 @@ int main(int argc, char *argv[] )
 
         file_manager->popTextureSearchPath();
 
+        StartupProfile::startPhase("attachments");
         attachment_manager->loadModels();
 
         GUIEngine::addLoadingIcon( irr_driver->getTexture(FileManager::GUI,
                                                           "banana.png")    );
 
         //handleCmdLine() needs InitTuxkart() so it can't be called first
+        StartupProfile::startPhase("command line");
         if(!handleCmdLine()) exit(0);
 
+        StartupProfile::startPhase("addons");
         addons_manager->checkInstalledAddons();
 
         // Load addons.xml to get info about addons even when not
@@ -1593,7 +1865,15 @@ int main(int argc, char *argv[] )
             HardwareStats::reportHardwareStats();
         }
 
-        if(!UserConfigParams::m_no_start_screen)
+        StartupProfile::startPhase("first screen");
+        if(NetworkConfig::get()->isDedicatedServer())
+        {
+            // No GUI at all, the server is controlled by the server lobby
+            // protocol and the network console.
+            Log::info("main", "Running as dedicated server with %d ticks "
+                      "per second.", (int)UserConfigParams::m_server_tick_rate);
+        }
+        else if(!UserConfigParams::m_no_start_screen)
         {
             // If there is a current player, it was saved in the config file,
             // so we immediately start the main menu (unless it was requested
@@ -1642,6 +1922,8 @@ int main(int argc, char *argv[] )
                               NULL, true);
         }   // if important_message
 
+        StartupProfile::finish();
+
 
         // Replay a race
         // =============
@@ -1670,16 +1952,27 @@ int main(int argc, char *argv[] )
                 race_manager->setupPlayerKartInfo();
                 race_manager->startNew(false);
             }
+            main_loop->run();
         }
         else  // profile
         {
             // Profiling
             // =========
-            race_manager->setMajorMode (RaceManager::MAJOR_MODE_SINGLE);
-            race_manager->setupPlayerKartInfo();
-            race_manager->startNew(false);
+            // Each combination of track, number of karts and difficulty
+            // is one race. The main loop is aborted at the end of each race.
+            while(ProfileWorld::startNextRun())
+            {
+                race_manager->setMajorMode (RaceManager::MAJOR_MODE_SINGLE);
+                race_manager->setupPlayerKartInfo();
+                race_manager->startNew(false);
+                main_loop->run();
+                // If the world still exists, STK was closed during a race
+                if(World::getWorld())
+                    break;
+                main_loop->resetAbort();
+            }
+            ProfileWorld::writeReport();
         }
-        main_loop->run();
 
     }  // try
     catch (std::exception &e)
@@ -1705,6 +1998,9 @@ int main(int argc, char *argv[] )
 
     cleanSuperTuxKart();
 
+    // Write all buffered log messages before exiting
+    Log::stopAsync();
+
 #ifdef DEBUG
     MemoryLeaks::checkForLeaks();
 #endif
@@ -1848,6 +2144,8 @@ void runUnitTests()
     GraphicsRestrictions::unitTesting();
     Log::info("UnitTest", "NetworkString");
     NetworkString::unitTesting();
+    Log::info("UnitTest", "KartSnapshot");
+    KartSnapshot::unitTesting();
 
     Log::info("UnitTest", "Easter detection");
     // Test easter mode: in 2015 Easter is 5th of April - check with 0 days
@@ -1887,6 +2185,12 @@ void runUnitTests()
     Log::info("UnitTest", "Battle Graph");
     BattleGraph::unitTesting();
 
+    Log::info("UnitTest", "Quad Graph");
+    QuadGraph::unitTesting();
+
+    Log::info("UnitTest", "Check lines");
+    CheckManager::unitTesting();
+
     Log::info("UnitTest", "Fonts for translation");
     font_manager->unitTesting();
 
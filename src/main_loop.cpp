@@ -38,6 +38,9 @@
 #include "race/race_manager.hpp"
 #include "states_screens/state_manager.hpp"
 #include "utils/profiler.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
 
 MainLoop* main_loop = 0;
 
@@ -47,6 +50,14 @@ m_abort(false)
     m_curr_time = 0;
     m_prev_time = 0;
     m_throttle_fps = true;
+    m_tick_start   = 0;
+    m_next_tick    = 0;
+    m_num_ticks    = 0;
+    m_num_overruns = 0;
+    m_num_skipped_ticks = 0;
+    m_total_tick_time   = 0;
+    m_max_tick_time     = 0;
+    m_last_report_time  = 0;
 }  // MainLoop
 
 //-----------------------------------------------------------------------------
@@ -120,6 +131,94 @@ float MainLoop::getLimitedDt()
     return dt;
 }   // getLimitedDt
 
+//-----------------------------------------------------------------------------
+/** Used instead of getLimitedDt() on a dedicated server: the world is
+ *  updated with a fixed time step (server_tick_rate updates per second),
+ *  independent of any frame rate. This function records how long the
+ *  previous tick took, and then sleeps until the next tick is due. If a
+ *  tick takes longer than the time step (an overrun), the following ticks
+ *  are started immediately to catch up; if the server falls behind by more
+ *  than MAX_TICKS_BEHIND ticks, those ticks are skipped.
+ *  \return The fixed time step size.
+ */
+float MainLoop::waitForNextTick()
+{
+    const int MAX_TICKS_BEHIND = 5;
+    const double tick = 1.0/std::max(1, (int)UserConfigParams::m_server_tick_rate);
+
+    double now = StkTime::getRealTime();
+    if (m_last_report_time == 0)
+    {
+        // First tick
+        m_last_report_time = now;
+        m_next_tick        = now;
+    }
+    else
+    {
+        double tick_time = now - m_tick_start;
+        m_num_ticks++;
+        m_total_tick_time += tick_time;
+        if (tick_time > m_max_tick_time)
+            m_max_tick_time = tick_time;
+        if (tick_time > tick)
+        {
+            m_num_overruns++;
+            Log::verbose("MainLoop", "Tick took %f ms, time step is %f ms.",
+                         tick_time*1000.0, tick*1000.0);
+        }
+        m_next_tick += tick;
+    }
+
+    if (now > m_next_tick + MAX_TICKS_BEHIND*tick)
+    {
+        m_num_skipped_ticks += (int)((now - m_next_tick)/tick);
+        m_next_tick = now;
+    }
+
+    while (now < m_next_tick)
+    {
+        StkTime::sleep(std::max(1, (int)((m_next_tick - now)*1000.0)));
+        now = StkTime::getRealTime();
+    }
+
+    if (now - m_last_report_time >= 60.0)
+        reportTickStatistics(now);
+
+    m_tick_start = now;
+    return (float)tick;
+}   // waitForNextTick
+
+//-----------------------------------------------------------------------------
+/** Prints the tick statistics of a dedicated server since the last report
+ *  and resets them. A warning is printed if ticks took longer than the
+ *  time step.
+ *  \param now The current real time.
+ */
+void MainLoop::reportTickStatistics(double now)
+{
+    float avg = m_num_ticks > 0 ? (float)(m_total_tick_time/m_num_ticks) : 0;
+    if (m_num_overruns > 0 || m_num_skipped_ticks > 0)
+    {
+        Log::warn("MainLoop", "%d ticks in %.0f s: %d overruns, %d skipped "
+                  "ticks, average tick time %.2f ms, maximum %.2f ms.",
+                  m_num_ticks, now - m_last_report_time, m_num_overruns,
+                  m_num_skipped_ticks, avg*1000.0f, m_max_tick_time*1000.0);
+    }
+    else
+    {
+        Log::info("MainLoop", "%d ticks in %.0f s, average tick time %.2f "
+                  "ms, maximum %.2f ms.", m_num_ticks,
+                  now - m_last_report_time, avg*1000.0f,
+                  m_max_tick_time*1000.0);
+    }
+    m_num_ticks         = 0;
+    m_num_overruns      = 0;
+    m_num_skipped_ticks = 0;
+    m_total_tick_time   = 0;
+    m_max_tick_time     = 0;
+    m_last_report_time  = now;
+}   // reportTickStatistics
+
 //-----------------------------------------------------------------------------
 /** Updates all race related objects.
  *  \param dt Time step size.
@@ -146,7 +245,9 @@ void MainLoop::run()
         PROFILER_PUSH_CPU_MARKER("Main loop", 0xFF, 0x00, 0xF7);
 
         m_prev_time = m_curr_time;
-        float dt   = getLimitedDt();
+        float dt   = NetworkConfig::get()->isDedicatedServer()
+                   ? waitForNextTick()
+                   : getLimitedDt();
 
         if (World::getWorld())  // race is active if world exists
         {
@@ -200,7 +301,19 @@ void MainLoop::run()
         else if (!m_abort && ProfileWorld::isNoGraphics())
         {
             PROFILER_PUSH_CPU_MARKER("Protocol manager update", 0x7F, 0x00, 0x7F);
-            if(NetworkConfig::get()->isNetworking())
+            if (NetworkConfig::get()->isDedicatedServer() &&
+                STKHost::existHost())
+            {
+                if (STKHost::get()->requestedShutdown())
+                {
+                    STKHost::get()->shutdown();
+                    // Nothing else to do for a dedicated server
+                    abort();
+                }
+                else
+                    ProtocolManager::getInstance()->update(dt);
+            }
+            else if(NetworkConfig::get()->isNetworking())
                 ProtocolManager::getInstance()->update(dt);
             PROFILER_POP_CPU_MARKER();
 
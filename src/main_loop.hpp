@@ -33,13 +33,35 @@ private:
 
     Uint32   m_curr_time;
     Uint32   m_prev_time;
+
+    /** Real time at which the current tick of a dedicated server started. */
+    double   m_tick_start;
+
+    /** Real time at which the next tick of a dedicated server should
+     *  start. */
+    double   m_next_tick;
+
+    /** Tick statistics of a dedicated server since the last report. */
+    int      m_num_ticks;
+    int      m_num_overruns;
+    int      m_num_skipped_ticks;
+    double   m_total_tick_time;
+    double   m_max_tick_time;
+    double   m_last_report_time;
+
     float    getLimitedDt();
+    float    waitForNextTick();
+    void     reportTickStatistics(double now);
     void     updateRace(float dt);
 public:
          MainLoop();
         ~MainLoop();
     void run();
     void abort();
+    // ------------------------------------------------------------------------
+    /** Clears the abort flag, so that run() can be called again (used
+     *  to profile several races in one process). */
+    void resetAbort() { m_abort = false; }
     void setThrottleFPS(bool throttle) { m_throttle_fps = throttle; }
     // ------------------------------------------------------------------------
     /** Returns true if STK is to be stoppe. */
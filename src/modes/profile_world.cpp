@@ -19,21 +19,37 @@
 #include "modes/profile_world.hpp"
 
 #include "main_loop.hpp"
+#include "config/user_config.hpp"
 #include "graphics/camera.hpp"
 #include "graphics/irr_driver.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/profiler.hpp"
+#include "utils/string_utils.hpp"
 
 #include <ISceneManager.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <stdlib.h>
 
 ProfileWorld::ProfileType ProfileWorld::m_profile_mode=PROFILE_NONE;
+ProfileWorld::ProfileType ProfileWorld::m_batch_profile_mode=PROFILE_NONE;
 int   ProfileWorld::m_num_laps    = 0;
 float ProfileWorld::m_time        = 0.0f;
 bool  ProfileWorld::m_no_graphics = false;
+std::vector<std::string> ProfileWorld::m_batch_tracks;
+std::vector<int>         ProfileWorld::m_batch_num_karts;
+std::vector<int>         ProfileWorld::m_batch_difficulties;
+unsigned int             ProfileWorld::m_batch_next_run = 0;
+std::string              ProfileWorld::m_report_file;
+double ProfileWorld::m_subsystem_time[ProfileWorld::PS_COUNT];
+std::vector<ProfileWorld::RunResult> ProfileWorld::m_run_results;
+bool                     ProfileWorld::m_determinism_check = false;
+unsigned int             ProfileWorld::m_checksum = 0;
 
 //-----------------------------------------------------------------------------
 /** The constructor sets the number of (local) players to 0, since only AI
@@ -92,6 +108,180 @@ void ProfileWorld::setProfileModeLaps(int laps)
     m_num_laps     = laps;
 }   // setProfileModeLaps
 
+//-----------------------------------------------------------------------------
+/** Sets the list of tracks to profile. Each track is raced once for each
+ *  number of karts and difficulty.
+ *  \param tracks List of track identifiers.
+ */
+void ProfileWorld::setBatchTracks(const std::vector<std::string> &tracks)
+{
+    m_batch_tracks = tracks;
+}   // setBatchTracks
+
+//-----------------------------------------------------------------------------
+/** Sets the list of kart numbers to profile.
+ *  \param num_karts List of number of karts.
+ */
+void ProfileWorld::setBatchNumKarts(const std::vector<int> &num_karts)
+{
+    m_batch_num_karts = num_karts;
+}   // setBatchNumKarts
+
+//-----------------------------------------------------------------------------
+/** Sets the list of difficulties to profile.
+ *  \param difficulties List of difficulties (see RaceManager::Difficulty).
+ */
+void ProfileWorld::setBatchDifficulties(const std::vector<int> &difficulties)
+{
+    m_batch_difficulties = difficulties;
+}   // setBatchDifficulties
+
+//-----------------------------------------------------------------------------
+/** Prepares the race manager for the next race to profile, i.e. the next
+ *  combination of track, number of karts and difficulty. Without any batch
+ *  lists exactly one race (using the settings from the command line) is
+ *  done.
+ *  \return False if all races have been profiled.
+ */
+bool ProfileWorld::startNextRun()
+{
+    // The destructor of a profile world resets the profile mode, so save
+    // the mode selected on the command line before the first race.
+    if(m_batch_next_run==0)
+        m_batch_profile_mode = m_profile_mode;
+
+    // An empty list is handled like one entry that keeps the current value
+    const unsigned int num_tracks = std::max(1u,
+                                 (unsigned int)m_batch_tracks.size());
+    const unsigned int num_karts  = std::max(1u,
+                                 (unsigned int)m_batch_num_karts.size());
+    const unsigned int num_diffs  = std::max(1u,
+                                 (unsigned int)m_batch_difficulties.size());
+
+    const unsigned int runs_per_race = m_determinism_check ? 2 : 1;
+    while(m_batch_next_run < num_tracks*num_karts*num_diffs*runs_per_race)
+    {
+        unsigned int n = m_batch_next_run++;
+        if(m_determinism_check)
+        {
+            // Run each race first with and then without parallel AI,
+            // using the same random numbers for both.
+            UserConfigParams::m_parallel_ai = n % 2 == 0;
+            srand(1234);
+            n /= 2;
+        }
+        if(m_batch_difficulties.size()>0)
+        {
+            race_manager->setDifficulty(
+             (RaceManager::Difficulty)m_batch_difficulties[n % num_diffs]);
+        }
+        n /= num_diffs;
+        if(m_batch_num_karts.size()>0)
+            race_manager->setNumKarts(m_batch_num_karts[n % num_karts]);
+        n /= num_karts;
+        if(m_batch_tracks.size()>0)
+        {
+            const std::string &ident = m_batch_tracks[n];
+            const Track *track = track_manager->getTrack(ident);
+            if(!track || track->isArena() || track->isSoccer() ||
+                track->isInternal())
+            {
+                Log::warn("profile", "Invalid track '%s' ignored.",
+                          ident.c_str());
+                continue;
+            }
+            race_manager->setTrack(ident);
+        }
+
+        m_profile_mode = m_batch_profile_mode;
+        for(unsigned int i=0; i<PS_COUNT; i++)
+            m_subsystem_time[i] = 0;
+        m_checksum = 2166136261u;
+        return true;
+    }   // while m_batch_next_run < number of races
+    return false;
+}   // startNextRun
+
+//-----------------------------------------------------------------------------
+/** Adds the time since start to the time spent in the specified subsystem.
+ *  This function does nothing if profiling is not enabled.
+ *  \param type The subsystem.
+ *  \param start The value of getTimeMilliseconds() when the subsystem was
+ *         started.
+ */
+void ProfileWorld::addSubsystemTime(SubsystemType type, double start)
+{
+    if(m_profile_mode==PROFILE_NONE) return;
+    m_subsystem_time[type] += getTimeMilliseconds() - start;
+}   // addSubsystemTime
+
+//-----------------------------------------------------------------------------
+/** Writes the results of all profiled races to the report file (if one was
+ *  specified). The format is JSON if the file name ends in ".json",
+ *  otherwise CSV (one line per race).
+ */
+void ProfileWorld::writeReport()
+{
+    if(m_report_file.empty()) return;
+
+    FILE *fd = fopen(m_report_file.c_str(), "w");
+    if(!fd)
+    {
+        Log::error("profile", "Can not open '%s' for writing.",
+                   m_report_file.c_str());
+        return;
+    }
+
+    static const char *names[PS_COUNT] = {"world", "physics", "karts", "ai",
+                                          "track", "items", "projectiles"};
+    const bool json = StringUtils::getExtension(m_report_file)=="json";
+    if(json)
+        fprintf(fd, "[\n");
+    else
+    {
+        fprintf(fd, "track,karts,difficulty,frames,simulated_time,wall_time,"
+                    "simulated_per_wall_second");
+        for(unsigned int j=0; j<PS_COUNT; j++)
+            fprintf(fd, ",%s_ms", names[j]);
+        fprintf(fd, "\n");
+    }
+
+    for(unsigned int i=0; i<m_run_results.size(); i++)
+    {
+        const RunResult &r = m_run_results[i];
+        float ratio = r.m_wall_time>0 ? r.m_simulated_time/r.m_wall_time : 0;
+        if(json)
+        {
+            fprintf(fd, "  { \"track\": \"%s\", \"karts\": %d, "
+                        "\"difficulty\": %d, \"frames\": %d, "
+                        "\"simulated_time\": %f, \"wall_time\": %f, "
+                        "\"simulated_per_wall_second\": %f",
+                    r.m_track.c_str(), r.m_num_karts, r.m_difficulty,
+                    r.m_frame_count, r.m_simulated_time, r.m_wall_time,
+                    ratio);
+            for(unsigned int j=0; j<PS_COUNT; j++)
+                fprintf(fd, ", \"%s_ms\": %f", names[j],
+                        r.m_subsystem_time[j]);
+            fprintf(fd, " }%s\n", i+1<m_run_results.size() ? "," : "");
+        }
+        else
+        {
+            fprintf(fd, "%s,%d,%d,%d,%f,%f,%f", r.m_track.c_str(),
+                    r.m_num_karts, r.m_difficulty, r.m_frame_count,
+                    r.m_simulated_time, r.m_wall_time, ratio);
+            for(unsigned int j=0; j<PS_COUNT; j++)
+                fprintf(fd, ",%f", r.m_subsystem_time[j]);
+            fprintf(fd, "\n");
+        }
+    }   // for i < m_run_results.size()
+
+    if(json)
+        fprintf(fd, "]\n");
+    fclose(fd);
+    Log::info("profile", "Results of %d races written to '%s'.",
+              (int)m_run_results.size(), m_report_file.c_str());
+}   // writeReport
+
 //-----------------------------------------------------------------------------
 /** Creates a kart, having a certain position, starting location, and local
  *  and global player id (if applicable).
@@ -152,7 +342,27 @@ bool ProfileWorld::isRaceOver()
  */
 void ProfileWorld::update(float dt)
 {
+    double start = getTimeMilliseconds();
     StandardRace::update(dt);
+    addSubsystemTime(PS_WORLD, start);
+
+    if(m_determinism_check)
+    {
+        // Update the checksum (FNV-1a) with the bit patterns of all
+        // kart transforms, so even the smallest difference is detected.
+        for(unsigned int i=0; i<m_karts.size(); i++)
+        {
+            const btTransform &t = m_karts[i]->getTrans();
+            const btQuaternion q = t.getRotation();
+            const float data[7] = { t.getOrigin().getX(),
+                                    t.getOrigin().getY(),
+                                    t.getOrigin().getZ(),
+                                    q.getX(), q.getY(), q.getZ(), q.getW() };
+            const unsigned char *p = (const unsigned char*)data;
+            for(unsigned int j=0; j<sizeof(data); j++)
+                m_checksum = (m_checksum ^ p[j]) * 16777619u;
+        }
+    }
 
     m_frame_count++;
     video::IVideoDriver *driver = irr_driver->getVideoDriver();
@@ -203,6 +413,39 @@ void ProfileWorld::enterRaceOverState()
     float runtime = (irr_driver->getRealTime()-m_start_time)*0.001f;
     Log::verbose("profile", "Number of frames: %d time %f, Average FPS: %f",
                  m_frame_count, runtime, (float)m_frame_count/runtime);
+    Log::verbose("profile", "Simulated time %f, simulated seconds per "
+                 "second: %f", getTime(), getTime()/runtime);
+
+    RunResult result;
+    result.m_track          = race_manager->getTrackName();
+    result.m_num_karts      = getNumKarts();
+    result.m_difficulty     = race_manager->getDifficulty();
+    result.m_frame_count    = m_frame_count;
+    result.m_simulated_time = getTime();
+    result.m_wall_time      = runtime;
+    for(unsigned int i=0; i<PS_COUNT; i++)
+        result.m_subsystem_time[i] = m_subsystem_time[i];
+    result.m_parallel_ai    = UserConfigParams::m_parallel_ai;
+    result.m_checksum       = m_checksum;
+    m_run_results.push_back(result);
+
+    // The second run of each race is done without parallel AI, compare
+    // it with the first run.
+    if(m_determinism_check && !result.m_parallel_ai &&
+        m_run_results.size()>=2)
+    {
+        const RunResult &parallel = m_run_results[m_run_results.size()-2];
+        if(parallel.m_checksum    == result.m_checksum &&
+           parallel.m_frame_count == result.m_frame_count)
+            Log::info("profile", "Determinism check passed for '%s'.",
+                      result.m_track.c_str());
+        else
+            Log::error("profile", "Determinism check failed for '%s': "
+                       "parallel AI %d frames checksum %x, serial AI "
+                       "%d frames checksum %x.", result.m_track.c_str(),
+                       parallel.m_frame_count, parallel.m_checksum,
+                       result.m_frame_count, result.m_checksum);
+    }
 
     // Print geometry statistics if we're not in no-graphics mode
     if(!m_no_graphics)
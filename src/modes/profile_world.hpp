@@ -21,6 +21,9 @@
 
 #include "modes/standard_race.hpp"
 
+#include <string>
+#include <vector>
+
 class Kart;
 
 /**
@@ -29,6 +32,15 @@ class Kart;
  */
 class ProfileWorld : public StandardRace
 {
+public:
+    /** The parts of a world update for which the time is measured. Note
+     *  that they are nested: PS_WORLD includes all others, PS_KARTS
+     *  includes PS_AI. PS_ITEMS is the update of all items (included in
+     *  PS_TRACK) plus the item hit tests of the karts (included in
+     *  PS_KARTS). */
+    enum SubsystemType {PS_WORLD, PS_PHYSICS, PS_KARTS, PS_AI, PS_TRACK,
+                        PS_ITEMS, PS_PROJECTILES, PS_COUNT};
+
 private:
     /** Profiling modes. */
     enum        ProfileType {PROFILE_NONE, PROFILE_TIME, PROFILE_LAPS};
@@ -36,6 +48,52 @@ private:
     /** If profiling is done, and if so, which mode. */
     static ProfileType m_profile_mode;
 
+    /** The profile mode selected on the command line. This is used to
+     *  restore m_profile_mode (which is reset when a world is deleted)
+     *  for each race of a batch. */
+    static ProfileType m_batch_profile_mode;
+
+    /** Tracks, number of karts and difficulties to profile. Each
+     *  combination of these is profiled as one race. An empty list means
+     *  that the value selected on the command line is used. */
+    static std::vector<std::string> m_batch_tracks;
+    static std::vector<int>         m_batch_num_karts;
+    static std::vector<int>         m_batch_difficulties;
+
+    /** Index of the next race to start in the batch. */
+    static unsigned int m_batch_next_run;
+
+    /** Name of the file to write the results of all races to. If it ends
+     *  in ".json" JSON is written, otherwise CSV. */
+    static std::string  m_report_file;
+
+    /** If each race is run twice (with and without parallel AI) to check
+     *  that both give identical results. */
+    static bool         m_determinism_check;
+
+    /** Checksum of the kart transforms of all frames in this race. */
+    static unsigned int m_checksum;
+
+    /** Accumulated time (in ms) spent in each subsystem in this race. */
+    static double m_subsystem_time[PS_COUNT];
+
+    /** The results of one profiled race. */
+    struct RunResult
+    {
+        std::string m_track;
+        int         m_num_karts;
+        int         m_difficulty;
+        int         m_frame_count;
+        float       m_simulated_time;
+        float       m_wall_time;
+        double      m_subsystem_time[PS_COUNT];
+        bool        m_parallel_ai;
+        unsigned int m_checksum;
+    };   // RunResult
+
+    /** The results of all profiled races. */
+    static std::vector<RunResult> m_run_results;
+
     /** If no graphics should be displayed. Useful for batch testing
      *  of AI changes etc. */
     static bool  m_no_graphics;
@@ -88,6 +146,20 @@ public:
 
     static   void setProfileModeTime(float time);
     static   void setProfileModeLaps(int laps);
+    static   void setBatchTracks(const std::vector<std::string> &tracks);
+    static   void setBatchNumKarts(const std::vector<int> &num_karts);
+    static   void setBatchDifficulties(const std::vector<int> &difficulties);
+    static   bool startNextRun();
+    static   void writeReport();
+    static   void addSubsystemTime(SubsystemType type, double start);
+    // ------------------------------------------------------------------------
+    /** Runs each race twice, with and without parallel AI, and compares
+     *  the kart positions of both races. */
+    static   void enableDeterminismCheck() { m_determinism_check = true; }
+    // ------------------------------------------------------------------------
+    /** Sets the file to which the results of all races are written. */
+    static   void setReportFile(const std::string &file)
+                                                     { m_report_file = file; }
     // ------------------------------------------------------------------------
     /** Returns true if profile mode was selected. */
     static   bool isProfileMode() {return m_profile_mode!=PROFILE_NONE; }
@@ -62,6 +62,7 @@
 #include "states_screens/state_manager.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
+#include "tracks/track_object_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/profiler.hpp"
 #include "utils/translation.hpp"
@@ -1001,18 +1002,50 @@ void World::update(float dt)
     if (m_script_engine) m_script_engine->update(dt);
     PROFILER_POP_CPU_MARKER();
 
+    double start = getTimeMilliseconds();
     if (!history->dontDoPhysics())
     {
         m_physics->update(dt);
+        // Driveable objects might have been moved by the physics
+        m_track->getTrackObjectManager()->updateDriveableTree();
     }
+    ProfileWorld::addSubsystemTime(ProfileWorld::PS_PHYSICS, start);
 
     PROFILER_PUSH_CPU_MARKER("World::update (Kart::update)", 0x40, 0x7F, 0x00);
+    start = getTimeMilliseconds();
     const int kart_amount = (int)m_karts.size();
+
+    // First let the controllers of all karts compute their decisions. This
+    // only reads the state of the world, so it can be done in parallel.
+    // The results are then used when updating the karts one after another.
+    // The transforms of the karts are copied from the physics bodies first
+    // (which Kart::update would otherwise do), so the decisions are based on
+    // the positions after the physics step just done.
+    if(!history->replayHistory())
+    {
+        for (int i = 0; i < kart_amount; ++i)
+        {
+            if(!m_karts[i]->isEliminated())
+                m_karts[i]->updateFromPhysics();
+        }
+
+        double ai_start = getTimeMilliseconds();
+        const bool parallel = UserConfigParams::m_parallel_ai;
+        #pragma omp parallel for if(parallel)
+        for (int i = 0; i < kart_amount; ++i)
+        {
+            if(!m_karts[i]->isEliminated())
+                m_karts[i]->getController()->computeDecisions(dt);
+        }
+        ProfileWorld::addSubsystemTime(ProfileWorld::PS_AI, ai_start);
+    }
+
     for (int i = 0 ; i < kart_amount; ++i)
     {
         // Update all karts that are not eliminated
         if(!m_karts[i]->isEliminated()) m_karts[i]->update(dt) ;
     }
+    ProfileWorld::addSubsystemTime(ProfileWorld::PS_KARTS, start);
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_PUSH_CPU_MARKER("World::update (camera)", 0x60, 0x7F, 0x00);
@@ -1030,7 +1063,9 @@ void World::update(float dt)
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_PUSH_CPU_MARKER("World::update (projectiles)", 0xa0, 0x7F, 0x00);
+    start = getTimeMilliseconds();
     projectile_manager->update(dt);
+    ProfileWorld::addSubsystemTime(ProfileWorld::PS_PROJECTILES, start);
     PROFILER_POP_CPU_MARKER();
 
     PROFILER_POP_CPU_MARKER();
@@ -1059,7 +1094,9 @@ void World::update(float dt)
  */
 void World::updateTrack(float dt)
 {
+    double start = getTimeMilliseconds();
     m_track->update(dt);
+    ProfileWorld::addSubsystemTime(ProfileWorld::PS_TRACK, start);
 }   // update Track
 // ----------------------------------------------------------------------------
 
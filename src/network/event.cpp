@@ -22,14 +22,21 @@
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
 
+#include <new>
+#include <sstream>
 #include <string.h>
 
+Synchronised<std::vector<void*> > Event::m_pool;
+unsigned int Event::m_num_allocations = 0;
+unsigned int Event::m_num_reuses      = 0;
+
 /** \brief Constructor
  *  \param event : The event that needs to be translated.
  */
 Event::Event(ENetEvent* event)
 {
     m_arrival_time = (double)StkTime::getTimeSinceEpoch();
+    m_data         = NULL;
 
     switch (event->type)
     {
@@ -48,8 +55,8 @@ Event::Event(ENetEvent* event)
     }
     if (m_type == EVENT_TYPE_MESSAGE)
     {
-        m_data = new NetworkString(event->packet->data, 
-                                      event->packet->dataLength);
+        m_data = NetworkString::create(event->packet->data,
+                                       event->packet->dataLength);
     }
     else
         m_data = NULL;
@@ -80,6 +87,68 @@ Event::~Event()
     // Do not delete m_peer, it's a pointer to the enet data structure
     // which is persistent.
     m_peer = NULL;
-    delete m_data;
+    if (m_data)
+        m_data->drop();
 }   // ~Event
 
+// ----------------------------------------------------------------------------
+/** Allocates memory for a new event, reusing the memory of a deleted event
+ *  if possible.
+ */
+void* Event::operator new(size_t size)
+{
+    assert(size == sizeof(Event));
+    void *p = NULL;
+    m_pool.lock();
+    if (m_pool.getData().empty())
+    {
+        m_num_allocations++;
+    }
+    else
+    {
+        p = m_pool.getData().back();
+        m_pool.getData().pop_back();
+        m_num_reuses++;
+    }
+    m_pool.unlock();
+    if (!p)
+        p = ::operator new(size);
+    return p;
+}   // operator new
+
+// ----------------------------------------------------------------------------
+/** Keeps the memory of a deleted event in the pool to be reused.
+ */
+void Event::operator delete(void *p)
+{
+    if (!p)
+        return;
+    m_pool.lock();
+    m_pool.getData().push_back(p);
+    m_pool.unlock();
+}   // operator delete
+
+// ----------------------------------------------------------------------------
+/** Frees the memory of all events in the pool.
+ */
+void Event::destroyPool()
+{
+    m_pool.lock();
+    for (unsigned int i = 0; i < m_pool.getData().size(); i++)
+        ::operator delete(m_pool.getData()[i]);
+    m_pool.getData().clear();
+    m_pool.unlock();
+}   // destroyPool
+
+// ----------------------------------------------------------------------------
+/** Returns a string with the number of allocated and reused events. */
+std::string Event::getPoolStatistics()
+{
+    std::ostringstream out;
+    m_pool.lock();
+    out << "Event: " << m_num_allocations << " allocated, " << m_num_reuses
+        << " reused, " << m_pool.getData().size() << " in pool";
+    m_pool.unlock();
+    return out.str();
+}   // getPoolStatistics
+
@@ -30,6 +30,9 @@
 
 #include "enet/enet.h"
 
+#include <string>
+#include <vector>
+
 class STKPeer;
 
 /*!
@@ -70,9 +73,23 @@ private:
     /** Arrivial time of the event, for timeouts. */
     double m_arrival_time;
 
+    /** Memory of deleted events, which is reused for new events, so that
+     *  receiving a packet does not need a memory allocation. */
+    static Synchronised<std::vector<void*> > m_pool;
+
+    /** Number of events allocated from the heap, protected by m_pool. */
+    static unsigned int m_num_allocations;
+
+    /** Number of events using memory from the pool, protected by m_pool. */
+    static unsigned int m_num_reuses;
+
 public:
          Event(ENetEvent* event);
         ~Event();
+    static void* operator new(size_t size);
+    static void  operator delete(void *p);
+    static void  destroyPool();
+    static std::string getPoolStatistics();
 
     // ------------------------------------------------------------------------
     /** Returns the type of this event. */
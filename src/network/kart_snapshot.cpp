@@ -0,0 +1,396 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/kart_snapshot.hpp"
+
+#include "network/network_string.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+namespace
+{
+    /** Field modes for one position component in a delta encoded kart. */
+    enum { FIELD_UNCHANGED = 0, FIELD_DELTA8 = 1, FIELD_FULL = 2 };
+
+    /** Bit in the field flags indicating that the rotation is sent. */
+    const uint8_t FIELD_ROTATION = 0x40;
+
+    /** Largest absolute value of the three smallest quaternion components. */
+    const float MAX_COMPONENT = 0.70710678f;
+}   // namespace
+
+// ============================================================================
+/** Unit testing: encodes snapshots with and without a baseline, decodes them
+ *  again and checks that the result is within the quantization error.
+ */
+void KartSnapshot::unitTesting()
+{
+    assert( isNewer(1, 0));
+    assert(!isNewer(0, 1));
+    assert(!isNewer(5, 5));
+    assert( isNewer(2, 65534));   // wrap around
+    assert(!isNewer(65534, 2));
+
+    const Vec3 min(-200, -20, -300), max(400, 80, 100);
+    const unsigned int num_karts = 16;
+    KartSnapshot s1(num_karts, min, max);
+    srand(1234);
+    std::vector<Vec3> xyz(num_karts);
+    std::vector<btQuaternion> rot(num_karts);
+    for(unsigned int i=0; i<num_karts; i++)
+    {
+        xyz[i] = Vec3(min.getX() + (max.getX()-min.getX())*rand()/RAND_MAX,
+                      min.getY() + (max.getY()-min.getY())*rand()/RAND_MAX,
+                      min.getZ() + (max.getZ()-min.getZ())*rand()/RAND_MAX);
+        rot[i] = btQuaternion(btVector3(rand()-RAND_MAX*0.5f,
+                                        rand()-RAND_MAX*0.5f,
+                                        rand()-RAND_MAX*0.5f).normalized(),
+                              6.28f*rand()/RAND_MAX);
+        s1.setKart(i, xyz[i], rot[i]);
+    }
+    s1.setSequence(17);
+
+    // Full snapshot round trip
+    BareNetworkString full;
+    s1.encode(&full, NULL);
+    KartSnapshot d1(num_karts, min, max);
+    // Decode outside of assert, so that this also works with NDEBUG
+    const bool full_ok = d1.decode(full, NULL);
+    assert(full_ok);
+    (void)full_ok;
+    assert(full.size()==0);
+    for(unsigned int i=0; i<num_karts; i++)
+    {
+        assert(d1.hasKart(i));
+        assert((d1.getXYZ(i)-xyz[i]).length() < 0.02f);
+        // q and -q are the same rotation
+        assert(fabsf(d1.getRotation(i).dot(rot[i])) > 0.999f);
+    }
+
+    // Delta snapshot: kart 0 moves a bit, kart 1 moves far and rotates,
+    // kart 2 is not contained in the new snapshot, all others are unchanged.
+    KartSnapshot s2 = s1;
+    s2.setSequence(18);
+    xyz[0] += Vec3(0.1f, 0, -0.2f);
+    s2.setKart(0, xyz[0], rot[0]);
+    xyz[1]  = (min+max)*0.5f;
+    rot[1]  = btQuaternion(btVector3(0, 1, 0), 1.0f);
+    s2.setKart(1, xyz[1], rot[1]);
+    s2.m_states[2].m_valid = false;
+
+    BareNetworkString delta;
+    s2.encode(&delta, &s1);
+    assert(delta.size() < full.getTotalSize()/4);
+    KartSnapshot d2(num_karts, min, max);
+    const bool delta_ok = d2.decode(delta, &d1);
+    assert(delta_ok);
+    (void)delta_ok;
+    for(unsigned int i=0; i<num_karts; i++)
+    {
+        assert(d2.hasKart(i) == (i!=2));
+        if(i==2) continue;
+        assert((d2.getXYZ(i)-xyz[i]).length() < 0.02f);
+        assert(fabsf(d2.getRotation(i).dot(rot[i])) > 0.999f);
+        // Delta decoding must give exactly the same quantized values
+        assert(memcmp(d2.m_states[i].m_xyz, s2.m_states[i].m_xyz,
+                      sizeof(s2.m_states[i].m_xyz))==0);
+        assert(d2.m_states[i].m_rotation == s2.m_states[i].m_rotation);
+    }
+
+    // Positions outside of the bounding box are clamped.
+    KartSnapshot s3(1, min, max);
+    s3.setKart(0, Vec3(1000, -1000, 0), btQuaternion(0, 0, 0, 1));
+    assert((s3.getXYZ(0) - Vec3(max.getX(), min.getY(), 0)).length() < 0.02f);
+}   // unitTesting
+
+// ============================================================================
+/** Compresses a quaternion into 32 bits: the index of the largest component
+ *  (2 bits), and the other three components with 10 bits each. Since q and -q
+ *  represent the same rotation, the sign is chosen so that the largest
+ *  component is positive, and it can then be reconstructed from the other
+ *  three components.
+ *  \param q The quaternion to compress.
+ */
+uint32_t KartSnapshot::compressQuaternion(const btQuaternion &q)
+{
+    btQuaternion n = q.normalized();
+    float c[4] = { n.getX(), n.getY(), n.getZ(), n.getW() };
+    unsigned int largest = 0;
+    for(unsigned int i=1; i<4; i++)
+    {
+        if(fabsf(c[i]) > fabsf(c[largest]))
+            largest = i;
+    }
+    const float sign = c[largest] < 0 ? -1.0f : 1.0f;
+
+    uint32_t result = largest;
+    for(unsigned int i=0; i<4; i++)
+    {
+        if(i==largest) continue;
+        float f = (sign*c[i]/MAX_COMPONENT)*0.5f + 0.5f;
+        f = std::max(0.0f, std::min(1.0f, f));
+        result = (result << 10) | (uint32_t)(f*1023.0f + 0.5f);
+    }
+    return result;
+}   // compressQuaternion
+
+// ----------------------------------------------------------------------------
+/** Reconstructs a quaternion compressed with compressQuaternion.
+ *  \param c The compressed quaternion.
+ */
+btQuaternion KartSnapshot::decompressQuaternion(uint32_t c)
+{
+    const unsigned int largest = c >> 30;
+    float q[4];
+    float sum = 0;
+    for(int i=3; i>=0; i--)
+    {
+        if(i==(int)largest) continue;
+        q[i] = ((c & 1023)/1023.0f*2.0f - 1.0f) * MAX_COMPONENT;
+        sum += q[i]*q[i];
+        c >>= 10;
+    }
+    q[largest] = sqrtf(std::max(0.0f, 1.0f - sum));
+    return btQuaternion(q[0], q[1], q[2], q[3]).normalized();
+}   // decompressQuaternion
+
+// ============================================================================
+/** Creates an empty snapshot (i.e. no kart is contained).
+ *  \param num_karts Number of karts in the world.
+ *  \param min, max The bounding box used to quantize positions.
+ */
+KartSnapshot::KartSnapshot(unsigned int num_karts, const Vec3 &min,
+                           const Vec3 &max)
+{
+    m_sequence = 0;
+    m_min      = min;
+    m_max      = max;
+    // Avoid a division by zero for a degenerated bounding box
+    for(unsigned int i=0; i<3; i++)
+    {
+        if(m_max[i] - m_min[i] < 1.0f)
+            m_max[i] = m_min[i] + 1.0f;
+    }
+    m_states.resize(num_karts);
+    for(unsigned int i=0; i<num_karts; i++)
+        m_states[i].m_valid = false;
+}   // KartSnapshot
+
+// ----------------------------------------------------------------------------
+/** Stores the quantized state of a kart. Positions outside of the bounding
+ *  box are clamped.
+ *  \param id World kart id of the kart.
+ *  \param xyz Position of the kart.
+ *  \param q Rotation of the kart.
+ */
+void KartSnapshot::setKart(unsigned int id, const Vec3 &xyz,
+                           const btQuaternion &q)
+{
+    KartState &state = m_states[id];
+    for(unsigned int i=0; i<3; i++)
+    {
+        float f = (xyz[i] - m_min[i]) / (m_max[i] - m_min[i]);
+        f = std::max(0.0f, std::min(1.0f, f));
+        state.m_xyz[i] = (uint16_t)(f*65535.0f + 0.5f);
+    }
+    state.m_rotation = compressQuaternion(q);
+    state.m_valid    = true;
+}   // setKart
+
+// ----------------------------------------------------------------------------
+/** Returns the (dequantized) position of a kart.
+ *  \param id World kart id of the kart.
+ */
+Vec3 KartSnapshot::getXYZ(unsigned int id) const
+{
+    const KartState &state = m_states[id];
+    Vec3 xyz;
+    for(unsigned int i=0; i<3; i++)
+        xyz[i] = m_min[i] + state.m_xyz[i]/65535.0f * (m_max[i] - m_min[i]);
+    return xyz;
+}   // getXYZ
+
+// ----------------------------------------------------------------------------
+/** Returns the rotation of a kart.
+ *  \param id World kart id of the kart.
+ */
+btQuaternion KartSnapshot::getRotation(unsigned int id) const
+{
+    return decompressQuaternion(m_states[id].m_rotation);
+}   // getRotation
+
+// ----------------------------------------------------------------------------
+/** Encodes this snapshot. The format is a bit mask with one bit for each
+ *  kart which is sent, followed by the data of each sent kart: one byte of
+ *  flags (two bits for each position component: unchanged, 8 bit delta or
+ *  16 bit full value; and one bit if the rotation is sent), then the
+ *  position components and the rotation.
+ *  \param ns The network string to append the data to.
+ *  \param baseline A snapshot the receiver is known to have. If it is
+ *         NULL, all karts contained in this snapshot are sent completely.
+ *         Otherwise only karts and components which differ are sent.
+ *         Karts not contained in this snapshot are never sent (the receiver
+ *         then marks them as missing).
+ */
+void KartSnapshot::encode(BareNetworkString *ns,
+                          const KartSnapshot *baseline) const
+{
+    const unsigned int num_karts = (unsigned int)m_states.size();
+    assert(!baseline || baseline->m_states.size()==num_karts);
+
+    // First determine which karts must be sent, and the flags for each
+    std::vector<uint8_t> flags(num_karts, 0);
+    for(unsigned int id=0; id<num_karts; id++)
+    {
+        const KartState &state = m_states[id];
+        if(!state.m_valid) continue;
+        const KartState *old = baseline && baseline->m_states[id].m_valid
+                             ? &baseline->m_states[id] : NULL;
+        for(unsigned int i=0; i<3; i++)
+        {
+            int mode = FIELD_FULL;
+            if(old)
+            {
+                int diff = (int)state.m_xyz[i] - (int)old->m_xyz[i];
+                if(diff==0)
+                    mode = FIELD_UNCHANGED;
+                else if(diff>=-128 && diff<=127)
+                    mode = FIELD_DELTA8;
+            }
+            flags[id] |= mode << (2*i);
+        }
+        if(!old || old->m_rotation!=state.m_rotation)
+            flags[id] |= FIELD_ROTATION;
+    }   // for id < num_karts
+
+    // A kart must be sent if it has changed, or if it is not in the
+    // baseline anymore (so the receiver can detect this).
+    for(unsigned int byte=0; byte<(num_karts+7)/8; byte++)
+    {
+        uint8_t mask = 0;
+        for(unsigned int bit=0; bit<8 && byte*8+bit<num_karts; bit++)
+        {
+            const unsigned int id = byte*8+bit;
+            bool in_baseline = baseline && baseline->m_states[id].m_valid;
+            if(flags[id]!=0 || (in_baseline && !m_states[id].m_valid))
+                mask |= 1 << bit;
+        }
+        ns->addUInt8(mask);
+    }
+
+    for(unsigned int id=0; id<num_karts; id++)
+    {
+        const KartState &state = m_states[id];
+        const bool in_baseline = baseline && baseline->m_states[id].m_valid;
+        if(flags[id]==0 && !(in_baseline && !state.m_valid))
+            continue;
+        // A kart removed since the baseline is sent with all flags set,
+        // which is otherwise impossible (mode 3 is not used).
+        if(!state.m_valid)
+        {
+            ns->addUInt8(0xff);
+            continue;
+        }
+        ns->addUInt8(flags[id]);
+        for(unsigned int i=0; i<3; i++)
+        {
+            int mode = (flags[id] >> (2*i)) & 3;
+            if(mode==FIELD_DELTA8)
+            {
+                int diff = (int)state.m_xyz[i]
+                         - (int)baseline->m_states[id].m_xyz[i];
+                ns->addUInt8((uint8_t)(int8_t)diff);
+            }
+            else if(mode==FIELD_FULL)
+                ns->addUInt16(state.m_xyz[i]);
+        }
+        if(flags[id] & FIELD_ROTATION)
+            ns->addUInt32(state.m_rotation);
+    }   // for id < num_karts
+}   // encode
+
+// ----------------------------------------------------------------------------
+/** Decodes a snapshot encoded with encode().
+ *  \param ns The network string to read the data from.
+ *  \param baseline The snapshot that was used as baseline when encoding,
+ *         or NULL if no baseline was used.
+ *  \return False if the data is invalid (e.g. too short), in which case
+ *          the content of this snapshot is undefined.
+ */
+bool KartSnapshot::decode(const BareNetworkString &ns,
+                          const KartSnapshot *baseline)
+{
+    const unsigned int num_karts = (unsigned int)m_states.size();
+    if(baseline && baseline->m_states.size()!=num_karts)
+        return false;
+
+    const unsigned int mask_bytes = (num_karts+7)/8;
+    if(ns.size() < mask_bytes)
+        return false;
+    std::vector<uint8_t> mask(mask_bytes);
+    for(unsigned int i=0; i<mask_bytes; i++)
+        mask[i] = ns.getUInt8();
+
+    for(unsigned int id=0; id<num_karts; id++)
+    {
+        KartState &state = m_states[id];
+        if(baseline)
+            state = baseline->m_states[id];
+        else
+            state.m_valid = false;
+        if( (mask[id/8] & (1 << (id%8))) == 0)
+            continue;
+
+        if(ns.size()<1) return false;
+        uint8_t flags = ns.getUInt8();
+        if(flags==0xff)
+        {
+            state.m_valid = false;
+            continue;
+        }
+        const bool has_old = state.m_valid;
+        for(unsigned int i=0; i<3; i++)
+        {
+            int mode = (flags >> (2*i)) & 3;
+            if(mode==FIELD_DELTA8)
+            {
+                if(!has_old || ns.size()<1) return false;
+                state.m_xyz[i] += (int8_t)ns.getUInt8();
+            }
+            else if(mode==FIELD_FULL)
+            {
+                if(ns.size()<2) return false;
+                state.m_xyz[i] = ns.getUInt16();
+            }
+            else if(mode==FIELD_UNCHANGED && !has_old)
+                return false;
+        }
+        if(flags & FIELD_ROTATION)
+        {
+            if(ns.size()<4) return false;
+            state.m_rotation = ns.getUInt32();
+        }
+        else if(!has_old)
+            return false;
+        state.m_valid = true;
+    }   // for id < num_karts
+    return true;
+}   // decode
@@ -0,0 +1,106 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file kart_snapshot.hpp
+ *  \brief Compact, quantized representation of the state of all karts.
+ */
+
+#ifndef HEADER_KART_SNAPSHOT_HPP
+#define HEADER_KART_SNAPSHOT_HPP
+
+#include "utils/types.hpp"
+#include "utils/vec3.hpp"
+
+#include "LinearMath/btQuaternion.h"
+
+#include <vector>
+
+class BareNetworkString;
+
+/** \class KartSnapshot
+ *  \brief Stores the position and rotation of all karts at one point in
+ *  time in a quantized form that can be sent efficiently over the network.
+ *  Positions are stored as 16 bit values relative to a bounding box (usually
+ *  the track's bounding box), rotations use the 'smallest three' encoding
+ *  (the largest component of a unit quaternion is dropped, the other three
+ *  are stored with 10 bits each). A snapshot can be encoded relative to a
+ *  baseline snapshot (which the receiver must have): only karts and
+ *  components that have changed are then sent, small position changes
+ *  with a single byte.
+ * \ingroup network
+ */
+class KartSnapshot
+{
+private:
+    /** The quantized state of one kart. */
+    struct KartState
+    {
+        /** The position, quantized relative to the bounding box. */
+        uint16_t m_xyz[3];
+
+        /** The compressed rotation. */
+        uint32_t m_rotation;
+
+        /** True if this kart is contained in the snapshot. */
+        bool     m_valid;
+    };   // KartState
+
+    /** Sequence number of this snapshot. */
+    uint16_t m_sequence;
+
+    /** The bounding box used to quantize positions. */
+    Vec3 m_min, m_max;
+
+    /** The state of each kart, indexed by world kart id. */
+    std::vector<KartState> m_states;
+
+public:
+    static void unitTesting();
+    static uint32_t compressQuaternion(const btQuaternion &q);
+    static btQuaternion decompressQuaternion(uint32_t c);
+
+         KartSnapshot(unsigned int num_karts=0,
+                      const Vec3 &min=Vec3(0,0,0),
+                      const Vec3 &max=Vec3(1,1,1));
+    void setKart(unsigned int id, const Vec3 &xyz, const btQuaternion &q);
+    Vec3 getXYZ(unsigned int id) const;
+    btQuaternion getRotation(unsigned int id) const;
+    void encode(BareNetworkString *ns, const KartSnapshot *baseline) const;
+    bool decode(const BareNetworkString &ns, const KartSnapshot *baseline);
+    // ------------------------------------------------------------------------
+    /** Returns true if sequence a is newer than sequence b, taking
+     *  wrap-around into account. */
+    static bool isNewer(uint16_t a, uint16_t b)
+    {
+        return a!=b && (uint16_t)(a-b) < 0x8000;
+    }   // isNewer
+    // ------------------------------------------------------------------------
+    /** Returns the number of karts this snapshot can store. */
+    unsigned int getNumKarts() const { return (unsigned int)m_states.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns if the state of the specified kart is stored. */
+    bool hasKart(unsigned int id) const { return m_states[id].m_valid; }
+    // ------------------------------------------------------------------------
+    /** Returns the sequence number of this snapshot. */
+    uint16_t getSequence() const { return m_sequence; }
+    // ------------------------------------------------------------------------
+    /** Sets the sequence number of this snapshot. */
+    void setSequence(uint16_t sequence) { m_sequence = sequence; }
+};   // KartSnapshot
+
+#endif
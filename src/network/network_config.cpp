@@ -36,7 +36,9 @@ NetworkConfig::NetworkConfig()
 {
     m_network_type  = NETWORK_NONE;
     m_is_server     = false;
+    m_is_dedicated_server = false;
     m_max_players   = 4;
+    m_server_port   = 2758;
     m_is_registered = false;
     m_server_name   = "";
     m_password      = "";
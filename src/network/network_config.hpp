@@ -42,6 +42,10 @@ private:
     /** True if this host is a server, false otherwise. */
     bool m_is_server;
 
+    /** True if this server runs without graphics and GUI, and updates
+     *  the world with a fixed tick rate. */
+    bool m_is_dedicated_server;
+
     /** The password for a server (or to authenticate to a server). */
     std::string m_password;
 
@@ -58,6 +62,9 @@ private:
     /** Maximum number of players on the server. */
     int m_max_players;
 
+    /** The port a server listens on. */
+    uint16_t m_server_port;
+
     /** If this is a server, it indicates if this server is registered
     *  with the stk server. */
     bool m_is_registered;
@@ -127,6 +134,13 @@ public:
     /** Returns if this instance is a client. */
     bool isClient() const { return !m_is_server; }
     // --------------------------------------------------------------------
+    /** Sets if this server is a dedicated server, i.e. runs without
+     *  graphics and GUI with a fixed tick rate. */
+    void setIsDedicatedServer(bool b) { m_is_dedicated_server = b; }
+    // --------------------------------------------------------------------
+    /** Returns if this instance is a dedicated server. */
+    bool isDedicatedServer() const { return m_is_dedicated_server; }
+    // --------------------------------------------------------------------
     /** Sets the name of this server. */
     void setServerName(const irr::core::stringw &name)
     {
@@ -173,6 +187,12 @@ public:
     // ------------------------------------------------------------------------
     /** Returns the private (LAN) port. */
     uint16_t getPrivatePort() const { return m_private_port; }
+    // ------------------------------------------------------------------------
+    /** Sets the port a server listens on. */
+    void setServerPort(uint16_t port) { m_server_port = port; }
+    // ------------------------------------------------------------------------
+    /** Returns the port a server listens on. */
+    uint16_t getServerPort() const { return m_server_port; }
 
 };   // class NetworkConfig
 
@@ -19,8 +19,10 @@
 #include "network/network_console.hpp"
 
 #include "main_loop.hpp"
+#include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/network_player_profile.hpp"
+#include "network/network_stats.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/stk_host.hpp"
 #include "network/protocols/client_lobby_room_protocol.hpp"
@@ -71,6 +73,42 @@ void* NetworkConsole::mainLoop(void* data)
         {
             stop = true;
         }
+        else if (str == "latency")
+        {
+            Log::info("Console", "Event latencies:\n%s",
+                      ProtocolManager::getInstance()
+                                     ->getEventLatencyString().c_str());
+        }
+        else if (str == "pool")
+        {
+            Log::info("Console", "%s.", Event::getPoolStatistics().c_str());
+            Log::info("Console", "%s.",
+                      NetworkString::getPoolStatistics().c_str());
+        }
+        else if (str == "latency-reset")
+        {
+            ProtocolManager::getInstance()->resetEventLatencies();
+        }
+        else if (str == "stats")
+        {
+            Log::info("Console", "Network statistics:\n%s",
+                      STKHost::get()->getNetworkStats()
+                                    ->getStatisticsString().c_str());
+        }
+        else if (str == "stats-reset")
+        {
+            STKHost::get()->getNetworkStats()->reset();
+        }
+        else if (str.compare(0, 10, "stats-csv ") == 0)
+        {
+            // "stats-csv file" starts appending to a CSV file, "stats-csv -"
+            // stops it again.
+            std::string file = str.substr(10);
+            if (file == "-")
+                STKHost::get()->getNetworkStats()->stopCSV();
+            else
+                STKHost::get()->getNetworkStats()->startCSV(file);
+        }
         else if (str == "kickall" && NetworkConfig::get()->isServer())
         {
             me->kickAllPlayers();
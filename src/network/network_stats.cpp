@@ -0,0 +1,341 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/network_stats.hpp"
+
+#include "network/transport_address.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <sstream>
+
+const float NetworkStats::STATS_INTERVAL = 1.0f;
+
+/** Upper limits (in ms) of the round trip time histogram buckets. The last
+ *  bucket contains all larger values. */
+static const uint32_t RTT_BUCKET_LIMITS[NetworkStats::NUM_RTT_BUCKETS - 1] =
+    { 10, 20, 40, 80, 160, 320, 640 };
+
+// ----------------------------------------------------------------------------
+/** Computes the rates of the last sample interval and stores the current
+ *  totals for the next interval.
+ *  \param dt Length of the sample interval in seconds.
+ */
+void NetworkStats::Traffic::updateRates(float dt)
+{
+    m_bytes_sent_rate        = (m_bytes_sent       - m_last_bytes_sent      )/dt;
+    m_packets_sent_rate      = (m_packets_sent     - m_last_packets_sent    )/dt;
+    m_bytes_received_rate    = (m_bytes_received   - m_last_bytes_received  )/dt;
+    m_packets_received_rate  = (m_packets_received - m_last_packets_received)/dt;
+    m_last_bytes_sent        = m_bytes_sent;
+    m_last_packets_sent      = m_packets_sent;
+    m_last_bytes_received    = m_bytes_received;
+    m_last_packets_received  = m_packets_received;
+}   // updateRates
+
+// ============================================================================
+NetworkStats::NetworkStats()
+{
+    pthread_mutex_init(&m_mutex, NULL);
+    m_csv_file         = NULL;
+    m_start_time       = StkTime::getRealTime();
+    m_last_sample_time = m_start_time;
+}   // NetworkStats
+
+// ----------------------------------------------------------------------------
+NetworkStats::~NetworkStats()
+{
+    stopCSV();
+    pthread_mutex_destroy(&m_mutex);
+}   // ~NetworkStats
+
+// ----------------------------------------------------------------------------
+/** Returns the key used to store the statistics of a peer.
+ *  \param address Address of the peer.
+ */
+uint64_t NetworkStats::getKey(const TransportAddress &address)
+{
+    return ((uint64_t)address.getIP() << 16) | address.getPort();
+}   // getKey
+
+// ----------------------------------------------------------------------------
+/** Converts a key as returned by getKey back into a printable address. */
+std::string NetworkStats::keyToString(uint64_t key)
+{
+    TransportAddress address((uint32_t)(key >> 16), (uint16_t)(key & 0xffff));
+    return address.toString();
+}   // keyToString
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the histogram bucket for a round trip time.
+ *  \param rtt Round trip time in ms.
+ */
+unsigned int NetworkStats::getRTTBucket(uint32_t rtt)
+{
+    for (unsigned int i = 0; i < NUM_RTT_BUCKETS - 1; i++)
+    {
+        if (rtt < RTT_BUCKET_LIMITS[i])
+            return i;
+    }
+    return NUM_RTT_BUCKETS - 1;
+}   // getRTTBucket
+
+// ----------------------------------------------------------------------------
+/** Returns a short description of the range of a histogram bucket, e.g.
+ *  "<10" or ">=640". */
+std::string NetworkStats::getRTTBucketName(unsigned int bucket)
+{
+    std::ostringstream out;
+    if (bucket < NUM_RTT_BUCKETS - 1)
+        out << "<" << RTT_BUCKET_LIMITS[bucket];
+    else
+        out << ">=" << RTT_BUCKET_LIMITS[NUM_RTT_BUCKETS - 2];
+    return out.str();
+}   // getRTTBucketName
+
+// ----------------------------------------------------------------------------
+/** Records a message sent to a peer. Can be called from any thread.
+ *  \param address Address of the peer the message is sent to.
+ *  \param protocol Protocol type of the message.
+ *  \param bytes Size of the message.
+ */
+void NetworkStats::addSent(const TransportAddress &address, int protocol,
+                           unsigned int bytes)
+{
+    pthread_mutex_lock(&m_mutex);
+    Traffic &t = m_protocol_traffic[protocol];
+    t.m_bytes_sent += bytes;
+    t.m_packets_sent++;
+    Traffic &p = m_peer_stats[getKey(address)].m_traffic;
+    p.m_bytes_sent += bytes;
+    p.m_packets_sent++;
+    pthread_mutex_unlock(&m_mutex);
+}   // addSent
+
+// ----------------------------------------------------------------------------
+/** Records a message received from a peer. Can be called from any thread.
+ *  \param address Address of the peer the message was received from.
+ *  \param protocol Protocol type of the message.
+ *  \param bytes Size of the message.
+ */
+void NetworkStats::addReceived(const TransportAddress &address, int protocol,
+                               unsigned int bytes)
+{
+    pthread_mutex_lock(&m_mutex);
+    Traffic &t = m_protocol_traffic[protocol];
+    t.m_bytes_received += bytes;
+    t.m_packets_received++;
+    Traffic &p = m_peer_stats[getKey(address)].m_traffic;
+    p.m_bytes_received += bytes;
+    p.m_packets_received++;
+    pthread_mutex_unlock(&m_mutex);
+}   // addReceived
+
+// ----------------------------------------------------------------------------
+/** Called regularly from the listening thread of STKHost (which is the only
+ *  thread accessing the ENet host). Once per STATS_INTERVAL it computes the
+ *  traffic rates, samples round trip time and packet loss of all connected
+ *  ENet peers, and writes the sample to the CSV file if one is open.
+ *  \param host The ENet host whose peers are sampled.
+ */
+void NetworkStats::update(ENetHost *host)
+{
+    double now = StkTime::getRealTime();
+    pthread_mutex_lock(&m_mutex);
+    float dt   = (float)(now - m_last_sample_time);
+    if (dt < STATS_INTERVAL)
+    {
+        pthread_mutex_unlock(&m_mutex);
+        return;
+    }
+    m_last_sample_time = now;
+
+    for (std::map<int, Traffic>::iterator i = m_protocol_traffic.begin();
+         i != m_protocol_traffic.end(); i++)
+    {
+        i->second.updateRates(dt);
+    }
+
+    // Peers that were already disconnected at the last sample are removed
+    // (so a disconnected peer is shown for one interval), the others are
+    // marked as connected again below if they still are.
+    std::map<uint64_t, PeerStats>::iterator peer = m_peer_stats.begin();
+    while (peer != m_peer_stats.end())
+    {
+        if (!peer->second.m_connected)
+        {
+            m_peer_stats.erase(peer++);
+            continue;
+        }
+        peer->second.m_traffic.updateRates(dt);
+        peer->second.m_connected = false;
+        peer++;
+    }
+
+    for (size_t i = 0; i < host->peerCount; i++)
+    {
+        const ENetPeer &peer = host->peers[i];
+        if (peer.state != ENET_PEER_STATE_CONNECTED)
+            continue;
+        PeerStats &p   = m_peer_stats[getKey(TransportAddress(peer.address))];
+        p.m_connected   = true;
+        p.m_rtt         = peer.roundTripTime;
+        p.m_packet_loss = peer.packetLoss / (float)ENET_PEER_PACKET_LOSS_SCALE;
+        p.m_rtt_histogram[getRTTBucket(peer.roundTripTime)]++;
+    }
+
+    if (m_csv_file)
+        writeCSV(now);
+    pthread_mutex_unlock(&m_mutex);
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Writes the current sample to the CSV file: one line for each protocol
+ *  type, and one for each connected peer. Must be called with m_mutex
+ *  locked.
+ *  \param now Current real time.
+ */
+void NetworkStats::writeCSV(double now)
+{
+    float t = (float)(now - m_start_time);
+    for (std::map<int, Traffic>::const_iterator i = m_protocol_traffic.begin();
+         i != m_protocol_traffic.end(); i++)
+    {
+        const Traffic &p = i->second;
+        fprintf(m_csv_file, "%.3f,protocol,0x%x,%.1f,%.1f,%.1f,%.1f,,\n",
+                t, i->first, p.m_bytes_sent_rate, p.m_packets_sent_rate,
+                p.m_bytes_received_rate, p.m_packets_received_rate);
+    }
+    for (std::map<uint64_t, PeerStats>::const_iterator i = m_peer_stats.begin();
+         i != m_peer_stats.end(); i++)
+    {
+        const PeerStats &p = i->second;
+        if (!p.m_connected)
+            continue;
+        fprintf(m_csv_file, "%.3f,peer,%s,%.1f,%.1f,%.1f,%.1f,%u,%.4f\n",
+                t, keyToString(i->first).c_str(),
+                p.m_traffic.m_bytes_sent_rate,
+                p.m_traffic.m_packets_sent_rate,
+                p.m_traffic.m_bytes_received_rate,
+                p.m_traffic.m_packets_received_rate,
+                p.m_rtt, p.m_packet_loss);
+    }
+    fflush(m_csv_file);
+}   // writeCSV
+
+// ----------------------------------------------------------------------------
+/** Starts writing all samples to a CSV file. An already open CSV file is
+ *  closed first.
+ *  \param filename Name of the file. If it exists, the samples are appended
+ *         to it, otherwise it is created with a header line.
+ *  \return True if the file could be opened.
+ */
+bool NetworkStats::startCSV(const std::string &filename)
+{
+    stopCSV();
+    FILE *f = fopen(filename.c_str(), "a");
+    if (!f)
+    {
+        Log::error("NetworkStats", "Can't open '%s' for writing.",
+                   filename.c_str());
+        return false;
+    }
+    // The initial position of a file opened for appending is not defined
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) == 0)
+    {
+        fprintf(f, "time,type,id,bytes_sent_per_s,packets_sent_per_s,"
+                   "bytes_received_per_s,packets_received_per_s,rtt_ms,"
+                   "packet_loss\n");
+    }
+    pthread_mutex_lock(&m_mutex);
+    m_csv_file = f;
+    pthread_mutex_unlock(&m_mutex);
+    Log::info("NetworkStats", "Writing network statistics to '%s'.",
+              filename.c_str());
+    return true;
+}   // startCSV
+
+// ----------------------------------------------------------------------------
+/** Stops writing samples to the CSV file and closes it. */
+void NetworkStats::stopCSV()
+{
+    pthread_mutex_lock(&m_mutex);
+    if (m_csv_file)
+        fclose(m_csv_file);
+    m_csv_file = NULL;
+    pthread_mutex_unlock(&m_mutex);
+}   // stopCSV
+
+// ----------------------------------------------------------------------------
+/** Removes all collected statistics. */
+void NetworkStats::reset()
+{
+    pthread_mutex_lock(&m_mutex);
+    m_protocol_traffic.clear();
+    m_peer_stats.clear();
+    m_start_time       = StkTime::getRealTime();
+    m_last_sample_time = m_start_time;
+    pthread_mutex_unlock(&m_mutex);
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Returns a printable summary of all statistics: totals and rates per
+ *  protocol type, and totals, rates, round trip time histogram and packet
+ *  loss per peer.
+ */
+std::string NetworkStats::getStatisticsString()
+{
+    std::ostringstream out;
+    pthread_mutex_lock(&m_mutex);
+    out << "Statistics of the last "
+        << (StkTime::getRealTime() - m_start_time) << " s:\n";
+    for (std::map<int, Traffic>::const_iterator i = m_protocol_traffic.begin();
+         i != m_protocol_traffic.end(); i++)
+    {
+        const Traffic &t = i->second;
+        out << "protocol 0x" << std::hex << i->first << std::dec
+            << " sent " << t.m_packets_sent << " packets/"
+            << t.m_bytes_sent << " bytes ("
+            << t.m_bytes_sent_rate << " B/s), received "
+            << t.m_packets_received << " packets/"
+            << t.m_bytes_received << " bytes ("
+            << t.m_bytes_received_rate << " B/s)\n";
+    }
+
+    for (std::map<uint64_t, PeerStats>::const_iterator i = m_peer_stats.begin();
+         i != m_peer_stats.end(); i++)
+    {
+        const PeerStats &p = i->second;
+        out << "peer " << keyToString(i->first)
+            << (p.m_connected ? "" : " (disconnected)")
+            << " sent " << p.m_traffic.m_packets_sent << " packets/"
+            << p.m_traffic.m_bytes_sent << " bytes ("
+            << p.m_traffic.m_bytes_sent_rate << " B/s), received "
+            << p.m_traffic.m_packets_received << " packets/"
+            << p.m_traffic.m_bytes_received << " bytes ("
+            << p.m_traffic.m_bytes_received_rate << " B/s)\n"
+            << "    rtt " << p.m_rtt << " ms, packet loss "
+            << 100.0f*p.m_packet_loss << "%, rtt histogram (ms):";
+        for (unsigned int j = 0; j < NUM_RTT_BUCKETS; j++)
+            out << " " << getRTTBucketName(j) << ":" << p.m_rtt_histogram[j];
+        out << "\n";
+    }
+    pthread_mutex_unlock(&m_mutex);
+    return out.str();
+}   // getStatisticsString
@@ -0,0 +1,147 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file network_stats.hpp
+ *  \brief Collects traffic and round trip time statistics of a network
+ *         session.
+ */
+
+#ifndef HEADER_NETWORK_STATS_HPP
+#define HEADER_NETWORK_STATS_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <enet/enet.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+
+class TransportAddress;
+
+/** \class NetworkStats
+ *  \brief Collects the number of bytes and packets sent and received per
+ *  protocol type and per peer, and a histogram of the round trip times and
+ *  the packet loss of each peer as measured by ENet. The traffic counters
+ *  are updated from any thread sending or receiving a message, the
+ *  per-second rates and the round trip times are sampled once per
+ *  STATS_INTERVAL by the listening thread of STKHost. Optionally each
+ *  sample is appended to a CSV file. Sizes are the sizes of the STK
+ *  messages, i.e. without ENet and UDP headers.
+ * \ingroup network
+ */
+class NetworkStats : public NoCopy
+{
+public:
+    /** Number of buckets of the round trip time histogram. */
+    enum { NUM_RTT_BUCKETS = 8 };
+
+private:
+    /** Traffic counters, used for each protocol type and each peer. */
+    struct Traffic
+    {
+        /** Total number of bytes and packets sent and received. */
+        uint64_t m_bytes_sent,    m_packets_sent;
+        uint64_t m_bytes_received, m_packets_received;
+
+        /** The totals at the time of the last sample, used to compute
+         *  the rates. */
+        uint64_t m_last_bytes_sent,     m_last_packets_sent;
+        uint64_t m_last_bytes_received, m_last_packets_received;
+
+        /** Bytes and packets per second during the last sample interval. */
+        float m_bytes_sent_rate,     m_packets_sent_rate;
+        float m_bytes_received_rate, m_packets_received_rate;
+
+        Traffic() { memset(this, 0, sizeof(Traffic)); }
+        void updateRates(float dt);
+    };   // Traffic
+
+    // ------------------------------------------------------------------------
+    /** Traffic and round trip time information of one peer. */
+    struct PeerStats
+    {
+        Traffic  m_traffic;
+
+        /** Number of round trip time samples in each histogram bucket. */
+        unsigned int m_rtt_histogram[NUM_RTT_BUCKETS];
+
+        /** Last sampled round trip time in ms. */
+        uint32_t m_rtt;
+
+        /** Last sampled packet loss as a fraction. */
+        float    m_packet_loss;
+
+        /** False once the peer is disconnected. */
+        bool     m_connected;
+
+        PeerStats()
+        {
+            memset(m_rtt_histogram, 0, sizeof(m_rtt_histogram));
+            m_rtt         = 0;
+            m_packet_loss = 0.0f;
+            m_connected   = true;
+        }
+    };   // PeerStats
+
+    /** Traffic per protocol type (without the synchronous flag). */
+    std::map<int, Traffic> m_protocol_traffic;
+
+    /** Statistics for each peer, indexed by the key returned by getKey. */
+    std::map<uint64_t, PeerStats> m_peer_stats;
+
+    /** Protects all statistics and the CSV file. */
+    pthread_mutex_t m_mutex;
+
+    /** Time the last sample was taken. */
+    double m_last_sample_time;
+
+    /** Time the statistics were started or reset. */
+    double m_start_time;
+
+    /** If not NULL each sample is written to this CSV file. */
+    FILE *m_csv_file;
+
+    static uint64_t getKey(const TransportAddress &address);
+    static std::string keyToString(uint64_t key);
+    void writeCSV(double now);
+
+public:
+    /** Time between two samples in seconds. */
+    static const float STATS_INTERVAL;
+
+    static unsigned int getRTTBucket(uint32_t rtt);
+    static std::string getRTTBucketName(unsigned int bucket);
+
+             NetworkStats();
+            ~NetworkStats();
+    void     addSent(const TransportAddress &address, int protocol,
+                     unsigned int bytes);
+    void     addReceived(const TransportAddress &address, int protocol,
+                         unsigned int bytes);
+    void     update(ENetHost *host);
+    void     reset();
+    bool     startCSV(const std::string &filename);
+    void     stopCSV();
+    std::string getStatisticsString();
+};   // NetworkStats
+
+#endif
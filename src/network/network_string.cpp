@@ -22,6 +22,14 @@
 #include <algorithm>   // for std::min
 #include <iomanip>
 #include <ostream>
+#include <sstream>
+
+/** Maximum number of unused strings kept in the pool. */
+static const unsigned int MAX_POOL_SIZE = 256;
+
+Synchronised<std::vector<NetworkString*> > NetworkString::m_pool;
+unsigned int NetworkString::m_num_allocations = 0;
+unsigned int NetworkString::m_num_reuses      = 0;
 
 // ============================================================================
 /** Unit testing function.
@@ -66,8 +74,144 @@ void NetworkString::unitTesting()
     std::string log = slog.getLogMessage();
     assert(log=="0x000 | 00 01 02 03 04 05 06 07  08 09 0a 0b 0c 0d 0e 0f   | ................\n"
                 "0x010 | 10 11 12 13 14 15 16 17  18 19 1a 1b               | ............\n");
+
+    // Check that dropped strings are reused without a new allocation
+    NetworkString *p1 = NetworkString::create(PROTOCOL_KART_UPDATE, 4);
+    p1->addUInt32(0xdeadbeef);
+    p1->grab();
+    p1->drop();   // Still referenced once
+    p1->drop();   // Now back in the pool
+    unsigned int allocations = m_num_allocations;
+    const uint8_t data[] = { PROTOCOL_LOBBY_ROOM, 0, 0, 0, 0, 42 };
+    NetworkString *p2 = NetworkString::create(data, sizeof(data));
+    assert(p2 == p1);
+    assert(m_num_allocations == allocations);
+    (void)allocations;
+    assert(p2->getProtocolType() == PROTOCOL_LOBBY_ROOM);
+    assert(p2->size() == 1);
+    const uint8_t value = p2->getUInt8();
+    assert(value == 42);
+    (void)value;
+    p2->drop();
+    NetworkString *p3 = NetworkString::create(PROTOCOL_LOBBY_ROOM);
+    assert(p3 == p1 && p3->getTotalSize() == 5);
+    p3->drop();
 }   // unitTesting
 
+// ============================================================================
+/** Returns an unused string from the pool, or allocates a new one. The
+ *  returned string is empty and has a reference count of 1.
+ */
+NetworkString* NetworkString::getFromPool()
+{
+    NetworkString *ns = NULL;
+    m_pool.lock();
+    if (m_pool.getData().empty())
+    {
+        m_num_allocations++;
+    }
+    else
+    {
+        ns = m_pool.getData().back();
+        m_pool.getData().pop_back();
+        m_num_reuses++;
+    }
+    m_pool.unlock();
+
+    if (!ns)
+        return new NetworkString(PROTOCOL_NONE);
+    ns->m_reference_count = 1;
+    ns->m_current_offset  = 0;
+    ns->m_buffer.clear();
+    return ns;
+}   // getFromPool
+
+// ----------------------------------------------------------------------------
+/** Returns a network string for a message to be sent, taken from the pool
+ *  of unused strings if possible. It must be released using drop().
+ *  \param type The protocol type of the message.
+ *  \param capacity Expected size of the message (without type and token).
+ */
+NetworkString* NetworkString::create(ProtocolType type, int capacity)
+{
+    NetworkString *ns = getFromPool();
+    ns->m_buffer.reserve(capacity+5);
+    ns->m_buffer.push_back(type);
+    ns->addUInt32(0);   // add dummy token for now
+    return ns;
+}   // create
+
+// ----------------------------------------------------------------------------
+/** Returns a network string with a copy of a received message, taken from
+ *  the pool of unused strings if possible. It must be released using drop().
+ *  \param data The received data.
+ *  \param len Number of bytes.
+ */
+NetworkString* NetworkString::create(const uint8_t *data, int len)
+{
+    NetworkString *ns = getFromPool();
+    ns->m_buffer.assign(data, data+len);
+    ns->m_current_offset = 5;   // ignore type and token
+    return ns;
+}   // create
+
+// ----------------------------------------------------------------------------
+/** Increases the reference count of this string. */
+void NetworkString::grab()
+{
+    m_pool.lock();
+    m_reference_count++;
+    m_pool.unlock();
+}   // grab
+
+// ----------------------------------------------------------------------------
+/** Decreases the reference count of this string. If it is not referenced
+ *  anymore, it is returned to the pool (or deleted if the pool is full).
+ */
+void NetworkString::drop()
+{
+    m_pool.lock();
+    m_reference_count--;
+    assert(m_reference_count >= 0);
+    if (m_reference_count > 0)
+    {
+        m_pool.unlock();
+        return;
+    }
+    if (m_pool.getData().size() < MAX_POOL_SIZE)
+    {
+        m_pool.getData().push_back(this);
+        m_pool.unlock();
+        return;
+    }
+    m_pool.unlock();
+    delete this;
+}   // drop
+
+// ----------------------------------------------------------------------------
+/** Frees all strings in the pool. */
+void NetworkString::destroyPool()
+{
+    m_pool.lock();
+    for (unsigned int i = 0; i < m_pool.getData().size(); i++)
+        delete m_pool.getData()[i];
+    m_pool.getData().clear();
+    m_pool.unlock();
+}   // destroyPool
+
+// ----------------------------------------------------------------------------
+/** Returns a string with the number of allocated and reused strings. */
+std::string NetworkString::getPoolStatistics()
+{
+    std::ostringstream out;
+    m_pool.lock();
+    out << "NetworkString: " << m_num_allocations << " allocated, "
+        << m_num_reuses << " reused, " << m_pool.getData().size()
+        << " in pool";
+    m_pool.unlock();
+    return out.str();
+}   // getPoolStatistics
+
 // ============================================================================
 
 // ----------------------------------------------------------------------------
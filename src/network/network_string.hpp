@@ -25,6 +25,7 @@
 
 #include "network/protocol.hpp"
 #include "utils/leak_check.hpp"
+#include "utils/synchronised.hpp"
 #include "utils/types.hpp"
 #include "utils/vec3.hpp"
 
@@ -321,15 +322,31 @@ public:
  */
 class NetworkString : public BareNetworkString
 {
-public:
-    static void unitTesting();
-        
+private:
+    /** Reference count. When it drops to 0, the string is returned to the
+     *  pool of unused strings. Protected by the lock of m_pool. */
+    int m_reference_count;
+
+    /** Unused network strings. Their buffers keep their capacity, so
+     *  reusing them does not need any memory allocation. */
+    static Synchronised<std::vector<NetworkString*> > m_pool;
+
+    /** Number of strings allocated by create(), protected by m_pool. */
+    static unsigned int m_num_allocations;
+
+    /** Number of strings reused from the pool, protected by m_pool. */
+    static unsigned int m_num_reuses;
+
+    static NetworkString* getFromPool();
+
+    // ------------------------------------------------------------------------
     /** Constructor for a message to be sent. It sets the 
      *  protocol type of this message. It adds 5 bytes to the capacity: 
      *  1 byte for the protocol type, and 4 bytes for the token. */
     NetworkString(ProtocolType type,  int capacity=16)
         : BareNetworkString(capacity+5)
     {
+        m_reference_count = 1;
         m_buffer.push_back(type);
         addUInt32(0);   // add dummy token for now
     }   // NetworkString
@@ -341,9 +358,24 @@ public:
     NetworkString(const uint8_t *data, int len) 
         : BareNetworkString((char*)data, len)
     {
-        m_current_offset = 5;   // ignore type and token
+        m_reference_count = 1;
+        m_current_offset  = 5;   // ignore type and token
     }   // NetworkString
 
+    // ------------------------------------------------------------------------
+    /** Strings are shared by reference counting, so they can only be freed
+     *  by drop() (or destroyPool()), never deleted by their users. */
+    ~NetworkString() {}
+
+public:
+    static void unitTesting();
+    static NetworkString* create(ProtocolType type, int capacity=16);
+    static NetworkString* create(const uint8_t *data, int len);
+    static void destroyPool();
+    static std::string getPoolStatistics();
+    void grab();
+    void drop();
+
     // ------------------------------------------------------------------------
     /** Returns the protocol type of this message. */
     ProtocolType getProtocolType() const
@@ -50,12 +50,14 @@ Protocol::~Protocol()
 }   // ~Protocol
 
 // ----------------------------------------------------------------------------
-/** Returns a network string with the given type.
+/** Returns a network string with the given type. The string is taken from
+ *  a pool of unused strings, and must be released using drop() so that it
+ *  can be reused.
  *  \capacity Default preallocated size for the message.
  */
 NetworkString* Protocol::getNetworkString(int capacity)
 {
-    return new NetworkString(m_type, capacity);
+    return NetworkString::create(m_type, capacity);
 }   // getNetworkString
 
 // ----------------------------------------------------------------------------
@@ -29,12 +29,16 @@
 #include <assert.h>
 #include <cstdlib>
 #include <errno.h>
+#include <sstream>
 #include <typeinfo>
 
 
 ProtocolManager::ProtocolManager()
 {
     pthread_mutex_init(&m_asynchronous_protocols_mutex, NULL);
+    pthread_mutex_init(&m_wake_up_mutex, NULL);
+    pthread_cond_init(&m_wake_up_cond, NULL);
+    m_wake_up = false;
     m_exit.setAtomic(false);
     m_next_protocol_id.setAtomic(0);
 
@@ -53,7 +57,19 @@ void* ProtocolManager::mainLoop(void* data)
     while(manager && !manager->m_exit.getAtomic())
     {
         manager->asynchronousUpdate();
-        StkTime::sleep(2);
+
+        // Wait till new events or requests are queued, but update the
+        // protocols at least every 2 ms.
+        pthread_mutex_lock(&manager->m_wake_up_mutex);
+        if (!manager->m_wake_up)
+        {
+            struct timespec timeout;
+            StkTime::getTimeout(2, &timeout);
+            pthread_cond_timedwait(&manager->m_wake_up_cond,
+                                   &manager->m_wake_up_mutex, &timeout);
+        }
+        manager->m_wake_up = false;
+        pthread_mutex_unlock(&manager->m_wake_up_mutex);
     }
     return NULL;
 }   // protocolManagerAsynchronousUpdate
@@ -70,6 +86,7 @@ ProtocolManager::~ProtocolManager()
 void ProtocolManager::abort()
 {
     m_exit.setAtomic(true);
+    wakeUpAsynchronousThread();
     pthread_mutex_lock(&m_asynchronous_protocols_mutex);
 
     m_protocols.lock();
@@ -78,13 +95,12 @@ void ProtocolManager::abort()
     m_protocols.getData().clear();
     m_protocols.unlock();
 
-    m_events_to_process.lock();
-    for (unsigned int i = 0; i < m_events_to_process.getData().size() ; i++)
-        delete m_events_to_process.getData()[i];
-    m_events_to_process.getData().clear();
-    m_events_to_process.unlock();
-    
-    
+    deleteEvents(&m_sync_events);
+    deleteEvents(&m_async_events);
+    m_pending_messages.lock();
+    m_pending_messages.getData().clear();
+    m_pending_messages.unlock();
+
     m_requests.lock();
     m_requests.getData().clear();
     m_requests.unlock();
@@ -93,8 +109,39 @@ void ProtocolManager::abort()
 
     pthread_mutex_destroy(&m_asynchronous_protocols_mutex);
     pthread_join(*m_asynchronous_update_thread, NULL); // wait the thread to finish
+    pthread_cond_destroy(&m_wake_up_cond);
+    pthread_mutex_destroy(&m_wake_up_mutex);
 }   // abort
 
+// ----------------------------------------------------------------------------
+/** Deletes all events in the given queues.
+ *  \param events The queues to clear.
+ */
+void ProtocolManager::deleteEvents(Synchronised<EventQueues> *events)
+{
+    events->lock();
+    EventQueues &queues = events->getData();
+    for (EventQueues::iterator i = queues.begin(); i != queues.end(); i++)
+    {
+        for (unsigned int j = 0; j < i->second.size(); j++)
+            delete i->second[j].m_event;
+    }
+    queues.clear();
+    events->unlock();
+}   // deleteEvents
+
+// ----------------------------------------------------------------------------
+/** Wakes up the asynchronous thread, e.g. because a new event or request
+ *  was queued.
+ */
+void ProtocolManager::wakeUpAsynchronousThread()
+{
+    pthread_mutex_lock(&m_wake_up_mutex);
+    m_wake_up = true;
+    pthread_cond_signal(&m_wake_up_cond);
+    pthread_mutex_unlock(&m_wake_up_mutex);
+}   // wakeUpAsynchronousThread
+
 // ----------------------------------------------------------------------------
 /** \brief Function that processes incoming events.
  *  This function is called by the network manager each time there is an
@@ -102,12 +149,47 @@ void ProtocolManager::abort()
  */
 void ProtocolManager::propagateEvent(Event* event)
 {
-    m_events_to_process.lock();
-    m_events_to_process.getData().push_back(event); 
-    m_events_to_process.unlock();
-    return;
+    QueuedEvent queued;
+    queued.m_event      = event;
+    queued.m_queue_time = StkTime::getRealTime();
+    int key = event->getType()==EVENT_TYPE_CONNECTED ? CONNECT_EVENTS
+                                                      : DISCONNECT_EVENTS;
+    if (event->getType() == EVENT_TYPE_MESSAGE)
+    {
+        key = event->data().getProtocolType();
+        m_pending_messages.lock();
+        m_pending_messages.getData()[event->getPeer()]++;
+        m_pending_messages.unlock();
+    }
+
+    if (event->isSynchronous())
+    {
+        m_sync_events.lock();
+        m_sync_events.getData()[key].push_back(queued);
+        m_sync_events.unlock();
+    }
+    else
+    {
+        m_async_events.lock();
+        m_async_events.getData()[key].push_back(queued);
+        m_async_events.unlock();
+        wakeUpAsynchronousThread();
+    }
 }   // propagateEvent
 
+// ----------------------------------------------------------------------------
+/** Adds a request to the queue of requests, and wakes up the asynchronous
+ *  thread which handles the requests.
+ *  \param request The request to add.
+ */
+void ProtocolManager::addRequest(const ProtocolRequest &request)
+{
+    m_requests.lock();
+    m_requests.getData().push_back(request);
+    m_requests.unlock();
+    wakeUpAsynchronousThread();
+}   // addRequest
+
 // ----------------------------------------------------------------------------
 /** \brief Asks the manager to start a protocol.
  * This function will store the request, and process it at a time it is
@@ -122,9 +204,7 @@ uint32_t ProtocolManager::requestStart(Protocol* protocol)
     // create the request
     ProtocolRequest req(PROTOCOL_REQUEST_START, protocol);
     // add it to the request stack
-    m_requests.lock();
-    m_requests.getData().push_back(req);
-    m_requests.unlock();
+    addRequest(req);
 
     return req.getProtocol()->getId();
 }   // requestStart
@@ -142,9 +222,7 @@ void ProtocolManager::requestPause(Protocol* protocol)
     // create the request
     ProtocolRequest req(PROTOCOL_REQUEST_PAUSE, protocol);
     // add it to the request stack
-    m_requests.lock();
-    m_requests.getData().push_back(req);
-    m_requests.unlock();
+    addRequest(req);
 }   // requestPause
 
 // ----------------------------------------------------------------------------
@@ -158,11 +236,9 @@ void ProtocolManager::requestUnpause(Protocol* protocol)
     if (!protocol)
         return;
     // create the request
-    ProtocolRequest req(PROTOCOL_REQUEST_UNPAUSE, protocol);;
+    ProtocolRequest req(PROTOCOL_REQUEST_UNPAUSE, protocol);
     // add it to the request stack
-    m_requests.lock();
-    m_requests.getData().push_back(req);
-    m_requests.unlock();
+    addRequest(req);
 }   // requestUnpause
 
 // ----------------------------------------------------------------------------
@@ -190,6 +266,7 @@ void ProtocolManager::requestTerminate(Protocol* protocol)
     }
     m_requests.getData().push_back(req);
     m_requests.unlock();
+    wakeUpAsynchronousThread();
 }   // requestTerminate
 
 // ----------------------------------------------------------------------------
@@ -269,9 +346,14 @@ void ProtocolManager::terminateProtocol(Protocol *protocol)
 }   // terminateProtocol
 
 // ----------------------------------------------------------------------------
-/** Sends the event to the corresponding protocol.
+/** Sends the event to the corresponding protocol. If the event was
+ *  delivered or is too old, it is deleted.
+ *  \param event The event to deliver.
+ *  \param queue_time The time the event was queued, used to collect
+ *         latency statistics.
+ *  \return True if the event was deleted.
  */
-bool ProtocolManager::sendEvent(Event* event)
+bool ProtocolManager::sendEvent(Event* event, double queue_time)
 {
     m_protocols.lock();
     int count=0;
@@ -302,6 +384,19 @@ bool ProtocolManager::sendEvent(Event* event)
 
     m_protocols.unlock();
 
+    if (count>0)
+    {
+        int key = event->getType()==EVENT_TYPE_CONNECTED ? CONNECT_EVENTS
+                                                          : DISCONNECT_EVENTS;
+        if (event->getType() == EVENT_TYPE_MESSAGE)
+        {
+            key = event->data().getProtocolType();
+            if (event->isSynchronous())
+                key |= PROTOCOL_SYNCHRONOUS;
+        }
+        addLatency(key, StkTime::getRealTime() - queue_time);
+    }
+
     if (count>0 || StkTime::getTimeSinceEpoch()-event->getArrivalTime()
                     >= TIME_TO_KEEP_EVENTS                                  )
     {
@@ -311,6 +406,62 @@ bool ProtocolManager::sendEvent(Event* event)
     return false;
 }   // sendEvent
 
+// ----------------------------------------------------------------------------
+/** Delivers all events in the given queues that can be delivered. Since all
+ *  events in one queue are for the same protocols, the events of a queue
+ *  are handled in order until one can not be delivered (yet). A
+ *  disconnection event is held back while messages from the same peer
+ *  are still queued.
+ *  \param events The queues to process.
+ */
+void ProtocolManager::processEvents(Synchronised<EventQueues> *events)
+{
+    events->lock();
+    EventQueues &queues = events->getData();
+    for (EventQueues::iterator i = queues.begin(); i != queues.end(); i++)
+    {
+        std::deque<QueuedEvent> &queue = i->second;
+        while (!queue.empty())
+        {
+            Event *event = queue.front().m_event;
+            const EVENT_TYPE type = event->getType();
+            STKPeer *peer = event->getPeer();
+            // The disconnected peer is deleted by the protocols, so older
+            // messages from it (in any queue) must be delivered first.
+            if (type == EVENT_TYPE_DISCONNECTED && hasPendingMessages(peer))
+                break;
+            if (!sendEvent(event, queue.front().m_queue_time))
+                break;
+            queue.pop_front();
+            if (type == EVENT_TYPE_MESSAGE)
+                removePendingMessage(peer);
+        }
+    }   // for i in queues
+    events->unlock();
+}   // processEvents
+
+// ----------------------------------------------------------------------------
+/** Returns true if messages from the given peer are still queued. */
+bool ProtocolManager::hasPendingMessages(STKPeer *peer)
+{
+    m_pending_messages.lock();
+    const bool pending = m_pending_messages.getData().count(peer) > 0;
+    m_pending_messages.unlock();
+    return pending;
+}   // hasPendingMessages
+
+// ----------------------------------------------------------------------------
+/** Notes that a message from the given peer was delivered or dropped. */
+void ProtocolManager::removePendingMessage(STKPeer *peer)
+{
+    m_pending_messages.lock();
+    std::map<STKPeer*, int>::iterator i =
+        m_pending_messages.getData().find(peer);
+    if (i != m_pending_messages.getData().end() && --i->second <= 0)
+        m_pending_messages.getData().erase(i);
+    m_pending_messages.unlock();
+}   // removePendingMessage
+
 // ----------------------------------------------------------------------------
 /** \brief Updates the manager.
  *
@@ -324,23 +475,7 @@ bool ProtocolManager::sendEvent(Event* event)
 void ProtocolManager::update(float dt)
 {
     // before updating, notify protocols that they have received events
-    m_events_to_process.lock();
-    int size = (int)m_events_to_process.getData().size();
-    int offset = 0;
-    for (int i = 0; i < size; i++)
-    {
-        // Don't handle asynchronous events here.
-        if(!m_events_to_process.getData()[i+offset]->isSynchronous()) continue;
-        bool result = sendEvent(m_events_to_process.getData()[i+offset]);
-        if (result)
-        {
-            m_events_to_process.getData()
-                               .erase(m_events_to_process.getData().begin()+(i+offset),
-                                      m_events_to_process.getData().begin()+(i+offset+1));
-            offset --;
-        }
-    }
-    m_events_to_process.unlock();
+    processEvents(&m_sync_events);
     // now update all protocols
     m_protocols.lock();
     for (unsigned int i = 0; i < m_protocols.getData().size(); i++)
@@ -363,23 +498,7 @@ void ProtocolManager::update(float dt)
 void ProtocolManager::asynchronousUpdate()
 {
     // before updating, notice protocols that they have received information
-    m_events_to_process.lock();
-    int size = (int)m_events_to_process.getData().size();
-    int offset = 0;
-    for (int i = 0; i < size; i++)
-    {
-        // Don't handle synchronous events here.
-        if(m_events_to_process.getData()[i+offset]->isSynchronous()) continue;
-        bool result = sendEvent(m_events_to_process.getData()[i+offset]);
-        if (result)
-        {
-            m_events_to_process.getData()
-                               .erase(m_events_to_process.getData().begin()+(i+offset),
-                                      m_events_to_process.getData().begin()+(i+offset+1));
-            offset --;
-        }
-    }
-    m_events_to_process.unlock();
+    processEvents(&m_async_events);
 
     // now update all protocols that need to be updated in asynchronous mode
     pthread_mutex_lock(&m_asynchronous_protocols_mutex);
@@ -470,4 +589,59 @@ uint32_t ProtocolManager::getNextProtocolId()
     return id;
 }   // getNextProtocolId
 
+// ----------------------------------------------------------------------------
+/** Adds the latency of one delivered event to the statistics.
+ *  \param key Protocol type of the event (plus PROTOCOL_SYNCHRONOUS for
+ *         synchronous events), or CONNECT_EVENTS or DISCONNECT_EVENTS.
+ *  \param latency Time between queueing and delivering the event.
+ */
+void ProtocolManager::addLatency(int key, double latency)
+{
+    m_event_latency.lock();
+    EventLatency &l = m_event_latency.getData()[key];
+    l.m_count++;
+    l.m_total += latency;
+    if (latency > l.m_max)
+        l.m_max = latency;
+    m_event_latency.unlock();
+}   // addLatency
 
+// ----------------------------------------------------------------------------
+/** Resets all event latency statistics.
+ */
+void ProtocolManager::resetEventLatencies()
+{
+    m_event_latency.lock();
+    m_event_latency.getData().clear();
+    m_event_latency.unlock();
+}   // resetEventLatencies
+
+// ----------------------------------------------------------------------------
+/** Returns a printable summary of the event latencies (time between an
+ *  event being queued and being delivered to a protocol) for each protocol
+ *  type.
+ */
+std::string ProtocolManager::getEventLatencyString()
+{
+    std::ostringstream out;
+    m_event_latency.lock();
+    const std::map<int, EventLatency> &all = m_event_latency.getData();
+    for (std::map<int, EventLatency>::const_iterator i = all.begin();
+         i != all.end(); i++)
+    {
+        const EventLatency &l = i->second;
+        if (i->first == CONNECT_EVENTS)
+            out << "connections    ";
+        else if (i->first == DISCONNECT_EVENTS)
+            out << "disconnections ";
+        else
+            out << "protocol 0x" << std::hex << (i->first & ~PROTOCOL_SYNCHRONOUS)
+                << std::dec
+                << ((i->first & PROTOCOL_SYNCHRONOUS) ? " sync  " : " async ");
+        out << l.m_count << " events, average "
+            << (l.m_count ? 1000.0*l.m_total/l.m_count : 0.0)
+            << " ms, max " << 1000.0*l.m_max << " ms\n";
+    }
+    m_event_latency.unlock();
+    return out.str();
+}   // getEventLatencyString
@@ -30,6 +30,9 @@
 #include "utils/synchronised.hpp"
 #include "utils/types.hpp"
 
+#include <deque>
+#include <map>
+#include <string>
 #include <vector>
 
 class Event;
@@ -101,9 +104,59 @@ private:
      *  state and their unique id. */
     Synchronised<std::vector<Protocol*> >m_protocols;
 
-    /** Contains the network events to pass asynchronously to protocols
-     *  (i.e. from the separate ProtocolManager thread). */
-    Synchronised<std::vector<Event*> > m_events_to_process;
+    /** Statistics about the time between queueing an event and
+     *  delivering it to a protocol. */
+    class EventLatency
+    {
+    public:
+        /** Number of delivered events. */
+        unsigned int m_count;
+        /** Sum of all latencies in seconds. */
+        double       m_total;
+        /** Maximum latency in seconds. */
+        double       m_max;
+        EventLatency() : m_count(0), m_total(0), m_max(0) {}
+    };   // EventLatency
+
+    /** An event waiting to be delivered, and the time it was queued. */
+    struct QueuedEvent
+    {
+        Event *m_event;
+        double m_queue_time;
+    };   // QueuedEvent
+
+    /** One queue of events per protocol type. All events in one queue are
+     *  delivered to the same protocols, so if the oldest event of a queue
+     *  can not be delivered yet, none of the others can. Connection and
+     *  disconnection events use the keys CONNECT_EVENTS and
+     *  DISCONNECT_EVENTS. They are kept in separate queues, since e.g. on
+     *  a server no protocol handles connection events, which would block
+     *  all disconnection events for TIME_TO_KEEP_EVENTS. */
+    typedef std::map<int, std::deque<QueuedEvent> > EventQueues;
+
+    /** Key used for connection events. */
+    static const int CONNECT_EVENTS = -2;
+
+    /** Key used for disconnection events. */
+    static const int DISCONNECT_EVENTS = -1;
+
+    /** The network events to be delivered in the main thread. */
+    Synchronised<EventQueues> m_sync_events;
+
+    /** The network events to pass asynchronously to protocols (i.e. from
+     *  the separate ProtocolManager thread). */
+    Synchronised<EventQueues> m_async_events;
+
+    /** Number of queued (sync and async) messages from each peer. The
+     *  protocols delete a peer when it disconnects, so a disconnection
+     *  event is only delivered once all messages from that peer that were
+     *  received before it have been delivered (or dropped). */
+    Synchronised<std::map<STKPeer*, int> > m_pending_messages;
+
+    /** Latency statistics, indexed by the protocol type (the synchronous
+     *  flag is added for synchronous events, connection events use
+     *  CONNECT_EVENTS and DISCONNECT_EVENTS). */
+    Synchronised<std::map<int, EventLatency> > m_event_latency;
 
     /** Contains the requests to start/pause etc... protocols. */
     Synchronised< std::vector<ProtocolRequest> > m_requests;
@@ -125,11 +178,29 @@ private:
     /*! Asynchronous update thread.*/
     pthread_t* m_asynchronous_update_thread;
 
+    /** Set when there is new work for the asynchronous thread, protected
+     *  by m_wake_up_mutex. */
+    bool m_wake_up;
+
+    /** Mutex for the condition variable m_wake_up_cond. */
+    pthread_mutex_t m_wake_up_mutex;
+
+    /** Used to wake up the asynchronous thread when events or requests
+     *  are queued. */
+    pthread_cond_t m_wake_up_cond;
+
                  ProtocolManager();
     virtual     ~ProtocolManager();
     static void* mainLoop(void *data);
     uint32_t     getNextProtocolId();
-    bool         sendEvent(Event* event);
+    bool         sendEvent(Event* event, double queue_time);
+    void         processEvents(Synchronised<EventQueues> *events);
+    bool         hasPendingMessages(STKPeer *peer);
+    void         removePendingMessage(STKPeer *peer);
+    void         deleteEvents(Synchronised<EventQueues> *events);
+    void         wakeUpAsynchronousThread();
+    void         addRequest(const ProtocolRequest &request);
+    void         addLatency(int key, double latency);
 
     virtual void startProtocol(Protocol *protocol);
     virtual void terminateProtocol(Protocol *protocol);
@@ -147,6 +218,8 @@ public:
     virtual void      update(float dt);
     virtual Protocol* getProtocol(uint32_t id);
     virtual Protocol* getProtocol(ProtocolType type);
+    void              resetEventLatencies();
+    std::string       getEventLatencyString();
 };   // class ProtocolManager
 
 #endif // PROTOCOL_MANAGER_HPP
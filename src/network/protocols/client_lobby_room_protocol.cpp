@@ -70,7 +70,7 @@ void ClientLobbyRoomProtocol::requestKartSelection(uint8_t player_id,
     request->addUInt8(LE_KART_SELECTION).addUInt8(player_id)
             .encodeString(kart_name);
     sendToServer(request, /*reliable*/ true);
-    delete request;
+    request->drop();
 }   // requestKartSelection
 
 //-----------------------------------------------------------------------------
@@ -86,7 +86,7 @@ void ClientLobbyRoomProtocol::voteMajor(uint8_t player_id, uint32_t major)
     request->addUInt8(LE_VOTE_MAJOR).addUInt8(player_id)
            .addUInt32(major);
     sendToServer(request, true);
-    delete request;
+    request->drop();
 }   // voteMajor
 
 //-----------------------------------------------------------------------------
@@ -101,7 +101,7 @@ void ClientLobbyRoomProtocol::voteRaceCount(uint8_t player_id, uint8_t count)
     NetworkString *request = getNetworkString(3);
     request->addUInt8(LE_VOTE_RACE_COUNT).addUInt8(player_id).addUInt8(count);
     sendToServer(request, true);
-    delete request;
+    request->drop();
 }   // voteRaceCount
 
 //-----------------------------------------------------------------------------
@@ -116,7 +116,7 @@ void ClientLobbyRoomProtocol::voteMinor(uint8_t player_id, uint32_t minor)
     NetworkString *request = getNetworkString(6);
     request->addUInt8(LE_VOTE_MINOR).addUInt8(player_id).addUInt32(minor);
     sendToServer(request, true);
-    delete request;
+    request->drop();
 }   // voteMinor
 
 //-----------------------------------------------------------------------------
@@ -135,7 +135,7 @@ void ClientLobbyRoomProtocol::voteTrack(uint8_t player_id,
     request->addUInt8(LE_VOTE_TRACK).addUInt8(player_id).addUInt8(track_nb)
             .encodeString(track);
     sendToServer(request, true);
-    delete request;
+    request->drop();
 }   // voteTrack
 
 //-----------------------------------------------------------------------------
@@ -154,7 +154,7 @@ void ClientLobbyRoomProtocol::voteReversed(uint8_t player_id, bool reversed,
     request->addUInt8(LE_VOTE_REVERSE).addUInt8(player_id).addUInt8(reversed)
             .addUInt8(track_nb);
     sendToServer(request, true);
-    delete request;
+    request->drop();
 }   // voteReversed
 
 //-----------------------------------------------------------------------------
@@ -171,7 +171,7 @@ void ClientLobbyRoomProtocol::voteLaps(uint8_t player_id, uint8_t laps,
     request->addUInt8(LE_VOTE_LAPS).addUInt8(player_id).addUInt8(laps)
             .addUInt8(track_nb);
     sendToServer(request, true);
-    delete request;
+    request->drop();
 }   // voteLaps
 
 //-----------------------------------------------------------------------------
@@ -195,7 +195,7 @@ void ClientLobbyRoomProtocol::doneWithResults()
     NetworkString *done = getNetworkString(1);
     done->addUInt8(LE_RACE_FINISHED_ACK);
     sendToServer(done, /*reliable*/true);
-    delete done;
+    done->drop();
 }   // doneWithResults
 
 //-----------------------------------------------------------------------------
@@ -295,7 +295,7 @@ void ClientLobbyRoomProtocol::update(float dt)
         ns->addUInt8(LE_CONNECTION_REQUESTED).encodeString(name)
           .encodeString(NetworkConfig::get()->getPassword());
         sendToServer(ns);
-        delete ns;
+        ns->drop();
         m_state = REQUESTING_CONNECTION;
     }
     break;
@@ -30,11 +30,14 @@
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
 
+const float ControllerEventsProtocol::SEND_INTERVAL = 1.0f/30.0f;
+
 //-----------------------------------------------------------------------------
 
 ControllerEventsProtocol::ControllerEventsProtocol()
                         : Protocol( PROTOCOL_CONTROLLER_EVENTS)
 {
+    m_time_since_send = 0.0f;
 }   // ControllerEventsProtocol
 
 //-----------------------------------------------------------------------------
@@ -44,49 +47,114 @@ ControllerEventsProtocol::~ControllerEventsProtocol()
 }   // ~ControllerEventsProtocol
 
 //-----------------------------------------------------------------------------
+/** Returns true if sequence number a is newer than b, taking wrap-around
+ *  into account. */
+bool ControllerEventsProtocol::isNewer(uint16_t a, uint16_t b)
+{
+    return a!=b && (uint16_t)(a-b) < 0x8000;
+}   // isNewer
+
+//-----------------------------------------------------------------------------
+/** Compresses the boolean kart controls and the skid state of a controller
+ *  into one byte.
+ *  \param controller The controller whose controls are compressed.
+ */
+uint8_t ControllerEventsProtocol::compressControls(Controller *controller)
+{
+    KartControl* controls = controller->getControls();
+    uint8_t serialized_1 = 0;
+    serialized_1 |= (controls->m_brake==true);
+    serialized_1 <<= 1;
+    serialized_1 |= (controls->m_nitro==true);
+    serialized_1 <<= 1;
+    serialized_1 |= (controls->m_rescue==true);
+    serialized_1 <<= 1;
+    serialized_1 |= (controls->m_fire==true);
+    serialized_1 <<= 1;
+    serialized_1 |= (controls->m_look_back==true);
+    serialized_1 <<= 2;
+    serialized_1 += controls->m_skid;
+    return serialized_1;
+}   // compressControls
 
+//-----------------------------------------------------------------------------
+/** Receives the actions of one or more karts. The message contains for each
+ *  kart: the kart id, the compressed controls after the last action, the
+ *  number of actions, and for each action its sequence number, the action
+ *  and its value. Only actions newer than the last executed one are
+ *  executed (in order); all others were already received in an earlier
+ *  message. The server forwards messages with new actions to all other
+ *  clients.
+ *  \param event The event with the message.
+ */
 bool ControllerEventsProtocol::notifyEventAsynchronous(Event* event)
 {
-    if(!checkDataSize(event, 13)) return true;
+    if(!checkDataSize(event, 7)) return true;
 
     NetworkString &data = event->data();
-    float time = data.getFloat();
+    data.getFloat();   // time, currently unused
 
-    uint8_t client_index = -1;
-    while (data.size() >= 9)
+    bool has_new_actions = false;
+    while (data.size() >= 3)
     {
-        uint8_t kart_id = data.getUInt8();
-        if (kart_id >=World::getWorld()->getNumKarts())
+        uint8_t kart_id      = data.getUInt8();
+        uint8_t serialized_1 = data.getUInt8();
+        uint8_t num_actions  = data.getUInt8();
+        if (data.size() < num_actions*7)
+            break;
+        if (kart_id >= World::getWorld()->getNumKarts())
         {
-            Log::warn("ControllerEventProtocol", "No valid kart id (%s).",
+            Log::warn("ControllerEventProtocol", "No valid kart id (%d).",
                       kart_id);
+            data.skip(num_actions*7);
             continue;
         }
-        uint8_t serialized_1   = data.getUInt8();
-        uint8_t serialized_2   = data.getUInt8();
-        uint8_t serialized_3   = data.getUInt8();
-        PlayerAction action    = (PlayerAction)(data.getUInt8());
-        int action_value       = data.getUInt32();
-        Log::info("ControllerEventsProtocol", "KartID %d action %d value %d",
-                  kart_id, action, action_value);
+
         Controller *controller = World::getWorld()->getKart(kart_id)
                                                   ->getController();
-        KartControl *controls  = controller->getControls();
-        controls->m_brake      = (serialized_1 & 0x40)!=0;
-        controls->m_nitro      = (serialized_1 & 0x20)!=0;
-        controls->m_rescue     = (serialized_1 & 0x10)!=0;
-        controls->m_fire       = (serialized_1 & 0x08)!=0;
-        controls->m_look_back  = (serialized_1 & 0x04)!=0;
-        controls->m_skid       = KartControl::SkidControl(serialized_1 & 0x03);
-
-        controller->action(action, action_value);
-    }
+        std::map<int, uint16_t>::iterator last = m_last_sequence.find(kart_id);
+        bool kart_changed = false;
+        for (unsigned int i = 0; i < num_actions; i++)
+        {
+            uint16_t sequence   = data.getUInt16();
+            PlayerAction action = (PlayerAction)(data.getUInt8());
+            int action_value    = data.getUInt32();
+            if (last != m_last_sequence.end() &&
+                !isNewer(sequence, last->second))
+                continue;
+            if (last != m_last_sequence.end() &&
+                (uint16_t)(sequence - last->second) > 1)
+            {
+                Log::verbose("ControllerEventsProtocol",
+                             "Kart %d lost %d actions.", kart_id,
+                             (uint16_t)(sequence - last->second) - 1);
+            }
+            controller->action(action, action_value);
+            m_last_sequence[kart_id] = sequence;
+            last = m_last_sequence.find(kart_id);
+            kart_changed = true;
+        }   // for i < num_actions
+
+        if (kart_changed)
+        {
+            // The compressed controls are the state after the last action
+            KartControl *controls  = controller->getControls();
+            controls->m_brake      = (serialized_1 & 0x40)!=0;
+            controls->m_nitro      = (serialized_1 & 0x20)!=0;
+            controls->m_rescue     = (serialized_1 & 0x10)!=0;
+            controls->m_fire       = (serialized_1 & 0x08)!=0;
+            controls->m_look_back  = (serialized_1 & 0x04)!=0;
+            controls->m_skid       = KartControl::SkidControl(serialized_1 & 0x03);
+            has_new_actions = true;
+        }
+    }   // while data.size()>=3
+
     if (data.size() > 0 )
     {
         Log::warn("ControllerEventProtocol",
                   "The data seems corrupted. Remains %d", data.size());
     }
-    if (NetworkConfig::get()->isServer())
+    if (NetworkConfig::get()->isServer() && has_new_actions)
     {
         // Send update to all clients except the original sender.
         STKHost::get()->sendPacketExcept(event->getPeer(), 
@@ -97,8 +165,8 @@ bool ControllerEventsProtocol::notifyEventAsynchronous(Event* event)
 
 //-----------------------------------------------------------------------------
 /** Called from the local kart controller when an action (like steering,
- *  acceleration, ...) was triggered. It compresses the current kart control
- *  state and sends a message with the new info to the server.
+ *  acceleration, ...) was triggered. The action is only recorded, it will
+ *  be sent to the server with the next input message in update().
  *  \param controller The controller that triggered the action.
  *  \param action Which action was triggered.
  *  \param value New value for the given action.
@@ -108,29 +176,70 @@ void ControllerEventsProtocol::controllerAction(Controller* controller,
 {
     assert(!NetworkConfig::get()->isServer());
 
-    KartControl* controls = controller->getControls();
-    uint8_t serialized_1 = 0;
-    serialized_1 |= (controls->m_brake==true);
-    serialized_1 <<= 1;
-    serialized_1 |= (controls->m_nitro==true);
-    serialized_1 <<= 1;
-    serialized_1 |= (controls->m_rescue==true);
-    serialized_1 <<= 1;
-    serialized_1 |= (controls->m_fire==true);
-    serialized_1 <<= 1;
-    serialized_1 |= (controls->m_look_back==true);
-    serialized_1 <<= 2;
-    serialized_1 += controls->m_skid;
-    uint8_t serialized_2 = (uint8_t)(controls->m_accel*255.0);
-    uint8_t serialized_3 = (uint8_t)(controls->m_steer*127.0);
-
-    NetworkString *ns = getNetworkString(13);
-    ns->addFloat(World::getWorld()->getTime());
-    ns->addUInt8(controller->getKart()->getWorldKartId());
-    ns->addUInt8(serialized_1).addUInt8(serialized_2).addUInt8(serialized_3);
-    ns->addUInt8((uint8_t)(action)).addUInt32(value);
-    sendToServer(ns, false); // send message to server
-    delete ns;
-
-    Log::info("ControllerEventsProtocol", "Action %d value %d", action, value);
+    int kart_id = controller->getKart()->getWorldKartId();
+    std::map<int, LocalKartInput>::iterator i = m_local_input.find(kart_id);
+    if (i == m_local_input.end())
+    {
+        LocalKartInput input;
+        input.m_next_sequence = 0;
+        i = m_local_input.insert(std::make_pair(kart_id, input)).first;
+    }
+    LocalKartInput &input = i->second;
+    input.m_controller = controller;
+
+    ActionRecord record;
+    record.m_sequence = input.m_next_sequence++;
+    record.m_action   = action;
+    record.m_value    = value;
+    input.m_actions.push_back(record);
+    if (input.m_actions.size() > MAX_ACTIONS)
+        input.m_actions.pop_front();
+    input.m_num_sends = NUM_RESENDS + 1;
 }   // controllerAction
+
+//-----------------------------------------------------------------------------
+/** Called once per frame on the main thread. On a client it sends at most
+ *  once per SEND_INTERVAL one message with the recent actions of all local
+ *  karts that have changed recently.
+ *  \param dt Time step size.
+ */
+void ControllerEventsProtocol::update(float dt)
+{
+    if (NetworkConfig::get()->isServer() || m_local_input.empty())
+        return;
+
+    m_time_since_send += dt;
+    if (m_time_since_send < SEND_INTERVAL)
+        return;
+
+    NetworkString *ns = NULL;
+    for (std::map<int, LocalKartInput>::iterator i = m_local_input.begin();
+         i != m_local_input.end(); i++)
+    {
+        LocalKartInput &input = i->second;
+        if (input.m_num_sends == 0)
+            continue;
+        input.m_num_sends--;
+        if (!ns)
+        {
+            ns = getNetworkString(4 + 3 + 7*MAX_ACTIONS);
+            ns->addFloat(World::getWorld()->getTime());
+        }
+        ns->addUInt8(i->first)
+           .addUInt8(compressControls(input.m_controller))
+           .addUInt8((uint8_t)input.m_actions.size());
+        for (unsigned int j = 0; j < input.m_actions.size(); j++)
+        {
+            const ActionRecord &r = input.m_actions[j];
+            ns->addUInt16(r.m_sequence).addUInt8((uint8_t)r.m_action)
+               .addUInt32(r.m_value);
+        }
+    }   // for i in m_local_input
+
+    if (ns)
+    {
+        sendToServer(ns, false); // send message to server
+        ns->drop();
+        m_time_since_send = 0.0f;
+    }
+}   // update
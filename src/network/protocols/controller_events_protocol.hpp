@@ -24,18 +24,80 @@
 #include "input/input.hpp"
 #include "utils/cpp2011.hpp"
 
+#include <deque>
+#include <map>
+
 class Controller;
 class STKPeer;
 
+/** \class ControllerEventsProtocol
+ *  \brief Transfers the actions of the local players to the server, which
+ *  forwards them to all other clients. Actions are not sent immediately,
+ *  they are collected and sent once per network tick (SEND_INTERVAL) in a
+ *  single unreliable message for all local karts. Each action gets a
+ *  sequence number, and each message contains the last MAX_ACTIONS actions
+ *  of a kart, so a lost message is recovered by the next one. The receiver
+ *  only executes actions with a sequence number newer than the last one it
+ *  executed for that kart. After the last change a message is repeated
+ *  NUM_RESENDS times, so that the final state arrives even if the player
+ *  does not change any input afterwards.
+ */
 class ControllerEventsProtocol : public Protocol
 {
+private:
+    /** Maximum number of (most recent) actions sent per kart. */
+    static const unsigned int MAX_ACTIONS = 8;
+
+    /** Number of times a message is repeated after the last change. */
+    static const unsigned int NUM_RESENDS = 3;
+
+    /** Minimum time between two input messages. */
+    static const float SEND_INTERVAL;
+
+    /** One action of a player with its sequence number. */
+    struct ActionRecord
+    {
+        uint16_t     m_sequence;
+        PlayerAction m_action;
+        int          m_value;
+    };   // ActionRecord
+
+    /** The recent actions of one local kart (client only). */
+    struct LocalKartInput
+    {
+        /** The controller of this kart. */
+        Controller *m_controller;
+
+        /** The last MAX_ACTIONS actions, oldest first. */
+        std::deque<ActionRecord> m_actions;
+
+        /** Sequence number for the next action. */
+        uint16_t m_next_sequence;
+
+        /** How often the current actions still need to be sent. */
+        unsigned int m_num_sends;
+    };   // LocalKartInput
+
+    /** Input of all local karts, indexed by world kart id. Only
+     *  accessed from the main thread. */
+    std::map<int, LocalKartInput> m_local_input;
+
+    /** Sequence number of the last executed action for each kart,
+     *  indexed by world kart id. Only accessed in notifyEventAsynchronous. */
+    std::map<int, uint16_t> m_last_sequence;
+
+    /** Time since the last input message was sent. */
+    float m_time_since_send;
+
+    static bool isNewer(uint16_t a, uint16_t b);
+    static uint8_t compressControls(Controller *controller);
 
 public:
              ControllerEventsProtocol();
     virtual ~ControllerEventsProtocol();
 
     virtual bool notifyEventAsynchronous(Event* event) OVERRIDE;
-    virtual void update(float dt) OVERRIDE {};
+    virtual void update(float dt) OVERRIDE;
     virtual void setup() OVERRIDE {};
     virtual void asynchronousUpdate() OVERRIDE {}
 
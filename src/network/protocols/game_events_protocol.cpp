@@ -87,7 +87,7 @@ void GameEventsProtocol::collectedItem(Item* item, AbstractKart* kart)
         ns->addUInt8(GE_ITEM_COLLECTED).addUInt32(item->getItemId())
            .addUInt8(powerup).addUInt8(kart->getWorldKartId());
         peers[i]->sendPacket(ns, /*reliable*/true);
-        delete ns;
+        ns->drop();
         Log::info("GameEventsProtocol",
                   "Notified a peer that a kart collected item %d.",
                   (int)(kart->getPowerup()->getType()));
@@ -127,7 +127,7 @@ void GameEventsProtocol::kartFinishedRace(AbstractKart *kart, float time)
     ns->addUInt8(GE_KART_FINISHED_RACE).addUInt8(kart->getWorldKartId())
        .addFloat(time);
     sendMessageToPeersChangingToken(ns, /*reliable*/true);
-    delete ns;
+    ns->drop();
 }   // kartFinishedRace
 
 // ----------------------------------------------------------------------------
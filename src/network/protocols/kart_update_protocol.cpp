@@ -1,23 +1,49 @@
 #include "network/protocols/kart_update_protocol.hpp"
 
+#include "config/user_config.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
 #include "modes/world.hpp"
 #include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/protocol_manager.hpp"
+#include "network/stk_host.hpp"
+#include "network/stk_peer.hpp"
+#include "tracks/track.hpp"
 #include "utils/time.hpp"
 
+#include <algorithm>
+
+const float KartUpdateProtocol::MAX_EXTRAPOLATION = 0.25f;
+
 KartUpdateProtocol::KartUpdateProtocol() : Protocol(PROTOCOL_KART_UPDATE)
 {
+    World *world = World::getWorld();
     // Allocate arrays to store one position and rotation for each kart
     // (which is the update information from the server to the client).
-    m_next_positions.resize(World::getWorld()->getNumKarts());
-    m_next_quaternions.resize(World::getWorld()->getNumKarts());
+    m_next_positions.resize(world->getNumKarts());
+    m_next_quaternions.resize(world->getNumKarts());
 
     // This flag keeps track if valid data for an update is in
     // the arrays
-    m_was_updated = false;
+    m_was_updated.resize(world->getNumKarts(), false);
+
+    // Positions are quantized relative to the track's bounding box. Add
+    // a margin, karts can be slightly outside (e.g. when jumping).
+    const Vec3 *min, *max;
+    world->getTrack()->getAABB(&min, &max);
+    const Vec3 margin(5.0f, 5.0f, 5.0f);
+    m_snapshot_min = *min - margin;
+    m_snapshot_max = *max + margin;
+
+    m_snapshots.resize(SNAPSHOT_HISTORY,
+                       KartSnapshot(world->getNumKarts(), m_snapshot_min,
+                                    m_snapshot_max));
+    m_sequence              = 0;
+    m_has_received_snapshot = false;
+    m_last_send_time        = 0;
+    m_transform_buffers.resize(world->getNumKarts());
+    m_time_offset           = 0;
 }   // KartUpdateProtocol
 
 // ----------------------------------------------------------------------------
@@ -30,35 +56,232 @@ void KartUpdateProtocol::setup()
 {
 }   // setup
 
+// ----------------------------------------------------------------------------
+/** Returns the time used to timestamp kart states. This is the world time,
+ *  negated for a count down clock so that it is always increasing.
+ */
+float KartUpdateProtocol::getNetworkTime()
+{
+    World *world = World::getWorld();
+    return world->getClockMode()==WorldStatus::CLOCK_COUNTDOWN
+         ? -world->getTime() : world->getTime();
+}   // getNetworkTime
+
+// ----------------------------------------------------------------------------
+/** Returns the stored snapshot with the given sequence number, or NULL if
+ *  this snapshot is not available (anymore).
+ *  \param sequence Sequence number of the snapshot.
+ */
+const KartSnapshot *KartUpdateProtocol::getSnapshot(uint16_t sequence) const
+{
+    const KartSnapshot &s = m_snapshots[sequence % SNAPSHOT_HISTORY];
+    return s.getSequence()==sequence ? &s : NULL;
+}   // getSnapshot
+
 // ----------------------------------------------------------------------------
 /** Store the update events in the queue. Since the events are handled in the
- *  synchronous notify function, there is no lock necessary to 
+ *  synchronous notify function, there is no lock necessary.
+ *  A message from the server contains the world time, the sequence number
+ *  of the snapshot and the sequence number of the baseline it is delta
+ *  encoded against (identical to the sequence number if no baseline is
+ *  used), followed by the snapshot. A message from a client contains the
+ *  world time, the last snapshot sequence number received from the server
+ *  (as acknowledgement), followed by a full snapshot of its local karts.
  */
 bool KartUpdateProtocol::notifyEvent(Event* event)
 {
     if (event->getType() != EVENT_TYPE_MESSAGE)
         return true;
     NetworkString &ns = event->data();
-    if (ns.size() < 33)
+    World *world = World::getWorld();
+    KartSnapshot snapshot(world->getNumKarts(), m_snapshot_min,
+                          m_snapshot_max);
+
+    if (NetworkConfig::get()->isServer())
     {
-        Log::info("KartUpdateProtocol", "Message too short.");
+        if (ns.size() < 7)
+        {
+            Log::info("KartUpdateProtocol", "Message too short.");
+            return true;
+        }
+        ns.getFloat();   // world time, currently unused
+        bool  has_ack     = ns.getUInt8()!=0;
+        uint16_t ack      = ns.getUInt16();
+        if (has_ack)
+        {
+            int host_id = event->getPeer()->getHostId();
+            std::map<int, uint16_t>::iterator i =
+                                               m_acked_sequence.find(host_id);
+            if (i == m_acked_sequence.end())
+                m_acked_sequence[host_id] = ack;
+            else if (KartSnapshot::isNewer(ack, i->second))
+                i->second = ack;
+        }
+        if (!snapshot.decode(ns, NULL))
+        {
+            Log::warn("KartUpdateProtocol", "Invalid snapshot received.");
+            return true;
+        }
+    }
+    else
+    {
+        if (ns.size() < 8)
+        {
+            Log::info("KartUpdateProtocol", "Message too short.");
+            return true;
+        }
+        float    time     = ns.getFloat();
+        uint16_t sequence = ns.getUInt16();
+        uint16_t baseline = ns.getUInt16();
+        // Discard outdated or duplicated snapshots
+        if (m_has_received_snapshot &&
+            !KartSnapshot::isNewer(sequence, m_sequence))
+            return true;
+        const KartSnapshot *base = NULL;
+        if (baseline != sequence)
+        {
+            base = m_has_received_snapshot ? getSnapshot(baseline) : NULL;
+            if (!base)
+            {
+                Log::verbose("KartUpdateProtocol",
+                             "Baseline %d not available, dropping %d.",
+                             baseline, sequence);
+                return true;
+            }
+        }
+        if (!snapshot.decode(ns, base))
+        {
+            Log::warn("KartUpdateProtocol", "Invalid snapshot received.");
+            return true;
+        }
+        snapshot.setSequence(sequence);
+        m_snapshots[sequence % SNAPSHOT_HISTORY] = snapshot;
+        // Smooth the estimate of the clock difference to the server,
+        // since the packets arrive with a varying delay.
+        const float offset = time - getNetworkTime();
+        if (m_has_received_snapshot)
+            m_time_offset += 0.1f*(offset - m_time_offset);
+        else
+            m_time_offset = offset;
+        m_sequence              = sequence;
+        m_has_received_snapshot = true;
+
+        for (unsigned int id = 0; id < snapshot.getNumKarts(); id++)
+        {
+            if (!snapshot.hasKart(id)) continue;
+            btTransform transform(snapshot.getRotation(id),
+                                  snapshot.getXYZ(id));
+            m_transform_buffers[id].add(time, transform);
+        }
         return true;
     }
-    float time = ns.getFloat();
-    while(ns.size() >= 29)
+
+    for (unsigned int id = 0; id < snapshot.getNumKarts(); id++)
     {
-        uint8_t kart_id             = ns.getUInt8();
-        Vec3 xyz                    = ns.getVec3();
-        btQuaternion quat           = ns.getQuat();
-        m_next_positions  [kart_id] = xyz;
-        m_next_quaternions[kart_id] = quat;
-    }   // while ns.size()>29
-
-    // Set the flag that a new update was received
-    m_was_updated = true;
+        if (!snapshot.hasKart(id)) continue;
+        m_next_positions  [id] = snapshot.getXYZ(id);
+        m_next_quaternions[id] = snapshot.getRotation(id);
+        // Set the flag that a new update was received
+        m_was_updated[id]      = true;
+    }
     return true;
 }   // notifyEvent
 
+// ----------------------------------------------------------------------------
+/** Sends the state of all karts to each client. The snapshot is delta
+ *  encoded against the latest snapshot acknowledged by that client, if
+ *  that snapshot is still stored; otherwise the full state is sent.
+ */
+void KartUpdateProtocol::sendServerUpdate()
+{
+    World *world = World::getWorld();
+    KartSnapshot &snapshot = m_snapshots[m_sequence % SNAPSHOT_HISTORY];
+    snapshot = KartSnapshot(world->getNumKarts(), m_snapshot_min,
+                            m_snapshot_max);
+    snapshot.setSequence(m_sequence);
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        AbstractKart* kart = world->getKart(i);
+        snapshot.setKart(kart->getWorldKartId(), kart->getXYZ(),
+                         kart->getRotation());
+    }
+
+    const std::vector<STKPeer*> &peers = STKHost::get()->getPeers();
+    for (unsigned int i = 0; i < peers.size(); i++)
+    {
+        const KartSnapshot *baseline = NULL;
+        std::map<int, uint16_t>::const_iterator ack =
+                                 m_acked_sequence.find(peers[i]->getHostId());
+        if (ack != m_acked_sequence.end() &&
+            (uint16_t)(m_sequence - ack->second) < SNAPSHOT_HISTORY)
+            baseline = getSnapshot(ack->second);
+
+        NetworkString *ns = getNetworkString(8 + world->getNumKarts()*11);
+        ns->setSynchronous(true);
+        ns->addFloat(getNetworkTime());
+        ns->addUInt16(m_sequence);
+        ns->addUInt16(baseline ? baseline->getSequence() : m_sequence);
+        snapshot.encode(ns, baseline);
+        peers[i]->sendPacket(ns, /*reliable*/false);
+        ns->drop();
+    }
+    m_sequence++;
+}   // sendServerUpdate
+
+// ----------------------------------------------------------------------------
+/** Sends the state of all local karts to the server, together with the
+ *  acknowledgement of the latest snapshot received.
+ */
+void KartUpdateProtocol::sendClientUpdate()
+{
+    World *world = World::getWorld();
+    KartSnapshot snapshot(world->getNumKarts(), m_snapshot_min,
+                          m_snapshot_max);
+    for (unsigned int i = 0; i < race_manager->getNumLocalPlayers(); i++)
+    {
+        AbstractKart *kart = world->getLocalPlayerKart(i);
+        snapshot.setKart(kart->getWorldKartId(), kart->getXYZ(),
+                         kart->getRotation());
+    }
+    NetworkString *ns =
+        getNetworkString(7 + world->getNumKarts()/8 + 1
+                         + 11*race_manager->getNumLocalPlayers());
+    ns->setSynchronous(true);
+    ns->addFloat(getNetworkTime());
+    ns->addUInt8(m_has_received_snapshot ? 1 : 0);
+    ns->addUInt16(m_sequence);
+    snapshot.encode(ns, NULL);
+    sendToServer(ns, /*reliable*/false);
+    ns->drop();
+}   // sendClientUpdate
+
+// ----------------------------------------------------------------------------
+/** Client: sets the transform of all remote karts to the transform at the
+ *  current server time minus the configured interpolation delay, which is
+ *  interpolated from the received kart states. This avoids the stutter
+ *  caused by the low update frequency and by varying network delays.
+ */
+void KartUpdateProtocol::applyInterpolatedTransforms()
+{
+    if (!m_has_received_snapshot)
+        return;
+    const float render_time = getNetworkTime() + m_time_offset
+                            - UserConfigParams::m_network_interpolation_delay;
+    World *world = World::getWorld();
+    for (unsigned int id = 0; id < m_transform_buffers.size(); id++)
+    {
+        AbstractKart *kart = world->getKart(id);
+        if (kart->getController()->isLocalPlayerController())
+            continue;
+        btTransform transform;
+        if (!m_transform_buffers[id].getTransform(render_time,
+                                                  MAX_EXTRAPOLATION,
+                                                  &transform))
+            continue;
+        kart->getBody()->setCenterOfMassTransform(transform);
+    }   // for id < num_karts
+}   // applyInterpolatedTransforms
+
 // ----------------------------------------------------------------------------
 /** Sends regular update events from the server to all clients and from the
  *  clients to the server (FIXME - is that actually necessary??)
@@ -71,73 +294,43 @@ void KartUpdateProtocol::update(float dt)
 {
     if (!World::getWorld())
         return;
-    static double time = 0;
     double current_time = StkTime::getRealTime();
-    if (current_time > time + 0.1) // 10 updates per second
+    int frequency = std::max((int)UserConfigParams::m_kart_update_frequency,
+                             1);
+    if (current_time > m_last_send_time + 1.0 / frequency)
     {
-        time = current_time;
+        m_last_send_time = current_time;
         if (NetworkConfig::get()->isServer())
-        {
-            World *world = World::getWorld();
-            NetworkString *ns = getNetworkString(4+world->getNumKarts()*29);
-            ns->setSynchronous(true);
-            ns->addFloat( world->getTime() );
-            for (unsigned int i = 0; i < world->getNumKarts(); i++)
-            {
-                AbstractKart* kart = world->getKart(i);
-                Vec3 xyz = kart->getXYZ();
-                ns->addUInt8( kart->getWorldKartId());
-                ns->add(xyz).add(kart->getRotation());
-                Log::verbose("KartUpdateProtocol",
-                             "Sending %d's positions %f %f %f",
-                             kart->getWorldKartId(), xyz[0], xyz[1], xyz[2]);
-            }
-            sendMessageToPeersChangingToken(ns, /*reliable*/false);
-            delete ns;
-        }
+            sendServerUpdate();
         else
-        {
-            NetworkString *ns =
-                     getNetworkString(4+29*race_manager->getNumLocalPlayers());
-            ns->setSynchronous(true);
-            ns->addFloat(World::getWorld()->getTime());
-            for(unsigned int i=0; i<race_manager->getNumLocalPlayers(); i++)
-            {
-                AbstractKart *kart = World::getWorld()->getLocalPlayerKart(i);
-                const Vec3 &xyz = kart->getXYZ();
-                ns->addUInt8(kart->getWorldKartId());
-                ns->add(xyz).add(kart->getRotation());
-                Log::verbose("KartUpdateProtocol",
-                             "Sending %d's positions %f %f %f",
-                              kart->getWorldKartId(), xyz[0], xyz[1], xyz[2]);
-            }
-            sendToServer(ns, /*reliable*/false);
-            delete ns;
-        }   // if server
-    }   // if (current_time > time + 0.1)
+            sendClientUpdate();
+    }   // if current_time > m_last_send_time + 1/frequency
 
 
+    if (!NetworkConfig::get()->isServer())
+    {
+        applyInterpolatedTransforms();
+        return;
+    }
+
     // Now handle all update events that have been received.
     // There is no lock necessary, since receiving new positions is done in
     // notifyEvent, which is called from the same thread that calls this
     // function.
-    if(m_was_updated)
+    for (unsigned id = 0; id < m_next_positions.size(); id++)
     {
-        for (unsigned id = 0; id < m_next_positions.size(); id++)
+        if (!m_was_updated[id]) continue;
+        AbstractKart *kart = World::getWorld()->getKart(id);
+        if (!kart->getController()->isLocalPlayerController())
         {
-            AbstractKart *kart = World::getWorld()->getKart(id);
-            if (!kart->getController()->isLocalPlayerController())
-            {
-                btTransform transform = kart->getBody()
-                                      ->getInterpolationWorldTransform();
-                transform.setOrigin(m_next_positions[id]);
-                transform.setRotation(m_next_quaternions[id]);
-                kart->getBody()->setCenterOfMassTransform(transform);
-                Log::verbose("KartUpdateProtocol", "Update kart %i pos",
-                             id);
-            }   // if not local player
-        }   // for id < num_karts
-        m_was_updated = false;  // mark that all updates were applied
-    }   // if m_was_updated
+            btTransform transform = kart->getBody()
+                                  ->getInterpolationWorldTransform();
+            transform.setOrigin(m_next_positions[id]);
+            transform.setRotation(m_next_quaternions[id]);
+            kart->getBody()->setCenterOfMassTransform(transform);
+            Log::verbose("KartUpdateProtocol", "Update kart %i pos",
+                         id);
+        }   // if not local player
+        m_was_updated[id] = false;  // mark that the update was applied
+    }   // for id < num_karts
 }   // update
-
@@ -1,12 +1,15 @@
 #ifndef KART_UPDATE_PROTOCOL_HPP
 #define KART_UPDATE_PROTOCOL_HPP
 
+#include "network/kart_snapshot.hpp"
 #include "network/protocol.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/transform_buffer.hpp"
 #include "utils/vec3.hpp"
 
 #include "LinearMath/btQuaternion.h"
 
+#include <map>
 #include <vector>
 #include "pthread.h"
 
@@ -15,6 +18,9 @@ class AbstractKart;
 class KartUpdateProtocol : public Protocol
 {
 private:
+    /** Number of snapshots that are kept (by the server to be used as
+     *  baseline for delta compression, by the client to decode them). */
+    static const unsigned int SNAPSHOT_HISTORY = 32;
 
     /** Stores the last updated position for a kart. */
     std::vector<Vec3> m_next_positions;
@@ -22,8 +28,47 @@ private:
     /** Stores the last updated rotation for a kart. */
     std::vector<btQuaternion> m_next_quaternions;
 
-    /** True if a new update for the kart positions was received. */
-    bool m_was_updated;
+    /** True for each kart for which a new update was received. */
+    std::vector<bool> m_was_updated;
+
+    /** The bounding box used to quantize kart positions. */
+    Vec3 m_snapshot_min, m_snapshot_max;
+
+    /** The last snapshots sent (server) or received (client), indexed by
+     *  sequence number modulo SNAPSHOT_HISTORY. */
+    std::vector<KartSnapshot> m_snapshots;
+
+    /** Server: sequence number of the next snapshot to send. Client:
+     *  sequence number of the latest snapshot received. */
+    uint16_t m_sequence;
+
+    /** Client: true once the first snapshot was received from the server. */
+    bool m_has_received_snapshot;
+
+    /** Client: the received transforms of each kart with the server time,
+     *  used to interpolate the remote karts. */
+    std::vector<TransformBuffer> m_transform_buffers;
+
+    /** Client: estimated difference between the server time and the local
+     *  time, used to determine which server time to display. */
+    float m_time_offset;
+
+    /** Server: the latest snapshot sequence number acknowledged by each
+     *  client (indexed by host id). */
+    std::map<int, uint16_t> m_acked_sequence;
+
+    /** Time the last update was sent. */
+    double m_last_send_time;
+
+    /** Maximum time a remote kart is extrapolated if no new data is
+     *  received. */
+    static const float MAX_EXTRAPOLATION;
+
+    static float getNetworkTime();
+    const KartSnapshot *getSnapshot(uint16_t sequence) const;
+    void applyInterpolatedTransforms();
+    void sendServerUpdate();
+    void sendClientUpdate();
 
 public:
              KartUpdateProtocol();
@@ -166,7 +166,7 @@ void ServerLobbyRoomProtocol::update(float dt)
             exit_result_screen->addUInt8(LE_EXIT_RESULT);
             sendMessageToPeersChangingToken(exit_result_screen,
                                             /*reliable*/true);
-            delete exit_result_screen;
+            exit_result_screen->drop();
             m_state = ACCEPTING_CLIENTS;
             RaceResultGUI::getInstance()->backToLobby();
             // notify the network world that it is stopped
@@ -249,7 +249,7 @@ void ServerLobbyRoomProtocol::startGame()
     NetworkString *ns = getNetworkString(1);
     ns->addUInt8(LE_START_RACE);
     sendMessageToPeersChangingToken(ns, /*reliable*/true);
-    delete ns;
+    ns->drop();
     Protocol *p = new StartGameProtocol(m_setup);
     p->requestStart();
     m_state = RACING;
@@ -273,7 +273,7 @@ void ServerLobbyRoomProtocol::startSelection(const Event *event)
     // start selection
     ns->addUInt8(LE_START_SELECTION);
     sendMessageToPeersChangingToken(ns, /*reliable*/true);
-    delete ns;
+    ns->drop();
 
     m_selection_enabled = true;
 
@@ -376,7 +376,7 @@ void ServerLobbyRoomProtocol::checkIncomingConnectionRequests()
             karts_results[i], i + 1);
     }
     sendMessageToPeersChangingToken(total, /*reliable*/ true);
-    delete total;
+    total->drop();
     Log::info("ServerLobbyRoomProtocol", "End of game message sent");
         
 }   // checkRaceFinished
@@ -404,7 +404,7 @@ void ServerLobbyRoomProtocol::clientDisconnected(Event* event)
     sendMessageToPeersChangingToken(msg, /*reliable*/true);
     // Remove the profile from the peer (to avoid double free)
     STKHost::get()->removePeer(event->getPeer());
-    delete msg;
+    msg->drop();
     
 }   // clientDisconnected
 
@@ -436,7 +436,7 @@ void ServerLobbyRoomProtocol::connectionRequested(Event* event)
 
         // send only to the peer that made the request
         peer->sendPacket(message);
-        delete message;
+        message->drop();
         Log::verbose("ServerLobbyRoomProtocol", "Player refused");
         return;
     }
@@ -469,7 +469,7 @@ void ServerLobbyRoomProtocol::connectionRequested(Event* event)
     message->addUInt8(LE_NEW_PLAYER_CONNECTED).addUInt8(new_player_id)
             .addUInt8(new_host_id).encodeString(name_u8);
     STKHost::get()->sendPacketExcept(peer, message);
-    delete message;
+    message->drop();
 
     // Now answer to the peer that just connected
     // ------------------------------------------
@@ -500,7 +500,7 @@ void ServerLobbyRoomProtocol::connectionRequested(Event* event)
                     .encodeString(players[i]->getName());
     }
     peer->sendPacket(message_ack);
-    delete message_ack;
+    message_ack->drop();
 
     NetworkPlayerProfile* profile = 
         new NetworkPlayerProfile(name, new_player_id, new_host_id);
@@ -547,7 +547,7 @@ void ServerLobbyRoomProtocol::kartSelectionRequested(Event* event)
         // selection still not started
         answer->addUInt8(LE_KART_SELECTION_REFUSED).addUInt8(2);
         peer->sendPacket(answer);
-        delete answer;
+        answer->drop();
         return;
     }
     // check if somebody picked that kart
@@ -557,7 +557,7 @@ void ServerLobbyRoomProtocol::kartSelectionRequested(Event* event)
         // kart is already taken
         answer->addUInt8(LE_KART_SELECTION_REFUSED).addUInt8(0);
         peer->sendPacket(answer);
-        delete answer;
+        answer->drop();
         return;
     }
     // check if this kart is authorized
@@ -567,7 +567,7 @@ void ServerLobbyRoomProtocol::kartSelectionRequested(Event* event)
         // kart is not authorized
         answer->addUInt8(LE_KART_SELECTION_REFUSED).addUInt8(1);
         peer->sendPacket(answer);
-        delete answer;
+        answer->drop();
         return;
     }
 
@@ -579,7 +579,7 @@ void ServerLobbyRoomProtocol::kartSelectionRequested(Event* event)
     answer->addUInt8(LE_KART_SELECTION_UPDATE).addUInt8(player_id)
           .encodeString(kart_name);
     sendMessageToPeersChangingToken(answer);
-    delete answer;
+    answer->drop();
     m_setup->setPlayerKart(player_id, kart_name);
 }   // kartSelectionRequested
 
@@ -607,7 +607,7 @@ void ServerLobbyRoomProtocol::playerMajorVote(Event* event)
     NetworkString *other = getNetworkString(6);
     other->addUInt8(LE_VOTE_MAJOR).addUInt8(player_id).addUInt32(major);
     sendMessageToPeersChangingToken(other);
-    delete other;
+    other->drop();
 }   // playerMajorVote
 
 //-----------------------------------------------------------------------------
@@ -633,7 +633,7 @@ void ServerLobbyRoomProtocol::playerRaceCountVote(Event* event)
     other->addUInt8(LE_VOTE_RACE_COUNT).addUInt8(player_id)
           .addUInt8(race_count);
     sendMessageToPeersChangingToken(other);
-    delete other;
+    other->drop();
 }   // playerRaceCountVote
 
 //-----------------------------------------------------------------------------
@@ -660,7 +660,7 @@ void ServerLobbyRoomProtocol::playerMinorVote(Event* event)
     NetworkString *other = getNetworkString(3);
     other->addUInt8(LE_VOTE_MINOR).addUInt8(player_id).addUInt8(minor); 
     sendMessageToPeersChangingToken(other);
-    delete other;
+    other->drop();
 }   // playerMinorVote
 
 //-----------------------------------------------------------------------------
@@ -692,7 +692,7 @@ void ServerLobbyRoomProtocol::playerTrackVote(Event* event)
     other->addUInt8(LE_VOTE_TRACK).addUInt8(player_id).addUInt8(track_number)
           .encodeString(track_name);
     sendMessageToPeersChangingToken(other);
-    delete other;
+    other->drop();
     if(m_setup->getRaceConfig()->getNumTrackVotes()==m_setup->getPlayerCount())
         startGame();
 }   // playerTrackVote
@@ -723,7 +723,7 @@ void ServerLobbyRoomProtocol::playerReversedVote(Event* event)
     other->addUInt8(LE_VOTE_REVERSE).addUInt8(player_id).addUInt8(reverse)
           .addUInt8(nb_track);
     sendMessageToPeersChangingToken(other);
-    delete other;
+    other->drop();
 }   // playerReversedVote
 
 //-----------------------------------------------------------------------------
@@ -750,7 +750,7 @@ void ServerLobbyRoomProtocol::playerLapsVote(Event* event)
     other->addUInt8(LE_VOTE_LAPS).addUInt8(player_id).addUInt8(lap_count)
           .addUInt8(track_nb);
     sendMessageToPeersChangingToken(other);
-    delete other;
+    other->drop();
 }   // playerLapsVote
 
 //-----------------------------------------------------------------------------
@@ -229,7 +229,7 @@ void StartGameProtocol::ready()
             Log::info("StartGameProtocol", "Player %d ready, notifying server.",
                        players[i]->getGlobalPlayerId());
             sendToServer(ns, /*reliable*/true);
-            delete ns;
+            ns->drop();
         }
         m_state = READY;
         m_ready = true;
@@ -72,7 +72,7 @@ bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
         // The '0' indicates a response to a ping request
         response->addUInt8(0).addUInt32(sequence);
         event->getPeer()->sendPacket(response, false);
-        delete response;
+        response->drop();
         Log::verbose("SynchronizationProtocol", "Answering sequence %u at %lf",
                      sequence, StkTime::getRealTime());
 
@@ -176,7 +176,7 @@ void SynchronizationProtocol::asynchronousUpdate()
                          m_pings[i].size(), i, StkTime::getRealTime());
             m_pings[i] [ m_pings_count ] = current_time;
             peers[i]->sendPacket(ping_request, false);
-            delete ping_request;
+            ping_request->drop();
         }   // for i M peers
         m_last_time = current_time;
         m_pings_count++;
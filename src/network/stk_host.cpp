@@ -23,6 +23,7 @@
 #include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/network_console.hpp"
+#include "network/network_stats.hpp"
 #include "network/network_string.hpp"
 #include "network/protocols/connect_to_peer.hpp"
 #include "network/protocols/connect_to_server.hpp"
@@ -48,6 +49,7 @@
 
 STKHost *STKHost::m_stk_host       = NULL;
 bool     STKHost::m_enable_console = true;
+std::string STKHost::m_network_stats_file = "";
 
 void STKHost::create()
 {
@@ -258,7 +260,7 @@ STKHost::STKHost(const irr::core::stringw &server_name)
 
     ENetAddress addr;
     addr.host = STKHost::HOST_ANY;
-    addr.port = 2758;
+    addr.port = NetworkConfig::get()->getServerPort();
 
     m_network= new Network(NetworkConfig::get()->getMaxPlayers(),
                            /*channel_limit*/2,
@@ -288,6 +290,9 @@ void STKHost::init()
     m_game_setup       = NULL;
     m_is_registered    = false;
     m_error_message    = "";
+    m_network_stats    = new NetworkStats();
+    if (!m_network_stats_file.empty())
+        m_network_stats->startCSV(m_network_stats_file);
 
     pthread_mutex_init(&m_exit_mutex, NULL);
 
@@ -334,6 +339,12 @@ STKHost::~STKHost()
     stopListening();
 
     delete m_network;
+    delete m_network_stats;
+
+    Log::info("STKHost", "%s.", Event::getPoolStatistics().c_str());
+    Log::info("STKHost", "%s.", NetworkString::getPoolStatistics().c_str());
+    Event::destroyPool();
+    NetworkString::destroyPool();
 }   // ~STKHost
 
 //-----------------------------------------------------------------------------
@@ -544,6 +555,13 @@ void* STKHost::mainLoop(void* self)
             else if (stk_event->getType() == EVENT_TYPE_MESSAGE)
             {
                 Network::logPacket(stk_event->data(), true);
+                if (stk_event->data().getTotalSize() > 0)
+                {
+                    myself->m_network_stats->addReceived(
+                        TransportAddress(event.peer->address),
+                        stk_event->data().getProtocolType(),
+                        stk_event->data().getTotalSize());
+                }
                 TransportAddress stk_addr(peer->getAddress());
                 Log::verbose("NetworkManager",
                              "Message, Sender : %s, message:",
@@ -556,6 +574,7 @@ void* STKHost::mainLoop(void* self)
             ProtocolManager::getInstance()->propagateEvent(stk_event);
             
         }   // while enet_host_service
+        myself->m_network_stats->update(host);
     }   // while !mustStopListening
 
     free(myself->m_listening_thread);
@@ -42,6 +42,7 @@
 
 class GameSetup;
 class NetworkConsole;
+class NetworkStats;
 
 class STKHost
 {
@@ -72,6 +73,9 @@ private:
     /** Network console */
     NetworkConsole *m_network_console;
 
+    /** Traffic and round trip time statistics of this host. */
+    NetworkStats *m_network_stats;
+
     /** The list of peers connected to this instance. */
     std::vector<STKPeer*> m_peers;
 
@@ -116,6 +120,9 @@ public:
     *  a crash in release mode on windows (see #1529). */
     static bool m_enable_console;
 
+    /** If not empty, the network statistics are written periodically to
+     *  this CSV file. */
+    static std::string m_network_stats_file;
 
     /** Creates the STKHost. It takes all confifguration parameters from
      *  NetworkConfig. This STKHost can either be a client or a server.
@@ -178,6 +185,9 @@ public:
     /** Returns the current game setup. */
     GameSetup* getGameSetup() { return m_game_setup; }
     // --------------------------------------------------------------------
+    /** Returns the network statistics of this host. */
+    NetworkStats* getNetworkStats() { return m_network_stats; }
+    // --------------------------------------------------------------------
     int receiveRawPacket(char *buffer, int buffer_len, 
                          TransportAddress* sender, int max_tries = -1)
     {
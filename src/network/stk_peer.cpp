@@ -20,6 +20,7 @@
 #include "network/game_setup.hpp"
 #include "network/network_string.hpp"
 #include "network/network_player_profile.hpp"
+#include "network/network_stats.hpp"
 #include "network/stk_host.hpp"
 #include "network/transport_address.hpp"
 #include "utils/log.hpp"
@@ -71,6 +72,8 @@ void STKPeer::sendPacket(NetworkString *data, bool reliable)
                                     (reliable ? ENET_PACKET_FLAG_RELIABLE
                                               : ENET_PACKET_FLAG_UNSEQUENCED));
     enet_peer_send(m_enet_peer, 0, packet);
+    STKHost::get()->getNetworkStats()->addSent(a, data->getProtocolType(),
+                                               data->getTotalSize());
 }   // sendPacket
 
 //-----------------------------------------------------------------------------
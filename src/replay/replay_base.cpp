@@ -1,3 +1,4 @@
+//
 //  SuperTuxKart - a fun racing game with go-kart
 //  Copyright (C) 2012-2015 Joerg Henrichs
 //
@@ -18,6 +19,134 @@
 #include "replay/replay_base.hpp"
 
 #include "io/file_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/types.hpp"
+
+#include <irrString.h>
+#include <algorithm>
+#include <string.h>
+#include <zlib.h>
+
+namespace
+{
+    /** Magic bytes at the start of a binary replay file. */
+    const char BINARY_MAGIC[4] = { 'S', 'T', 'K', 'R' };
+
+    /** A simple buffer to read and write the binary replay data. All
+     *  values are stored in little endian order. */
+    class ReplayBuffer
+    {
+    public:
+        std::string  m_data;
+        unsigned int m_pos;
+        bool         m_error;
+        ReplayBuffer() : m_pos(0), m_error(false) {}
+        // --------------------------------------------------------------------
+        void addUInt8(uint8_t v)  { m_data.push_back((char)v); }
+        // --------------------------------------------------------------------
+        void addUInt16(uint16_t v)
+        {
+            addUInt8(v & 0xff); addUInt8(v >> 8);
+        }   // addUInt16
+        // --------------------------------------------------------------------
+        void addUInt32(uint32_t v)
+        {
+            addUInt16(v & 0xffff); addUInt16(v >> 16);
+        }   // addUInt32
+        // --------------------------------------------------------------------
+        void addFloat(float f)
+        {
+            uint32_t v;
+            memcpy(&v, &f, 4);
+            addUInt32(v);
+        }   // addFloat
+        // --------------------------------------------------------------------
+        void addString(const std::string &s)
+        {
+            addUInt16((uint16_t)s.size());
+            m_data.append(s);
+        }   // addString
+        // --------------------------------------------------------------------
+        uint8_t getUInt8()
+        {
+            if (m_pos >= m_data.size())
+            {
+                m_error = true;
+                return 0;
+            }
+            return (uint8_t)m_data[m_pos++];
+        }   // getUInt8
+        // --------------------------------------------------------------------
+        uint16_t getUInt16()
+        {
+            uint16_t v = getUInt8();
+            return v | (getUInt8() << 8);
+        }   // getUInt16
+        // --------------------------------------------------------------------
+        uint32_t getUInt32()
+        {
+            uint32_t v = getUInt16();
+            return v | ((uint32_t)getUInt16() << 16);
+        }   // getUInt32
+        // --------------------------------------------------------------------
+        float getFloat()
+        {
+            uint32_t v = getUInt32();
+            float f;
+            memcpy(&f, &v, 4);
+            return f;
+        }   // getFloat
+        // --------------------------------------------------------------------
+        std::string getString()
+        {
+            unsigned int len = getUInt16();
+            if (m_pos + len > m_data.size())
+            {
+                m_error = true;
+                return "";
+            }
+            std::string s = m_data.substr(m_pos, len);
+            m_pos += len;
+            return s;
+        }   // getString
+        // --------------------------------------------------------------------
+        /** Reads n bytes from the file and appends them to the buffer. */
+        bool read(FILE *fd, unsigned int n)
+        {
+            if (n == 0) return true;
+            size_t old_size = m_data.size();
+            m_data.resize(old_size + n);
+            return fread(&m_data[old_size], 1, n, fd) == n;
+        }   // read
+        // --------------------------------------------------------------------
+        /** Writes the content of the buffer to the file. */
+        bool write(FILE *fd) const
+        {
+            return m_data.empty() ||
+                   fwrite(m_data.data(), 1, m_data.size(), fd)
+                                                            == m_data.size();
+        }   // write
+    };   // ReplayBuffer
+
+    /** Size in bytes of one event in an uncompressed event block: the time,
+     *  13 floats of transform and physic info, and three bytes of kart
+     *  replay events. */
+    const unsigned int BINARY_EVENT_SIZE = 14*4 + 3;
+
+    // ------------------------------------------------------------------------
+    /** Returns the number of bytes from the current position to the end of
+     *  the file, or 0 if this can not be determined. */
+    long getRemainingSize(FILE *fd)
+    {
+        long pos = ftell(fd);
+        if (pos < 0 || fseek(fd, 0, SEEK_END) != 0)
+            return 0;
+        long end = ftell(fd);
+        if (fseek(fd, pos, SEEK_SET) != 0 || end < pos)
+            return 0;
+        return end - pos;
+    }   // getRemainingSize
+}   // anonymous namespace
 
 // -----------------------------------------------------------------------------
 ReplayBase::ReplayBase()
@@ -33,7 +162,7 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path)
 {
     FILE *fd = fopen(full_path ? getReplayFilename().c_str() :
         (file_manager->getReplayDir() + getReplayFilename()).c_str(),
-        writeable ? "w" : "r");
+        writeable ? "wb" : "rb");
     if (!fd)
     {
         return NULL;
@@ -41,3 +170,551 @@ FILE* ReplayBase::openReplayFile(bool writeable, bool full_path)
     return fd;
 
 }   // openReplayFile
+
+// -----------------------------------------------------------------------------
+/** Returns true if the file is a binary replay file. The file position is
+ *  reset to the beginning of the file.
+ *  \param fd The file to test.
+ */
+bool ReplayBase::isBinaryReplay(FILE *fd)
+{
+    char magic[4];
+    bool binary = fread(magic, 1, 4, fd) == 4 &&
+                  memcmp(magic, BINARY_MAGIC, 4) == 0;
+    rewind(fd);
+    return binary;
+}   // isBinaryReplay
+
+// -----------------------------------------------------------------------------
+/** Reads the header of a text or binary replay file. Afterwards the file
+ *  is positioned at the start of the replay events.
+ *  \param fd The file to read from.
+ *  \param header On return contains the header data.
+ *  \param compressed On return true if the events are compressed (which
+ *         is only possible for binary files).
+ *  \return False if the file is not a valid replay file.
+ */
+bool ReplayBase::readReplayHeader(FILE *fd, ReplayHeader *header,
+                                  bool *compressed)
+{
+    *compressed = false;
+    if (isBinaryReplay(fd))
+        return readBinaryHeader(fd, header, compressed);
+    return readTextHeader(fd, header);
+}   // readReplayHeader
+
+// -----------------------------------------------------------------------------
+/** Reads the events of all karts from a replay file, which must be
+ *  positioned after the header (see readReplayHeader).
+ *  \param fd The file to read from.
+ *  \param binary True if this is a binary replay file.
+ *  \param compressed True if the binary event blocks are compressed.
+ *  \param num_karts Number of karts in this replay.
+ *  \param events On return contains the events of each kart.
+ */
+bool ReplayBase::readReplayEvents(FILE *fd, bool binary, bool compressed,
+                                  unsigned int num_karts,
+                                  std::vector<KartEvents> *events)
+{
+    if (binary)
+        return readBinaryEvents(fd, compressed, num_karts, events);
+    return readTextEvents(fd, num_karts, events);
+}   // readReplayEvents
+
+// -----------------------------------------------------------------------------
+/** Reads the header of a text replay file.
+ *  \param fd The file to read from.
+ *  \param header On return contains the header data.
+ *  \return False if the header could not be read, or the replay version
+ *          is not supported.
+ */
+bool ReplayBase::readTextHeader(FILE *fd, ReplayHeader *header)
+{
+    char s[1024], s1[1024];
+
+    if (fgets(s, 1023, fd) == NULL) return false;
+    unsigned int version;
+    if (sscanf(s,"version: %u", &version) != 1)
+    {
+        Log::warn("Replay", "No Version information "
+                  "found in replay file (bogus replay file).");
+        return false;
+    }
+    if (version != getReplayVersion())
+    {
+        Log::warn("Replay", "Replay is version '%d'", version);
+        Log::warn("Replay", "STK version is '%d'", getReplayVersion());
+        return false;
+    }
+
+    header->m_kart_list.clear();
+    while(true)
+    {
+        if (fgets(s, 1023, fd) == NULL) return false;
+        irr::core::stringc is_end(s);
+        is_end.trim();
+        if (is_end == "kart_list_end") break;
+
+        if (sscanf(s,"kart: %s", s1) != 1)
+        {
+            Log::warn("Replay", "Could not read ghost karts info!");
+            break;
+        }
+        header->m_kart_list.push_back(std::string(s1));
+    }
+
+    int reverse = 0;
+    fgets(s, 1023, fd);
+    if(sscanf(s, "reverse: %d", &reverse) != 1)
+    {
+        Log::warn("Replay", "Reverse info found in replay file.");
+        return false;
+    }
+    header->m_reverse = reverse != 0;
+
+    fgets(s, 1023, fd);
+    if (sscanf(s, "difficulty: %u", &header->m_difficulty) != 1)
+    {
+        Log::warn("Replay", " No difficulty found in replay file.");
+        return false;
+    }
+
+    fgets(s, 1023, fd);
+    if (sscanf(s, "track: %s", s1) != 1)
+    {
+        Log::warn("Replay", "Track info not found in replay file.");
+        return false;
+    }
+    header->m_track_name = std::string(s1);
+
+    fgets(s, 1023, fd);
+    if (sscanf(s, "laps: %u", &header->m_laps) != 1)
+    {
+        Log::warn("Replay", "No number of laps found in replay file.");
+        return false;
+    }
+
+    fgets(s, 1023, fd);
+    if (sscanf(s, "min_time: %f", &header->m_min_time) != 1)
+    {
+        Log::warn("Replay", "Finish time not found in replay file.");
+        return false;
+    }
+    return true;
+}   // readTextHeader
+
+// -----------------------------------------------------------------------------
+/** Reads the events of all karts from a text replay file.
+ *  \param fd The file to read from, positioned after the header.
+ *  \param num_karts Number of karts in this replay.
+ *  \param events On return contains the events of each kart.
+ */
+bool ReplayBase::readTextEvents(FILE *fd, unsigned int num_karts,
+                                std::vector<KartEvents> *events)
+{
+    char s[1024];
+    events->clear();
+    events->resize(num_karts);
+    for (unsigned int k = 0; k < num_karts; k++)
+    {
+        unsigned int size;
+        if (fgets(s, 1023, fd) == NULL || sscanf(s, "size: %u", &size) != 1)
+        {
+            Log::warn("Replay", "Number of records not found in replay file "
+                      "for kart %d.", k);
+            return false;
+        }
+
+        KartEvents &ke = (*events)[k];
+        ke.m_transform_events.reserve(size);
+        ke.m_physic_info.reserve(size);
+        ke.m_kart_replay_events.reserve(size);
+        for (unsigned int i = 0; i < size; i++)
+        {
+            if (fgets(s, 1023, fd) == NULL)
+                break;
+            float x, y, z, rx, ry, rz, rw, time, speed, steer,
+                  w1, w2, w3, w4;
+            int nitro, zipper, skidding, red_skidding, jumping;
+
+            // Check for EV_TRANSFORM event:
+            // -----------------------------
+            if (sscanf(s, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  "
+                          "%d %d %d %d %d\n",
+                &time,
+                &x, &y, &z,
+                &rx, &ry, &rz, &rw,
+                &speed, &steer, &w1, &w2, &w3, &w4,
+                &nitro, &zipper, &skidding, &red_skidding, &jumping
+                ) == 19)
+            {
+                TransformEvent te;
+                te.m_time = time;
+                te.m_transform = btTransform(btQuaternion(rx, ry, rz, rw),
+                                             btVector3(x, y, z));
+                PhysicInfo pi = {0};
+                KartReplayEvent kre = {0};
+                pi.m_speed = speed;
+                pi.m_steer = steer;
+                pi.m_suspension_length[0] = w1;
+                pi.m_suspension_length[1] = w2;
+                pi.m_suspension_length[2] = w3;
+                pi.m_suspension_length[3] = w4;
+                kre.m_nitro_usage = nitro;
+                kre.m_zipper_usage = zipper != 0;
+                kre.m_skidding_state = skidding;
+                kre.m_red_skidding = red_skidding != 0;
+                kre.m_jumping = jumping != 0;
+                ke.m_transform_events.push_back(te);
+                ke.m_physic_info.push_back(pi);
+                ke.m_kart_replay_events.push_back(kre);
+            }
+            else
+            {
+                // Invalid record found
+                // ---------------------
+                Log::warn("Replay", "Can't read replay data line %d:", i);
+                Log::warn("Replay", "%s", s);
+                Log::warn("Replay", "Ignored.");
+            }
+        }   // for i < size
+    }   // for k < num_karts
+    return true;
+}   // readTextEvents
+
+// -----------------------------------------------------------------------------
+/** Writes a replay in the (old) text format.
+ *  \param fd The file to write to.
+ *  \param header The header data.
+ *  \param events The events of each kart.
+ */
+void ReplayBase::writeTextReplay(FILE *fd, const ReplayHeader &header,
+                                 const std::vector<KartEvents> &events)
+{
+    fprintf(fd, "version: %d\n",    getReplayVersion());
+    for (unsigned int k = 0; k < header.m_kart_list.size(); k++)
+        fprintf(fd, "kart: %s\n", header.m_kart_list[k].c_str());
+    fprintf(fd, "kart_list_end\n");
+    fprintf(fd, "reverse: %d\n",    (int)header.m_reverse);
+    fprintf(fd, "difficulty: %d\n", header.m_difficulty);
+    fprintf(fd, "track: %s\n",      header.m_track_name.c_str());
+    fprintf(fd, "laps: %d\n",       header.m_laps);
+    fprintf(fd, "min_time: %f\n",   header.m_min_time);
+
+    for (unsigned int k = 0; k < events.size(); k++)
+    {
+        const KartEvents &ke = events[k];
+        fprintf(fd, "size:     %d\n", (int)ke.m_transform_events.size());
+        for (unsigned int i = 0; i < ke.m_transform_events.size(); i++)
+        {
+            const TransformEvent *p  = &(ke.m_transform_events[i]);
+            const PhysicInfo *q      = &(ke.m_physic_info[i]);
+            const KartReplayEvent *r = &(ke.m_kart_replay_events[i]);
+            fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
+                    p->m_time,
+                    p->m_transform.getOrigin().getX(),
+                    p->m_transform.getOrigin().getY(),
+                    p->m_transform.getOrigin().getZ(),
+                    p->m_transform.getRotation().getX(),
+                    p->m_transform.getRotation().getY(),
+                    p->m_transform.getRotation().getZ(),
+                    p->m_transform.getRotation().getW(),
+                    q->m_speed,
+                    q->m_steer,
+                    q->m_suspension_length[0],
+                    q->m_suspension_length[1],
+                    q->m_suspension_length[2],
+                    q->m_suspension_length[3],
+                    r->m_nitro_usage,
+                    (int)r->m_zipper_usage,
+                    r->m_skidding_state,
+                    (int)r->m_red_skidding,
+                    (int)r->m_jumping
+                );
+        }   // for i
+    }   // for k
+}   // writeTextReplay
+
+// -----------------------------------------------------------------------------
+/** Writes a replay in the binary format. The file starts with the magic
+ *  bytes 'STKR', the format version (uint16), flags (uint16) and the size
+ *  of the following header data (uint32). This allows reading the header
+ *  (kart list, track, reverse, difficulty, laps and finish time) without
+ *  reading any events. Then, for each kart, the number of events and blocks
+ *  (both uint32) follow, and the events in blocks of at most
+ *  EVENTS_PER_BLOCK events. Each block starts with the number of events,
+ *  the time of its first event, and the uncompressed and stored size (so
+ *  blocks can be skipped). In a block each value is stored for all events
+ *  one after another, which compresses better.
+ *  \param fd The file to write to.
+ *  \param header The header data.
+ *  \param events The events of each kart.
+ *  \param compress True if the event blocks should be compressed with zlib.
+ *  \return False if an error occurred.
+ */
+bool ReplayBase::writeBinaryReplay(FILE *fd, const ReplayHeader &header,
+                                   const std::vector<KartEvents> &events,
+                                   bool compress)
+{
+    ReplayBuffer data;
+    data.addString(header.m_track_name);
+    data.addUInt8(header.m_reverse ? 1 : 0);
+    data.addUInt8(header.m_difficulty);
+    data.addUInt16(header.m_laps);
+    data.addFloat(header.m_min_time);
+    data.addUInt8((uint8_t)header.m_kart_list.size());
+    for (unsigned int k = 0; k < header.m_kart_list.size(); k++)
+        data.addString(header.m_kart_list[k]);
+
+    ReplayBuffer start;
+    start.m_data.append(BINARY_MAGIC, 4);
+    start.addUInt16(BINARY_REPLAY_VERSION);
+    start.addUInt16(compress ? BINARY_FLAG_COMPRESSED : 0);
+    start.addUInt32((uint32_t)data.m_data.size());
+    if (!start.write(fd) || !data.write(fd))
+        return false;
+
+    for (unsigned int k = 0; k < events.size(); k++)
+    {
+        const KartEvents &ke = events[k];
+        const unsigned int num_events =
+                                   (unsigned int)ke.m_transform_events.size();
+        const unsigned int num_blocks =
+                           (num_events + EVENTS_PER_BLOCK-1)/EVENTS_PER_BLOCK;
+        ReplayBuffer kart;
+        kart.addUInt32(num_events);
+        kart.addUInt32(num_blocks);
+        if (!kart.write(fd))
+            return false;
+
+        for (unsigned int b = 0; b < num_blocks; b++)
+        {
+            const unsigned int first = b*EVENTS_PER_BLOCK;
+            const unsigned int n = std::min(EVENTS_PER_BLOCK,
+                                            num_events - first);
+            ReplayBuffer block;
+            for (unsigned int i = first; i < first + n; i++)
+                block.addFloat(ke.m_transform_events[i].m_time);
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                for (unsigned int i = first; i < first + n; i++)
+                    block.addFloat(ke.m_transform_events[i].m_transform
+                                                        .getOrigin()[j]);
+            }
+            for (unsigned int j = 0; j < 4; j++)
+            {
+                for (unsigned int i = first; i < first + n; i++)
+                    block.addFloat(ke.m_transform_events[i].m_transform
+                                                      .getRotation()[j]);
+            }
+            for (unsigned int i = first; i < first + n; i++)
+                block.addFloat(ke.m_physic_info[i].m_speed);
+            for (unsigned int i = first; i < first + n; i++)
+                block.addFloat(ke.m_physic_info[i].m_steer);
+            for (unsigned int j = 0; j < 4; j++)
+            {
+                for (unsigned int i = first; i < first + n; i++)
+                    block.addFloat(ke.m_physic_info[i]
+                                                 .m_suspension_length[j]);
+            }
+            for (unsigned int i = first; i < first + n; i++)
+                block.addUInt8(ke.m_kart_replay_events[i].m_nitro_usage);
+            for (unsigned int i = first; i < first + n; i++)
+                block.addUInt8(ke.m_kart_replay_events[i].m_skidding_state);
+            for (unsigned int i = first; i < first + n; i++)
+            {
+                const KartReplayEvent &kre = ke.m_kart_replay_events[i];
+                block.addUInt8( (kre.m_zipper_usage ? 1 : 0) |
+                                (kre.m_red_skidding ? 2 : 0) |
+                                (kre.m_jumping      ? 4 : 0)   );
+            }
+
+            std::string stored;
+            if (compress)
+            {
+                uLongf size = compressBound((uLong)block.m_data.size());
+                stored.resize(size);
+                if (compress2((Bytef*)&stored[0], &size,
+                              (const Bytef*)block.m_data.data(),
+                              (uLong)block.m_data.size(),
+                              Z_BEST_COMPRESSION) != Z_OK)
+                    return false;
+                stored.resize(size);
+            }
+            else
+                stored = block.m_data;
+
+            ReplayBuffer block_header;
+            block_header.addUInt32(n);
+            block_header.addFloat(ke.m_transform_events[first].m_time);
+            block_header.addUInt32((uint32_t)block.m_data.size());
+            block_header.addUInt32((uint32_t)stored.size());
+            if (!block_header.write(fd) ||
+                fwrite(stored.data(), 1, stored.size(), fd) != stored.size())
+                return false;
+        }   // for b < num_blocks
+    }   // for k < events.size()
+    return true;
+}   // writeBinaryReplay
+
+// -----------------------------------------------------------------------------
+/** Reads the header of a binary replay file (see writeBinaryReplay).
+ *  \param fd The file to read from.
+ *  \param header On return contains the header data.
+ *  \param compressed On return true if the event blocks are compressed.
+ *  \return False if the header could not be read, or the replay version
+ *          is not supported.
+ */
+bool ReplayBase::readBinaryHeader(FILE *fd, ReplayHeader *header,
+                                  bool *compressed)
+{
+    ReplayBuffer start;
+    if (!start.read(fd, 12) || memcmp(start.m_data.data(), BINARY_MAGIC, 4))
+        return false;
+    start.m_pos = 4;
+    unsigned int version = start.getUInt16();
+    if (version != BINARY_REPLAY_VERSION)
+    {
+        Log::warn("Replay", "Binary replay is version '%d'", version);
+        Log::warn("Replay", "STK version is '%d'", BINARY_REPLAY_VERSION);
+        return false;
+    }
+    *compressed = (start.getUInt16() & BINARY_FLAG_COMPRESSED) != 0;
+
+    ReplayBuffer data;
+    if (!data.read(fd, start.getUInt32()))
+        return false;
+    header->m_track_name = data.getString();
+    header->m_reverse    = data.getUInt8() != 0;
+    header->m_difficulty = data.getUInt8();
+    header->m_laps       = data.getUInt16();
+    header->m_min_time   = data.getFloat();
+    unsigned int num_karts = data.getUInt8();
+    header->m_kart_list.clear();
+    for (unsigned int k = 0; k < num_karts; k++)
+        header->m_kart_list.push_back(data.getString());
+    if (data.m_error)
+    {
+        Log::warn("Replay", "Invalid binary replay header.");
+        return false;
+    }
+    return true;
+}   // readBinaryHeader
+
+// -----------------------------------------------------------------------------
+/** Reads the events of all karts from a binary replay file.
+ *  \param fd The file to read from, positioned after the header.
+ *  \param compressed True if the event blocks are compressed.
+ *  \param num_karts Number of karts in this replay.
+ *  \param events On return contains the events of each kart.
+ */
+bool ReplayBase::readBinaryEvents(FILE *fd, bool compressed,
+                                  unsigned int num_karts,
+                                  std::vector<KartEvents> *events)
+{
+    events->clear();
+    events->resize(num_karts);
+    for (unsigned int k = 0; k < num_karts; k++)
+    {
+        ReplayBuffer kart;
+        if (!kart.read(fd, 8))
+            return false;
+        const unsigned int num_events = kart.getUInt32();
+        const unsigned int num_blocks = kart.getUInt32();
+        // Each block has a 16 byte header and at most EVENTS_PER_BLOCK
+        // events, so check the counts before allocating any memory.
+        const long remaining = getRemainingSize(fd);
+        if ((uint64_t)num_blocks * 16 > (uint64_t)remaining ||
+            num_events > (uint64_t)num_blocks * EVENTS_PER_BLOCK)
+        {
+            Log::warn("Replay", "Invalid number of events in binary replay.");
+            return false;
+        }
+
+        KartEvents &ke = (*events)[k];
+        ke.m_transform_events.resize(num_events);
+        ke.m_physic_info.resize(num_events);
+        ke.m_kart_replay_events.resize(num_events);
+
+        unsigned int first = 0;
+        for (unsigned int b = 0; b < num_blocks; b++)
+        {
+            ReplayBuffer block_header;
+            if (!block_header.read(fd, 16))
+                return false;
+            const unsigned int n = block_header.getUInt32();
+            block_header.getFloat();   // time of first event, for seeking
+            const unsigned int raw_size    = block_header.getUInt32();
+            const unsigned int stored_size = block_header.getUInt32();
+            if (n > EVENTS_PER_BLOCK || first + n > num_events ||
+                raw_size > n * BINARY_EVENT_SIZE ||
+                stored_size > (unsigned long)getRemainingSize(fd))
+            {
+                Log::warn("Replay", "Invalid event block in binary replay.");
+                return false;
+            }
+
+            ReplayBuffer block;
+            if (compressed)
+            {
+                ReplayBuffer stored;
+                if (!stored.read(fd, stored_size))
+                    return false;
+                block.m_data.resize(raw_size);
+                uLongf size = raw_size;
+                if (raw_size > 0 &&
+                    uncompress((Bytef*)&block.m_data[0], &size,
+                               (const Bytef*)stored.m_data.data(),
+                               stored_size) != Z_OK)
+                    return false;
+            }
+            else if (!block.read(fd, stored_size))
+                return false;
+
+            for (unsigned int i = first; i < first + n; i++)
+            {
+                TransformEvent &te = ke.m_transform_events[i];
+                te.m_time = block.getFloat();
+            }
+            // The block stores each of the 13 values for all events in a
+            // row, transpose them so that the values of one event are
+            // consecutive.
+            std::vector<float> values(13*n);
+            for (unsigned int j = 0; j < 13; j++)
+                for (unsigned int i = 0; i < n; i++)
+                    values[i*13 + j] = block.getFloat();
+            for (unsigned int i = 0; i < n; i++)
+            {
+                const float *v = &values[i*13];
+                TransformEvent &te = ke.m_transform_events[first + i];
+                te.m_transform = btTransform(btQuaternion(v[3], v[4], v[5],
+                                                          v[6]),
+                                             btVector3(v[0], v[1], v[2]));
+                PhysicInfo &pi = ke.m_physic_info[first + i];
+                pi.m_speed = v[7];
+                pi.m_steer = v[8];
+                for (unsigned int j = 0; j < 4; j++)
+                    pi.m_suspension_length[j] = v[9 + j];
+            }
+            for (unsigned int i = first; i < first + n; i++)
+                ke.m_kart_replay_events[i].m_nitro_usage = block.getUInt8();
+            for (unsigned int i = first; i < first + n; i++)
+                ke.m_kart_replay_events[i].m_skidding_state =
+                                                           block.getUInt8();
+            for (unsigned int i = first; i < first + n; i++)
+            {
+                uint8_t flags = block.getUInt8();
+                KartReplayEvent &kre = ke.m_kart_replay_events[i];
+                kre.m_zipper_usage = (flags & 1) != 0;
+                kre.m_red_skidding = (flags & 2) != 0;
+                kre.m_jumping      = (flags & 4) != 0;
+            }
+            if (block.m_error)
+                return false;
+            first += n;
+        }   // for b < num_blocks
+        if (first != num_events)
+            return false;
+    }   // for k < num_karts
+    return true;
+}   // readBinaryEvents
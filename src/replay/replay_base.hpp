@@ -34,6 +34,20 @@ class ReplayBase : public NoCopy
     // Needs access to KartReplayEvent
     friend class GhostKart;
 
+public:
+    /** The information stored in the header of a replay file, which can
+     *  be read without reading the actual replay events. */
+    class ReplayHeader
+    {
+    public:
+        std::vector<std::string> m_kart_list;
+        std::string              m_track_name;
+        bool                     m_reverse;
+        unsigned int             m_difficulty;
+        unsigned int             m_laps;
+        float                    m_min_time;
+    };   // ReplayHeader
+
 protected:
     /** Stores a transform event, i.e. a position and rotation of a kart
      *  at a certain time. */
@@ -72,16 +86,55 @@ protected:
         bool        m_jumping;
     };   // KartReplayEvent
 
+    // ------------------------------------------------------------------------
+    /** All events recorded for one kart. */
+    struct KartEvents
+    {
+        std::vector<TransformEvent>  m_transform_events;
+        std::vector<PhysicInfo>      m_physic_info;
+        std::vector<KartReplayEvent> m_kart_replay_events;
+    };   // KartEvents
+
+    // ------------------------------------------------------------------------
+    /** Version of the binary replay format. */
+    static const unsigned int BINARY_REPLAY_VERSION = 1;
+
+    /** Flag in a binary replay file indicating that the event blocks are
+     *  compressed with zlib. */
+    static const unsigned int BINARY_FLAG_COMPRESSED = 1;
+
+    /** Maximum number of events stored in one block of a binary replay. */
+    static const unsigned int EVENTS_PER_BLOCK = 256;
+
     // ------------------------------------------------------------------------
     FILE *openReplayFile(bool writeable, bool full_path = false);
+    static bool isBinaryReplay(FILE *fd);
+    static bool readReplayHeader(FILE *fd, ReplayHeader *header,
+                                 bool *compressed);
+    static bool readReplayEvents(FILE *fd, bool binary, bool compressed,
+                                 unsigned int num_karts,
+                                 std::vector<KartEvents> *events);
+    static bool readTextHeader(FILE *fd, ReplayHeader *header);
+    static bool readTextEvents(FILE *fd, unsigned int num_karts,
+                               std::vector<KartEvents> *events);
+    static bool readBinaryHeader(FILE *fd, ReplayHeader *header,
+                                 bool *compressed);
+    static bool readBinaryEvents(FILE *fd, bool compressed,
+                                 unsigned int num_karts,
+                                 std::vector<KartEvents> *events);
+    static void writeTextReplay(FILE *fd, const ReplayHeader &header,
+                                const std::vector<KartEvents> &events);
+    static bool writeBinaryReplay(FILE *fd, const ReplayHeader &header,
+                                  const std::vector<KartEvents> &events,
+                                  bool compress);
     // ------------------------------------------------------------------------
     /** Returns the filename that was opened. */
     virtual const std::string& getReplayFilename() const = 0;
     // ------------------------------------------------------------------------
-    /** Returns the version number of the replay file. This is used to check
-     *  that a loaded replay file can still be understood by this
+    /** Returns the version number of the text replay file. This is used to
+     *  check that a loaded replay file can still be understood by this
      *  executable. */
-    unsigned int getReplayVersion() const { return 3; }
+    static unsigned int getReplayVersion() { return 3; }
 
 public:
              ReplayBase();
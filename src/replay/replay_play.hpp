@@ -24,6 +24,7 @@
 #include "utils/ptr_vector.hpp"
 
 #include <algorithm>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -48,17 +49,11 @@ public:
         SO_TIME
     };
 
-    class ReplayData
+    class ReplayData : public ReplayHeader
     {
     public:
         std::string              m_filename;
-        std::string              m_track_name;
-        std::vector<std::string> m_kart_list;
-        bool                     m_reverse;
         bool                     m_custom_replay_file;
-        unsigned int             m_difficulty;
-        unsigned int             m_laps;
-        float                    m_min_time;
 
         bool operator < (const ReplayData& r) const
         {
@@ -96,13 +91,39 @@ private:
 
     std::vector<ReplayData>  m_replay_file_list;
 
+    /** A cached replay header together with the modification time and size
+     *  of the replay file when the header was read. */
+    struct CachedHeader
+    {
+        ReplayHeader m_header;
+        int64_t      m_mtime;
+        int64_t      m_size;
+        /** False if the file is not a valid replay file, in which case
+         *  m_header is not used. */
+        bool         m_valid;
+        /** True if the replay file was found in the last listing. */
+        bool         m_used;
+    };   // CachedHeader
+
+    /** The headers of all known replay files, indexed by the full path of
+     *  the replay file. It is stored in the replay directory, so that the
+     *  list of replays can be created without opening each replay file. */
+    std::map<std::string, CachedHeader> m_header_cache;
+
+    /** True if the header cache was changed and needs to be saved. */
+    bool                     m_header_cache_changed;
+
     /** All ghost karts. */
     PtrVector<GhostKart>     m_ghost_karts;
 
           ReplayPlay();
          ~ReplayPlay();
-    void  readKartData(FILE *fd, char *next_line);
+    void  createGhostKart(unsigned int kart_num, const KartEvents &events);
+    void  loadHeaderCache();
+    void  saveHeaderCache();
+    std::string getHeaderCacheFilename() const;
 public:
+    static void benchmark(const std::string &filename);
     void  reset();
     void  load();
     void  loadAllReplayFile();
@@ -19,6 +19,7 @@
 #include "replay/replay_recorder.hpp"
 
 #include "config/stk_config.hpp"
+#include "config/user_config.hpp"
 #include "io/file_manager.hpp"
 #include "guiengine/message_queue.hpp"
 #include "karts/ghost_kart.hpp"
@@ -207,6 +208,34 @@ void ReplayRecorder::save()
         << "_" << num_karts << "_" << time << ".replay";
     m_filename = oss.str();
 
+    ReplayHeader header;
+    std::vector<KartEvents> events;
+    unsigned int max_frames = (unsigned int)(  stk_config->m_replay_max_time 
+                                             / stk_config->m_replay_dt      );
+    for (unsigned int k = 0; k < num_karts; k++)
+    {
+        if (world->getKart(k)->isGhostKart()) continue;
+        header.m_kart_list.push_back(world->getKart(k)->getIdent());
+
+        unsigned int num_transforms = std::min(max_frames,
+                                               m_count_transforms[k]);
+        events.push_back(KartEvents());
+        KartEvents &ke = events.back();
+        ke.m_transform_events.assign(m_transform_events[k].begin(),
+                                     m_transform_events[k].begin()
+                                                          + num_transforms);
+        ke.m_physic_info.assign(m_physic_info[k].begin(),
+                                m_physic_info[k].begin() + num_transforms);
+        ke.m_kart_replay_events.assign(m_kart_replay_event[k].begin(),
+                                       m_kart_replay_event[k].begin()
+                                                          + num_transforms);
+    }
+    header.m_reverse    = race_manager->getReverseTrack();
+    header.m_difficulty = race_manager->getDifficulty();
+    header.m_track_name = world->getTrack()->getIdent();
+    header.m_laps       = race_manager->getNumLaps();
+    header.m_min_time   = min_time;
+
     FILE *fd = openReplayFile(/*writeable*/true);
     if (!fd)
     {
@@ -215,61 +244,18 @@ void ReplayRecorder::save()
         return;
     }
 
-    core::stringw msg = _("Replay saved in \"%s\".",
-        (file_manager->getReplayDir() + getReplayFilename()).c_str());
-    MessageQueue::add(MessageQueue::MT_GENERIC, msg);
-
-    fprintf(fd, "version: %d\n",    getReplayVersion());
-    for (unsigned int real_karts = 0; real_karts < num_karts; real_karts++)
+    if (!writeBinaryReplay(fd, header, events,
+                           UserConfigParams::m_replay_compression))
     {
-        if (world->getKart(real_karts)->isGhostKart()) continue;
-        fprintf(fd, "kart: %s\n",
-            world->getKart(real_karts)->getIdent().c_str());
+        Log::error("ReplayRecorder", "Error writing '%s'.",
+                   getReplayFilename().c_str());
+        fclose(fd);
+        return;
     }
 
-    fprintf(fd, "kart_list_end\n");
-    fprintf(fd, "reverse: %d\n",    (int)race_manager->getReverseTrack());
-    fprintf(fd, "difficulty: %d\n", race_manager->getDifficulty());
-    fprintf(fd, "track: %s\n",      world->getTrack()->getIdent().c_str());
-    fprintf(fd, "laps: %d\n",       race_manager->getNumLaps());
-    fprintf(fd, "min_time: %f\n",   min_time);
-
-    unsigned int max_frames = (unsigned int)(  stk_config->m_replay_max_time 
-                                             / stk_config->m_replay_dt      );
-    for (unsigned int k = 0; k < num_karts; k++)
-    {
-        if (world->getKart(k)->isGhostKart()) continue;
-        fprintf(fd, "size:     %d\n", m_count_transforms[k]);
+    core::stringw msg = _("Replay saved in \"%s\".",
+        (file_manager->getReplayDir() + getReplayFilename()).c_str());
+    MessageQueue::add(MessageQueue::MT_GENERIC, msg);
 
-        unsigned int num_transforms = std::min(max_frames,
-                                               m_count_transforms[k]);
-        for (unsigned int i = 0; i < num_transforms; i++)
-        {
-            const TransformEvent *p  = &(m_transform_events[k][i]);
-            const PhysicInfo *q      = &(m_physic_info[k][i]);
-            const KartReplayEvent *r = &(m_kart_replay_event[k][i]);
-            fprintf(fd, "%f  %f %f %f  %f %f %f %f  %f  %f  %f %f %f %f  %d %d %d %d %d\n",
-                    p->m_time,
-                    p->m_transform.getOrigin().getX(),
-                    p->m_transform.getOrigin().getY(),
-                    p->m_transform.getOrigin().getZ(),
-                    p->m_transform.getRotation().getX(),
-                    p->m_transform.getRotation().getY(),
-                    p->m_transform.getRotation().getZ(),
-                    p->m_transform.getRotation().getW(),
-                    q->m_speed,
-                    q->m_steer,
-                    q->m_suspension_length[0],
-                    q->m_suspension_length[1],
-                    q->m_suspension_length[2],
-                    q->m_suspension_length[3],
-                    r->m_nitro_usage,
-                    (int)r->m_zipper_usage,
-                    r->m_skidding_state,
-                    (int)r->m_red_skidding,
-                    (int)r->m_jumping
-                );
-        }   // for i
-    }
     fclose(fd);
 }   // save
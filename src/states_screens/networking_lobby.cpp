@@ -171,9 +171,10 @@ void NetworkingLobby::eventCallback(Widget* widget, const std::string& name,
         else // client
         {
             // Send a message to the server to start
-            NetworkString start(PROTOCOL_LOBBY_ROOM);
-            start.addUInt8(LobbyRoomProtocol::LE_REQUEST_BEGIN);
-            STKHost::get()->sendToServer(&start, true);
+            NetworkString *start = NetworkString::create(PROTOCOL_LOBBY_ROOM);
+            start->addUInt8(LobbyRoomProtocol::LE_REQUEST_BEGIN);
+            STKHost::get()->sendToServer(start, true);
+            start->drop();
         }
     }
 
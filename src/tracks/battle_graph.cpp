@@ -32,11 +32,18 @@
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
 
 #include <algorithm>
+#include <limits>
+#include <math.h>
 #include <queue>
+#include <stdio.h>
+#include <string.h>
 
-const int BattleGraph::UNKNOWN_POLY  = -1;
+const int      BattleGraph::UNKNOWN_POLY   = -1;
+const uint16_t BattleGraph::NO_PATH;
+const float    BattleGraph::DISTANCE_SCALE = 10.0f;
 BattleGraph * BattleGraph::m_battle_graph = NULL;
 
 /** Constructor, Creates a navmesh, builds a graph from the navmesh and
@@ -51,9 +58,23 @@ BattleGraph::BattleGraph(const std::string &navmesh_file_name,
     m_navmesh_file = navmesh_file_name;
     buildGraph(NavMesh::get());
 
-    // Compute shortest distance from all nodes
-    for(unsigned int i=0; i < NavMesh::get()->getNumberOfQuads(); i++)
-        computeDijkstra(i);
+    // Compute shortest distance from all nodes, unless the results for
+    // the same navmesh were saved before
+    std::string cache_file;
+    uint64_t hash = 0;
+    bool loaded = false;
+    if (UserConfigParams::m_cache_battle_graph)
+    {
+        hash       = getNavMeshHash();
+        cache_file = getCacheFileName();
+        loaded     = loadShortestPaths(cache_file, hash);
+    }
+    if (!loaded)
+    {
+        computeShortestPaths(/*parallel*/true);
+        if (UserConfigParams::m_cache_battle_graph)
+            saveShortestPaths(cache_file, hash);
+    }
 
     sortNearbyQuad();
     if (node && race_manager->getMinorMode() == RaceManager::MINOR_MODE_SOCCER)
@@ -73,52 +94,69 @@ BattleGraph::~BattleGraph(void)
 } // ~BattleGraph
 
 // ----------------------------------------------------------------------------
-/** Builds a graph from an existing NavMesh. The graph is stored as an
- *  adjacency matrix. */
+/** Builds a graph from an existing NavMesh. The graph is stored as
+ *  adjacency lists, together with the distance between the centers of
+ *  adjacent quads. */
 void BattleGraph::buildGraph(NavMesh* navmesh)
 {
-    const unsigned int n_quads = navmesh->getNumberOfQuads();
-
-    m_distance_matrix = std::vector<std::vector<float>>
-        (n_quads, std::vector<float>(n_quads, 9999.9f));
-    for(unsigned int i = 0; i < n_quads; i++)
+    m_num_nodes = navmesh->getNumberOfQuads();
+    // Node indices are stored as 16 bit values, with NO_PATH reserved
+    if (m_num_nodes >= NO_PATH)
+        Log::fatal("BattleGraph", "Navmesh '%s' has %d quads, at most %d "
+                   "are supported.", m_navmesh_file.c_str(), m_num_nodes,
+                   NO_PATH - 1);
+
+    m_adjacency_start.resize(m_num_nodes + 1);
+    m_adjacency.clear();
+    for(unsigned int i = 0; i < m_num_nodes; i++)
     {
+        m_adjacency_start[i] = (unsigned int)m_adjacency.size();
         const Quad& cur_quad = navmesh->getQuad(i);
         for (const int& adjacent : navmesh->getAdjacentQuads(i))
         {
             Vec3 diff = navmesh->getQuad(adjacent).getCenter()
                       - cur_quad.getCenter();
-            float distance = diff.length();
-            m_distance_matrix[i][adjacent] = distance;
+            m_adjacency.push_back(std::make_pair(adjacent, diff.length()));
         }
-        m_distance_matrix[i][i] = 0.0f;
     }
+    m_adjacency_start[m_num_nodes] = (unsigned int)m_adjacency.size();
+}    // buildGraph
 
-    // Allocate and initialise the previous node data structure:
-    m_parent_poly = std::vector<std::vector<int>>
-        (n_quads, std::vector<int>(n_quads, BattleGraph::UNKNOWN_POLY));
-    for (unsigned int i = 0; i < n_quads; i++)
-    {
-        for (unsigned int j = 0; j < n_quads; j++)
-        {
-            if(i == j || m_distance_matrix[i][j] >= 9899.9f)
-                m_parent_poly[i][j] = -1;
-            else
-                m_parent_poly[i][j] = i;
-        }   // for j
-    }   // for i
+// ----------------------------------------------------------------------------
+/** Computes the shortest paths between all pairs of nodes by running
+ *  Dijkstra from each node. Each run only writes the row of its source node
+ *  in m_distance and m_parent_poly, so the runs are done in parallel.
+ *  \param parallel If the rows should be computed in parallel (only
+ *         disabled by the unit test to compare the timings).
+ */
+void BattleGraph::computeShortestPaths(bool parallel)
+{
+    const int n = m_num_nodes;
+    m_distance.assign((size_t)n*n, NO_PATH);
+    m_parent_poly.assign((size_t)n*n, NO_PATH);
 
-}    // buildGraph
+#pragma omp parallel if(parallel)
+    {
+        // Unquantized distances from the current source node
+        std::vector<float> distance(n);
+#pragma omp for schedule(dynamic, 16)
+        for (int i = 0; i < n; i++)
+            computeDijkstra(i, &distance);
+    }
+}   // computeShortestPaths
 
 // ----------------------------------------------------------------------------
 /** Dijkstra shortest path computation. It computes the shortest distance from
  *  the specified node 'source' to all other nodes. At the end of the 
- *  computation, m_distance_matrix[i][j] stores the shortest path distance from
+ *  computation, m_distance[source][j] stores the shortest path distance from
  *  source to j and m_parent_poly[source][j] stores the last vertex visited on
- *  the shortest path from i to j before visiting j. Suppose the shortest path
- *  from i to j is i->......->k->j  then m_parent_poly[i][j] = k
+ *  the shortest path from source to j before visiting j. Suppose the shortest
+ *  path from i to j is i->......->k->j  then m_parent_poly[i][j] = k
+ *  \param source The source node.
+ *  \param distance Temporary storage for the distances from 'source'
+ *         (getNumNodes() entries), so that parallel runs don't share it.
  */
-void BattleGraph::computeDijkstra(int source)
+void BattleGraph::computeDijkstra(int source, std::vector<float> *distance)
 {
     // Stores the distance (float) to 'source' from a specified node (int)
     typedef std::pair<int, float> IndDistPair;
@@ -132,62 +170,79 @@ void BattleGraph::computeDijkstra(int source)
         }
     };
     std::priority_queue<IndDistPair, std::vector<IndDistPair>, Shortest> queue;
-    IndDistPair begin(source, 0.0f);
-    queue.push(begin);
-    const unsigned int n=getNumNodes();
-    std::vector<bool> visited;
-    visited.resize(n, false);
-    NavMesh *navmesh = NavMesh::get();
+
+    std::vector<float> &dist = *distance;
+    std::fill(dist.begin(), dist.end(), std::numeric_limits<float>::max());
+    dist[source] = 0.0f;
+    uint16_t *parent = &m_parent_poly[(size_t)source*m_num_nodes];
+
+    queue.push(IndDistPair(source, 0.0f));
     while(!queue.empty())
     {
         // Get element with shortest path
         IndDistPair current = queue.top();
         queue.pop();
-        int cur_index = current.first;
-        if(visited[cur_index]) continue;
-        visited[cur_index] = true;
+        const int cur_index = current.first;
+        // A shorter path to this node was found after this entry was added
+        if(current.second > dist[cur_index]) continue;
 
-        for (const int& adjacent : navmesh->getAdjacentQuads(cur_index))
+        for (unsigned int k  = m_adjacency_start[cur_index];
+                          k  < m_adjacency_start[cur_index+1]; k++)
         {
-            // Distance already computed, can be ignored
-            if(visited[adjacent]) continue;
-
-            float new_dist = current.second + m_distance_matrix[cur_index][adjacent];
-            if(new_dist < m_distance_matrix[source][adjacent])
+            const int adjacent   = m_adjacency[k].first;
+            const float new_dist = current.second + m_adjacency[k].second;
+            if(new_dist < dist[adjacent])
             {
-                m_distance_matrix[source][adjacent] = new_dist;
-                m_parent_poly[source][adjacent] = cur_index;
+                dist[adjacent]   = new_dist;
+                parent[adjacent] = cur_index;
+                queue.push(IndDistPair(adjacent, new_dist));
             }
-            IndDistPair pair(adjacent, new_dist);
-            queue.push(pair);
         }
     }
+
+    // Store the quantized distances, unreachable nodes keep NO_PATH
+    uint16_t *row = &m_distance[(size_t)source*m_num_nodes];
+    const float max_distance = NO_PATH - 1;
+    for (unsigned int j = 0; j < m_num_nodes; j++)
+    {
+        if (dist[j] == std::numeric_limits<float>::max()) continue;
+        row[j] = (uint16_t)std::min(dist[j]*DISTANCE_SCALE + 0.5f,
+                                    max_distance);
+    }
 }   // computeDijkstra
 
 // ----------------------------------------------------------------------------
 /** THIS FUNCTION IS ONLY USED FOR UNIT-TESTING, to verify that the new
  *  Dijkstra algorithm gives the same results.
  *  computeFloydWarshall() computes the shortest distance between any two 
- *  nodes. At the end of the computation, m_distance_matrix[i][j] stores the
- *  shortest path distance from i to j and m_parent_poly[i][j] stores the last
+ *  nodes. At the end of the computation, distance[i*n+j] stores the
+ *  shortest path distance from i to j and parent_poly[i*n+j] stores the last
  *  vertex visited on the shortest path from i to j before visiting j. Suppose
  *  the shortest path from i to j is i->......->k->j  then 
- *  m_parent_poly[i][j] = k
+ *  parent_poly[i*n+j] = k
+ *  \param distance On return the (unquantized) distances.
+ *  \param parent_poly On return the parent polys, UNKNOWN_POLY if no path
+ *         exists.
  */
-void BattleGraph::computeFloydWarshall()
+void BattleGraph::computeFloydWarshall(std::vector<float> *distance,
+                                       std::vector<int> *parent_poly) const
 {
-    unsigned int n = getNumNodes();
-
-    // initialize m_parent_poly with unknown_poly so that if no path is found b/w i and j
-    // then m_parent_poly[i][j] = -1 (UNKNOWN_POLY)
-    // AI must check this
-    m_parent_poly = std::vector< std::vector<int> > (n, std::vector<int>(n,BattleGraph::UNKNOWN_POLY));
+    const unsigned int n = m_num_nodes;
+    std::vector<float> &d = *distance;
+    std::vector<int>   &p = *parent_poly;
+
+    // initialize parent_poly with unknown_poly so that if no path is found
+    // b/w i and j then parent_poly[i*n+j] = -1 (UNKNOWN_POLY)
+    d.assign((size_t)n*n, 9999.9f);
+    p.assign((size_t)n*n, BattleGraph::UNKNOWN_POLY);
     for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<n; j++)
+        d[i*n+i] = 0.0f;
+        for (unsigned int k = m_adjacency_start[i];
+                          k < m_adjacency_start[i+1]; k++)
         {
-            if(i == j || m_distance_matrix[i][j]>=9899.9f) m_parent_poly[i][j]=-1;
-            else    m_parent_poly[i][j] = i;
+            d[i*n+m_adjacency[k].first] = m_adjacency[k].second;
+            p[i*n+m_adjacency[k].first] = i;
         }
     }
 
@@ -197,10 +252,10 @@ void BattleGraph::computeFloydWarshall()
         {
             for(unsigned int j=0; j<n; j++)
             {
-                if( (m_distance_matrix[i][k] + m_distance_matrix[k][j]) < m_distance_matrix[i][j])
+                if( (d[i*n+k] + d[k*n+j]) < d[i*n+j])
                 {
-                    m_distance_matrix[i][j] = m_distance_matrix[i][k] + m_distance_matrix[k][j];
-                    m_parent_poly[i][j] = m_parent_poly[k][j];
+                    d[i*n+j] = d[i*n+k] + d[k*n+j];
+                    p[i*n+j] = p[k*n+j];
                 }
             }
         }
@@ -208,6 +263,117 @@ void BattleGraph::computeFloydWarshall()
 
 }    // computeFloydWarshall
 
+// ----------------------------------------------------------------------------
+/** Returns a hash (FNV-1a) of the contents of the navmesh file. It is used
+ *  to detect if cached shortest paths are still valid.
+ */
+uint64_t BattleGraph::getNavMeshHash() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    // Read the file through the irrlicht file system, since it can be in
+    // a mounted addon package.
+    io::IReadFile *file = file_manager->getFileSystem()
+                        ->createAndOpenFile(m_navmesh_file.c_str());
+    if (!file)
+        return hash;
+    std::vector<char> buffer(64*1024);
+    s32 n;
+    while ((n = file->read(&buffer[0], (u32)buffer.size())) > 0)
+    {
+        for (s32 k = 0; k < n; k++)
+            hash = (hash ^ (unsigned char)buffer[k]) * 1099511628211ULL;
+    }
+    file->drop();
+    return hash;
+}   // getNavMeshHash
+
+// ----------------------------------------------------------------------------
+/** Returns the name of the file the shortest paths are cached in. The track
+ *  directory itself might not be writable, so the file is stored in the
+ *  cached-textures directory, named after the track directory.
+ */
+std::string BattleGraph::getCacheFileName() const
+{
+    const std::string track =
+        StringUtils::getBasename(StringUtils::getPath(m_navmesh_file));
+    return file_manager->getCachedTexturesDir() + "battlegraph-" + track
+         + ".bin";
+}   // getCacheFileName
+
+// ----------------------------------------------------------------------------
+/** Tries to load cached shortest paths. The file starts with a small header
+ *  (magic, version, number of nodes and hash of the navmesh file), followed
+ *  by the distance and the parent poly tables. The header must match the
+ *  current navmesh, otherwise the file is ignored.
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the current navmesh file.
+ *  \return True if the shortest paths were loaded.
+ */
+bool BattleGraph::loadShortestPaths(const std::string &filename,
+                                    uint64_t hash)
+{
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+
+    char magic[4];
+    uint32_t version = 0, num_nodes = 0;
+    uint64_t file_hash = 0;
+    bool ok = fread(magic, 1, 4, f) == 4 &&
+              fread(&version, sizeof(version), 1, f) == 1 &&
+              fread(&num_nodes, sizeof(num_nodes), 1, f) == 1 &&
+              fread(&file_hash, sizeof(file_hash), 1, f) == 1;
+    ok = ok && memcmp(magic, "STKB", 4) == 0 && version == 1 &&
+         num_nodes == m_num_nodes && file_hash == hash;
+
+    if (ok)
+    {
+        const size_t size = (size_t)m_num_nodes*m_num_nodes;
+        m_distance.resize(size);
+        m_parent_poly.resize(size);
+        ok = fread(&m_distance[0],    sizeof(uint16_t), size, f) == size &&
+             fread(&m_parent_poly[0], sizeof(uint16_t), size, f) == size;
+        if (!ok)
+        {
+            Log::warn("BattleGraph", "Shortest path cache '%s' is truncated.",
+                      filename.c_str());
+            m_distance.clear();
+            m_parent_poly.clear();
+        }
+    }
+    fclose(f);
+    if (ok)
+        Log::verbose("BattleGraph", "Shortest paths loaded from '%s'.",
+                     filename.c_str());
+    return ok;
+}   // loadShortestPaths
+
+// ----------------------------------------------------------------------------
+/** Saves the shortest paths so that they can be loaded the next time this
+ *  arena is used. See loadShortestPaths for the format.
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the current navmesh file.
+ */
+void BattleGraph::saveShortestPaths(const std::string &filename,
+                                    uint64_t hash) const
+{
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+    {
+        Log::warn("BattleGraph", "Can't write shortest path cache '%s'.",
+                  filename.c_str());
+        return;
+    }
+    const uint32_t version = 1, num_nodes = m_num_nodes;
+    const size_t size = (size_t)m_num_nodes*m_num_nodes;
+    fwrite("STKB", 1, 4, f);
+    fwrite(&version, sizeof(version), 1, f);
+    fwrite(&num_nodes, sizeof(num_nodes), 1, f);
+    fwrite(&hash, sizeof(hash), 1, f);
+    fwrite(&m_distance[0],    sizeof(uint16_t), size, f);
+    fwrite(&m_parent_poly[0], sizeof(uint16_t), size, f);
+    fclose(f);
+}   // saveShortestPaths
 // -----------------------------------------------------------------------------
 /** Maps items on battle graph */
 void BattleGraph::findItemsOnGraphNodes()
@@ -347,42 +513,113 @@ void BattleGraph::loadGoalNodes(const XMLNode *node)
  *  Instead of using hand-tuned test cases we use the tested, verified and
  *  easier to understand Floyd-Warshall algorithm to compute the distances,
  *  and check if the (significanty faster) Dijkstra algorithm gives the same
- *  results. For now we use the cave mesh as test case.
+ *  results. It also checks that the parallel computation and the cache file
+ *  give exactly the same tables as the sequential computation, and prints
+ *  the timings of all versions. For now we use the cave mesh as test case.
  */
 void BattleGraph::unitTesting()
 {
     Track *track = track_manager->getTrack("cave");
     std::string navmesh_file_name=track->getTrackFile("navmesh.xml");
 
-    double s = StkTime::getRealTime();
     BattleGraph *bg = new BattleGraph(navmesh_file_name);
+    const unsigned int n = bg->m_num_nodes;
+    Log::info("BattleGraph", "%d nodes, tables use %d bytes (%d bytes with "
+              "float distances and int parents).", n,
+              (int)(2*n*n*sizeof(uint16_t)),
+              (int)(n*n*(sizeof(float)+sizeof(int))));
+
+    double s = StkTime::getRealTime();
+    bg->computeShortestPaths(/*parallel*/false);
     double e = StkTime::getRealTime();
     Log::error("Time", "Dijkstra       %lf", e-s);
 
     // Save the Dijkstra results
-    std::vector< std::vector< float > > distance_matrix = bg->m_distance_matrix;
-    std::vector< std::vector< int > > parent_poly = bg->m_parent_poly;
-    bg->buildGraph(NavMesh::get());
+    std::vector<uint16_t> distance    = bg->m_distance;
+    std::vector<uint16_t> parent_poly = bg->m_parent_poly;
+
+    s = StkTime::getRealTime();
+    bg->computeShortestPaths(/*parallel*/true);
+    e = StkTime::getRealTime();
+    Log::error("Time", "Dijkstra (par) %lf", e-s);
+    if(bg->m_distance != distance || bg->m_parent_poly != parent_poly)
+        Log::error("BattleGraph", "Parallel Dijkstra gives different results.");
+
+    // Check that the cache gives the same tables
+    const std::string cache_file = file_manager->getCachedTexturesDir()
+                                 + "battlegraph-unit-test.bin";
+    bg->saveShortestPaths(cache_file, 1234);
+    bg->m_distance.clear();
+    bg->m_parent_poly.clear();
+    s = StkTime::getRealTime();
+    bool loaded = bg->loadShortestPaths(cache_file, 1234);
+    e = StkTime::getRealTime();
+    Log::error("Time", "Cache loading  %lf", e-s);
+    if(!loaded || bg->m_distance != distance ||
+        bg->m_parent_poly != parent_poly)
+        Log::error("BattleGraph", "Cached shortest paths are different.");
+    if(bg->loadShortestPaths(cache_file, 4321))
+        Log::error("BattleGraph", "Cache with a different hash was loaded.");
+    file_manager->removeFile(cache_file);
 
     // Now compute results with Floyd-Warshall
+    std::vector<float> fw_distance;
+    std::vector<int>   fw_parent_poly;
     s = StkTime::getRealTime();
-    bg->computeFloydWarshall();
+    bg->computeFloydWarshall(&fw_distance, &fw_parent_poly);
     e = StkTime::getRealTime();
     Log::error("Time", "Floyd-Warshall %lf", e-s);
 
+    // Distances are rounded to the nearest multiple of 1/DISTANCE_SCALE
+    const float max_error = 0.5f/DISTANCE_SCALE + 0.001f;
     int error_count = 0;
-    for(unsigned int i=0; i<bg->m_distance_matrix.size(); i++)
+    for(unsigned int i=0; i<n; i++)
     {
-        for(unsigned int j=0; j<bg->m_distance_matrix[i].size(); j++)
+        for(unsigned int j=0; j<n; j++)
         {
-            if(bg->m_distance_matrix[i][j] - distance_matrix[i][j] > 0.001f)
+            const float fw = fw_distance[i*n+j];
+            if(fw >= 9899.9f)
+            {
+                if(distance[i*n+j] != NO_PATH)
+                {
+                    Log::error("BattleGraph", "Path %d, %d should not exist.",
+                               i, j);
+                    error_count++;
+                }
+                continue;
+            }
+            if(fabsf(bg->getDistance(i, j) - fw) > max_error)
             {
                 Log::error("BattleGraph",
                            "Incorrect distance %d, %d: Dijkstra: %f F.W.: %f",
-                           i, j, distance_matrix[i][j], bg->m_distance_matrix[i][j]);
+                           i, j, bg->getDistance(i, j), fw);
                 error_count++;
             }    // if distance is too different
 
+            // Follow the path from i to j, its length must be the (not
+            // quantized) shortest distance.
+            float length = 0.0f;
+            int cur = i;
+            while(cur != (int)j)
+            {
+                const int next = bg->getNextShortestPathPoly(cur, j);
+                if(next == UNKNOWN_POLY) break;
+                for(unsigned int k  = bg->m_adjacency_start[cur];
+                                 k  < bg->m_adjacency_start[cur+1]; k++)
+                {
+                    if(bg->m_adjacency[k].first == next)
+                        length += bg->m_adjacency[k].second;
+                }
+                cur = next;
+            }
+            if(cur != (int)j || fabsf(length - fw) > 0.01f)
+            {
+                Log::error("BattleGraph",
+                           "Incorrect path %d, %d: length %f F.W.: %f",
+                           i, j, length, fw);
+                error_count++;
+            }
+
             // Unortunately it happens frequently that there are different
             // shortest path with the same length. And Dijkstra might find
             // a different path then Floyd-Warshall. So the test for parent
@@ -391,16 +628,27 @@ void BattleGraph::unitTesting()
             // debugging in the feature
 #undef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
 #ifdef TEST_PARENT_POLY_EVEN_THOUGH_MANY_FALSE_POSITIVES
-            if(bg->m_parent_poly[i][j] != parent_poly[i][j])
+            const int dijkstra_parent = parent_poly[i*n+j] == NO_PATH
+                                      ? UNKNOWN_POLY : parent_poly[i*n+j];
+            if(fw_parent_poly[i*n+j] != dijkstra_parent)
             {
                 error_count++;
-                std::vector<int> dijkstra_path = getPathFromTo(i, j, parent_poly);
-                std::vector<int> floyd_path = getPathFromTo(i, j, bg->m_parent_poly);
+                std::vector<int> dijkstra_parent_poly(parent_poly.begin(),
+                                                      parent_poly.end());
+                for(unsigned int k=0; k<dijkstra_parent_poly.size(); k++)
+                {
+                    if(dijkstra_parent_poly[k] == NO_PATH)
+                        dijkstra_parent_poly[k] = UNKNOWN_POLY;
+                }
+                std::vector<int> dijkstra_path =
+                    getPathFromTo(i, j, dijkstra_parent_poly, n);
+                std::vector<int> floyd_path =
+                    getPathFromTo(i, j, fw_parent_poly, n);
                 if(dijkstra_path.size()!=floyd_path.size())
                 {
                     Log::error("BattleGraph",
                                "Incorrect path length %d, %d: Dijkstra: %d F.W.: %d",
-                               i, j, parent_poly[i][j], bg->m_parent_poly[i][j]);
+                               i, j, dijkstra_parent, fw_parent_poly[i*n+j]);
                     continue;
                 }
                 Log::error("BattleGraph", "Path problems from %d to %d:",
@@ -417,20 +665,25 @@ void BattleGraph::unitTesting()
 #endif 
         }   // for j
     }   // for i
+    if(error_count > 0)
+        Log::error("BattleGraph", "%d errors found.", error_count);
 }   // unitTesting
 
 // ----------------------------------------------------------------------------
 /** Determines the full path from 'from' to 'to' and returns it in a 
  *  std::vector (in reverse order). Used only for unit testing.
+ *  \param parent_poly Parent table with n*n entries, see computeDijkstra.
+ *  \param n Number of nodes.
  */
 std::vector<int> BattleGraph::getPathFromTo(int from, int to, 
-                           const std::vector< std::vector< int > > parent_poly)
+                                            const std::vector<int> &parent_poly,
+                                            unsigned int n)
 {
     std::vector<int> path;
     path.push_back(to);
     while(from!=to)
     {
-        to = parent_poly[from][to];
+        to = parent_poly[from*n+to];
         path.push_back(to);
     }
     return path;
@@ -446,15 +699,20 @@ void BattleGraph::sortNearbyQuad()
 
     for (unsigned int i = 0; i < this->getNumNodes(); i++)
     {
-        // Get the distance to all nodes at i
-        std::vector<float> dist = m_distance_matrix[i];
-        for (unsigned int j = 0; j < n; j++)
+        // Get the distance to all nodes at i. The node itself must be the
+        // first entry, even if a quad at distance 0 (after rounding) comes
+        // first.
+        std::vector<uint16_t> dist(m_distance.begin() + i*m_num_nodes,
+                                   m_distance.begin() + (i+1)*m_num_nodes);
+        m_nearby_quads[i][0] = i;
+        dist[i] = NO_PATH;
+        for (unsigned int j = 1; j < n; j++)
         {
-            std::vector<float>::iterator it =
+            std::vector<uint16_t>::iterator it =
                 std::min_element(dist.begin(), dist.end());
             const int pos = it - dist.begin();
             m_nearby_quads[i][j] = pos;
-            dist[pos] = 999999.0f;
+            dist[pos] = NO_PATH;
         }
     }
 }   // sortNearbyQuad
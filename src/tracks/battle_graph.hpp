@@ -25,6 +25,7 @@
 
 #include "tracks/graph_structure.hpp"
 #include "tracks/navmesh.hpp"
+#include "utils/types.hpp"
 
 class Item;
 class ItemManager;
@@ -46,10 +47,28 @@ class BattleGraph : public GraphStructure
 private:
     static BattleGraph        *m_battle_graph;
 
-    /** The actual graph data structure, it is an adjacency matrix */
-    std::vector< std::vector< float > > m_distance_matrix;
-    /** The matrix that is used to store computed shortest paths */
-    std::vector< std::vector< int > > m_parent_poly;
+    /** Distances are stored in units of 1/DISTANCE_SCALE. */
+    static const float    DISTANCE_SCALE;
+    /** Entry in m_parent_poly and m_distance for 'no path'. */
+    static const uint16_t NO_PATH = 0xffff;
+
+    /** Number of nodes, i.e. the length of one row of the tables below. */
+    unsigned int m_num_nodes;
+
+    /** The graph data structure as compressed adjacency lists: the
+     *  neighbours of node i (and the distance to them) are stored in
+     *  m_adjacency[m_adjacency_start[i]] to
+     *  m_adjacency[m_adjacency_start[i+1]-1]. */
+    std::vector< unsigned int > m_adjacency_start;
+    std::vector< std::pair<int, float> > m_adjacency;
+
+    /** Shortest path distance from i to j, stored at i*m_num_nodes+j and
+     *  quantized to 1/DISTANCE_SCALE. */
+    std::vector< uint16_t > m_distance;
+
+    /** The last node before j on the shortest path from i to j, stored at
+     *  i*m_num_nodes+j. */
+    std::vector< uint16_t > m_parent_poly;
 
     std::vector< std::vector< int > > m_nearby_quads;
 
@@ -62,7 +81,13 @@ private:
     std::set<int> m_blue_node;
 
     void buildGraph(NavMesh*);
-    void computeFloydWarshall();
+    void computeShortestPaths(bool parallel);
+    void computeFloydWarshall(std::vector<float> *distance,
+                              std::vector<int> *parent_poly) const;
+    uint64_t getNavMeshHash() const;
+    std::string getCacheFileName() const;
+    bool loadShortestPaths(const std::string &filename, uint64_t hash);
+    void saveShortestPaths(const std::string &filename, uint64_t hash) const;
     void loadGoalNodes(const XMLNode *node);
     void sortNearbyQuad();
 
@@ -82,9 +107,10 @@ private:
                                                             { return false; }
     // ------------------------------------------------------------------------
     virtual const bool differentNodeColor(int n, NodeColor* c) const;
-    void computeDijkstra(int n);
-    static std::vector<int> getPathFromTo(int from, int to, 
-                          const std::vector< std::vector< int > > parent_poly);
+    void computeDijkstra(int source, std::vector<float> *distance);
+    static std::vector<int> getPathFromTo(int from, int to,
+                                          const std::vector<int> &parent_poly,
+                                          unsigned int n);
 
 public:
     static const int UNKNOWN_POLY;
@@ -131,7 +157,7 @@ public:
         if (from == BattleGraph::UNKNOWN_POLY ||
             to == BattleGraph::UNKNOWN_POLY)
             return 0.0f;
-        return m_distance_matrix[from][to];
+        return m_distance[from*m_num_nodes + to] / DISTANCE_SCALE;
     }
     // ------------------------------------------------------------------------
     /** Returns the next polygon on the shortest path from i to j.
@@ -142,7 +168,8 @@ public:
     {
         if (i == BattleGraph::UNKNOWN_POLY || j == BattleGraph::UNKNOWN_POLY)
             return BattleGraph::UNKNOWN_POLY;
-        return m_parent_poly[j][i];
+        const uint16_t parent = m_parent_poly[j*m_num_nodes + i];
+        return parent == NO_PATH ? BattleGraph::UNKNOWN_POLY : parent;
     }
     // ------------------------------------------------------------------------
     std::vector<std::pair<const Item*, int>>& getItemList()
@@ -26,6 +26,7 @@
 #include "modes/linear_world.hpp"
 #include "modes/world.hpp"
 #include "race/race_manager.hpp"
+#include "tracks/check_manager.hpp"
 
 #include "irrlicht.h"
 
@@ -42,6 +43,7 @@ CheckLine::CheckLine(const XMLNode &node,  unsigned int index)
     // Note that when this is called the karts have not been allocated
     // in world, so we can't call world->getNumKarts()
     m_previous_sign.resize(race_manager->getNumberOfKarts());
+    m_line_index = -1;
     std::string p1_string("p1");
     std::string p2_string("p2");
 
@@ -166,7 +168,11 @@ bool CheckLine::isTriggered(const Vec3 &old_pos, const Vec3 &new_pos,
 {
     World* w = World::getWorld();
     core::vector2df p=new_pos.toIrrVector2d();
-    bool sign = m_line.getPointOrientation(p)>=0;
+    // The check manager computes the side of all lines for all karts
+    // at once at the start of each update.
+    bool sign = m_line_index>=0 && (int)kart_index!=-1
+              ? CheckManager::get()->getLineSign(m_line_index, kart_index)
+              : m_line.getPointOrientation(p)>=0;
     bool result;
 
     bool previous_sign;
@@ -64,6 +64,10 @@ private:
     /** Used to display debug information about checklines. */
     scene::IMeshSceneNode *m_debug_node;
 
+    /** Index of this line in the line arrays of the check manager, or -1
+     *  if it is not managed there. */
+    int             m_line_index;
+
     /** How much a kart is allowed to be under the minimum height of a
      *  quad and still considered to be able to cross it. */
     static const int m_under_min_height = 1;
@@ -81,6 +85,10 @@ public:
     /** Returns the actual line data for this checkpoint. */
     const core::line2df &getLine2D() const {return m_line;}
     // ------------------------------------------------------------------------
+    /** Sets the index of this line in the line arrays of the check
+     *  manager. */
+    void setLineIndex(int index) { m_line_index = index; }
+    // ------------------------------------------------------------------------
     /** Returns the 2d point at which the line was crossed. Note that this
      *  value is ONLY valid after isTriggered is called and inside of
      *  trigger(). */
@@ -21,14 +21,20 @@
 #include <string>
 #include <algorithm>
 
+#include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
+#include "karts/abstract_kart.hpp"
+#include "modes/world.hpp"
 #include "tracks/ambient_light_sphere.hpp"
 #include "tracks/check_cannon.hpp"
 #include "tracks/check_goal.hpp"
 #include "tracks/check_lap.hpp"
 #include "tracks/check_line.hpp"
 #include "tracks/check_structure.hpp"
+#include "tracks/quad_graph.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/time.hpp"
 
 CheckManager *CheckManager::m_check_manager = NULL;
 
@@ -43,24 +49,24 @@ void CheckManager::load(const XMLNode &node)
         if(type=="check-line")
         {
             CheckLine *cl = new CheckLine(*check_node, i);
-            m_all_checks.push_back(cl);
+            add(cl);
         }   // checkline
         else if(type=="check-lap")
         {
-            m_all_checks.push_back(new CheckLap(*check_node, i));
+            add(new CheckLap(*check_node, i));
         }
         else if(type=="cannon")
         {
-            m_all_checks.push_back(new CheckCannon(*check_node, i));
+            add(new CheckCannon(*check_node, i));
         }
         else if(type=="goal")
         {
-            m_all_checks.push_back(new CheckGoal(*check_node, i));
+            add(new CheckGoal(*check_node, i));
         }
         else if(type=="check-sphere")
         {
             CheckSphere *cs = new CheckSphere(*check_node, i);
-            m_all_checks.push_back(cs);
+            add(cs);
         }   // checksphere
         else
             Log::warn("CheckManager", "Unknown check structure '%s' - ignored.", type.c_str());
@@ -93,6 +99,74 @@ void CheckManager::load(const XMLNode &node)
     }
 }   // load
 
+// ----------------------------------------------------------------------------
+/** Adds a check structure. Check lines (including cannons) are also added
+ *  to the line arrays.
+ *  \param strct The check structure to add.
+ */
+void CheckManager::add(CheckStructure* strct)
+{
+    m_all_checks.push_back(strct);
+    CheckLine *line = dynamic_cast<CheckLine*>(strct);
+    if(line)
+        addLine(line);
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Adds a check line to the line arrays.
+ *  \param line The check line to add.
+ */
+void CheckManager::addLine(CheckLine *line)
+{
+    line->setLineIndex(m_lines.size());
+    m_lines.add(line);
+}   // addLine
+
+// ----------------------------------------------------------------------------
+/** Adds the start point and direction of a check line to the arrays.
+ *  \param line The check line.
+ */
+void CheckManager::LineArrays::add(const CheckLine *line)
+{
+    const core::line2df &l = line->getLine2D();
+    m_start_x.push_back(l.start.X);
+    m_start_z.push_back(l.start.Y);
+    m_delta_x.push_back(l.end.X - l.start.X);
+    m_delta_z.push_back(l.end.Y - l.start.Y);
+}   // LineArrays::add
+
+// ----------------------------------------------------------------------------
+/** Computes for each line and each kart if the kart is on or to the right
+ *  of the line. This is the same computation as
+ *  core::line2df::getPointOrientation(p)>=0 (with the same order of
+ *  operations, so the results are identical), but done for all lines
+ *  and karts in one loop that the compiler can vectorise.
+ *  \param lines The check lines.
+ *  \param num_karts Number of karts.
+ *  \param kart_x, kart_z X and Z coordinates of the karts.
+ *  \param signs On return signs[line*num_karts+kart] is 1 if the kart is
+ *         on or to the right of the line, 0 otherwise.
+ */
+void CheckManager::computeLineSigns(const LineArrays &lines,
+                                    unsigned int num_karts,
+                                    const float *kart_x, const float *kart_z,
+                                    uint8_t *signs)
+{
+    for(unsigned int l=0; l<lines.size(); l++)
+    {
+        const float start_x = lines.m_start_x[l];
+        const float start_z = lines.m_start_z[l];
+        const float delta_x = lines.m_delta_x[l];
+        const float delta_z = lines.m_delta_z[l];
+        uint8_t *line_signs = signs + l*num_karts;
+        for(unsigned int k=0; k<num_karts; k++)
+        {
+            line_signs[k] = delta_x*(kart_z[k]-start_z)
+                          - (kart_x[k]-start_x)*delta_z >= 0.0f;
+        }
+    }   // for l < lines.size()
+}   // computeLineSigns
+
 // ----------------------------------------------------------------------------
 /** Private destructor (to make sure it is only called using the static
  *  destroy function). Frees all check structures.
@@ -122,6 +196,23 @@ void CheckManager::reset(const Track &track)
  */
 void CheckManager::update(float dt)
 {
+    // First compute on which side of all check lines the karts are, so
+    // that the check lines only need to look up the result.
+    World *world = World::getWorld();
+    const unsigned int num_karts = world->getNumKarts();
+    m_kart_x.resize(num_karts);
+    m_kart_z.resize(num_karts);
+    for(unsigned int k=0; k<num_karts; k++)
+    {
+        const Vec3 &xyz = world->getKart(k)->getFrontXYZ();
+        m_kart_x[k] = xyz.getX();
+        m_kart_z[k] = xyz.getZ();
+    }
+    m_line_sign.resize(m_lines.size()*num_karts);
+    if(m_line_sign.size()>0)
+        computeLineSigns(m_lines, num_karts, &m_kart_x[0], &m_kart_z[0],
+                         &m_line_sign[0]);
+
     std::vector<CheckStructure*>::iterator i;
     for(i=m_all_checks.begin(); i!=m_all_checks.end(); i++)
         (*i)->update(dt);
@@ -173,3 +264,114 @@ int CheckManager::getChecklineTriggering(const Vec3 &from,
     }
     return -1;
 }   // getChecklineTriggering
+
+// ----------------------------------------------------------------------------
+/** Unit testing for the line arrays. For each race track 30 karts are moved
+ *  along the driveline (at different offsets), and the side of each check
+ *  line of the track is computed once with getPointOrientation for each
+ *  line and kart (as CheckLine::isTriggered did), and once with
+ *  computeLineSigns. The results must be identical.
+ */
+void CheckManager::unitTesting()
+{
+    const unsigned int num_karts = 30;
+    for(unsigned int t=0; t<track_manager->getNumberOfTracks(); t++)
+    {
+        const Track *track = track_manager->getTrack(t);
+        if(track->isArena() || track->isSoccer() || track->isInternal())
+            continue;
+        XMLNode *scene =
+            file_manager->createXMLTree(track->getTrackFile("scene.xml"));
+        const XMLNode *checks = scene ? scene->getNode("checks") : NULL;
+        if(!checks)
+        {
+            delete scene;
+            continue;
+        }
+
+        std::vector<CheckLine*> all_lines;
+        LineArrays lines;
+        for(unsigned int i=0; i<checks->getNumNodes(); i++)
+        {
+            const XMLNode *node = checks->getNode(i);
+            if(node->getName()!="check-line") continue;
+            all_lines.push_back(new CheckLine(*node, i));
+            lines.add(all_lines.back());
+        }
+        delete scene;
+
+        // Positions following the driveline, 4 per graph node
+        QuadGraph::create(track->getTrackFile("quads.xml"),
+                          track->getTrackFile("graph.xml"), /*reverse*/false);
+        QuadGraph *qg = QuadGraph::get();
+        std::vector<Vec3> path;
+        unsigned int node = 0;
+        for(unsigned int n=0; n<qg->getNumNodes(); n++)
+        {
+            const GraphNode &gn = qg->getNode(node);
+            const unsigned int next = gn.getSuccessor(0);
+            const Vec3 center      = gn.getCenter();
+            const Vec3 next_center = qg->getNode(next).getCenter();
+            for(unsigned int s=0; s<4; s++)
+                path.push_back(center + (next_center-center)*(0.25f*s));
+            node = next;
+        }
+        QuadGraph::destroy();
+
+        std::vector<float> kart_x(num_karts), kart_z(num_karts);
+        std::vector<uint8_t> signs[2];
+        double time[2] = {0, 0};
+        for(unsigned int step=0; step<path.size(); step++)
+        {
+            for(unsigned int k=0; k<num_karts; k++)
+            {
+                const Vec3 &xyz = path[(step+k*7) % path.size()];
+                kart_x[k] = xyz.getX() + (float)(k%5) - 2.0f;
+                kart_z[k] = xyz.getZ() + (float)(k%3) - 1.0f;
+            }
+
+            const unsigned int offset = (unsigned int)signs[0].size();
+            signs[0].resize(offset + lines.size()*num_karts);
+            signs[1].resize(offset + lines.size()*num_karts);
+            if(lines.size()==0) continue;
+
+            double start = StkTime::getRealTime();
+            for(unsigned int l=0; l<all_lines.size(); l++)
+            {
+                const core::line2df &line = all_lines[l]->getLine2D();
+                for(unsigned int k=0; k<num_karts; k++)
+                {
+                    core::vector2df p(kart_x[k], kart_z[k]);
+                    signs[0][offset+l*num_karts+k] =
+                        line.getPointOrientation(p)>=0;
+                }
+            }
+            time[0] += StkTime::getRealTime() - start;
+
+            start = StkTime::getRealTime();
+            computeLineSigns(lines, num_karts, &kart_x[0], &kart_z[0],
+                             &signs[1][offset]);
+            time[1] += StkTime::getRealTime() - start;
+        }   // for step < path.size()
+
+        int error_count   = 0;
+        int sign_changes  = 0;
+        for(unsigned int i=0; i<signs[0].size(); i++)
+        {
+            if(signs[0][i]!=signs[1][i])
+                error_count++;
+            if(i>=lines.size()*num_karts &&
+                signs[0][i]!=signs[0][i-lines.size()*num_karts])
+                sign_changes++;
+        }
+        Log::info("CheckManager", "Track '%s', %d check lines, %d karts, "
+                  "%d steps, %d line crossings: per line %lf arrays %lf, "
+                  "%d errors.", track->getIdent().c_str(), lines.size(),
+                  num_karts, (int)path.size(), sign_changes, time[0], time[1],
+                  error_count);
+        assert(error_count==0);
+
+        for(unsigned int i=0; i<all_lines.size(); i++)
+            delete all_lines[i];
+    }   // for t < getNumberOfTracks
+}   // unitTesting
@@ -20,11 +20,13 @@
 #define HEADER_CHECK_MANAGER_HPP
 
 #include "utils/no_copy.hpp"
+#include "utils/types.hpp"
 
 #include <assert.h>
 #include <string>
 #include <vector>
 
+class CheckLine;
 class CheckStructure;
 class Track;
 class XMLNode;
@@ -37,14 +39,44 @@ class Vec3;
 class CheckManager : public NoCopy
 {
 private:
+    /** The start point and direction (in the XZ plane) of all check lines
+     *  (including cannons) in struct-of-arrays layout, so that the side of
+     *  each line each kart is on can be computed in one loop. */
+    struct LineArrays
+    {
+        std::vector<float> m_start_x, m_start_z;
+        std::vector<float> m_delta_x, m_delta_z;
+        void add(const CheckLine *line);
+        unsigned int size() const { return (unsigned int)m_start_x.size(); }
+    };   // LineArrays
+
     std::vector<CheckStructure*> m_all_checks;
     static CheckManager         *m_check_manager;
+
+    /** All check lines. */
+    LineArrays             m_lines;
+
+    /** The front positions of all karts, X and Z coordinates. */
+    std::vector<float>     m_kart_x, m_kart_z;
+
+    /** For each check line and kart if the kart is on or to the right of
+     *  the line, index is line*number_of_karts+kart. Computed at the start
+     *  of each update. */
+    std::vector<uint8_t>   m_line_sign;
+
+    void   addLine(CheckLine *line);
+    static void computeLineSigns(const LineArrays &lines,
+                                 unsigned int num_karts,
+                                 const float *kart_x, const float *kart_z,
+                                 uint8_t *signs);
+
            /** Private constructor, to make sure it is only called via
             *  the static create function. */
            CheckManager()       {m_all_checks.clear();};
           ~CheckManager();
 public:
-    void   add(CheckStructure* strct) { m_all_checks.push_back(strct); }
+    static void unitTesting();
+    void   add(CheckStructure* strct);
     void   load(const XMLNode &node);
     void   update(float dt);
     void   reset(const Track &track);
@@ -73,6 +105,16 @@ public:
         assert(n < m_all_checks.size());
         return m_all_checks[n];
     }
+    // ------------------------------------------------------------------------
+    /** Returns if a kart was on or to the right of a check line at the
+     *  start of the current update.
+     *  \param line Index of the check line (see CheckLine::getLineIndex).
+     *  \param kart World id of the kart. */
+    bool getLineSign(unsigned int line, unsigned int kart) const
+    {
+        assert(line*m_kart_x.size()+kart < m_line_sign.size());
+        return m_line_sign[line*m_kart_x.size()+kart]!=0;
+    }   // getLineSign
 };   // CheckManager
 
 #endif
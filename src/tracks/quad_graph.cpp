@@ -37,7 +37,12 @@
 #include "tracks/check_manager.hpp"
 #include "tracks/quad_set.hpp"
 #include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
 #include "graphics/glwrap.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 const int QuadGraph::UNKNOWN_SECTOR  = -1;
 QuadGraph *QuadGraph::m_quad_graph = NULL;
@@ -52,11 +57,13 @@ QuadGraph::QuadGraph(const std::string &quad_file_name,
                      const bool reverse) : m_reverse(reverse)
 {
     m_lap_length           = 0;
+    m_use_spatial_index    = true;
     QuadSet::create();
     QuadSet::get()->init(quad_file_name);
     m_quad_filename        = quad_file_name;
     m_quad_graph           = this;
     load(graph_file_name);
+    buildSpatialIndex();
 }   // QuadGraph
 
 // -----------------------------------------------------------------------------
@@ -215,6 +222,90 @@ unsigned int QuadGraph::getStartNode() const
                      : 0;
 }   // getStartNode
 
+// ----------------------------------------------------------------------------
+/** Builds the 2d grid used to speed up findRoadSector() and
+ *  findOutOfRoadSector(). Each graph node is added to all cells which are
+ *  overlapped by the 2d bounding box of its quad. The cell size is based on
+ *  the average quad size, so that a cell only contains a few graph nodes.
+ */
+void QuadGraph::buildSpatialIndex()
+{
+    m_grid_cells.clear();
+    m_grid_width  = 0;
+    m_grid_height = 0;
+    if(m_all_nodes.empty())
+        return;
+
+    // A small margin to make sure that rounding errors can not result in
+    // a point of a quad being outside of the cells the quad is stored in.
+    const float MARGIN = 0.01f;
+
+    std::vector<Vec3> node_min(m_all_nodes.size());
+    std::vector<Vec3> node_max(m_all_nodes.size());
+    Vec3 all_min( 999999.9f), all_max(-999999.9f);
+    float total_size = 0;
+    for(unsigned int i=0; i<m_all_nodes.size(); i++)
+    {
+        const Quad &q = getQuadOfNode(i);
+        node_min[i] = q[0];
+        node_max[i] = q[0];
+        for(unsigned int j=1; j<4; j++)
+        {
+            node_min[i].min(q[j]);
+            node_max[i].max(q[j]);
+        }
+        node_min[i] -= Vec3(MARGIN);
+        node_max[i] += Vec3(MARGIN);
+        all_min.min(node_min[i]);
+        all_max.max(node_max[i]);
+        total_size += std::max(node_max[i].getX() - node_min[i].getX(),
+                               node_max[i].getZ() - node_min[i].getZ());
+    }
+
+    // Limit the number of cells in each direction, otherwise a track with
+    // a few very small quads far apart would create a huge grid.
+    const int MAX_CELLS = 256;
+    float width  = all_max.getX() - all_min.getX();
+    float height = all_max.getZ() - all_min.getZ();
+    m_grid_cell_size = std::max(total_size/m_all_nodes.size(), 1.0f);
+    m_grid_cell_size = std::max(m_grid_cell_size,
+                                std::max(width, height)/MAX_CELLS);
+    m_grid_min_x     = all_min.getX();
+    m_grid_min_z     = all_min.getZ();
+    m_grid_width     = (int)(width  / m_grid_cell_size) + 1;
+    m_grid_height    = (int)(height / m_grid_cell_size) + 1;
+    m_grid_cells.resize(m_grid_width*m_grid_height);
+
+    for(unsigned int i=0; i<m_all_nodes.size(); i++)
+    {
+        int x0, z0, x1, z1;
+        getGridCell(node_min[i].getX(), node_min[i].getZ(), &x0, &z0);
+        getGridCell(node_max[i].getX(), node_max[i].getZ(), &x1, &z1);
+        x0 = std::max(x0, 0);   x1 = std::min(x1, m_grid_width -1);
+        z0 = std::max(z0, 0);   z1 = std::min(z1, m_grid_height-1);
+        for(int z=z0; z<=z1; z++)
+        {
+            for(int x=x0; x<=x1; x++)
+                m_grid_cells[z*m_grid_width+x].push_back(i);
+        }
+    }   // for i<m_all_nodes.size()
+}   // buildSpatialIndex
+
+// ----------------------------------------------------------------------------
+/** Returns the grid cell for a 2d position. The result is not clamped to the
+ *  grid size, except that points far outside of the grid are mapped to the
+ *  cells just outside of the grid (to avoid integer overflows).
+ *  \param x, z The coordinates of the point.
+ *  \param cell_x, cell_z On return the cell indices.
+ */
+void QuadGraph::getGridCell(float x, float z, int *cell_x, int *cell_z) const
+{
+    float fx = floorf((x - m_grid_min_x) / m_grid_cell_size);
+    float fz = floorf((z - m_grid_min_z) / m_grid_cell_size);
+    *cell_x = (int)std::max(-1.0f, std::min(fx, (float)m_grid_width ));
+    *cell_z = (int)std::max(-1.0f, std::min(fz, (float)m_grid_height));
+}   // getGridCell
+
 // ----------------------------------------------------------------------------
 /** Sets the checkline requirements for all nodes in the graph.
  */
@@ -646,6 +737,14 @@ void QuadGraph::findRoadSector(const Vec3& xyz, int *sector,
         return;
     }   // if still on same quad
 
+    // Without a list of sectors to test, the grid can be used to only test
+    // the quads that overlap the position.
+    if(!all_sectors && m_use_spatial_index && !m_grid_cells.empty())
+    {
+        findRoadSectorInGrid(xyz, sector);
+        return;
+    }
+
     // Now we search through all graph nodes, starting with
     // the current one
     int indx       = *sector;
@@ -684,6 +783,48 @@ void QuadGraph::findRoadSector(const Vec3& xyz, int *sector,
     return;
 }   // findRoadSector
 
+//-----------------------------------------------------------------------------
+/** Same as the loop over all graph nodes in findRoadSector, but only the
+ *  graph nodes in the grid cell containing xyz are tested. To get identical
+ *  results, if two quads have the same height difference the one that
+ *  would have been found first by the linear search (which starts after the
+ *  previous sector) is used.
+ *  \param xyz Position for which the segment should be determined.
+ *  \param sector Contains the previous sector, and on return the result.
+ */
+void QuadGraph::findRoadSectorInGrid(const Vec3& xyz, int *sector) const
+{
+    const int num_nodes = (int)m_all_nodes.size();
+    // Index of the node the linear search would test first
+    const int first     = (*sector + 1) % num_nodes;
+    *sector = UNKNOWN_SECTOR;
+
+    int cell_x, cell_z;
+    getGridCell(xyz.getX(), xyz.getZ(), &cell_x, &cell_z);
+    if(cell_x<0 || cell_x>=m_grid_width || cell_z<0 || cell_z>=m_grid_height)
+        return;
+
+    const std::vector<int> &cell = m_grid_cells[cell_z*m_grid_width+cell_x];
+    float min_dist  = 999999.9f;
+    int   min_order = num_nodes;
+    for(unsigned int i=0; i<cell.size(); i++)
+    {
+        const int indx = cell[i];
+        const Quad &q  = getQuadOfNode(indx);
+        float dist     = xyz.getY() - q.getMinHeight();
+        if(dist <= -1.0f || dist > min_dist)
+            continue;
+        const int order = (indx - first + num_nodes) % num_nodes;
+        if(dist == min_dist && (*sector==UNKNOWN_SECTOR || order > min_order))
+            continue;
+        if(!q.pointInQuad(xyz))
+            continue;
+        min_dist  = dist;
+        min_order = order;
+        *sector   = indx;
+    }   // for i<cell.size()
+}   // findRoadSectorInGrid
+
 //-----------------------------------------------------------------------------
 /** findOutOfRoadSector finds the sector where XYZ is, but as it name
     implies, it is more accurate for the outside of the track than the
@@ -740,6 +881,21 @@ int QuadGraph::findOutOfRoadSector(const Vec3& xyz,
         if(current_sector<0) current_sector += getNumNodes();
     }
 
+    if(!all_sectors && m_use_spatial_index && !m_grid_cells.empty())
+    {
+        const int first = ((current_sector+1) % (int)getNumNodes()
+                          + getNumNodes()                        )
+                        % getNumNodes();
+        for(int phase=0; phase<2; phase++)
+        {
+            int sector = findNearestNodeInGrid(xyz, first, phase==0);
+            if(sector!=UNKNOWN_SECTOR)
+                return sector;
+        }
+        Log::info("Quad Grap", "unknown sector found.");
+        return UNKNOWN_SECTOR;
+    }
+
     int   min_sector = UNKNOWN_SECTOR;
     float min_dist_2 = 999999.0f*999999.0f;
 
@@ -789,3 +945,168 @@ int QuadGraph::findOutOfRoadSector(const Vec3& xyz,
     }
     return min_sector;
 }   // findOutOfRoadSector
+
+//-----------------------------------------------------------------------------
+/** Finds the graph node whose driveline segment is closest to xyz (in 2d),
+ *  using the grid: the cells are searched in rings of increasing distance
+ *  around the cell containing xyz, until no cell further away can contain
+ *  a closer node. If two nodes have the same distance, the node that the
+ *  linear search in findOutOfRoadSector would find first is returned.
+ *  \param xyz The position for which to find the closest graph node.
+ *  \param first_node The node that would be tested first by the linear
+ *         search.
+ *  \param test_height If the node must be at a height similar to xyz.
+ */
+int QuadGraph::findNearestNodeInGrid(const Vec3& xyz, int first_node,
+                                     bool test_height) const
+{
+    const int num_nodes = (int)m_all_nodes.size();
+    int cell_x, cell_z;
+    getGridCell(xyz.getX(), xyz.getZ(), &cell_x, &cell_z);
+    const int max_ring = std::max(std::max(cell_x, m_grid_width -1-cell_x),
+                                  std::max(cell_z, m_grid_height-1-cell_z));
+    // Position of xyz relative to the grid origin
+    const float px = xyz.getX() - m_grid_min_x;
+    const float pz = xyz.getZ() - m_grid_min_z;
+
+    int   min_sector = UNKNOWN_SECTOR;
+    int   min_order  = num_nodes;
+    float min_dist_2 = 999999.0f*999999.0f;
+    for(int ring=0; ring<=max_ring; ring++)
+    {
+        for(int z=cell_z-ring; z<=cell_z+ring; z++)
+        {
+            if(z<0 || z>=m_grid_height) continue;
+            // Inside of the ring only the first and last cell are new.
+            const bool full_row = z==cell_z-ring || z==cell_z+ring;
+            const int  step     = full_row ? 1 : std::max(2*ring, 1);
+            for(int x=cell_x-ring; x<=cell_x+ring; x+=step)
+            {
+                if(x<0 || x>=m_grid_width) continue;
+                const std::vector<int> &cell = m_grid_cells[z*m_grid_width+x];
+                for(unsigned int i=0; i<cell.size(); i++)
+                {
+                    const int indx = cell[i];
+                    float dist_2 =
+                        m_all_nodes[indx]->getDistance2FromPoint(xyz);
+                    if(dist_2 > min_dist_2)
+                        continue;
+                    const int order = (indx-first_node+num_nodes)%num_nodes;
+                    if(dist_2 == min_dist_2 &&
+                        (min_sector==UNKNOWN_SECTOR || order >= min_order))
+                        continue;
+                    if(test_height)
+                    {
+                        float dist = xyz.getY()
+                                   - getQuadOfNode(indx).getMinHeight();
+                        if(dist >= 5.0f || dist <= -1.0f)
+                            continue;
+                    }
+                    min_dist_2 = dist_2;
+                    min_order  = order;
+                    min_sector = indx;
+                }   // for i < cell.size()
+            }   // for x
+        }   // for z
+
+        if(min_sector==UNKNOWN_SECTOR) continue;
+        // All nodes not found so far are outside of the square of cells
+        // tested, so their distance is at least the distance of xyz to the
+        // border of this square.
+        float border = std::min(
+            std::min(px - (cell_x-ring  )*m_grid_cell_size,
+                     (cell_x+ring+1)*m_grid_cell_size - px),
+            std::min(pz - (cell_z-ring  )*m_grid_cell_size,
+                     (cell_z+ring+1)*m_grid_cell_size - pz) ) - 0.01f;
+        if(border > 0 && min_dist_2 < border*border)
+            break;
+    }   // for ring <= max_ring
+
+    return min_sector;
+}   // findNearestNodeInGrid
+
+// ============================================================================
+/** Unit testing for the grid used in findRoadSector and findOutOfRoadSector.
+ *  For each race track a list of positions following the driveline is
+ *  created (including points off the road, and above and below the road),
+ *  and then replayed in the same way TrackSector::update uses them, once
+ *  using the linear search and once using the grid. The found sectors must
+ *  be identical.
+ */
+void QuadGraph::unitTesting()
+{
+    for(unsigned int t=0; t<track_manager->getNumberOfTracks(); t++)
+    {
+        const Track *track = track_manager->getTrack(t);
+        if(track->isArena() || track->isSoccer() || track->isInternal())
+            continue;
+        QuadGraph::create(track->getTrackFile("quads.xml"),
+                          track->getTrackFile("graph.xml"), /*reverse*/false);
+        QuadGraph *qg = QuadGraph::get();
+
+        // Positions inside and beside each quad at different heights,
+        // extending half a quad width to each side of the road.
+        const float side[]   = { -0.5f, 0.25f, 0.75f, 1.5f };
+        const float along[]  = { 0.1f, 0.5f, 0.9f };
+        const float height[] = { -2.0f, 0.5f, 8.0f };
+        std::vector<Vec3> positions;
+        for(unsigned int n=0; n<qg->getNumNodes(); n++)
+        {
+            const Quad &q = qg->getQuadOfNode(n);
+            for(unsigned int a=0; a<3; a++)
+            {
+                Vec3 left  = q[0] + (q[3]-q[0])*along[a];
+                Vec3 right = q[1] + (q[2]-q[1])*along[a];
+                for(unsigned int s=0; s<4; s++)
+                {
+                    for(unsigned int h=0; h<3; h++)
+                    {
+                        positions.push_back(left + (right-left)*side[s]
+                                            + Vec3(0, height[h], 0)   );
+                    }
+                }
+            }
+        }   // for n < getNumNodes
+
+        std::vector<int> sectors[2];
+        double time[2];
+        for(unsigned int mode=0; mode<2; mode++)
+        {
+            qg->m_use_spatial_index = mode==1;
+            int sector = UNKNOWN_SECTOR;
+            double start = StkTime::getRealTime();
+            for(unsigned int i=0; i<positions.size(); i++)
+            {
+                int prev_sector = sector;
+                qg->findRoadSector(positions[i], &sector);
+                sectors[mode].push_back(sector);
+                if(sector==UNKNOWN_SECTOR)
+                {
+                    sector = qg->findOutOfRoadSector(positions[i],
+                                                     prev_sector);
+                    sectors[mode].push_back(sector);
+                }
+            }
+            time[mode] = StkTime::getRealTime() - start;
+        }   // for mode < 2
+
+        int error_count = 0;
+        for(unsigned int i=0; i<sectors[0].size(); i++)
+        {
+            if(i<sectors[1].size() && sectors[0][i]==sectors[1][i])
+                continue;
+            error_count++;
+            if(error_count<10)
+                Log::error("QuadGraph", "Track '%s' result %d: linear %d "
+                           "grid %d.", track->getIdent().c_str(), i,
+                           sectors[0][i],
+                           i<sectors[1].size() ? sectors[1][i] : -2);
+        }
+        Log::info("QuadGraph", "Track '%s', %d nodes, %d positions: linear "
+                  "%lf grid %lf, %d errors.", track->getIdent().c_str(),
+                  qg->getNumNodes(), (int)positions.size(), time[0], time[1],
+                  error_count);
+        assert(error_count==0 && sectors[0].size()==sectors[1].size());
+        QuadGraph::destroy();
+    }   // for t < getNumberOfTracks
+}   // unitTesting
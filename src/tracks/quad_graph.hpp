@@ -58,6 +58,25 @@ private:
     /** Wether the graph should be reverted or not */
     bool                     m_reverse;
 
+    /** A uniform 2d grid (in the x/z plane) over the bounding box of all
+     *  quads. Each cell contains the indices of all graph nodes whose quad
+     *  overlaps the cell. It is used to avoid testing every single graph
+     *  node in findRoadSector and findOutOfRoadSector. */
+    std::vector< std::vector<int> > m_grid_cells;
+
+    /** Minimum x and z coordinate of the grid. */
+    float                    m_grid_min_x, m_grid_min_z;
+
+    /** Size of a (square) grid cell. */
+    float                    m_grid_cell_size;
+
+    /** Number of grid cells in x and z direction. */
+    int                      m_grid_width, m_grid_height;
+
+    /** If the grid is used at all. This is only disabled for unit testing,
+     *  to compare the results with the full linear search. */
+    bool                     m_use_spatial_index;
+
     void setDefaultSuccessors();
     void computeChecklineRequirements(GraphNode* node, int latest_checkline);
     void computeDirectionData();
@@ -68,6 +87,11 @@ private:
     void load         (const std::string &filename);
     void computeDistanceFromStart(unsigned int start_node, float distance);
     unsigned int getStartNode() const;
+    void buildSpatialIndex();
+    void getGridCell(float x, float z, int *cell_x, int *cell_z) const;
+    void findRoadSectorInGrid(const Vec3& xyz, int *sector) const;
+    int  findNearestNodeInGrid(const Vec3& xyz, int first_node,
+                               bool test_height) const;
          QuadGraph     (const std::string &quad_file_name,
                         const std::string &graph_file_name,
                         const bool reverse);
@@ -93,6 +117,8 @@ private:
 public:
     static const int UNKNOWN_SECTOR;
 
+    static void  unitTesting();
+
     void         getSuccessors(int node_number,
                                std::vector<unsigned int>& succ,
                                bool for_ai=false) const;
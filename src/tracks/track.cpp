@@ -20,6 +20,7 @@
 #include "tracks/track.hpp"
 
 #include "addons/addon.hpp"
+#include "addons/zip_package.hpp"
 #include "audio/music_manager.hpp"
 #include "challenges/challenge_status.hpp"
 #include "challenges/unlock_manager.hpp"
@@ -46,6 +47,7 @@
 #include "karts/kart_properties.hpp"
 #include "modes/linear_world.hpp"
 #include "modes/easter_egg_hunt.hpp"
+#include "modes/profile_world.hpp"
 #include "modes/world.hpp"
 #include "physics/physical_object.hpp"
 #include "physics/physics.hpp"
@@ -61,6 +63,7 @@
 #include "tracks/track_object_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/profiler.hpp"
 #include "utils/string_utils.hpp"
 #include "utils/translation.hpp"
 
@@ -73,6 +76,7 @@
 #include <SMeshBuffer.h>
 
 #include <iostream>
+#include <set>
 #include <stdexcept>
 #include <sstream>
 #include <wchar.h>
@@ -275,6 +279,7 @@ void Track::reset()
  */
 void Track::cleanup()
 {
+    m_height_map.clear();
     QuadGraph::destroy();
     BattleGraph::destroy();
     ItemManager::destroy();
@@ -1438,7 +1443,9 @@ void Track::update(float dt)
         m_animated_textures[i]->update(dt);
     }
     CheckManager::get()->update(dt);
+    double start = getTimeMilliseconds();
     ItemManager::get()->update(dt);
+    ProfileWorld::addSubsystemTime(ProfileWorld::PS_ITEMS, start);
 
     // TODO: enable onUpdate scripts if we ever find a compelling use for them
     //Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
@@ -1639,7 +1646,7 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
     // Soccer field with navmesh requires it
     // for two goal line to be drawn them in minimap
     std::string path = m_root + m_all_modes[mode_id].m_scene;
-    XMLNode *root    = file_manager->createXMLTree(path);
+    XMLNode *root    = file_manager->createXMLTree(path, /*use_cache*/true);
 
     // Make sure that we have a track (which is used for raycasts to
     // place other objects).
@@ -2315,43 +2322,192 @@ bool Track::setTerrainHeight(Vec3 *pos) const
 }   // setTerrainHeight
 
 // ----------------------------------------------------------------------------
+/** Returns the height map of this track. It is computed the first time it is
+ *  requested after loading a track (or loaded from the cached-textures
+ *  directory if a height map for the same track files was saved before),
+ *  and then shared by all particle emitters till the track is cleaned up.
+ */
+const std::vector< std::vector<float> >& Track::getHeightMap()
+{
+    if (!m_height_map.empty())
+        return m_height_map;
+
+    std::string cache_file;
+    uint64_t hash = 0;
+    if (UserConfigParams::m_cache_height_map)
+    {
+        hash       = getTrackFilesHash();
+        cache_file = file_manager->getCachedTexturesDir() + "heightmap-"
+                   + m_ident + ".bin";
+        if (loadHeightMap(cache_file, hash))
+            return m_height_map;
+    }
 
-std::vector< std::vector<float> > Track::buildHeightMap()
+    double start = getTimeMilliseconds();
+    buildHeightMap();
+    Log::verbose("Track", "Height map for '%s' built in %f ms.",
+                 m_ident.c_str(), getTimeMilliseconds() - start);
+
+    if (UserConfigParams::m_cache_height_map)
+        saveHeightMap(cache_file, hash);
+    return m_height_map;
+}   // getHeightMap
+
+// ----------------------------------------------------------------------------
+/** Computes the height map by casting a ray down into the track mesh for
+ *  each grid point. The rows are independent of each other, and castRay
+ *  does not modify the mesh, so they are computed in parallel.
+ */
+void Track::buildHeightMap()
 {
-    std::vector< std::vector<float> > out(HEIGHT_MAP_RESOLUTION);
+    m_height_map.resize(HEIGHT_MAP_RESOLUTION);
 
-    float x = m_aabb_min.getX();
     const float x_len = m_aabb_max.getX() - m_aabb_min.getX();
     const float z_len = m_aabb_max.getZ() - m_aabb_min.getZ();
 
     const float x_step = x_len/HEIGHT_MAP_RESOLUTION;
     const float z_step = z_len/HEIGHT_MAP_RESOLUTION;
 
-    btVector3 hitpoint;
-    const Material* material;
-    btVector3 normal;
-
+#pragma omp parallel for
     for (int i=0; i<HEIGHT_MAP_RESOLUTION; i++)
     {
-        out[i].resize(HEIGHT_MAP_RESOLUTION);
-        float z = m_aabb_min.getZ();
+        std::vector<float> &row = m_height_map[i];
+        row.resize(HEIGHT_MAP_RESOLUTION);
+        const float x = m_aabb_min.getX() + i*x_step;
+
+        // If nothing is hit, the height of the previous point in this
+        // row is used.
+        btVector3 hitpoint(x, m_aabb_min.getY(), m_aabb_min.getZ());
+        const Material* material;
+        btVector3 normal;
 
         for (int j=0; j<HEIGHT_MAP_RESOLUTION; j++)
         {
-            btVector3 pos(x, 100.0f, z);
+            btVector3 pos(x, 100.0f, m_aabb_min.getZ() + j*z_step);
             btVector3 to = pos;
             to.setY(-100000.f);
 
             m_track_mesh->castRay(pos, to, &hitpoint, &material, &normal);
-            z += z_step;
-
-            out[i][j] = hitpoint.getY();
+            row[j] = hitpoint.getY();
         }   // j<HEIGHT_MAP_RESOLUTION
-        x += x_step;
+    }   // i<HEIGHT_MAP_RESOLUTION
+}   // buildHeightMap
+
+// ----------------------------------------------------------------------------
+/** Returns a hash (FNV-1a) of the names and contents of all files in the
+ *  track directory that can influence the track mesh (xml files and
+ *  models). It is used to detect if a cached height map is still valid.
+ */
+uint64_t Track::getTrackFilesHash() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    std::set<std::string> files;
+    file_manager->listFiles(files, m_root);
+    std::vector<char> buffer(64*1024);
+    for (std::set<std::string>::const_iterator i = files.begin();
+         i != files.end(); i++)
+    {
+        const std::string ext = StringUtils::getExtension(*i);
+        // A mounted addon only contains the package file
+        if (ext != "xml" && ext != "b3d" && ext != "spm" &&
+            *i != ZipPackage::PACKAGE_NAME)
+            continue;
+        for (unsigned int k = 0; k < i->size(); k++)
+            hash = (hash ^ (unsigned char)(*i)[k]) * 1099511628211ULL;
+
+        FILE *f = fopen((m_root + *i).c_str(), "rb");
+        if (!f)
+            continue;
+        size_t n;
+        while ((n = fread(&buffer[0], 1, buffer.size(), f)) > 0)
+        {
+            for (size_t k = 0; k < n; k++)
+                hash = (hash ^ (unsigned char)buffer[k]) * 1099511628211ULL;
+        }
+        fclose(f);
+    }   // for i in files
+    return hash;
+}   // getTrackFilesHash
+
+// ----------------------------------------------------------------------------
+/** Tries to load a cached height map. The file starts with a small header
+ *  (magic, version, resolution, hash of the track files and the bounding
+ *  box of the track), followed by the heights in row order. The header
+ *  must match this track, otherwise the file is ignored.
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the current track files.
+ *  \return True if the height map was loaded.
+ */
+bool Track::loadHeightMap(const std::string &filename, uint64_t hash)
+{
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+
+    char magic[4];
+    uint32_t version = 0, resolution = 0;
+    uint64_t file_hash = 0;
+    float aabb[4];
+    bool ok = fread(magic, 1, 4, f) == 4 &&
+              fread(&version, sizeof(version), 1, f) == 1 &&
+              fread(&resolution, sizeof(resolution), 1, f) == 1 &&
+              fread(&file_hash, sizeof(file_hash), 1, f) == 1 &&
+              fread(aabb, sizeof(float), 4, f) == 4;
+    ok = ok && memcmp(magic, "STKH", 4) == 0 && version == 1   &&
+         resolution == HEIGHT_MAP_RESOLUTION && file_hash == hash &&
+         aabb[0] == m_aabb_min.getX() && aabb[1] == m_aabb_min.getZ() &&
+         aabb[2] == m_aabb_max.getX() && aabb[3] == m_aabb_max.getZ();
+
+    if (ok)
+    {
+        m_height_map.resize(HEIGHT_MAP_RESOLUTION);
+        for (int i = 0; ok && i < HEIGHT_MAP_RESOLUTION; i++)
+        {
+            m_height_map[i].resize(HEIGHT_MAP_RESOLUTION);
+            ok = fread(&m_height_map[i][0], sizeof(float),
+                       HEIGHT_MAP_RESOLUTION, f) == HEIGHT_MAP_RESOLUTION;
+        }
+        if (!ok)
+        {
+            Log::warn("Track", "Height map cache '%s' is truncated.",
+                      filename.c_str());
+            m_height_map.clear();
+        }
     }
+    fclose(f);
+    if (ok)
+        Log::verbose("Track", "Height map loaded from '%s'.",
+                     filename.c_str());
+    return ok;
+}   // loadHeightMap
 
-    return out;
-}   // buildHeightMap
+// ----------------------------------------------------------------------------
+/** Saves the height map so that it can be loaded the next time this track
+ *  is used. See loadHeightMap for the format.
+ *  \param filename Name of the cache file.
+ *  \param hash Hash of the current track files.
+ */
+void Track::saveHeightMap(const std::string &filename, uint64_t hash) const
+{
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+    {
+        Log::warn("Track", "Can't write height map cache '%s'.",
+                  filename.c_str());
+        return;
+    }
+    const uint32_t version = 1, resolution = HEIGHT_MAP_RESOLUTION;
+    const float aabb[4] = { m_aabb_min.getX(), m_aabb_min.getZ(),
+                            m_aabb_max.getX(), m_aabb_max.getZ() };
+    fwrite("STKH", 1, 4, f);
+    fwrite(&version, sizeof(version), 1, f);
+    fwrite(&resolution, sizeof(resolution), 1, f);
+    fwrite(&hash, sizeof(hash), 1, f);
+    fwrite(aabb, sizeof(float), 4, f);
+    for (int i = 0; i < HEIGHT_MAP_RESOLUTION; i++)
+        fwrite(&m_height_map[i][0], sizeof(float), HEIGHT_MAP_RESOLUTION, f);
+    fclose(f);
+}   // saveHeightMap
 
 // ----------------------------------------------------------------------------
 /** Returns the rotation of the sun. */
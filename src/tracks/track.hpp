@@ -45,6 +45,7 @@ class ModelDefinitionLoader;
 #include "tracks/quad_graph.hpp"
 #include "utils/aligned_array.hpp"
 #include "utils/translation.hpp"
+#include "utils/types.hpp"
 #include "utils/vec3.hpp"
 #include "utils/ptr_vector.hpp"
 
@@ -201,6 +202,11 @@ private:
     Vec3                     m_aabb_min;
     /** Maximum coordinates of this track. */
     Vec3                     m_aabb_max;
+    /** The height of the terrain on a HEIGHT_MAP_RESOLUTION^2 grid covering
+     *  the track. It is computed (or loaded from the cache) the first time
+     *  it is needed, and shared by all users until the track is cleaned
+     *  up. Empty if it has not been computed yet. */
+    std::vector< std::vector<float> > m_height_map;
     /** True if this track is an arena. */
     bool                     m_is_arena;
     /** Max players supported by an arena. */
@@ -389,6 +395,10 @@ private:
                              std::vector<MusicInformation*>& m_music   );
     void loadCurves(const XMLNode &node);
     void handleSky(const XMLNode &root, const std::string &filename);
+    void buildHeightMap();
+    uint64_t getTrackFilesHash() const;
+    bool loadHeightMap(const std::string &filename, uint64_t hash);
+    void saveHeightMap(const std::string &filename, uint64_t hash) const;
 
 public:
 
@@ -430,7 +440,7 @@ public:
                                         unsigned int mode_id=0);
     bool findGround(AbstractKart *kart);
 
-    std::vector< std::vector<float> > buildHeightMap();
+    const std::vector< std::vector<float> >& getHeightMap();
     // ------------------------------------------------------------------------
     /** Returns the texture with the mini map for this track. */
     const video::ITexture*    getOldRttMiniMap() const { return m_old_rtt_mini_map; }
@@ -22,6 +22,7 @@
 #include "graphics/irr_driver.hpp"
 #include "io/file_manager.hpp"
 #include "tracks/track.hpp"
+#include "utils/string_utils.hpp"
 
 #include <algorithm>
 #include <iostream>
@@ -146,6 +147,7 @@ void TrackManager::loadTrackList()
     m_track_avail.clear();
     m_tracks.clear();
 
+    preloadAllTracks();
     for(unsigned int i=0; i<m_track_search_path.size(); i++)
     {
         const std::string &dir = m_track_search_path[i];
@@ -165,8 +167,59 @@ void TrackManager::loadTrackList()
             loadTrack(dir+*subdir+"/");
         }   // for dir in dirs
     }   // for i <m_track_search_path.size()
+    // Free the trees of tracks that were not loaded
+    file_manager->clearPreloadedXMLTrees();
 }  // loadTrackList
 
+// ----------------------------------------------------------------------------
+/** Parses the track.xml files of all tracks and decodes their screenshots on
+ *  several threads, so that loadTrack (which must be called on the main
+ *  thread) finds the data already in memory. It uses the same search order
+ *  as loadTrackList.
+ */
+void TrackManager::preloadAllTracks()
+{
+    std::vector<std::string> track_files;
+    for(unsigned int i=0; i<m_track_search_path.size(); i++)
+    {
+        const std::string &dir = m_track_search_path[i];
+        if(file_manager->fileExists(dir+"track.xml"))
+        {
+            track_files.push_back(dir+"track.xml");
+            continue;
+        }
+        std::set<std::string> dirs;
+        file_manager->listFiles(dirs, dir);
+        for(std::set<std::string>::iterator subdir = dirs.begin();
+            subdir != dirs.end(); subdir++)
+        {
+            if(*subdir=="." || *subdir=="..") continue;
+            const std::string filename = dir+*subdir+"/track.xml";
+            if(file_manager->fileExists(filename))
+                track_files.push_back(filename);
+        }   // for dir in dirs
+    }   // for i <m_track_search_path.size()
+
+    file_manager->preloadXMLTrees(track_files);
+
+    std::vector<std::string> screenshots;
+    for(unsigned int i=0; i<track_files.size(); i++)
+    {
+        const XMLNode *root =
+            file_manager->getPreloadedXMLTree(track_files[i]);
+        if(!root) continue;
+        bool internal = false;
+        root->get("internal", &internal);
+        std::string screenshot;
+        if(internal || !root->get("screenshot", &screenshot))
+            continue;
+        // Same path as used in Track::loadTrackInfo
+        screenshots.push_back(StringUtils::getPath(track_files[i]) + "/"
+                              + screenshot);
+    }
+    irr_driver->preloadTextures(screenshots);
+}   // preloadAllTracks
+
 // ----------------------------------------------------------------------------
 /** Tries to load a track from a single directory. Returns true if a track was
  *  successfully loaded.
@@ -68,6 +68,7 @@ private:
     std::vector<bool>                        m_track_avail;
 
     void          updateGroups(const Track* track);
+    void          preloadAllTracks();
 
 public:
                 TrackManager();
@@ -30,6 +30,8 @@
 #include <IMeshSceneNode.h>
 #include <ISceneManager.h>
 
+const float TrackObjectManager::AABB_MARGIN = 0.5f;
+
 TrackObjectManager::TrackObjectManager()
 {
 }   // TrackObjectManager
@@ -70,7 +72,8 @@ void TrackObjectManager::init()
     {
         curr->onWorldReady();
     }
-}   // reset
+    updateDriveableTree();
+}   // init
 // ----------------------------------------------------------------------------
 /** Initialises all track objects.
  */
@@ -81,6 +84,7 @@ void TrackObjectManager::reset()
         curr->reset();
         curr->resetEnabled();
     }
+    updateDriveableTree();
 }   // reset
 // ----------------------------------------------------------------------------
 /** returns a reference to the track object
@@ -148,8 +152,41 @@ void TrackObjectManager::update(float dt)
     {
         curr->update(dt);
     }
+    updateDriveableTree();
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Updates the boxes of all driveable objects in the AABB tree used for
+ *  raycasts. This must be called after driveable objects might have moved,
+ *  i.e. after the track objects are updated and after each physics step.
+ *  Objects that are not yet in the tree are added.
+ */
+void TrackObjectManager::updateDriveableTree()
+{
+    m_driveable_leaves.resize(m_driveable_objects.size(), NULL);
+    for (unsigned int i = 0; i < m_driveable_objects.size(); i++)
+    {
+        PhysicalObject *object = m_driveable_objects.get(i)->getPhysicalObject();
+        if (!object || !object->getBody())
+            continue;
+        btVector3 min, max;
+        object->getBody()->getAabb(min, max);
+        btDbvtVolume volume = btDbvtVolume::FromMM(min, max);
+        if (m_driveable_leaves[i])
+        {
+            // This only changes the tree if the object left its box
+            m_driveable_tree.update(m_driveable_leaves[i], volume,
+                                    AABB_MARGIN);
+        }
+        else
+        {
+            volume.Expand(btVector3(AABB_MARGIN, AABB_MARGIN, AABB_MARGIN));
+            m_driveable_leaves[i] =
+                m_driveable_tree.insert(volume, m_driveable_objects.get(i));
+        }
+    }   // for i < m_driveable_objects.size()
+}   // updateDriveableTree
+
 // ----------------------------------------------------------------------------
 /** Does a raycast against all driveable objects. This way part of the track
  *  can be a physical object, and can e.g. be animated. A separate list of all
@@ -176,33 +213,94 @@ void TrackObjectManager::castRay(const btVector3 &from,
                                  btVector3 *normal,
                                  bool interpolate_normal) const
 {
-    float distance = 9999.9f;
-    // If there was a hit already, compute the current distance
-    if(*material)
-    {
-        distance = hit_point->distance(from);
-    }
-    for (const TrackObject* curr : m_driveable_objects)
+    castRays(1, &from, &to, hit_point, material, normal, interpolate_normal);
+}   // castRay
+
+// ----------------------------------------------------------------------------
+/** Does a raycast against all driveable objects for a number of rays at
+ *  once, e.g. the terrain rays of all karts. For each ray only the objects
+ *  whose box in the AABB tree is hit are tested. For each ray i the result
+ *  is handled as in castRay: the parameters hit_points[i], materials[i] and
+ *  normals[i] are only updated if a track object is hit closer than the
+ *  hit already stored there. Rays are independent of each other and are
+ *  cast in parallel if there are enough of them.
+ *  \param num_rays Number of rays.
+ *  \param from/to Arrays with the from and to positions of the rays.
+ *  \param hit_points Array with the positions in world where the rays hit.
+ *  \param materials Array with the materials of the meshes that were hit.
+ *  \param normals Array with the normals at the hit positions, can be NULL.
+ *  \param interpolate_normal If true, the returned normals are interpolated,
+ *         see castRay.
+ */
+void TrackObjectManager::castRays(unsigned int num_rays,
+                                  const btVector3 *from, const btVector3 *to,
+                                  btVector3 *hit_points,
+                                  const Material **materials,
+                                  btVector3 *normals,
+                                  bool interpolate_normal) const
+{
+    /** Called for each object whose box is hit by a ray, it does the
+     *  raycast against the actual mesh and keeps the closest hit. */
+    class ClosestHit : public btDbvt::ICollide
     {
-        btVector3 new_hit_point;
-        const Material *new_material;
-        btVector3 new_normal;
-        if(curr->castRay(from, to, &new_hit_point, &new_material, &new_normal,
-                      interpolate_normal))
+    public:
+        const btVector3 &m_from, &m_to;
+        bool             m_interpolate_normal;
+        btVector3        m_hit_point, m_normal;
+        const Material  *m_material;
+        float            m_distance;
+        // --------------------------------------------------------------------
+        ClosestHit(const btVector3 &from, const btVector3 &to,
+                   bool interpolate_normal, float distance)
+            : m_from(from), m_to(to)
         {
-            float new_distance = new_hit_point.distance(from);
-            // If the new hit is closer than the current hit, save
-            // the data.
-            if (new_distance < distance)
+            m_interpolate_normal = interpolate_normal;
+            m_material           = NULL;
+            m_distance           = distance;
+        }   // ClosestHit
+        // --------------------------------------------------------------------
+        virtual void Process(const btDbvtNode *leaf)
+        {
+            const TrackObject *object = (const TrackObject*)leaf->data;
+            btVector3 new_hit_point;
+            const Material *new_material;
+            btVector3 new_normal;
+            if(!object->castRay(m_from, m_to, &new_hit_point, &new_material,
+                                &new_normal, m_interpolate_normal))
+                return;
+            float new_distance = new_hit_point.distance(m_from);
+            // If the new hit is closer than the current hit, save the data.
+            if (new_distance < m_distance)
             {
-                *material  = new_material;
-                *hit_point = new_hit_point;
-                *normal    = new_normal;
-                distance   = new_distance;
-            }   // if new_distance < distance
-        }   // if hit
-    }   // for all track objects.
-}   // castRay
+                m_material  = new_material;
+                m_hit_point = new_hit_point;
+                m_normal    = new_normal;
+                m_distance  = new_distance;
+            }
+        }   // Process
+    };   // ClosestHit
+
+    if (!m_driveable_tree.m_root)
+        return;
+
+#pragma omp parallel for if(num_rays >= 8)
+    for (int i = 0; i < (int)num_rays; i++)
+    {
+        float distance = 9999.9f;
+        // If there was a hit already, compute the current distance
+        if (materials[i])
+            distance = hit_points[i].distance(from[i]);
+        ClosestHit hit(from[i], to[i], interpolate_normal, distance);
+        btDbvt::rayTest(m_driveable_tree.m_root, from[i], to[i], hit);
+        if (hit.m_material)
+        {
+            materials[i]  = hit.m_material;
+            hit_points[i] = hit.m_hit_point;
+            if (normals)
+                normals[i] = hit.m_normal;
+        }
+    }   // for i < num_rays
+}   // castRays
 
 // ----------------------------------------------------------------------------
 /** Enables or disables fog for a given scene node.
@@ -284,6 +382,19 @@ void TrackObjectManager::insertObject(TrackObject* object)
  */
 void TrackObjectManager::removeObject(TrackObject* obj)
 {
+    for (unsigned int i = 0; i < m_driveable_objects.size(); i++)
+    {
+        if (m_driveable_objects.get(i) != obj)
+            continue;
+        if (i < m_driveable_leaves.size())
+        {
+            if (m_driveable_leaves[i])
+                m_driveable_tree.remove(m_driveable_leaves[i]);
+            m_driveable_leaves.erase(m_driveable_leaves.begin() + i);
+        }
+        m_driveable_objects.remove(i);
+        break;
+    }
     m_all_objects.remove(obj);
     delete obj;
 }   // removeObject
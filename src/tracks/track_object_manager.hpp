@@ -23,6 +23,8 @@
 #include "tracks/track_object.hpp"
 #include "utils/ptr_vector.hpp"
 
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+
 class Track;
 class Vec3;
 class XMLNode;
@@ -51,6 +53,18 @@ protected:
     /** A second list which holds all objects that karts can drive on. */
     PtrVector<TrackObject, REF> m_driveable_objects;
 
+    /** An AABB tree of all driveable objects, so that a raycast only needs
+     *  to test the objects whose bounding box is hit by the ray. */
+    btDbvt m_driveable_tree;
+
+    /** The leaf of each driveable object in m_driveable_tree (same index
+     *  as in m_driveable_objects), NULL if it is not yet in the tree. */
+    std::vector<btDbvtNode*> m_driveable_leaves;
+
+    /** The boxes in the tree are enlarged by this amount, so that slowly
+     *  moving objects only rarely need to be moved in the tree. */
+    static const float AABB_MARGIN;
+
 public:
          TrackObjectManager();
         ~TrackObjectManager();
@@ -66,6 +80,11 @@ public:
                  const btVector3 &to, btVector3 *hit_point,
                  const Material **material, btVector3 *normal = NULL,
                  bool interpolate_normal = false) const;
+    void castRays(unsigned int num_rays, const btVector3 *from,
+                  const btVector3 *to, btVector3 *hit_points,
+                  const Material **materials, btVector3 *normals = NULL,
+                  bool interpolate_normal = false) const;
+    void updateDriveableTree();
 
     /** Enable or disable fog on objects */
     void enableFog(bool enable);
@@ -19,9 +19,17 @@
 #include "utils/log.hpp"
 
 #include "config/user_config.hpp"
+#include "utils/ring_buffer.hpp"
+#include "utils/time.hpp"
+#include "utils/vs.hpp"
 
 #include <cstdio>
+#include <map>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
 
 #ifdef ANDROID
 #  include <android/log.h>
@@ -35,6 +43,126 @@
 Log::LogLevel Log::m_min_log_level = Log::LL_VERBOSE;
 bool          Log::m_no_colors     = false;
 FILE*         Log::m_file_stdout   = NULL;
+volatile bool Log::m_async         = false;
+
+namespace
+{
+    /** Maximum length of a message that is written asynchronously, longer
+     *  messages are written synchronously. */
+    const unsigned int MAX_MESSAGE_LENGTH      = 1024;
+    const unsigned int MAX_COMPONENT_LENGTH    = 32;
+    /** Maximum number of threads with their own buffer at the same time
+     *  (the buffer of a thread that exits is reused). Messages of further
+     *  threads are written synchronously. */
+    const unsigned int MAX_THREADS             = 32;
+    /** Maximum number of messages below warning level per component and
+     *  second, further messages are dropped by the writer. */
+    const unsigned int MAX_MESSAGES_PER_SECOND = 500;
+
+    /** A formatted message waiting to be written. */
+    struct LogRecord
+    {
+        int  m_level;
+        char m_component[MAX_COMPONENT_LENGTH];
+        char m_message[MAX_MESSAGE_LENGTH];
+    };   // LogRecord
+
+    /** The messages of one thread. The thread is the only producer, the
+     *  writer thread the only consumer (the thread itself only takes
+     *  messages out while holding g_output_mutex, when the writer can not),
+     *  so no lock is needed for adding messages. */
+    struct LogBuffer
+    {
+        RingBuffer<LogRecord, 128> m_records;
+        /** Number of messages dropped because the buffer was full, only
+         *  written by the thread owning the buffer. */
+        volatile unsigned int m_num_dropped;
+        /** Number of dropped messages already reported by the writer. */
+        unsigned int m_num_reported;
+        /** Set when the thread owning the buffer exits. The buffer is then
+         *  given to a new thread once all its messages are written. */
+        volatile bool m_released;
+        LogBuffer()
+        {
+            m_num_dropped  = 0;
+            m_num_reported = 0;
+            m_released     = false;
+        }
+    };   // LogBuffer
+
+    /** Number of messages written and suppressed in the current second,
+     *  used by the writer to limit the messages per component. */
+    struct RateLimit
+    {
+        unsigned int m_count, m_suppressed;
+        RateLimit() { m_count = 0; m_suppressed = 0; }
+    };   // RateLimit
+
+    /** The buffer of each thread, stored as thread specific data. The
+     *  buffers are never freed, since other threads might still be adding
+     *  a message to their buffer while the asynchronous log is stopped. */
+    pthread_key_t         g_buffer_key;
+    /** True once the key and the mutexes were created. */
+    bool                  g_initialised = false;
+    LogBuffer            *g_buffers[MAX_THREADS];
+    volatile unsigned int g_num_buffers = 0;
+    /** Marks threads that did not get a buffer (MAX_THREADS reached). */
+    char                  g_no_buffer;
+    pthread_mutex_t       g_register_mutex;
+    /** Serialises the output of the writer thread and of messages that
+     *  are written synchronously. */
+    pthread_mutex_t       g_output_mutex;
+    pthread_t             g_writer_thread;
+    volatile bool         g_stop_writer = false;
+
+    // ------------------------------------------------------------------------
+    /** Called when a thread with a buffer exits, marks the buffer as free.
+     *  \param data The buffer of the thread.
+     */
+    void releaseThreadBuffer(void *data)
+    {
+        if (data != &g_no_buffer)
+            ((LogBuffer*)data)->m_released = true;
+    }   // releaseThreadBuffer
+
+    // ------------------------------------------------------------------------
+    /** Returns the buffer of the calling thread. It reuses the buffer of a
+     *  thread that has exited, or creates a new buffer. Returns NULL if no
+     *  more buffers can be created.
+     */
+    LogBuffer *getThreadBuffer()
+    {
+        void *data = pthread_getspecific(g_buffer_key);
+        if (data)
+            return data == &g_no_buffer ? NULL : (LogBuffer*)data;
+
+        LogBuffer *buffer = NULL;
+        pthread_mutex_lock(&g_register_mutex);
+        for (unsigned int i = 0; i < g_num_buffers; i++)
+        {
+            // Only the writer removes messages, so once the buffer is empty
+            // the previous owner is done with it.
+            if (g_buffers[i]->m_released && g_buffers[i]->m_records.isEmpty())
+            {
+                buffer = g_buffers[i];
+                buffer->m_released = false;
+                break;
+            }
+        }
+        if (!buffer && g_num_buffers < MAX_THREADS)
+        {
+            buffer = new LogBuffer();
+            g_buffers[g_num_buffers] = buffer;
+            // Make sure the buffer is stored before the writer can see it
+            stkMemoryBarrier();
+            g_num_buffers++;
+        }
+        pthread_mutex_unlock(&g_register_mutex);
+        pthread_setspecific(g_buffer_key, buffer ? (void*)buffer
+                                                 : (void*)&g_no_buffer);
+        return buffer;
+    }   // getThreadBuffer
+}   // namespace
 
 // ----------------------------------------------------------------------------
 /** Selects background/foreground colors for the message depending on
@@ -123,8 +251,56 @@ void Log::resetTerminalColor()
 }   // resetTerminalColor
 
 // ----------------------------------------------------------------------------
-/** This actually prints the log message. If log messages are not redirected
- *  to a file, it tries to select a terminal colour.
+/** Writes a formatted message to the console and/or the log file. If log
+ *  messages are not redirected to a file, it tries to select a terminal
+ *  colour.
+ *  \param level Log level of the message to print.
+ *  \param component Name of the component that printed the message.
+ *  \param message The formatted message.
+ */
+void Log::writeMessage(int level, const char *component, const char *message)
+{
+    static const char *names[] = {"debug", "verbose  ", "info   ",
+                                  "warn   ", "error  ", "fatal  "};
+
+    // If we don't have a console file, write to stdout and hope for the best
+    if(!m_file_stdout || level >= LL_WARN ||
+        UserConfigParams::m_log_errors_to_console) // log to console & file
+    {
+        setTerminalColor((LogLevel)level);
+        printf("[%s] %s: %s", names[level], component, message);
+        resetTerminalColor();  // this prints a \n
+    }
+
+#if defined(_MSC_FULL_VER) && defined(_DEBUG)
+    OutputDebugString("[");
+    OutputDebugString(names[level]);
+    OutputDebugString("] ");
+    OutputDebugString(component);
+    OutputDebugString(": ");
+    OutputDebugString(message);
+    OutputDebugString("\r\n");
+#endif
+
+    if(m_file_stdout)
+        fprintf(m_file_stdout, "[%s] %s: %s\n", names[level], component,
+                message);
+
+#ifdef WIN32
+    if (level >= LL_FATAL)
+    {
+        std::string text = std::string("[") + names[level] + "] "
+                         + component + ": " + message;
+        MessageBoxA(NULL, text.c_str(), "SuperTuxKart - Fatal error", MB_OK);
+    }
+#endif
+}   // writeMessage
+
+// ----------------------------------------------------------------------------
+/** This actually prints the log message. If the asynchronous log is
+ *  enabled, the message is formatted and added to the buffer of the
+ *  calling thread, and written later by the writer thread. Otherwise (or if
+ *  the message can not be buffered) it is written immediately.
  *  \param level Log level of the message to print.
  *  \param format A printf-like format string.
  *  \param va_list The values to be printed for the format.
@@ -155,80 +331,247 @@ void Log::printMessage(int level, const char *component, const char *format,
     }
     __android_log_vprint(alp, "SuperTuxKart", format, args);
 #else
-    static const char *names[] = {"debug", "verbose  ", "info   ",
-                                  "warn   ", "error  ", "fatal  "};
+    const bool async = m_async;
+    if (async && level < LL_FATAL && pushMessage(level, component, format,
+                                                 args))
+        return;
 
     // Using a va_list twice produces undefined results, ie crash.
-    // So make a copy if we're going to use it twice.
-    VALIST copy;
-    if (m_file_stdout)
-    {
-        va_copy(copy, args);
-    }
-#if defined(_MSC_FULL_VER) && defined(_DEBUG)
-    VALIST copy2;
-    va_copy(copy2, args);
-#endif
-
-    // If we don't have a console file, write to stdout and hope for the best
-    if(!m_file_stdout || level >= LL_WARN ||
-        UserConfigParams::m_log_errors_to_console) // log to console & file
+    // So make a copy for each attempt.
+    std::vector<char> message(MAX_MESSAGE_LENGTH);
+    while (true)
     {
         VALIST out;
         va_copy(out, args);
-
-        setTerminalColor((LogLevel)level);
-        printf("[%s] %s: ", names[level], component);
-        vprintf(format, out);
-        resetTerminalColor();  // this prints a \n
-
+        const int n = vsnprintf(&message[0], message.size(), format, out);
         va_end(out);
+        if (n >= 0 && n < (int)message.size())
+            break;
+        // Older windows compilers return -1 if the buffer is too small
+        if (message.size() >= 1024*1024)
+        {
+            message[message.size() - 1] = 0;
+            break;
+        }
+        message.resize(n >= 0 ? n + 1 : message.size() * 2);
     }
 
-#if defined(_MSC_FULL_VER) && defined(_DEBUG)
-    static char szBuff[2048];
-    vsnprintf(szBuff, sizeof(szBuff), format, copy2);
-
-    OutputDebugString("[");
-    OutputDebugString(names[level]);
-    OutputDebugString("] ");
-    OutputDebugString(component);
-    OutputDebugString(": ");
-    OutputDebugString(szBuff);
-    OutputDebugString("\r\n");
-#endif
-
-
-    if(m_file_stdout)
+    if (async)
     {
-        fprintf (m_file_stdout, "[%s] %s: ", names[level], component);
-        vfprintf(m_file_stdout, format, copy);
-        fprintf (m_file_stdout, "\n");
-        va_end(copy);
+        // Write the buffered messages of this thread first to keep their
+        // order. The writer thread only takes messages from a buffer while
+        // it holds g_output_mutex, so this thread can do it here. Messages
+        // of other threads are not waited for.
+        pthread_mutex_lock(&g_output_mutex);
+        void *data = pthread_getspecific(g_buffer_key);
+        if (data && data != &g_no_buffer)
+        {
+            LogBuffer *buffer = (LogBuffer*)data;
+            LogRecord record;
+            while (buffer->m_records.pop(&record))
+                writeMessage(record.m_level, record.m_component,
+                             record.m_message);
+        }
     }
+    writeMessage(level, component, &message[0]);
+    if (async)
+        pthread_mutex_unlock(&g_output_mutex);
+#endif
+}   // printMessage
 
-#ifdef WIN32
-    if (level >= LL_FATAL)
-    {
-        std::string message;
+// ----------------------------------------------------------------------------
+/** Formats a message and adds it to the buffer of the calling thread. If
+ *  the buffer is full, messages below warning level are dropped (and
+ *  counted), more important messages are not added.
+ *  \return False if the message was not added and must be written
+ *          synchronously.
+ */
+bool Log::pushMessage(int level, const char *component, const char *format,
+                      VALIST args)
+{
+    LogBuffer *buffer = getThreadBuffer();
+    if (!buffer)
+        return false;
+
+    LogRecord record;
+    VALIST out;
+    va_copy(out, args);
+    const int n = vsnprintf(record.m_message, MAX_MESSAGE_LENGTH, format, out);
+    va_end(out);
+    if (n < 0 || n >= (int)MAX_MESSAGE_LENGTH)
+        return false;
+    record.m_level = level;
+    strncpy(record.m_component, component, MAX_COMPONENT_LENGTH - 1);
+    record.m_component[MAX_COMPONENT_LENGTH - 1] = 0;
+
+    if (buffer->m_records.push(record))
+        return true;
+    if (level >= LL_WARN)
+        return false;
+    buffer->m_num_dropped++;
+    return true;
+}   // pushMessage
 
-        char tmp[2048];
-        sprintf(tmp, "[%s] %s: ", names[level], component);
-        message += tmp;
+// ----------------------------------------------------------------------------
+/** The writer thread: it writes the messages of all buffers, limits the
+ *  number of messages per component and reports dropped messages.
+ */
+void *Log::asyncWriter(void *data)
+{
+    VS::setThreadName("LogWriter");
+    std::map<std::string, RateLimit> limits;
+    time_t current_second = time(NULL);
+    LogRecord record;
+    char text[256];
 
-        VALIST out;
-        va_copy(out, args);
-        vsprintf(tmp, format, out);
-        message += tmp;
-        va_end(out);
+    while (true)
+    {
+        // Read the flag first, so that all messages are written after the
+        // writer was asked to stop.
+        const bool stop = g_stop_writer;
+        stkMemoryBarrier();
+        const unsigned int num_buffers = g_num_buffers;
+        stkMemoryBarrier();
+        unsigned int num_written = 0;
+        for (unsigned int i = 0; i < num_buffers; i++)
+        {
+            LogBuffer *buffer = g_buffers[i];
+            pthread_mutex_lock(&g_output_mutex);
+            while (buffer->m_records.pop(&record))
+            {
+                if (record.m_level < LL_WARN)
+                {
+                    RateLimit &limit = limits[record.m_component];
+                    if (++limit.m_count > MAX_MESSAGES_PER_SECOND)
+                    {
+                        limit.m_suppressed++;
+                        continue;
+                    }
+                }
+                writeMessage(record.m_level, record.m_component,
+                             record.m_message);
+                num_written++;
+            }
+            const unsigned int num_dropped = buffer->m_num_dropped;
+            if (num_dropped != buffer->m_num_reported)
+            {
+                sprintf(text, "%u messages were dropped because the log "
+                        "buffer was full.",
+                        num_dropped - buffer->m_num_reported);
+                writeMessage(LL_WARN, "Log", text);
+                buffer->m_num_reported = num_dropped;
+            }
+            pthread_mutex_unlock(&g_output_mutex);
+        }   // for i < num_buffers
+
+        const time_t now = time(NULL);
+        if (now != current_second || stop)
+        {
+            std::map<std::string, RateLimit>::iterator i;
+            for (i = limits.begin(); i != limits.end(); i++)
+            {
+                if (i->second.m_suppressed > 0)
+                {
+                    sprintf(text, "%u messages of '%s' were suppressed.",
+                            i->second.m_suppressed, i->first.c_str());
+                    pthread_mutex_lock(&g_output_mutex);
+                    writeMessage(LL_WARN, "Log", text);
+                    pthread_mutex_unlock(&g_output_mutex);
+                }
+                i->second = RateLimit();
+            }
+            current_second = now;
+        }
+
+        if (stop)
+            break;
+        if (num_written == 0)
+            StkTime::sleep(2);
+    }   // while true
+    return NULL;
+}   // asyncWriter
 
-        MessageBoxA(NULL, message.c_str(), "SuperTuxKart - Fatal error", MB_OK);
+// ----------------------------------------------------------------------------
+/** Starts the writer thread. From then on messages (except fatal errors)
+ *  are only formatted by the calling thread and added to a lock-free buffer
+ *  of that thread, so logging can not stall the main or network threads
+ *  when writing to the console or the log file is slow.
+ */
+void Log::startAsync()
+{
+#ifndef ANDROID
+    if (m_async)
+        return;
+    if (!g_initialised)
+    {
+        pthread_key_create(&g_buffer_key, &releaseThreadBuffer);
+        pthread_mutex_init(&g_register_mutex, NULL);
+        pthread_mutex_init(&g_output_mutex, NULL);
+        g_initialised = true;
+    }
+    g_stop_writer = false;
+    if (pthread_create(&g_writer_thread, NULL, &Log::asyncWriter, NULL) != 0)
+    {
+        Log::warn("Log", "Could not start the log writer thread.");
+        return;
     }
+    m_async = true;
 #endif
+}   // startAsync
 
-#endif
-}   // printMessage
+// ----------------------------------------------------------------------------
+/** Writes all buffered messages and stops the writer thread. Messages are
+ *  written synchronously again afterwards. The buffers are kept (and used
+ *  again if the asynchronous log is restarted), since another thread might
+ *  still be adding a message it started before the log was stopped.
+ */
+void Log::stopAsync()
+{
+    if (!m_async)
+        return;
+    m_async = false;
+    stkMemoryBarrier();
+    g_stop_writer = true;
+    pthread_join(g_writer_thread, NULL);
+}   // stopAsync
 
+// ----------------------------------------------------------------------------
+/** Waits (at most about one second) till all buffered messages have been
+ *  written.
+ */
+void Log::flush()
+{
+    if (!m_async)
+        return;
+    for (int n = 0; n < 500; n++)
+    {
+        bool empty = true;
+        const unsigned int num_buffers = g_num_buffers;
+        stkMemoryBarrier();
+        for (unsigned int i = 0; i < num_buffers; i++)
+            empty &= g_buffers[i]->m_records.isEmpty();
+        if (empty)
+            break;
+        StkTime::sleep(2);
+    }
+    // Wait till the writer has written the last message it removed
+    pthread_mutex_lock(&g_output_mutex);
+    pthread_mutex_unlock(&g_output_mutex);
+}   // flush
+
+// ----------------------------------------------------------------------------
+/** Returns the number of messages dropped because a log buffer was full. */
+unsigned int Log::getNumDroppedMessages()
+{
+    if (!m_async)
+        return 0;
+    unsigned int n = 0;
+    const unsigned int num_buffers = g_num_buffers;
+    stkMemoryBarrier();
+    for (unsigned int i = 0; i < num_buffers; i++)
+        n += g_buffers[i]->m_num_dropped;
+    return n;
+}   // getNumDroppedMessages
 
 // ----------------------------------------------------------------------------
 /** This function opens the files that will contain the output.
@@ -251,9 +594,11 @@ void Log::openOutputFiles(const std::string &logout)
 } // closeOutputFiles
 
 // ----------------------------------------------------------------------------
-/** Function to close output files */
+/** Function to close output files. This also stops the asynchronous log,
+ *  so that all messages are written before the file is closed. */
 void Log::closeOutputFiles()
 {
+    stopAsync();
     fclose(m_file_stdout);
 } // closeOutputFiles
 
@@ -59,8 +59,16 @@ private:
     /** The file where stdout output will be written */
     static FILE* m_file_stdout;
 
+    /** True if messages are written by the background writer thread. */
+    static volatile bool m_async;
+
     static void setTerminalColor(LogLevel level);
     static void resetTerminalColor();
+    static void writeMessage(int level, const char *component,
+                             const char *message);
+    static bool pushMessage(int level, const char *component,
+                            const char *format, VALIST args);
+    static void *asyncWriter(void *data);
 
 public:
 
@@ -96,6 +104,11 @@ public:
 
     static void closeOutputFiles();
 
+    static void startAsync();
+    static void stopAsync();
+    static void flush();
+    static unsigned int getNumDroppedMessages();
+
     // ------------------------------------------------------------------------
     /** Defines the minimum log level to be displayed. */
     static void setLogLevel(int n)
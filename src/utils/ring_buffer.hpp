@@ -0,0 +1,128 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_RING_BUFFER_HPP
+#define HEADER_RING_BUFFER_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <assert.h>
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  pragma intrinsic(_ReadWriteBarrier)
+#endif
+
+/** Issues a full memory barrier, i.e. no load or store will be moved across
+ *  this barrier by either the compiler or the CPU. */
+inline void stkMemoryBarrier()
+{
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+    _mm_mfence();
+#else
+    __sync_synchronize();
+#endif
+}   // stkMemoryBarrier
+
+// ============================================================================
+/** A lock-free, fixed size queue for exactly one producer thread and one
+ *  consumer thread. All elements are preallocated, push and pop only copy
+ *  the element and update one index each, so no memory allocation or lock
+ *  is necessary. The producer only writes m_write_index, the consumer only
+ *  writes m_read_index.
+ *  \param T Type of the elements, must be copyable and default
+ *         constructable.
+ *  \param SIZE Number of slots, must be a power of two. One slot is always
+ *         kept empty to distinguish a full from an empty buffer.
+ * \ingroup utils
+ */
+template<typename T, unsigned int SIZE>
+class RingBuffer : public NoCopy
+{
+private:
+    /** The preallocated elements. */
+    T m_data[SIZE];
+
+    /** Index of the next element to be read, only written by the
+     *  consumer. */
+    volatile unsigned int m_read_index;
+
+    /** Index of the next free slot, only written by the producer. */
+    volatile unsigned int m_write_index;
+
+public:
+    RingBuffer()
+    {
+        assert((SIZE & (SIZE-1)) == 0);
+        m_read_index  = 0;
+        m_write_index = 0;
+    }   // RingBuffer
+    // ------------------------------------------------------------------------
+    /** Adds an element to the queue. Must only be called by the producer
+     *  thread.
+     *  \param t The element to add.
+     *  \return False if the buffer is full (and the element was not added).
+     */
+    bool push(const T &t)
+    {
+        const unsigned int w    = m_write_index;
+        const unsigned int next = (w + 1) & (SIZE - 1);
+        if (next == m_read_index)
+            return false;
+        m_data[w] = t;
+        // Make sure the element is written before it becomes visible
+        stkMemoryBarrier();
+        m_write_index = next;
+        return true;
+    }   // push
+    // ------------------------------------------------------------------------
+    /** Removes the oldest element from the queue. Must only be called by
+     *  the consumer thread.
+     *  \param t Where to store the element.
+     *  \return False if the queue was empty.
+     */
+    bool pop(T *t)
+    {
+        const unsigned int r = m_read_index;
+        if (r == m_write_index)
+            return false;
+        // Make sure the element is not read before the index was read
+        stkMemoryBarrier();
+        *t = m_data[r];
+        stkMemoryBarrier();
+        m_read_index = (r + 1) & (SIZE - 1);
+        return true;
+    }   // pop
+    // ------------------------------------------------------------------------
+    /** Returns the number of elements in the queue. Called from a thread
+     *  other than the producer or consumer the result is only approximate.
+     */
+    unsigned int size() const
+    {
+        return (m_write_index - m_read_index) & (SIZE - 1);
+    }   // size
+    // ------------------------------------------------------------------------
+    /** Returns if the queue is empty. */
+    bool isEmpty() const { return m_write_index == m_read_index; }
+    // ------------------------------------------------------------------------
+    /** Returns the maximum number of elements that can be stored. */
+    static unsigned int capacity() { return SIZE - 1; }
+};   // RingBuffer
+
+#endif
@@ -0,0 +1,96 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/startup_profile.hpp"
+
+#include "utils/log.hpp"
+#include "utils/profiler.hpp"
+
+bool        StartupProfile::m_enabled          = false;
+std::string StartupProfile::m_current_phase;
+double      StartupProfile::m_start_time       = 0.0;
+double      StartupProfile::m_phase_start_time = 0.0;
+std::vector<std::pair<std::string, double> > StartupProfile::m_phases;
+
+// ----------------------------------------------------------------------------
+/** Enables the profile. The total startup time is measured from this call
+ *  on, so it should be called as early as possible.
+ */
+void StartupProfile::enable()
+{
+    m_enabled          = true;
+    m_start_time       = getTimeMilliseconds();
+    m_phase_start_time = m_start_time;
+    m_current_phase    = "";
+    m_phases.clear();
+}   // enable
+
+// ----------------------------------------------------------------------------
+/** Ends the current phase (if any) and stores its duration.
+ *  \param now The current time in ms.
+ */
+void StartupProfile::endPhase(double now)
+{
+    if (m_current_phase != "")
+    {
+        m_phases.push_back(std::make_pair(m_current_phase,
+                                          now - m_phase_start_time));
+    }
+    m_current_phase    = "";
+    m_phase_start_time = now;
+}   // endPhase
+
+// ----------------------------------------------------------------------------
+/** Starts a new phase, which also ends the previous phase. Does nothing if
+ *  the profile is not enabled.
+ *  \param name Name of the new phase.
+ */
+void StartupProfile::startPhase(const std::string &name)
+{
+    if (!m_enabled) return;
+    endPhase(getTimeMilliseconds());
+    m_current_phase = name;
+}   // startPhase
+
+// ----------------------------------------------------------------------------
+/** Ends the current phase and prints the duration of all phases. Time
+ *  between phases (i.e. not covered by any phase) is listed as 'other'.
+ *  Afterwards the profile is disabled.
+ */
+void StartupProfile::finish()
+{
+    if (!m_enabled) return;
+    const double now = getTimeMilliseconds();
+    endPhase(now);
+
+    const double total = now - m_start_time;
+    double sum = 0.0;
+    Log::info("StartupProfile", "Phase                  Time [ms]      %%");
+    for (unsigned int i = 0; i < m_phases.size(); i++)
+    {
+        const double t = m_phases[i].second;
+        sum += t;
+        Log::info("StartupProfile", "%-20s %10.1f %6.1f",
+                  m_phases[i].first.c_str(), t,
+                  total > 0 ? 100.0 * t / total : 0.0);
+    }
+    Log::info("StartupProfile", "%-20s %10.1f %6.1f", "other", total - sum,
+              total > 0 ? 100.0 * (total - sum) / total : 0.0);
+    Log::info("StartupProfile", "%-20s %10.1f", "total", total);
+    m_enabled = false;
+}   // finish
@@ -0,0 +1,65 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_STARTUP_PROFILE_HPP
+#define HEADER_STARTUP_PROFILE_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Measures the wall time of the different phases of loading STK (enabled
+ *  with --startup-profile). Each call to startPhase ends the previous
+ *  phase, finish prints the time of all phases.
+ *  Example usage
+ *  \code
+ *     StartupProfile::startPhase("materials");
+ *     material_manager->loadMaterial();
+ *     StartupProfile::startPhase("karts");
+ *     ...
+ *     StartupProfile::finish();
+ *  \endcode
+ * \ingroup utils
+ */
+class StartupProfile
+{
+private:
+    /** True if --startup-profile was specified. */
+    static bool m_enabled;
+
+    /** Name and duration (in ms) of all phases that are finished. */
+    static std::vector<std::pair<std::string, double> > m_phases;
+
+    /** Name of the current phase, empty if there is none. */
+    static std::string m_current_phase;
+
+    /** Time the profile was enabled and time the current phase started. */
+    static double m_start_time, m_phase_start_time;
+
+    static void endPhase(double now);
+
+public:
+    static void enable();
+    static void startPhase(const std::string &name);
+    static void finish();
+    // ------------------------------------------------------------------------
+    /** Returns if the startup time is profiled. */
+    static bool isEnabled() { return m_enabled; }
+};   // StartupProfile
+
+#endif
@@ -27,6 +27,7 @@
 #  define WIN32_LEAN_AND_MEAN
 #  include <windows.h>
 #  include <time.h>
+#  include <sys/timeb.h>
 #else
 #  include <stdint.h>
 #  include <sys/time.h>
@@ -121,6 +122,33 @@ public:
 #endif
     }   // sleep
     // ------------------------------------------------------------------------
+    /** Computes the absolute time which is the specified number of
+     *  milliseconds in the future, as used by pthread_cond_timedwait.
+     *  \param msec Number of milliseconds from now.
+     *  \param ts On return the absolute time.
+     */
+    static void getTimeout(int msec, struct timespec *ts)
+    {
+#ifdef WIN32
+        struct _timeb tb;
+        _ftime(&tb);
+        ts->tv_sec  = (long)tb.time;
+        ts->tv_nsec = tb.millitm * 1000000L;
+#else
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        ts->tv_sec  = tv.tv_sec;
+        ts->tv_nsec = tv.tv_usec * 1000L;
+#endif
+        ts->tv_sec  += msec / 1000;
+        ts->tv_nsec += (msec % 1000) * 1000000L;
+        if (ts->tv_nsec >= 1000000000L)
+        {
+            ts->tv_sec++;
+            ts->tv_nsec -= 1000000000L;
+        }
+    }   // getTimeout
+    // ------------------------------------------------------------------------
     /**
      * \brief Add a interval to a time.
      */
@@ -0,0 +1,110 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/transform_buffer.hpp"
+
+#include <algorithm>
+
+TransformBuffer::TransformBuffer(unsigned int max_size)
+{
+    m_max_size = std::max(max_size, 2u);
+}   // TransformBuffer
+
+// ----------------------------------------------------------------------------
+/** Interpolates between two transforms: the origin is interpolated linearly,
+ *  the rotation using slerp. Values of f outside of [0,1] extrapolate.
+ *  \param a The transform at f=0.
+ *  \param b The transform at f=1.
+ *  \param f The interpolation factor.
+ */
+btTransform TransformBuffer::interpolate(const btTransform &a,
+                                         const btTransform &b, float f)
+{
+    btTransform result;
+    result.setOrigin((1-f)*a.getOrigin() + f*b.getOrigin());
+    result.setRotation(a.getRotation().slerp(b.getRotation(), f));
+    return result;
+}   // interpolate
+
+// ----------------------------------------------------------------------------
+/** Adds a transform. Entries can be added out of order (e.g. if network
+ *  packets are re-ordered), an entry with the same time as an existing
+ *  one replaces it. If the buffer is full, the oldest entry is removed.
+ *  \param time The time of this transform.
+ *  \param transform The transform.
+ */
+void TransformBuffer::add(float time, const btTransform &transform)
+{
+    Entry e;
+    e.m_time      = time;
+    e.m_transform = transform;
+
+    // Usually the entry is appended, so search from the back
+    std::deque<Entry>::iterator i = m_entries.end();
+    while (i != m_entries.begin() && (i-1)->m_time > time)
+        i--;
+    if (i != m_entries.begin() && (i-1)->m_time == time)
+    {
+        (i-1)->m_transform = transform;
+        return;
+    }
+    // Ignore entries too old to be ever used
+    if (i == m_entries.begin() && m_entries.size() >= m_max_size)
+        return;
+    m_entries.insert(i, e);
+    if (m_entries.size() > m_max_size)
+        m_entries.pop_front();
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Computes the transform at the specified time. All entries that are older
+ *  than needed to interpolate this time are removed, so the time should
+ *  not decrease between calls.
+ *  \param time The time for which to compute the transform.
+ *  \param max_extrapolation Maximum time after the latest entry for which
+ *         the transform is extrapolated. Beyond that the extrapolated
+ *         transform at the latest entry time + max_extrapolation is used.
+ *  \param transform On return contains the transform.
+ *  \return False if no entry is available (transform is then unchanged).
+ */
+bool TransformBuffer::getTransform(float time, float max_extrapolation,
+                                   btTransform *transform)
+{
+    if (m_entries.empty())
+        return false;
+
+    // Remove entries which are not needed anymore, i.e. keep the
+    // latest entry before time.
+    while (m_entries.size() > 2 && m_entries[1].m_time <= time)
+        m_entries.pop_front();
+
+    if (m_entries.size() == 1 || time <= m_entries[0].m_time)
+    {
+        *transform = m_entries[0].m_transform;
+        return true;
+    }
+
+    const Entry &e0 = m_entries[0];
+    const Entry &e1 = m_entries[1];
+    // If there is no later entry, this extrapolates using the last two
+    if (time > e1.m_time + max_extrapolation)
+        time = e1.m_time + max_extrapolation;
+    const float f = (time - e0.m_time) / (e1.m_time - e0.m_time);
+    *transform = interpolate(e0.m_transform, e1.m_transform, f);
+    return true;
+}   // getTransform
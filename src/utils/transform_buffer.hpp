@@ -0,0 +1,72 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_TRANSFORM_BUFFER_HPP
+#define HEADER_TRANSFORM_BUFFER_HPP
+
+#include "LinearMath/btTransform.h"
+
+#include <deque>
+
+/** This class stores a list of timestamped transforms (e.g. the positions
+ *  of a kart received from the network) and computes the transform at
+ *  an arbitrary time by interpolating between the two surrounding entries.
+ *  If the requested time is after the last entry, the transform is
+ *  extrapolated from the last two entries (up to a maximum time).
+ *  Entries that are not needed anymore are discarded when a transform
+ *  is requested.
+ */
+class TransformBuffer
+{
+private:
+    /** One timestamped transform. */
+    struct Entry
+    {
+        float       m_time;
+        btTransform m_transform;
+    };   // Entry
+
+    /** The entries, sorted by time. */
+    std::deque<Entry> m_entries;
+
+    /** Maximum number of entries stored. */
+    unsigned int m_max_size;
+
+public:
+    static btTransform interpolate(const btTransform &a,
+                                   const btTransform &b, float f);
+
+         TransformBuffer(unsigned int max_size = 32);
+    void add(float time, const btTransform &transform);
+    bool getTransform(float time, float max_extrapolation,
+                      btTransform *transform);
+    // ------------------------------------------------------------------------
+    /** Removes all entries. */
+    void clear() { m_entries.clear(); }
+    // ------------------------------------------------------------------------
+    /** Returns the number of stored entries. */
+    unsigned int size() const { return (unsigned int)m_entries.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns the time of the latest entry, or 0 if there is none. */
+    float getLatestTime() const
+    {
+        return m_entries.empty() ? 0.0f : m_entries.back().m_time;
+    }   // getLatestTime
+};   // TransformBuffer
+
+#endif
@@ -44,6 +44,7 @@
 #include "io/file_manager.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/profiler.hpp"
 
 
 // set to 1 to debug i18n
@@ -174,6 +175,7 @@ wchar_t* fromFribidiChar(const FriBidiChar* str)
 // ----------------------------------------------------------------------------
 Translations::Translations() //: m_dictionary_manager("UTF-16")
 {
+    m_main_thread = pthread_self();
     m_dictionary_manager.add_directory(
                         file_manager->getAsset(FileManager::TRANSLATION,""));
 
@@ -564,6 +566,98 @@ const wchar_t* Translations::w_ngettext(const char* singular, const char* plural
     return out_ptr;
 }
 
+// ----------------------------------------------------------------------------
+/** Translates and fribidizes a string without values to insert, used by _()
+ *  and _C(). The result is cached, so that strings which are displayed each
+ *  frame (e.g. in the race gui) do not need to be converted and fribidized
+ *  again and again. The cache is only used by the main thread, so it does
+ *  not need to be locked.
+ *  \param buffer Storage for the result if it can not be cached.
+ *  \param context Optional context, can be NULL.
+ *  \param original Message to translate.
+ */
+const wchar_t* Translations::translate(FormatBuffer &&buffer,
+                                       const char *context,
+                                       const char *original)
+{
+    if (!pthread_equal(pthread_self(), m_main_thread))
+    {
+        buffer.m_string = new irr::core::stringw(
+          fribidize(StringUtils::insertValues(w_gettext(original, context))));
+        return buffer.m_string->c_str();
+    }
+
+    const std::pair<const char*, const char*> key(original, context);
+    std::map<std::pair<const char*, const char*>, CachedTranslation>::iterator
+        i = m_translation_cache.find(key);
+    if (i != m_translation_cache.end() && i->second.m_original == original &&
+        (!context || i->second.m_context == context))
+        return i->second.m_translation.c_str();
+
+    irr::core::stringw translation(
+        fribidize(StringUtils::insertValues(w_gettext(original, context))));
+
+    // Strings which are not literals can fill the cache, in which case
+    // only the strings already cached are used from the cache.
+    if (i == m_translation_cache.end() &&
+        m_translation_cache.size() >= MAX_CACHED_TRANSLATIONS)
+    {
+        buffer.m_string = new irr::core::stringw(translation);
+        return buffer.m_string->c_str();
+    }
+
+    CachedTranslation &entry = m_translation_cache[key];
+    entry.m_original    = original;
+    entry.m_context     = context ? context : "";
+    entry.m_translation = translation;
+    return entry.m_translation.c_str();
+}   // translate
+
+// ----------------------------------------------------------------------------
+/** Measures the time of 10000 lookups of strings used in the race gui with
+ *  the cache used by _(), and without the cache (i.e. the way _() worked
+ *  before), and checks that both give the same results.
+ */
+void Translations::benchmark()
+{
+    const char *strings[] = { N_("Lap"), N_("Rank"), N_("Leader"),
+                              N_("Ready!"), N_("Set!"), N_("Go!"),
+                              N_("Final lap!"), N_("WRONG WAY!"),
+                              N_("New fastest lap"), N_("GOAL!")     };
+    const unsigned int num_strings = sizeof(strings)/sizeof(strings[0]);
+    const int num_lookups = 10000;
+
+    bool all_correct = true;
+    for (unsigned int i = 0; i < num_strings; i++)
+    {
+        const irr::core::stringw uncached =
+            fribidize(StringUtils::insertValues(w_gettext(strings[i])));
+        all_correct &= uncached == translate(FormatBuffer(), NULL, strings[i]);
+    }
+
+    // Use the results so that the lookups are not optimised away
+    unsigned int length = 0;
+    double start = getTimeMilliseconds();
+    for (int i = 0; i < num_lookups; i++)
+        length += wcslen(translate(FormatBuffer(), NULL,
+                                   strings[i % num_strings]));
+    const double cached_time = getTimeMilliseconds() - start;
+
+    start = getTimeMilliseconds();
+    for (int i = 0; i < num_lookups; i++)
+        length += wcslen(fribidize(StringUtils::insertValues(
+                                  w_gettext(strings[i % num_strings]))));
+    const double uncached_time = getTimeMilliseconds() - start;
+
+    Log::info("Translations", "Language '%s': %d lookups cached %8.3f ms, "
+              "uncached %8.3f ms (%d characters).",
+              m_current_language_name.c_str(), num_lookups, cached_time,
+              uncached_time, length/2);
+    if (!all_correct)
+        Log::error("Translations", "Cached and uncached translations "
+                   "differ.");
+}   // benchmark
+
 
 bool Translations::isRTLLanguage() const
 {
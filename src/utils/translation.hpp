@@ -21,18 +21,20 @@
 
 #include <irrString.h>
 #include <map>
+#include <pthread.h>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "utils/no_copy.hpp"
 #include "utils/string_utils.hpp"
 
 #include "tinygettext/tinygettext.hpp"
 
-#  define _(String, ...)        (translations->fribidize(StringUtils::insertValues(translations->w_gettext(String), ##__VA_ARGS__)))
+#  define _(String, ...)        (translations->translate(Translations::FormatBuffer(), NULL, String, ##__VA_ARGS__))
 #undef _C
 #undef _P
-#  define _C(Ctx, String, ...)  (translations->fribidize(StringUtils::insertValues(translations->w_gettext(String, Ctx), ##__VA_ARGS__)))
+#  define _C(Ctx, String, ...)  (translations->translate(Translations::FormatBuffer(), Ctx, String, ##__VA_ARGS__))
 #  define _P(Singular, Plural, Num, ...) (translations->fribidize(StringUtils::insertValues(translations->w_ngettext(Singular, Plural, Num), Num, ##__VA_ARGS__)))
 #  define _CP(Ctx, Singular, Plural, Num, ...) (translations->fribidize(StringUtils::insertValues(translations->w_ngettext(Singular, Plural, Num, Ctx), Num, ##__VA_ARGS__)))
 #  define _LTR(String, ...)     (StringUtils::insertValues(translations->w_gettext(String), ##__VA_ARGS__))
@@ -45,7 +47,48 @@
 
 class Translations
 {
+public:
+    /** Storage for the result of _() if values are inserted into the
+     *  translation. A FormatBuffer is created as temporary in the
+     *  expression using _(), so the returned string stays valid till the
+     *  end of that expression. Nothing is allocated if it is not used. */
+    class FormatBuffer : public NoCopy
+    {
+    public:
+        irr::core::stringw *m_string;
+        FormatBuffer()  { m_string = NULL; }
+        ~FormatBuffer() { delete m_string; }
+    };   // FormatBuffer
+
 private:
+    /** A translation as returned by _() without values to insert. */
+    struct CachedTranslation
+    {
+        /** The original string and context, to detect if the same pointer
+         *  is used for a different string later. */
+        std::string        m_original;
+        std::string        m_context;
+        /** The translated and fribidized string. */
+        irr::core::stringw m_translation;
+    };   // CachedTranslation
+
+    /** Maximum number of entries in m_translation_cache. */
+    static const unsigned int MAX_CACHED_TRANSLATIONS = 4096;
+
+    /** Results of _() indexed by the pointers to the original string and
+     *  the context. Most strings are literals, so a lookup is only a
+     *  pointer comparison (and a string compare to verify the content).
+     *  A new language creates a new Translations object, so the cache
+     *  never needs to be invalidated. */
+    std::map<std::pair<const char*, const char*>, CachedTranslation>
+                                   m_translation_cache;
+
+    /** The thread that created this object (i.e. the main thread). Only
+     *  this thread uses m_translation_cache, other threads (e.g. the news
+     *  manager or the request manager) translate without the cache. */
+    pthread_t                      m_main_thread;
+
+
     tinygettext::DictionaryManager m_dictionary_manager;
     tinygettext::Dictionary        m_dictionary;
 
@@ -68,6 +111,28 @@ public:
     const wchar_t     *w_ngettext(const wchar_t* singular, const wchar_t* plural, int num, const char* context=NULL);
     const wchar_t     *w_ngettext(const char* singular, const char* plural, int num, const char* context=NULL);
 
+    const wchar_t     *translate(FormatBuffer &&buffer, const char *context,
+                                 const char *original);
+    // ------------------------------------------------------------------------
+    /** Translates a string, inserts the values and fribidizes the result.
+     *  Used by _() and _C() if there are values to insert, or if the
+     *  original is a wide string.
+     *  \param buffer Storage for the result.
+     *  \param context Optional context, can be NULL.
+     *  \param original Message to translate.
+     */
+    template<typename T, typename...Args>
+    const wchar_t     *translate(FormatBuffer &&buffer, const char *context,
+                                 const T *original, Args ...args)
+    {
+        buffer.m_string = new irr::core::stringw(
+            StringUtils::insertValues(w_gettext(original, context),
+                                      std::forward<Args>(args)...));
+        return fribidize(*buffer.m_string);
+    }   // translate
+    // ------------------------------------------------------------------------
+    void               benchmark();
+
     bool               isRTLLanguage() const;
     const wchar_t*     fribidize(const wchar_t* in_ptr);
     const wchar_t*     fribidize(const irr::core::stringw &str) { return fribidize(str.c_str()); }